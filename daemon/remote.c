@@ -4660,6 +4660,73 @@ remoteDispatchDomainListAllSnapshots(virNetServerPtr server ATTRIBUTE_UNUSED,
     return rv;
 }
 
+static int
+remoteDispatchDomainSnapshotCreateGroup(virNetServerPtr server ATTRIBUTE_UNUSED,
+                                        virNetServerClientPtr client,
+                                        virNetMessagePtr msg ATTRIBUTE_UNUSED,
+                                        virNetMessageErrorPtr rerr,
+                                        remote_domain_snapshot_create_group_args *args,
+                                        remote_domain_snapshot_create_group_ret *ret)
+{
+    virDomainPtr *doms = NULL;
+    virDomainSnapshotPtr *snaps = NULL;
+    const char **xml_descs;
+    unsigned int ndoms = 0;
+    size_t i;
+    int rv = -1;
+    struct daemonClientPrivate *priv = virNetServerClientGetPrivateData(client);
+
+    if (!priv->conn) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _("connection not open"));
+        goto cleanup;
+    }
+
+    if (args->xml_descs.xml_descs_len != args->doms.doms_len) {
+        virReportError(VIR_ERR_RPC,
+                       _("Got '%u' snapshot descriptions for '%u' domains"),
+                       args->xml_descs.xml_descs_len, args->doms.doms_len);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(doms, args->doms.doms_len) < 0)
+        goto cleanup;
+
+    for (ndoms = 0; ndoms < args->doms.doms_len; ndoms++) {
+        if (!(doms[ndoms] = get_nonnull_domain(priv->conn,
+                                               args->doms.doms_val[ndoms])))
+            goto cleanup;
+    }
+
+    xml_descs = (const char **) args->xml_descs.xml_descs_val;
+
+    if (virDomainSnapshotCreateGroup(doms, xml_descs, ndoms,
+                                     &snaps, args->flags) < 0)
+        goto cleanup;
+
+    if (VIR_ALLOC_N(ret->snaps.snaps_val, ndoms) < 0)
+        goto cleanup;
+
+    ret->snaps.snaps_len = ndoms;
+
+    for (i = 0; i < ndoms; i++)
+        make_nonnull_domain_snapshot(ret->snaps.snaps_val + i, snaps[i]);
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    if (snaps) {
+        for (i = 0; i < ndoms; i++)
+            virDomainSnapshotFree(snaps[i]);
+        VIR_FREE(snaps);
+    }
+    for (i = 0; i < ndoms; i++)
+        virDomainFree(doms[i]);
+    VIR_FREE(doms);
+    return rv;
+}
+
 static int
 remoteDispatchDomainSnapshotListAllChildren(virNetServerPtr server ATTRIBUTE_UNUSED,
                                             virNetServerClientPtr client,
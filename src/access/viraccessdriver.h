@@ -61,6 +61,30 @@ typedef int (*virAccessDriverCheckStorageVolDrv)(virAccessManagerPtr manager,
                                                  virStorageVolDefPtr vol,
                                                  virAccessPermStorageVol av);
 
+/*
+ * The bulk variants decide the same permission for a whole set
+ * of objects at once, storing each decision in @allowed. They
+ * return -1 on error, 0 otherwise.
+ */
+typedef int (*virAccessDriverCheckDomainsDrv)(virAccessManagerPtr manager,
+                                              const char *driverName,
+                                              virDomainDefPtr *domains,
+                                              size_t ndomains,
+                                              virAccessPermDomain av,
+                                              bool *allowed);
+typedef int (*virAccessDriverCheckNetworksDrv)(virAccessManagerPtr manager,
+                                               const char *driverName,
+                                               virNetworkDefPtr *networks,
+                                               size_t nnetworks,
+                                               virAccessPermNetwork av,
+                                               bool *allowed);
+typedef int (*virAccessDriverCheckStoragePoolsDrv)(virAccessManagerPtr manager,
+                                                   const char *driverName,
+                                                   virStoragePoolDefPtr *pools,
+                                                   size_t npools,
+                                                   virAccessPermStoragePool av,
+                                                   bool *allowed);
+
 typedef int (*virAccessDriverSetupDrv)(virAccessManagerPtr manager);
 typedef void (*virAccessDriverCleanupDrv)(virAccessManagerPtr manager);
 
@@ -83,6 +107,10 @@ struct _virAccessDriver {
     virAccessDriverCheckSecretDrv checkSecret;
     virAccessDriverCheckStoragePoolDrv checkStoragePool;
     virAccessDriverCheckStorageVolDrv checkStorageVol;
+
+    virAccessDriverCheckDomainsDrv checkDomains;
+    virAccessDriverCheckNetworksDrv checkNetworks;
+    virAccessDriverCheckStoragePoolsDrv checkStoragePools;
 };
 
 
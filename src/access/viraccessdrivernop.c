@@ -103,6 +103,51 @@ virAccessDriverNopCheckStorageVol(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
     return 1; /* Allow */
 }
 
+static int
+virAccessDriverNopCheckDomains(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
+                               const char *driverName ATTRIBUTE_UNUSED,
+                               virDomainDefPtr *domains ATTRIBUTE_UNUSED,
+                               size_t ndomains,
+                               virAccessPermDomain perm ATTRIBUTE_UNUSED,
+                               bool *allowed)
+{
+    size_t i;
+
+    for (i = 0; i < ndomains; i++)
+        allowed[i] = true; /* Allow */
+    return 0;
+}
+
+static int
+virAccessDriverNopCheckNetworks(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
+                                const char *driverName ATTRIBUTE_UNUSED,
+                                virNetworkDefPtr *networks ATTRIBUTE_UNUSED,
+                                size_t nnetworks,
+                                virAccessPermNetwork perm ATTRIBUTE_UNUSED,
+                                bool *allowed)
+{
+    size_t i;
+
+    for (i = 0; i < nnetworks; i++)
+        allowed[i] = true; /* Allow */
+    return 0;
+}
+
+static int
+virAccessDriverNopCheckStoragePools(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
+                                    const char *driverName ATTRIBUTE_UNUSED,
+                                    virStoragePoolDefPtr *pools ATTRIBUTE_UNUSED,
+                                    size_t npools,
+                                    virAccessPermStoragePool perm ATTRIBUTE_UNUSED,
+                                    bool *allowed)
+{
+    size_t i;
+
+    for (i = 0; i < npools; i++)
+        allowed[i] = true; /* Allow */
+    return 0;
+}
+
 
 virAccessDriver accessDriverNop = {
     .name = "none",
@@ -115,4 +160,7 @@ virAccessDriver accessDriverNop = {
     .checkSecret = virAccessDriverNopCheckSecret,
     .checkStoragePool = virAccessDriverNopCheckStoragePool,
     .checkStorageVol = virAccessDriverNopCheckStorageVol,
+    .checkDomains = virAccessDriverNopCheckDomains,
+    .checkNetworks = virAccessDriverNopCheckNetworks,
+    .checkStoragePools = virAccessDriverNopCheckStoragePools,
 };
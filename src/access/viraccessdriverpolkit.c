@@ -23,6 +23,7 @@
 #include "viraccessdriverpolkit.h"
 #include "viralloc.h"
 #include "vircommand.h"
+#include "virdbus.h"
 #include "virlog.h"
 #include "virprocess.h"
 #include "virerror.h"
@@ -38,17 +39,89 @@ VIR_LOG_INIT("access.accessdriverpolkit");
 
 #define VIR_ACCESS_DRIVER_POLKIT_ACTION_PREFIX "org.libvirt.api"
 
+#define VIR_ACCESS_DRIVER_POLKIT_CHANGED_MATCH                          \
+    "type='signal'"                                                     \
+    ",interface='org.freedesktop.PolicyKit1.Authority'"                 \
+    ",member='Changed'"
+
 typedef struct _virAccessDriverPolkitPrivate virAccessDriverPolkitPrivate;
 typedef virAccessDriverPolkitPrivate *virAccessDriverPolkitPrivatePtr;
 
 struct _virAccessDriverPolkitPrivate {
-    bool ignore;
+    bool watching;
 };
 
 
+#ifdef WITH_DBUS
+static DBusHandlerResult
+virAccessDriverPolkitChanged(DBusConnection *connection ATTRIBUTE_UNUSED,
+                             DBusMessage *message,
+                             void *opaque)
+{
+    virAccessManagerPtr manager = opaque;
+
+    if (dbus_message_is_signal(message,
+                               "org.freedesktop.PolicyKit1.Authority",
+                               "Changed")) {
+        VIR_DEBUG("Policy kit authority changed, dropping cached decisions");
+        virAccessManagerCacheInvalidate(manager);
+    }
+
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+
+static int virAccessDriverPolkitSetup(virAccessManagerPtr manager)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    DBusConnection *sysbus;
+
+    if (!(sysbus = virDBusGetSystemBus()))
+        return -1;
+
+    /* Decisions are cached by the access manager, so they must
+     * be forgotten whenever the polkit policy or the set of
+     * temporary authorizations changes */
+    dbus_bus_add_match(sysbus, VIR_ACCESS_DRIVER_POLKIT_CHANGED_MATCH, NULL);
+    if (!dbus_connection_add_filter(sysbus, virAccessDriverPolkitChanged,
+                                    manager, NULL)) {
+        dbus_bus_remove_match(sysbus, VIR_ACCESS_DRIVER_POLKIT_CHANGED_MATCH,
+                              NULL);
+        virReportOOMError();
+        return -1;
+    }
+    priv->watching = true;
+
+    return 0;
+}
+
+
+static void virAccessDriverPolkitCleanup(virAccessManagerPtr manager)
+{
+    virAccessDriverPolkitPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    DBusConnection *sysbus;
+
+    if (!priv->watching ||
+        !(sysbus = virDBusGetSystemBus()))
+        return;
+
+    dbus_connection_remove_filter(sysbus, virAccessDriverPolkitChanged,
+                                  manager);
+    dbus_bus_remove_match(sysbus, VIR_ACCESS_DRIVER_POLKIT_CHANGED_MATCH,
+                          NULL);
+    priv->watching = false;
+}
+#else /* !WITH_DBUS */
+static int virAccessDriverPolkitSetup(virAccessManagerPtr manager ATTRIBUTE_UNUSED)
+{
+    return 0;
+}
+
+
 static void virAccessDriverPolkitCleanup(virAccessManagerPtr manager ATTRIBUTE_UNUSED)
 {
 }
+#endif /* !WITH_DBUS */
 
 
 static char *
@@ -71,23 +144,24 @@ virAccessDriverPolkitFormatAction(const char *typename,
 }
 
 
-static char *
-virAccessDriverPolkitFormatProcess(const char *actionid)
+static int
+virAccessDriverPolkitGetCaller(const char *actionid,
+                               pid_t *pid,
+                               unsigned long long *startTime,
+                               uid_t *uid)
 {
     virIdentityPtr identity = virIdentityGetCurrent();
     const char *callerPid = NULL;
     const char *callerTime = NULL;
     const char *callerUid = NULL;
-    char *ret = NULL;
-#ifndef PKCHECK_SUPPORTS_UID
-    static bool polkitInsecureWarned;
-#endif
+    long long val;
+    int ret = -1;
 
     if (!identity) {
         virAccessError(VIR_ERR_ACCESS_DENIED,
                        _("Policy kit denied action %s from <anonymous>"),
                        actionid);
-        return NULL;
+        return -1;
     }
     if (virIdentityGetAttr(identity, VIR_IDENTITY_ATTR_UNIX_PROCESS_ID, &callerPid) < 0)
         goto cleanup;
@@ -112,18 +186,25 @@ virAccessDriverPolkitFormatProcess(const char *actionid)
         goto cleanup;
     }
 
-#ifdef PKCHECK_SUPPORTS_UID
-    if (virAsprintf(&ret, "%s,%s,%s", callerPid, callerTime, callerUid) < 0)
+    if (virStrToLong_ll(callerPid, NULL, 10, &val) < 0) {
+        virAccessError(VIR_ERR_INTERNAL_ERROR,
+                       _("Cannot parse process ID '%s'"), callerPid);
+        goto cleanup;
+    }
+    *pid = val;
+    if (virStrToLong_ull(callerTime, NULL, 10, startTime) < 0) {
+        virAccessError(VIR_ERR_INTERNAL_ERROR,
+                       _("Cannot parse process start time '%s'"), callerTime);
         goto cleanup;
-#else
-    if (!polkitInsecureWarned) {
-        VIR_WARN("No support for caller UID with pkcheck. "
-                 "This deployment is known to be insecure.");
-        polkitInsecureWarned = true;
     }
-    if (virAsprintf(&ret, "%s,%s", callerPid, callerTime) < 0)
+    if (virStrToLong_ll(callerUid, NULL, 10, &val) < 0) {
+        virAccessError(VIR_ERR_INTERNAL_ERROR,
+                       _("Cannot parse user ID '%s'"), callerUid);
         goto cleanup;
-#endif
+    }
+    *uid = val;
+
+    ret = 0;
 
  cleanup:
     virObjectUnref(identity);
@@ -131,23 +212,167 @@ virAccessDriverPolkitFormatProcess(const char *actionid)
 }
 
 
+#ifdef WITH_DBUS
+/*
+ * Asks polkitd directly, using the same CheckAuthorization
+ * method pkcheck would call on our behalf:
+ *
+ *  CheckAuthorization(in  (sa{sv}) subject,
+ *                     in  s        action_id,
+ *                     in  a{ss}    details,
+ *                     in  u        flags,
+ *                     in  s        cancellation_id,
+ *                     out (bba{ss}) result);
+ *
+ * One request is made per object in @attrs, and all of them
+ * are queued before waiting for the first decision. Each
+ * decision is stored in @results as 1 (allowed), 0 (denied)
+ * or -1 (could not be checked, error logged).
+ */
 static int
-virAccessDriverPolkitCheck(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
-                           const char *typename,
-                           const char *permname,
-                           const char **attrs)
+virAccessDriverPolkitCheckActions(const char *actionid,
+                                  const char **const *attrs,
+                                  size_t nobjects,
+                                  int *results)
 {
-    char *actionid = NULL;
+    DBusConnection *sysbus;
+    DBusMessage **calls = NULL;
+    DBusMessage **replies = NULL;
+    pid_t pid;
+    unsigned long long startTime;
+    uid_t uid;
+    size_t i;
+    int ret = -1;
+
+    if (virAccessDriverPolkitGetCaller(actionid, &pid, &startTime, &uid) < 0)
+        return -1;
+
+    VIR_DEBUG("Check action '%s' on %zu objects for process '%lld' "
+              "time '%llu' uid '%d'",
+              actionid, nobjects, (long long) pid, startTime, (int) uid);
+
+    if (!(sysbus = virDBusGetSystemBus()))
+        return -1;
+
+    if (VIR_ALLOC_N(calls, nobjects) < 0 ||
+        VIR_ALLOC_N(replies, nobjects) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nobjects; i++) {
+        const char **details = attrs[i];
+        size_t ndetails = 0;
+
+        while (details && details[ndetails * 2] && details[(ndetails * 2) + 1])
+            ndetails++;
+
+        if (virDBusCreateMethod(&calls[i],
+                                "org.freedesktop.PolicyKit1",
+                                "/org/freedesktop/PolicyKit1/Authority",
+                                "org.freedesktop.PolicyKit1.Authority",
+                                "CheckAuthorization",
+                                "(sa{sv})sa&{ss}us",
+                                "unix-process",
+                                3,
+                                "pid", "u", (unsigned int) pid,
+                                "start-time", "t", startTime,
+                                "uid", "i", (int) uid,
+                                actionid,
+                                (int) ndetails, details,
+                                0, /* no user interaction */
+                                "" /* cancellation ID */) < 0)
+            goto cleanup;
+    }
+
+    if (virDBusCallMultiple(sysbus, calls, nobjects, replies) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nobjects; i++) {
+        int isAuthorized = 0;
+        int isChallenge = 0;
+
+        results[i] = -1;
+        if (!replies[i])
+            continue;
+
+        /* The details returned alongside the decision are of no
+         * interest to us, so decode none of them */
+        if (virDBusMessageRead(replies[i],
+                               "(bba{ss})",
+                               &isAuthorized,
+                               &isChallenge,
+                               0) < 0)
+            continue;
+
+        if (isAuthorized) {
+            results[i] = 1; /* Allowed */
+        } else {
+            VIR_DEBUG("Policy kit denied action %s from %lld (challenge %d)",
+                      actionid, (long long) pid, isChallenge);
+            results[i] = 0; /* Denied */
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; calls && i < nobjects; i++)
+        virDBusMessageUnref(calls[i]);
+    for (i = 0; replies && i < nobjects; i++)
+        virDBusMessageUnref(replies[i]);
+    VIR_FREE(calls);
+    VIR_FREE(replies);
+    return ret;
+}
+
+
+static int
+virAccessDriverPolkitCheckAction(const char *actionid,
+                                 const char **attrs)
+{
+    int result;
+
+    if (virAccessDriverPolkitCheckActions(actionid, &attrs, 1, &result) < 0)
+        return -1;
+
+    if (result < 0)
+        virAccessError(VIR_ERR_ACCESS_DENIED,
+                       _("Policy kit failed to check action %s"),
+                       actionid);
+
+    return result;
+}
+#else /* !WITH_DBUS */
+static int
+virAccessDriverPolkitCheckAction(const char *actionid,
+                                 const char **attrs)
+{
+    pid_t pid;
+    unsigned long long startTime;
+    uid_t uid;
     char *process = NULL;
     virCommandPtr cmd = NULL;
     int status;
     int ret = -1;
+# ifndef PKCHECK_SUPPORTS_UID
+    static bool polkitInsecureWarned;
+# endif
 
-    if (!(actionid = virAccessDriverPolkitFormatAction(typename, permname)))
-        goto cleanup;
+    if (virAccessDriverPolkitGetCaller(actionid, &pid, &startTime, &uid) < 0)
+        return -1;
 
-    if (!(process = virAccessDriverPolkitFormatProcess(actionid)))
+# ifdef PKCHECK_SUPPORTS_UID
+    if (virAsprintf(&process, "%lld,%llu,%d",
+                    (long long) pid, startTime, (int) uid) < 0)
+        goto cleanup;
+# else
+    if (!polkitInsecureWarned) {
+        VIR_WARN("No support for caller UID with pkcheck. "
+                 "This deployment is known to be insecure.");
+        polkitInsecureWarned = true;
+    }
+    if (virAsprintf(&process, "%lld,%llu", (long long) pid, startTime) < 0)
         goto cleanup;
+# endif
 
     VIR_DEBUG("Check action '%s' for process '%s'", actionid, process);
 
@@ -183,12 +408,131 @@ virAccessDriverPolkitCheck(virAccessManagerPtr manager ATTRIBUTE_UNUSED,
 
  cleanup:
     virCommandFree(cmd);
-    VIR_FREE(actionid);
     VIR_FREE(process);
     return ret;
 }
 
 
+static int
+virAccessDriverPolkitCheckActions(const char *actionid,
+                                  const char **const *attrs,
+                                  size_t nobjects,
+                                  int *results)
+{
+    size_t i;
+
+    for (i = 0; i < nobjects; i++)
+        results[i] = virAccessDriverPolkitCheckAction(actionid, attrs[i]);
+
+    return 0;
+}
+#endif /* !WITH_DBUS */
+
+
+static int
+virAccessDriverPolkitCheck(virAccessManagerPtr manager,
+                           const char *typename,
+                           const char *permname,
+                           const char **attrs)
+{
+    char *actionid = NULL;
+    int ret;
+
+    if ((ret = virAccessManagerCacheLookup(manager, typename,
+                                           permname, attrs)) >= 0) {
+        VIR_DEBUG("Using cached decision %d for %s %s",
+                  ret, typename, permname);
+        return ret;
+    }
+
+    if (!(actionid = virAccessDriverPolkitFormatAction(typename, permname)))
+        return -1;
+
+    if ((ret = virAccessDriverPolkitCheckAction(actionid, attrs)) >= 0)
+        virAccessManagerCacheAdd(manager, typename, permname, attrs, ret == 1);
+
+    VIR_FREE(actionid);
+    return ret;
+}
+
+
+/*
+ * Decides @permname for @nobjects objects whose attributes
+ * are laid out one after the other in @attrs, each list being
+ * NULL terminated within @stride elements. Cached decisions
+ * are reused, all the others are requested from polkit in a
+ * single batch.
+ */
+static int
+virAccessDriverPolkitCheckBulk(virAccessManagerPtr manager,
+                               const char *typename,
+                               const char *permname,
+                               const char **attrs,
+                               size_t stride,
+                               size_t nobjects,
+                               bool *allowed)
+{
+    char *actionid = NULL;
+    const char ***missingAttrs = NULL;
+    size_t *missing = NULL;
+    size_t nmissing = 0;
+    int *results = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(missing, nobjects) < 0 ||
+        VIR_ALLOC_N(missingAttrs, nobjects) < 0 ||
+        VIR_ALLOC_N(results, nobjects) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nobjects; i++) {
+        const char **objattrs = attrs + (i * stride);
+        int rv = virAccessManagerCacheLookup(manager, typename,
+                                             permname, objattrs);
+
+        if (rv >= 0) {
+            allowed[i] = rv == 1;
+        } else {
+            missing[nmissing] = i;
+            missingAttrs[nmissing] = objattrs;
+            nmissing++;
+        }
+    }
+
+    VIR_DEBUG("Checking %zu of %zu %s objects for %s",
+              nmissing, nobjects, typename, permname);
+
+    if (nmissing == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (!(actionid = virAccessDriverPolkitFormatAction(typename, permname)))
+        goto cleanup;
+
+    if (virAccessDriverPolkitCheckActions(actionid,
+                                          (const char **const *) missingAttrs,
+                                          nmissing, results) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nmissing; i++) {
+        allowed[missing[i]] = results[i] == 1;
+        if (results[i] >= 0)
+            virAccessManagerCacheAdd(manager, typename, permname,
+                                     missingAttrs[i], results[i] == 1);
+    }
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(actionid);
+    VIR_FREE(missing);
+    VIR_FREE(missingAttrs);
+    VIR_FREE(results);
+    return ret;
+}
+
+
 static int
 virAccessDriverPolkitCheckConnect(virAccessManagerPtr manager,
                                   const char *driverName,
@@ -415,9 +759,139 @@ virAccessDriverPolkitCheckStorageVol(virAccessManagerPtr manager,
                                       attrs);
 }
 
+static int
+virAccessDriverPolkitCheckDomains(virAccessManagerPtr manager,
+                                  const char *driverName,
+                                  virDomainDefPtr *domains,
+                                  size_t ndomains,
+                                  virAccessPermDomain perm,
+                                  bool *allowed)
+{
+    const size_t stride = 7;
+    const char **attrs = NULL;
+    char *uuidstrs = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(attrs, ndomains * stride) < 0 ||
+        VIR_ALLOC_N(uuidstrs, ndomains * VIR_UUID_STRING_BUFLEN) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ndomains; i++) {
+        const char **objattrs = attrs + (i * stride);
+        char *uuidstr = uuidstrs + (i * VIR_UUID_STRING_BUFLEN);
+
+        virUUIDFormat(domains[i]->uuid, uuidstr);
+        objattrs[0] = "connect_driver";
+        objattrs[1] = driverName;
+        objattrs[2] = "domain_name";
+        objattrs[3] = domains[i]->name;
+        objattrs[4] = "domain_uuid";
+        objattrs[5] = uuidstr;
+        /* objattrs[6] stays NULL, terminating the list */
+    }
+
+    ret = virAccessDriverPolkitCheckBulk(manager,
+                                         "domain",
+                                         virAccessPermDomainTypeToString(perm),
+                                         attrs, stride, ndomains, allowed);
+
+ cleanup:
+    VIR_FREE(attrs);
+    VIR_FREE(uuidstrs);
+    return ret;
+}
+
+static int
+virAccessDriverPolkitCheckNetworks(virAccessManagerPtr manager,
+                                   const char *driverName,
+                                   virNetworkDefPtr *networks,
+                                   size_t nnetworks,
+                                   virAccessPermNetwork perm,
+                                   bool *allowed)
+{
+    const size_t stride = 7;
+    const char **attrs = NULL;
+    char *uuidstrs = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(attrs, nnetworks * stride) < 0 ||
+        VIR_ALLOC_N(uuidstrs, nnetworks * VIR_UUID_STRING_BUFLEN) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nnetworks; i++) {
+        const char **objattrs = attrs + (i * stride);
+        char *uuidstr = uuidstrs + (i * VIR_UUID_STRING_BUFLEN);
+
+        virUUIDFormat(networks[i]->uuid, uuidstr);
+        objattrs[0] = "connect_driver";
+        objattrs[1] = driverName;
+        objattrs[2] = "network_name";
+        objattrs[3] = networks[i]->name;
+        objattrs[4] = "network_uuid";
+        objattrs[5] = uuidstr;
+        /* objattrs[6] stays NULL, terminating the list */
+    }
+
+    ret = virAccessDriverPolkitCheckBulk(manager,
+                                         "network",
+                                         virAccessPermNetworkTypeToString(perm),
+                                         attrs, stride, nnetworks, allowed);
+
+ cleanup:
+    VIR_FREE(attrs);
+    VIR_FREE(uuidstrs);
+    return ret;
+}
+
+static int
+virAccessDriverPolkitCheckStoragePools(virAccessManagerPtr manager,
+                                       const char *driverName,
+                                       virStoragePoolDefPtr *pools,
+                                       size_t npools,
+                                       virAccessPermStoragePool perm,
+                                       bool *allowed)
+{
+    const size_t stride = 7;
+    const char **attrs = NULL;
+    char *uuidstrs = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (VIR_ALLOC_N(attrs, npools * stride) < 0 ||
+        VIR_ALLOC_N(uuidstrs, npools * VIR_UUID_STRING_BUFLEN) < 0)
+        goto cleanup;
+
+    for (i = 0; i < npools; i++) {
+        const char **objattrs = attrs + (i * stride);
+        char *uuidstr = uuidstrs + (i * VIR_UUID_STRING_BUFLEN);
+
+        virUUIDFormat(pools[i]->uuid, uuidstr);
+        objattrs[0] = "connect_driver";
+        objattrs[1] = driverName;
+        objattrs[2] = "pool_name";
+        objattrs[3] = pools[i]->name;
+        objattrs[4] = "pool_uuid";
+        objattrs[5] = uuidstr;
+        /* objattrs[6] stays NULL, terminating the list */
+    }
+
+    ret = virAccessDriverPolkitCheckBulk(manager,
+                                         "storage-pool",
+                                         virAccessPermStoragePoolTypeToString(perm),
+                                         attrs, stride, npools, allowed);
+
+ cleanup:
+    VIR_FREE(attrs);
+    VIR_FREE(uuidstrs);
+    return ret;
+}
+
 virAccessDriver accessDriverPolkit = {
     .privateDataLen = sizeof(virAccessDriverPolkitPrivate),
     .name = "polkit",
+    .setup = virAccessDriverPolkitSetup,
     .cleanup = virAccessDriverPolkitCleanup,
     .checkConnect = virAccessDriverPolkitCheckConnect,
     .checkDomain = virAccessDriverPolkitCheckDomain,
@@ -428,4 +902,7 @@ virAccessDriver accessDriverPolkit = {
     .checkSecret = virAccessDriverPolkitCheckSecret,
     .checkStoragePool = virAccessDriverPolkitCheckStoragePool,
     .checkStorageVol = virAccessDriverPolkitCheckStorageVol,
+    .checkDomains = virAccessDriverPolkitCheckDomains,
+    .checkNetworks = virAccessDriverPolkitCheckNetworks,
+    .checkStoragePools = virAccessDriverPolkitCheckStoragePools,
 };
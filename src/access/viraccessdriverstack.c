@@ -268,6 +268,114 @@ virAccessDriverStackCheckStorageVol(virAccessManagerPtr manager,
     return ret;
 }
 
+static int
+virAccessDriverStackCheckDomains(virAccessManagerPtr manager,
+                                 const char *driverName,
+                                 virDomainDefPtr *domains,
+                                 size_t ndomains,
+                                 virAccessPermDomain perm,
+                                 bool *allowed)
+{
+    virAccessDriverStackPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    bool *childAllowed = NULL;
+    int ret = 0;
+    size_t i, j;
+
+    if (VIR_ALLOC_N(childAllowed, ndomains) < 0)
+        return -1;
+
+    for (j = 0; j < ndomains; j++)
+        allowed[j] = true;
+
+    for (i = 0; i < priv->managersLen; i++) {
+        /* We do not short-circuit on first denial - always check all drivers */
+        if (virAccessManagerCheckDomains(priv->managers[i], driverName,
+                                         domains, ndomains, perm,
+                                         childAllowed) < 0) {
+            ret = -1;
+            continue;
+        }
+        for (j = 0; j < ndomains; j++)
+            if (!childAllowed[j])
+                allowed[j] = false;
+    }
+
+    VIR_FREE(childAllowed);
+    return ret;
+}
+
+static int
+virAccessDriverStackCheckNetworks(virAccessManagerPtr manager,
+                                  const char *driverName,
+                                  virNetworkDefPtr *networks,
+                                  size_t nnetworks,
+                                  virAccessPermNetwork perm,
+                                  bool *allowed)
+{
+    virAccessDriverStackPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    bool *childAllowed = NULL;
+    int ret = 0;
+    size_t i, j;
+
+    if (VIR_ALLOC_N(childAllowed, nnetworks) < 0)
+        return -1;
+
+    for (j = 0; j < nnetworks; j++)
+        allowed[j] = true;
+
+    for (i = 0; i < priv->managersLen; i++) {
+        /* We do not short-circuit on first denial - always check all drivers */
+        if (virAccessManagerCheckNetworks(priv->managers[i], driverName,
+                                          networks, nnetworks, perm,
+                                          childAllowed) < 0) {
+            ret = -1;
+            continue;
+        }
+        for (j = 0; j < nnetworks; j++)
+            if (!childAllowed[j])
+                allowed[j] = false;
+    }
+
+    VIR_FREE(childAllowed);
+    return ret;
+}
+
+static int
+virAccessDriverStackCheckStoragePools(virAccessManagerPtr manager,
+                                      const char *driverName,
+                                      virStoragePoolDefPtr *pools,
+                                      size_t npools,
+                                      virAccessPermStoragePool perm,
+                                      bool *allowed)
+{
+    virAccessDriverStackPrivatePtr priv = virAccessManagerGetPrivateData(manager);
+    bool *childAllowed = NULL;
+    int ret = 0;
+    size_t i, j;
+
+    if (VIR_ALLOC_N(childAllowed, npools) < 0)
+        return -1;
+
+    for (j = 0; j < npools; j++)
+        allowed[j] = true;
+
+    for (i = 0; i < priv->managersLen; i++) {
+        /* We do not short-circuit on first denial - always check all drivers */
+        if (virAccessManagerCheckStoragePools(priv->managers[i], driverName,
+                                              pools, npools, perm,
+                                              childAllowed) < 0) {
+            ret = -1;
+            continue;
+        }
+        for (j = 0; j < npools; j++)
+            if (!childAllowed[j])
+                allowed[j] = false;
+    }
+
+    VIR_FREE(childAllowed);
+    return ret;
+}
+
 virAccessDriver accessDriverStack = {
     .privateDataLen = sizeof(virAccessDriverStackPrivate),
     .name = "stack",
@@ -281,4 +389,7 @@ virAccessDriver accessDriverStack = {
     .checkSecret = virAccessDriverStackCheckSecret,
     .checkStoragePool = virAccessDriverStackCheckStoragePool,
     .checkStorageVol = virAccessDriverStackCheckStorageVol,
+    .checkDomains = virAccessDriverStackCheckDomains,
+    .checkNetworks = virAccessDriverStackCheckNetworks,
+    .checkStoragePools = virAccessDriverStackCheckStoragePools,
 };
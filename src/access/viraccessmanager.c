@@ -27,9 +27,12 @@
 # include "viraccessdriverpolkit.h"
 #endif
 #include "viralloc.h"
+#include "virbuffer.h"
 #include "virerror.h"
+#include "virhash.h"
 #include "virobject.h"
 #include "virthread.h"
+#include "virtime.h"
 #include "virlog.h"
 
 #define VIR_FROM_THIS VIR_FROM_ACCESS
@@ -40,11 +43,26 @@ VIR_LOG_INIT("access.accessmanager");
     virReportErrorHelper(VIR_FROM_THIS, code, __FILE__,                 \
                          __FUNCTION__, __LINE__, __VA_ARGS__)
 
+/* Upper bound on the number of remembered decisions, and
+ * how long each of them is trusted for */
+#define VIR_ACCESS_MANAGER_CACHE_MAX 1024
+#define VIR_ACCESS_MANAGER_CACHE_TTL 5000 /* milliseconds */
+
+typedef struct _virAccessManagerCacheEntry virAccessManagerCacheEntry;
+typedef virAccessManagerCacheEntry *virAccessManagerCacheEntryPtr;
+struct _virAccessManagerCacheEntry {
+    bool allowed;
+    unsigned long long expires;
+};
+
 struct _virAccessManager {
     virObjectLockable parent;
 
     virAccessDriverPtr drv;
     void *privateData;
+
+    /* Decisions keyed on identity, permission and object attributes */
+    virHashTablePtr cache;
 };
 
 static virClassPtr virAccessManagerClass;
@@ -99,6 +117,12 @@ static virAccessManagerPtr virAccessManagerNewDriver(virAccessDriverPtr drv)
     mgr->drv = drv;
     mgr->privateData = privateData;
 
+    if (!(mgr->cache = virHashCreate(VIR_ACCESS_MANAGER_CACHE_MAX / 8,
+                                     virHashValueFree))) {
+        virObjectUnref(mgr);
+        return NULL;
+    }
+
     if (mgr->drv->setup &&
         mgr->drv->setup(mgr) < 0) {
         virObjectUnref(mgr);
@@ -189,6 +213,183 @@ static void virAccessManagerDispose(void *object)
     if (mgr->drv->cleanup)
         mgr->drv->cleanup(mgr);
     VIR_FREE(mgr->privateData);
+    virHashFree(mgr->cache);
+}
+
+
+/*
+ * Builds the cache key for a check made on behalf of the
+ * current identity. Each component is length prefixed so
+ * that attribute values cannot be confused with separators.
+ * Returns NULL, without reporting an error, if there is no
+ * identity to key on.
+ */
+static char *
+virAccessManagerCacheKey(const char *typename,
+                         const char *permname,
+                         const char **attrs)
+{
+    virIdentityPtr identity = virIdentityGetCurrent();
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    if (!identity)
+        return NULL;
+
+    for (i = 0; i < VIR_IDENTITY_ATTR_LAST; i++) {
+        const char *value = NULL;
+
+        ignore_value(virIdentityGetAttr(identity, i, &value));
+        if (!value)
+            value = "";
+        virBufferAsprintf(&buf, "%zu:%s", strlen(value), value);
+    }
+    virObjectUnref(identity);
+
+    virBufferAsprintf(&buf, "%zu:%s%zu:%s",
+                      strlen(typename), typename,
+                      strlen(permname), permname);
+    while (attrs && attrs[0] && attrs[1]) {
+        virBufferAsprintf(&buf, "%zu:%s%zu:%s",
+                          strlen(attrs[0]), attrs[0],
+                          strlen(attrs[1]), attrs[1]);
+        attrs += 2;
+    }
+
+    if (virBufferError(&buf)) {
+        virBufferFreeAndReset(&buf);
+        return NULL;
+    }
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+/**
+ * virAccessManagerCacheLookup:
+ * @mgr: the access manager
+ * @typename: the object type being checked
+ * @permname: the permission being checked
+ * @attrs: NULL terminated list of object attribute name/value pairs
+ *
+ * Look for a decision previously recorded with virAccessManagerCacheAdd
+ * for the current identity which has not yet expired.
+ *
+ * Returns 1 if access was allowed, 0 if it was denied and -1 if there
+ * is no usable cached decision. No error is reported.
+ */
+int
+virAccessManagerCacheLookup(virAccessManagerPtr mgr,
+                            const char *typename,
+                            const char *permname,
+                            const char **attrs)
+{
+    virAccessManagerCacheEntryPtr entry;
+    unsigned long long now;
+    char *key;
+    int ret = -1;
+
+    if (!(key = virAccessManagerCacheKey(typename, permname, attrs)))
+        return -1;
+
+    if (virTimeMillisNow(&now) < 0) {
+        virResetLastError();
+        VIR_FREE(key);
+        return -1;
+    }
+
+    virObjectLock(mgr);
+    if ((entry = virHashLookup(mgr->cache, key))) {
+        if (entry->expires > now)
+            ret = entry->allowed ? 1 : 0;
+        else
+            virHashRemoveEntry(mgr->cache, key);
+    }
+    virObjectUnlock(mgr);
+
+    VIR_FREE(key);
+    return ret;
+}
+
+
+static int
+virAccessManagerCacheExpired(const void *payload,
+                             const void *name ATTRIBUTE_UNUSED,
+                             const void *opaque)
+{
+    const virAccessManagerCacheEntry *entry = payload;
+    const unsigned long long *now = opaque;
+
+    return entry->expires <= *now;
+}
+
+
+/**
+ * virAccessManagerCacheAdd:
+ * @mgr: the access manager
+ * @typename: the object type being checked
+ * @permname: the permission being checked
+ * @attrs: NULL terminated list of object attribute name/value pairs
+ * @allowed: the decision made
+ *
+ * Remember the decision for the current identity for a short
+ * while. Failure to record it is not an error, so nothing is
+ * reported.
+ */
+void
+virAccessManagerCacheAdd(virAccessManagerPtr mgr,
+                         const char *typename,
+                         const char *permname,
+                         const char **attrs,
+                         bool allowed)
+{
+    virAccessManagerCacheEntryPtr entry = NULL;
+    unsigned long long now;
+    char *key;
+
+    if (!(key = virAccessManagerCacheKey(typename, permname, attrs)))
+        return;
+
+    if (virTimeMillisNow(&now) < 0 ||
+        VIR_ALLOC_QUIET(entry) < 0) {
+        virResetLastError();
+        VIR_FREE(key);
+        return;
+    }
+
+    entry->allowed = allowed;
+    entry->expires = now + VIR_ACCESS_MANAGER_CACHE_TTL;
+
+    virObjectLock(mgr);
+    if (virHashSize(mgr->cache) >= VIR_ACCESS_MANAGER_CACHE_MAX) {
+        virHashRemoveSet(mgr->cache, virAccessManagerCacheExpired, &now);
+        if (virHashSize(mgr->cache) >= VIR_ACCESS_MANAGER_CACHE_MAX)
+            virHashRemoveAll(mgr->cache);
+    }
+    if (virHashUpdateEntry(mgr->cache, key, entry) < 0) {
+        virResetLastError();
+        VIR_FREE(entry);
+    }
+    virObjectUnlock(mgr);
+
+    VIR_FREE(key);
+}
+
+
+/**
+ * virAccessManagerCacheInvalidate:
+ * @mgr: the access manager
+ *
+ * Forget all cached decisions, for example because the
+ * authorization policy has changed.
+ */
+void
+virAccessManagerCacheInvalidate(virAccessManagerPtr mgr)
+{
+    virObjectLock(mgr);
+    VIR_DEBUG("Dropping %zd cached decisions", virHashSize(mgr->cache));
+    virHashRemoveAll(mgr->cache);
+    virObjectUnlock(mgr);
 }
 
 
@@ -344,3 +545,127 @@ int virAccessManagerCheckStorageVol(virAccessManagerPtr manager,
 
     return virAccessManagerSanitizeError(ret);
 }
+
+
+/*
+ * Decides @perm for every one of @domains at once. Drivers
+ * without a bulk implementation get one check per object.
+ * Any single object which could not be checked is denied.
+ */
+int virAccessManagerCheckDomains(virAccessManagerPtr manager,
+                                 const char *driverName,
+                                 virDomainDefPtr *domains,
+                                 size_t ndomains,
+                                 virAccessPermDomain perm,
+                                 bool *allowed)
+{
+    int ret = 0;
+    size_t i;
+    VIR_DEBUG("manager=%p(name=%s) driver=%s ndomains=%zu perm=%d",
+              manager, manager->drv->name, driverName, ndomains, perm);
+
+    if (manager->drv->checkDomains) {
+        ret = manager->drv->checkDomains(manager, driverName,
+                                         domains, ndomains, perm, allowed);
+    } else {
+        for (i = 0; i < ndomains; i++) {
+            int rv = 1;
+            if (manager->drv->checkDomain)
+                rv = manager->drv->checkDomain(manager, driverName,
+                                               domains[i], perm);
+            /* The error has been logged, deny just this object */
+            if (rv < 0)
+                virResetLastError();
+            allowed[i] = rv == 1;
+        }
+    }
+
+    if (ret < 0) {
+        for (i = 0; i < ndomains; i++)
+            allowed[i] = false;
+    }
+
+    return virAccessManagerSanitizeError(ret);
+}
+
+/*
+ * Decides @perm for every one of @networks at once. Drivers
+ * without a bulk implementation get one check per object.
+ * Any single object which could not be checked is denied.
+ */
+int virAccessManagerCheckNetworks(virAccessManagerPtr manager,
+                                  const char *driverName,
+                                  virNetworkDefPtr *networks,
+                                  size_t nnetworks,
+                                  virAccessPermNetwork perm,
+                                  bool *allowed)
+{
+    int ret = 0;
+    size_t i;
+    VIR_DEBUG("manager=%p(name=%s) driver=%s nnetworks=%zu perm=%d",
+              manager, manager->drv->name, driverName, nnetworks, perm);
+
+    if (manager->drv->checkNetworks) {
+        ret = manager->drv->checkNetworks(manager, driverName,
+                                          networks, nnetworks, perm, allowed);
+    } else {
+        for (i = 0; i < nnetworks; i++) {
+            int rv = 1;
+            if (manager->drv->checkNetwork)
+                rv = manager->drv->checkNetwork(manager, driverName,
+                                                networks[i], perm);
+            /* The error has been logged, deny just this object */
+            if (rv < 0)
+                virResetLastError();
+            allowed[i] = rv == 1;
+        }
+    }
+
+    if (ret < 0) {
+        for (i = 0; i < nnetworks; i++)
+            allowed[i] = false;
+    }
+
+    return virAccessManagerSanitizeError(ret);
+}
+
+/*
+ * Decides @perm for every one of @pools at once. Drivers
+ * without a bulk implementation get one check per object.
+ * Any single object which could not be checked is denied.
+ */
+int virAccessManagerCheckStoragePools(virAccessManagerPtr manager,
+                                      const char *driverName,
+                                      virStoragePoolDefPtr *pools,
+                                      size_t npools,
+                                      virAccessPermStoragePool perm,
+                                      bool *allowed)
+{
+    int ret = 0;
+    size_t i;
+    VIR_DEBUG("manager=%p(name=%s) driver=%s npools=%zu perm=%d",
+              manager, manager->drv->name, driverName, npools, perm);
+
+    if (manager->drv->checkStoragePools) {
+        ret = manager->drv->checkStoragePools(manager, driverName,
+                                              pools, npools, perm, allowed);
+    } else {
+        for (i = 0; i < npools; i++) {
+            int rv = 1;
+            if (manager->drv->checkStoragePool)
+                rv = manager->drv->checkStoragePool(manager, driverName,
+                                                    pools[i], perm);
+            /* The error has been logged, deny just this object */
+            if (rv < 0)
+                virResetLastError();
+            allowed[i] = rv == 1;
+        }
+    }
+
+    if (ret < 0) {
+        for (i = 0; i < npools; i++)
+            allowed[i] = false;
+    }
+
+    return virAccessManagerSanitizeError(ret);
+}
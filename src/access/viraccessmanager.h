@@ -43,6 +43,17 @@ virAccessManagerPtr virAccessManagerNewStack(const char **names);
 
 void *virAccessManagerGetPrivateData(virAccessManagerPtr manager);
 
+int virAccessManagerCacheLookup(virAccessManagerPtr manager,
+                                const char *typename,
+                                const char *permname,
+                                const char **attrs);
+void virAccessManagerCacheAdd(virAccessManagerPtr manager,
+                              const char *typename,
+                              const char *permname,
+                              const char **attrs,
+                              bool allowed);
+void virAccessManagerCacheInvalidate(virAccessManagerPtr manager);
+
 
 /*
  * The virAccessManagerCheckXXX functions will
@@ -88,4 +99,28 @@ int virAccessManagerCheckStorageVol(virAccessManagerPtr manager,
                                     virAccessPermStorageVol perm);
 
 
+/*
+ * The bulk virAccessManagerCheckXXXs functions will
+ * Return -1 on error, treating every object as denied
+ * Return 0 otherwise, with each decision stored in @allowed
+ */
+int virAccessManagerCheckDomains(virAccessManagerPtr manager,
+                                 const char *driverName,
+                                 virDomainDefPtr *domains,
+                                 size_t ndomains,
+                                 virAccessPermDomain perm,
+                                 bool *allowed);
+int virAccessManagerCheckNetworks(virAccessManagerPtr manager,
+                                  const char *driverName,
+                                  virNetworkDefPtr *networks,
+                                  size_t nnetworks,
+                                  virAccessPermNetwork perm,
+                                  bool *allowed);
+int virAccessManagerCheckStoragePools(virAccessManagerPtr manager,
+                                      const char *driverName,
+                                      virStoragePoolDefPtr *pools,
+                                      size_t npools,
+                                      virAccessPermStoragePool perm,
+                                      bool *allowed);
+
 #endif /* __VIR_ACCESS_MANAGER_H__ */
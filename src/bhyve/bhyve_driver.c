@@ -726,7 +726,7 @@ bhyveConnectListAllDomains(virConnectPtr conn,
         return -1;
 
     ret = virDomainObjListExport(privconn->domains, conn, domains,
-                                 virConnectListAllDomainsCheckACL, flags);
+                                 virConnectListAllDomainsCheckACLBulk, flags);
 
     return ret;
 }
@@ -171,6 +171,7 @@ typedef int (*virDomainDefNamespaceParse)(xmlDocPtr, xmlNodePtr,
 typedef void (*virDomainDefNamespaceFree)(void *);
 typedef int (*virDomainDefNamespaceXMLFormat)(virBufferPtr, void *);
 typedef const char *(*virDomainDefNamespaceHref)(void);
+typedef int (*virDomainDefNamespaceCopy)(void *, void **);
 
 typedef struct _virDomainXMLNamespace virDomainXMLNamespace;
 typedef virDomainXMLNamespace *virDomainXMLNamespacePtr;
@@ -179,6 +180,7 @@ struct _virDomainXMLNamespace {
     virDomainDefNamespaceFree free;
     virDomainDefNamespaceXMLFormat format;
     virDomainDefNamespaceHref href;
+    virDomainDefNamespaceCopy copy;
 };
 
 typedef struct _virCaps virCaps;
@@ -53,6 +53,7 @@
 #include "device_conf.h"
 #include "virtpm.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_DOMAIN
 
@@ -769,6 +770,9 @@ static virClassPtr virDomainXMLOptionClass;
 static void virDomainObjDispose(void *obj);
 static void virDomainObjListDispose(void *obj);
 static void virDomainXMLOptionClassDispose(void *obj);
+static int virDomainHostdevDefCopyData(virDomainHostdevDefPtr dst,
+                                       virDomainHostdevDefPtr src,
+                                       unsigned int flags);
 
 static int virDomainObjOnceInit(void)
 {
@@ -1094,6 +1098,23 @@ virDomainDeviceInfoFree(virDomainDeviceInfoPtr info)
 }
 
 
+/* Copies @src into the cleared @dst the way formatting and parsing it
+ * back as inactive XML would: the live-only alias is dropped, and
+ * s390 virtio addresses are never formatted.  */
+static int
+virDomainDeviceInfoCopyConfig(virDomainDeviceInfoPtr dst,
+                              virDomainDeviceInfoPtr src)
+{
+    if (virDomainDeviceInfoCopy(dst, src) < 0)
+        return -1;
+
+    VIR_FREE(dst->alias);
+    if (dst->type == VIR_DOMAIN_DEVICE_ADDRESS_TYPE_VIRTIO_S390)
+        dst->type = VIR_DOMAIN_DEVICE_ADDRESS_TYPE_NONE;
+    return 0;
+}
+
+
 static void
 virDomainGraphicsAuthDefClear(virDomainGraphicsAuthDefPtr def)
 {
@@ -1159,6 +1180,133 @@ void virDomainGraphicsDefFree(virDomainGraphicsDefPtr def)
     VIR_FREE(def);
 }
 
+static int
+virDomainGraphicsAuthDefCopy(virDomainGraphicsAuthDefPtr dst,
+                             virDomainGraphicsAuthDefPtr src)
+{
+    dst->expires = src->expires;
+    dst->validTo = src->validTo;
+    dst->connected = src->connected;
+    return VIR_STRDUP(dst->passwd, src->passwd);
+}
+
+/* Copies @src the way formatting it with @flags and parsing it back
+ * as inactive XML would: reserved ports are forgotten, auto-allocated
+ * ones are reset and the address of a network listen is dropped.  A
+ * migratable copy also drops the listens taken from the config file
+ * of the driver.  */
+static virDomainGraphicsDefPtr
+virDomainGraphicsDefCopy(virDomainGraphicsDefPtr src,
+                         unsigned int flags)
+{
+    virDomainGraphicsDefPtr def;
+    size_t i;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+
+    switch ((virDomainGraphicsType)def->type) {
+    case VIR_DOMAIN_GRAPHICS_TYPE_VNC:
+        /* the port is not formatted along with a socket */
+        if (src->data.vnc.socket || src->data.vnc.autoport ||
+            src->data.vnc.port == 0 || src->data.vnc.port == -1)
+            def->data.vnc.autoport = true;
+        else
+            def->data.vnc.port = src->data.vnc.port;
+        def->data.vnc.websocket = src->data.vnc.websocket;
+        def->data.vnc.sharePolicy = src->data.vnc.sharePolicy;
+        if (VIR_STRDUP(def->data.vnc.socket, src->data.vnc.socket) < 0 ||
+            VIR_STRDUP(def->data.vnc.keymap, src->data.vnc.keymap) < 0 ||
+            virDomainGraphicsAuthDefCopy(&def->data.vnc.auth,
+                                         &src->data.vnc.auth) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_GRAPHICS_TYPE_SDL:
+        def->data.sdl.fullscreen = src->data.sdl.fullscreen;
+        if (VIR_STRDUP(def->data.sdl.display, src->data.sdl.display) < 0 ||
+            VIR_STRDUP(def->data.sdl.xauth, src->data.sdl.xauth) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_GRAPHICS_TYPE_RDP:
+        if (src->data.rdp.autoport ||
+            src->data.rdp.port == 0 || src->data.rdp.port == -1)
+            def->data.rdp.autoport = true;
+        else
+            def->data.rdp.port = src->data.rdp.port;
+        def->data.rdp.replaceUser = src->data.rdp.replaceUser;
+        def->data.rdp.multiUser = src->data.rdp.multiUser;
+        break;
+
+    case VIR_DOMAIN_GRAPHICS_TYPE_DESKTOP:
+        def->data.desktop.fullscreen = src->data.desktop.fullscreen;
+        if (VIR_STRDUP(def->data.desktop.display,
+                       src->data.desktop.display) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_GRAPHICS_TYPE_SPICE:
+        if (src->data.spice.autoport ||
+            (src->data.spice.port == -1 && src->data.spice.tlsPort == -1)) {
+            def->data.spice.autoport = true;
+        } else {
+            def->data.spice.port = src->data.spice.port;
+            def->data.spice.tlsPort = src->data.spice.tlsPort;
+        }
+        def->data.spice.mousemode = src->data.spice.mousemode;
+        memcpy(def->data.spice.channels, src->data.spice.channels,
+               sizeof(def->data.spice.channels));
+        def->data.spice.defaultMode = src->data.spice.defaultMode;
+        def->data.spice.image = src->data.spice.image;
+        def->data.spice.jpeg = src->data.spice.jpeg;
+        def->data.spice.zlib = src->data.spice.zlib;
+        def->data.spice.playback = src->data.spice.playback;
+        def->data.spice.streaming = src->data.spice.streaming;
+        def->data.spice.copypaste = src->data.spice.copypaste;
+        def->data.spice.filetransfer = src->data.spice.filetransfer;
+        if (VIR_STRDUP(def->data.spice.keymap, src->data.spice.keymap) < 0 ||
+            virDomainGraphicsAuthDefCopy(&def->data.spice.auth,
+                                         &src->data.spice.auth) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_GRAPHICS_TYPE_LAST:
+        break;
+    }
+
+    if (src->nListens && VIR_ALLOC_N(def->listens, src->nListens) < 0)
+        goto error;
+
+    for (i = 0; i < src->nListens; i++) {
+        virDomainGraphicsListenDefPtr listen = &def->listens[def->nListens];
+
+        /* listens without a type are never formatted */
+        if (src->listens[i].type == VIR_DOMAIN_GRAPHICS_LISTEN_TYPE_NONE)
+            continue;
+
+        if ((flags & VIR_DOMAIN_XML_MIGRATABLE) && src->listens[i].fromConfig)
+            continue;
+
+        def->nListens++;
+        listen->type = src->listens[i].type;
+        if (VIR_STRDUP(listen->network, src->listens[i].network) < 0)
+            goto error;
+        /* the address of a network listen is live status only */
+        if (listen->type == VIR_DOMAIN_GRAPHICS_LISTEN_TYPE_ADDRESS &&
+            VIR_STRDUP(listen->address, src->listens[i].address) < 0)
+            goto error;
+    }
+
+    return def;
+
+ error:
+    virDomainGraphicsDefFree(def);
+    return NULL;
+}
+
 void virDomainInputDefFree(virDomainInputDefPtr def)
 {
     if (!def)
@@ -1168,6 +1316,25 @@ void virDomainInputDefFree(virDomainInputDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainInputDefPtr
+virDomainInputDefCopy(virDomainInputDefPtr src)
+{
+    virDomainInputDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    def->bus = src->bus;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainInputDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainLeaseDefFree(virDomainLeaseDefPtr def)
 {
     if (!def)
@@ -1180,6 +1347,26 @@ void virDomainLeaseDefFree(virDomainLeaseDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainLeaseDefPtr
+virDomainLeaseDefCopy(virDomainLeaseDefPtr src)
+{
+    virDomainLeaseDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->offset = src->offset;
+
+    if (VIR_STRDUP(def->lockspace, src->lockspace) < 0 ||
+        VIR_STRDUP(def->key, src->key) < 0 ||
+        VIR_STRDUP(def->path, src->path) < 0) {
+        virDomainLeaseDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 
 virDomainDiskDefPtr
 virDomainDiskDefNew(void)
@@ -1213,6 +1400,77 @@ virDomainDiskDefFree(virDomainDiskDefPtr def)
 }
 
 
+/* Forget labelskip, which only records a failed relabel attempt of a
+ * running domain and is thus never parsed from inactive XML.  */
+static void
+virSecurityDeviceLabelDefsClearSkip(virSecurityDeviceLabelDefPtr *seclabels,
+                                    size_t nseclabels)
+{
+    size_t i;
+
+    for (i = 0; i < nseclabels; i++) {
+        if (seclabels[i]->labelskip) {
+            seclabels[i]->labelskip = false;
+            seclabels[i]->norelabel = false;
+        }
+    }
+}
+
+
+static virDomainDiskDefPtr
+virDomainDiskDefCopy(virDomainDiskDefPtr src)
+{
+    virDomainDiskDefPtr def;
+    virStorageSourcePtr n;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    /* the block job mirror is live status only */
+    def->device = src->device;
+    def->bus = src->bus;
+    def->tray_status = src->tray_status;
+    def->removable = src->removable;
+    def->geometry = src->geometry;
+    def->blockio = src->blockio;
+    def->blkdeviotune = src->blkdeviotune;
+    def->cachemode = src->cachemode;
+    def->error_policy = src->error_policy;
+    def->rerror_policy = src->rerror_policy;
+    def->iomode = src->iomode;
+    def->ioeventfd = src->ioeventfd;
+    def->event_idx = src->event_idx;
+    def->copy_on_read = src->copy_on_read;
+    def->snapshot = src->snapshot;
+    def->startupPolicy = src->startupPolicy;
+    def->transient = src->transient;
+    def->rawio_specified = src->rawio_specified;
+    def->rawio = src->rawio;
+    def->sgio = src->sgio;
+    def->discard = src->discard;
+
+    if (!(def->src = virStorageSourceCopy(src->src, true)))
+        goto error;
+
+    for (n = def->src; n; n = n->backingStore)
+        virSecurityDeviceLabelDefsClearSkip(n->seclabels, n->nseclabels);
+
+    if (VIR_STRDUP(def->dst, src->dst) < 0 ||
+        VIR_STRDUP(def->serial, src->serial) < 0 ||
+        VIR_STRDUP(def->wwn, src->wwn) < 0 ||
+        VIR_STRDUP(def->vendor, src->vendor) < 0 ||
+        VIR_STRDUP(def->product, src->product) < 0 ||
+        virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    return def;
+
+ error:
+    virDomainDiskDefFree(def);
+    return NULL;
+}
+
+
 int
 virDomainDiskGetType(virDomainDiskDefPtr def)
 {
@@ -1295,6 +1553,30 @@ void virDomainControllerDefFree(virDomainControllerDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainControllerDefPtr
+virDomainControllerDefCopy(virDomainControllerDefPtr src)
+{
+    virDomainControllerDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    def->idx = src->idx;
+    def->model = src->model;
+    def->queues = src->queues;
+    def->cmd_per_lun = src->cmd_per_lun;
+    def->max_sectors = src->max_sectors;
+    def->opts = src->opts;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainControllerDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainFSDefFree(virDomainFSDefPtr def)
 {
     if (!def)
@@ -1307,6 +1589,34 @@ void virDomainFSDefFree(virDomainFSDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainFSDefPtr
+virDomainFSDefCopy(virDomainFSDefPtr src)
+{
+    virDomainFSDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    def->fsdriver = src->fsdriver;
+    def->accessmode = src->accessmode;
+    def->wrpolicy = src->wrpolicy;
+    def->format = src->format;
+    def->usage = src->usage;
+    def->readonly = src->readonly;
+    def->space_hard_limit = src->space_hard_limit;
+    def->space_soft_limit = src->space_soft_limit;
+
+    if (VIR_STRDUP(def->src, src->src) < 0 ||
+        VIR_STRDUP(def->dst, src->dst) < 0 ||
+        virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainFSDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void
 virDomainActualNetDefFree(virDomainActualNetDefPtr def)
 {
@@ -1395,6 +1705,115 @@ void virDomainNetDefFree(virDomainNetDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainNetDefPtr
+virDomainNetDefCopy(virDomainNetDefPtr src,
+                    unsigned int flags)
+{
+    virDomainNetDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    virMacAddrSet(&def->mac, &src->mac);
+    def->driver = src->driver;
+    def->tune = src->tune;
+    def->linkstate = src->linkstate;
+
+    if (VIR_STRDUP(def->model, src->model) < 0 ||
+        VIR_STRDUP(def->script, src->script) < 0 ||
+        VIR_STRDUP(def->filter, src->filter) < 0 ||
+        virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    /* Auto-generated target names are not kept in the config, and
+     * neither is any macvtap device name.  */
+    if (src->type != VIR_DOMAIN_NET_TYPE_DIRECT &&
+        !(src->ifname && STRPREFIX(src->ifname, VIR_NET_GENERATED_PREFIX)) &&
+        VIR_STRDUP(def->ifname, src->ifname) < 0)
+        goto error;
+
+    switch (src->type) {
+    case VIR_DOMAIN_NET_TYPE_ETHERNET:
+        if (VIR_STRDUP(def->data.ethernet.dev, src->data.ethernet.dev) < 0 ||
+            VIR_STRDUP(def->data.ethernet.ipaddr,
+                       src->data.ethernet.ipaddr) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_SERVER:
+    case VIR_DOMAIN_NET_TYPE_CLIENT:
+    case VIR_DOMAIN_NET_TYPE_MCAST:
+        def->data.socket.port = src->data.socket.port;
+        if (VIR_STRDUP(def->data.socket.address,
+                       src->data.socket.address) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_NETWORK:
+        /* the actual device is allocated whenever the domain starts */
+        if (VIR_STRDUP(def->data.network.name, src->data.network.name) < 0 ||
+            VIR_STRDUP(def->data.network.portgroup,
+                       src->data.network.portgroup) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_BRIDGE:
+        if (VIR_STRDUP(def->data.bridge.brname, src->data.bridge.brname) < 0 ||
+            VIR_STRDUP(def->data.bridge.ipaddr, src->data.bridge.ipaddr) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_INTERNAL:
+        if (VIR_STRDUP(def->data.internal.name,
+                       src->data.internal.name) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_DIRECT:
+        def->data.direct.mode = src->data.direct.mode;
+        if (VIR_STRDUP(def->data.direct.linkdev,
+                       src->data.direct.linkdev) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_HOSTDEV:
+        def->data.hostdev.def.parent.type = VIR_DOMAIN_DEVICE_NET;
+        def->data.hostdev.def.parent.data.net = def;
+        def->data.hostdev.def.info = &def->info;
+        if (virDomainHostdevDefCopyData(&def->data.hostdev.def,
+                                        &src->data.hostdev.def, flags) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_USER:
+    case VIR_DOMAIN_NET_TYPE_LAST:
+        break;
+    }
+
+    if (src->virtPortProfile) {
+        if (VIR_ALLOC(def->virtPortProfile) < 0)
+            goto error;
+        *def->virtPortProfile = *src->virtPortProfile;
+    }
+
+    if (src->filterparams &&
+        (!(def->filterparams = virNWFilterHashTableCreate(0)) ||
+         virNWFilterHashTablePutAll(src->filterparams,
+                                    def->filterparams) < 0))
+        goto error;
+
+    if (virNetDevBandwidthCopy(&def->bandwidth, src->bandwidth) < 0 ||
+        virNetDevVlanCopy(&def->vlan, &src->vlan) < 0)
+        goto error;
+
+    return def;
+
+ error:
+    virDomainNetDefFree(def);
+    return NULL;
+}
+
 void ATTRIBUTE_NONNULL(1)
 virDomainChrSourceDefClear(virDomainChrSourceDefPtr def)
 {
@@ -1443,6 +1862,7 @@ virDomainChrSourceDefCopy(virDomainChrSourceDefPtr dest,
         return -1;
 
     virDomainChrSourceDefClear(dest);
+    dest->type = src->type;
 
     switch (src->type) {
     case VIR_DOMAIN_CHR_TYPE_PTY:
@@ -1473,11 +1893,16 @@ virDomainChrSourceDefCopy(virDomainChrSourceDefPtr dest,
 
         if (VIR_STRDUP(dest->data.tcp.service, src->data.tcp.service) < 0)
             return -1;
+
+        dest->data.tcp.listen = src->data.tcp.listen;
+        dest->data.tcp.protocol = src->data.tcp.protocol;
         break;
 
     case VIR_DOMAIN_CHR_TYPE_UNIX:
         if (VIR_STRDUP(dest->data.nix.path, src->data.nix.path) < 0)
             return -1;
+
+        dest->data.nix.listen = src->data.nix.listen;
         break;
 
     case VIR_DOMAIN_CHR_TYPE_NMDM:
@@ -1487,9 +1912,17 @@ virDomainChrSourceDefCopy(virDomainChrSourceDefPtr dest,
             return -1;
 
         break;
-    }
 
-    dest->type = src->type;
+    case VIR_DOMAIN_CHR_TYPE_SPICEVMC:
+        dest->data.spicevmc = src->data.spicevmc;
+        break;
+
+    case VIR_DOMAIN_CHR_TYPE_SPICEPORT:
+        if (VIR_STRDUP(dest->data.spiceport.channel,
+                       src->data.spiceport.channel) < 0)
+            return -1;
+        break;
+    }
 
     return 0;
 }
@@ -1504,6 +1937,20 @@ void virDomainChrSourceDefFree(virDomainChrSourceDefPtr def)
     VIR_FREE(def);
 }
 
+/* Like virDomainChrSourceDefCopy, but skips the pty path allocated on
+ * startup which is only ever parsed from live XML.  */
+static int
+virDomainChrSourceDefCopyConfig(virDomainChrSourceDefPtr dest,
+                                virDomainChrSourceDefPtr src)
+{
+    if (virDomainChrSourceDefCopy(dest, src) < 0)
+        return -1;
+
+    if (dest->type == VIR_DOMAIN_CHR_TYPE_PTY)
+        VIR_FREE(dest->data.file.path);
+    return 0;
+}
+
 /* virDomainChrSourceDefIsEqual:
  * @src: Source
  * @tgt: Target
@@ -1599,6 +2046,57 @@ void virDomainChrDefFree(virDomainChrDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainChrDefPtr
+virDomainChrDefCopy(virDomainChrDefPtr src)
+{
+    virDomainChrDefPtr def;
+    size_t i;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->deviceType = src->deviceType;
+    def->targetTypeAttr = src->targetTypeAttr;
+    def->targetType = src->targetType;
+
+    if (def->deviceType == VIR_DOMAIN_CHR_DEVICE_TYPE_CHANNEL &&
+        def->targetType == VIR_DOMAIN_CHR_CHANNEL_TARGET_TYPE_GUESTFWD) {
+        if (src->target.addr) {
+            if (VIR_ALLOC(def->target.addr) < 0)
+                goto error;
+            *def->target.addr = *src->target.addr;
+        }
+    } else if (def->deviceType == VIR_DOMAIN_CHR_DEVICE_TYPE_CHANNEL &&
+               def->targetType == VIR_DOMAIN_CHR_CHANNEL_TARGET_TYPE_VIRTIO) {
+        if (VIR_STRDUP(def->target.name, src->target.name) < 0)
+            goto error;
+    } else {
+        def->target.port = src->target.port;
+    }
+
+    if (virDomainChrSourceDefCopyConfig(&def->source, &src->source) < 0 ||
+        virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    if (src->nseclabels &&
+        VIR_ALLOC_N(def->seclabels, src->nseclabels) < 0)
+        goto error;
+
+    for (i = 0; i < src->nseclabels; i++) {
+        if (!(def->seclabels[i] =
+              virSecurityDeviceLabelDefCopy(src->seclabels[i])))
+            goto error;
+        def->nseclabels++;
+    }
+    virSecurityDeviceLabelDefsClearSkip(def->seclabels, def->nseclabels);
+
+    return def;
+
+ error:
+    virDomainChrDefFree(def);
+    return NULL;
+}
+
 void virDomainSmartcardDefFree(virDomainSmartcardDefPtr def)
 {
     size_t i;
@@ -1628,6 +2126,49 @@ void virDomainSmartcardDefFree(virDomainSmartcardDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainSmartcardDefPtr
+virDomainSmartcardDefCopy(virDomainSmartcardDefPtr src)
+{
+    virDomainSmartcardDefPtr def;
+    size_t i;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+
+    switch (def->type) {
+    case VIR_DOMAIN_SMARTCARD_TYPE_HOST_CERTIFICATES:
+        for (i = 0; i < VIR_DOMAIN_SMARTCARD_NUM_CERTIFICATES; i++) {
+            if (VIR_STRDUP(def->data.cert.file[i],
+                           src->data.cert.file[i]) < 0)
+                goto error;
+        }
+        if (VIR_STRDUP(def->data.cert.database,
+                       src->data.cert.database) < 0)
+            goto error;
+        break;
+
+    case VIR_DOMAIN_SMARTCARD_TYPE_PASSTHROUGH:
+        if (virDomainChrSourceDefCopyConfig(&def->data.passthru,
+                                            &src->data.passthru) < 0)
+            goto error;
+        break;
+
+    default:
+        break;
+    }
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    return def;
+
+ error:
+    virDomainSmartcardDefFree(def);
+    return NULL;
+}
+
 void virDomainSoundCodecDefFree(virDomainSoundCodecDefPtr def)
 {
     if (!def)
@@ -1651,6 +2192,37 @@ void virDomainSoundDefFree(virDomainSoundDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainSoundDefPtr
+virDomainSoundDefCopy(virDomainSoundDefPtr src)
+{
+    virDomainSoundDefPtr def;
+    size_t i;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->model = src->model;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    if (src->ncodecs && VIR_ALLOC_N(def->codecs, src->ncodecs) < 0)
+        goto error;
+
+    for (i = 0; i < src->ncodecs; i++) {
+        if (VIR_ALLOC(def->codecs[i]) < 0)
+            goto error;
+        def->ncodecs++;
+        *def->codecs[i] = *src->codecs[i];
+    }
+
+    return def;
+
+ error:
+    virDomainSoundDefFree(def);
+    return NULL;
+}
+
 void virDomainMemballoonDefFree(virDomainMemballoonDefPtr def)
 {
     if (!def)
@@ -1661,6 +2233,25 @@ void virDomainMemballoonDefFree(virDomainMemballoonDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainMemballoonDefPtr
+virDomainMemballoonDefCopy(virDomainMemballoonDefPtr src)
+{
+    virDomainMemballoonDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->model = src->model;
+    def->period = src->period;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainMemballoonDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainNVRAMDefFree(virDomainNVRAMDefPtr def)
 {
     if (!def)
@@ -1671,6 +2262,22 @@ void virDomainNVRAMDefFree(virDomainNVRAMDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainNVRAMDefPtr
+virDomainNVRAMDefCopy(virDomainNVRAMDefPtr src)
+{
+    virDomainNVRAMDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainNVRAMDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainWatchdogDefFree(virDomainWatchdogDefPtr def)
 {
     if (!def)
@@ -1681,6 +2288,25 @@ void virDomainWatchdogDefFree(virDomainWatchdogDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainWatchdogDefPtr
+virDomainWatchdogDefCopy(virDomainWatchdogDefPtr src)
+{
+    virDomainWatchdogDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->model = src->model;
+    def->action = src->action;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainWatchdogDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainVideoDefFree(virDomainVideoDefPtr def)
 {
     if (!def)
@@ -1692,6 +2318,36 @@ void virDomainVideoDefFree(virDomainVideoDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainVideoDefPtr
+virDomainVideoDefCopy(virDomainVideoDefPtr src)
+{
+    virDomainVideoDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    def->ram = src->ram;
+    def->vram = src->vram;
+    def->heads = src->heads;
+    def->primary = src->primary;
+
+    if (src->accel) {
+        if (VIR_ALLOC(def->accel) < 0)
+            goto error;
+        *def->accel = *src->accel;
+    }
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    return def;
+
+ error:
+    virDomainVideoDefFree(def);
+    return NULL;
+}
+
 virDomainHostdevDefPtr virDomainHostdevDefAlloc(void)
 {
     virDomainHostdevDefPtr def = NULL;
@@ -1738,6 +2394,74 @@ void virDomainHostdevDefClear(virDomainHostdevDefPtr def)
     }
 }
 
+/* Copies the host side of @src into @dst, whose parent and info are
+ * left for the caller to set up.  The original state of the host
+ * device and whether it went missing are only known while the domain
+ * runs, so neither is copied.  Whether the address of a USB device was
+ * looked up by vendor and product is only kept in migratable copies,
+ * as the formatter leaves it out otherwise.  */
+static int
+virDomainHostdevDefCopyData(virDomainHostdevDefPtr dst,
+                            virDomainHostdevDefPtr src,
+                            unsigned int flags)
+{
+    virDomainHostdevSubsysPtr subsys = &dst->source.subsys;
+    virDomainHostdevCapsPtr caps = &dst->source.caps;
+
+    dst->mode = src->mode;
+    dst->startupPolicy = src->startupPolicy;
+    dst->managed = src->managed;
+    dst->readonly = src->readonly;
+    dst->shareable = src->shareable;
+
+    switch ((virDomainHostdevMode) dst->mode) {
+    case VIR_DOMAIN_HOSTDEV_MODE_CAPABILITIES:
+        caps->type = src->source.caps.type;
+        switch ((virDomainHostdevCapsType) caps->type) {
+        case VIR_DOMAIN_HOSTDEV_CAPS_TYPE_STORAGE:
+            return VIR_STRDUP(caps->u.storage.block,
+                              src->source.caps.u.storage.block);
+        case VIR_DOMAIN_HOSTDEV_CAPS_TYPE_MISC:
+            return VIR_STRDUP(caps->u.misc.chardev,
+                              src->source.caps.u.misc.chardev);
+        case VIR_DOMAIN_HOSTDEV_CAPS_TYPE_NET:
+            return VIR_STRDUP(caps->u.net.iface,
+                              src->source.caps.u.net.iface);
+        case VIR_DOMAIN_HOSTDEV_CAPS_TYPE_LAST:
+            break;
+        }
+        break;
+
+    case VIR_DOMAIN_HOSTDEV_MODE_SUBSYS:
+        subsys->type = src->source.subsys.type;
+        switch ((virDomainHostdevSubsysType) subsys->type) {
+        case VIR_DOMAIN_HOSTDEV_SUBSYS_TYPE_USB:
+            subsys->u.usb = src->source.subsys.u.usb;
+            if (!(flags & VIR_DOMAIN_XML_MIGRATABLE))
+                subsys->u.usb.autoAddress = false;
+            break;
+        case VIR_DOMAIN_HOSTDEV_SUBSYS_TYPE_PCI:
+            subsys->u.pci = src->source.subsys.u.pci;
+            break;
+        case VIR_DOMAIN_HOSTDEV_SUBSYS_TYPE_SCSI:
+            subsys->u.scsi.bus = src->source.subsys.u.scsi.bus;
+            subsys->u.scsi.target = src->source.subsys.u.scsi.target;
+            subsys->u.scsi.unit = src->source.subsys.u.scsi.unit;
+            subsys->u.scsi.sgio = src->source.subsys.u.scsi.sgio;
+            return VIR_STRDUP(subsys->u.scsi.adapter,
+                              src->source.subsys.u.scsi.adapter);
+        case VIR_DOMAIN_HOSTDEV_SUBSYS_TYPE_LAST:
+            break;
+        }
+        break;
+
+    case VIR_DOMAIN_HOSTDEV_MODE_LAST:
+        break;
+    }
+
+    return 0;
+}
+
 void virDomainTPMDefFree(virDomainTPMDefPtr def)
 {
     if (!def)
@@ -1755,6 +2479,38 @@ void virDomainTPMDefFree(virDomainTPMDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainTPMDefPtr
+virDomainTPMDefCopy(virDomainTPMDefPtr src)
+{
+    virDomainTPMDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    def->model = src->model;
+
+    switch (def->type) {
+    case VIR_DOMAIN_TPM_TYPE_PASSTHROUGH:
+        def->data.passthrough.source.type = src->data.passthrough.source.type;
+        if (VIR_STRDUP(def->data.passthrough.source.data.file.path,
+                       src->data.passthrough.source.data.file.path) < 0)
+            goto error;
+        break;
+    case VIR_DOMAIN_TPM_TYPE_LAST:
+        break;
+    }
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    return def;
+
+ error:
+    virDomainTPMDefFree(def);
+    return NULL;
+}
+
 void virDomainHostdevDefFree(virDomainHostdevDefPtr def)
 {
     if (!def)
@@ -1770,6 +2526,24 @@ void virDomainHostdevDefFree(virDomainHostdevDefPtr def)
         VIR_FREE(def);
 }
 
+static virDomainHostdevDefPtr
+virDomainHostdevDefCopy(virDomainHostdevDefPtr src,
+                        unsigned int flags)
+{
+    virDomainHostdevDefPtr def;
+
+    if (!(def = virDomainHostdevDefAlloc()))
+        return NULL;
+
+    if (virDomainHostdevDefCopyData(def, src, flags) < 0 ||
+        virDomainDeviceInfoCopyConfig(def->info, src->info) < 0) {
+        virDomainHostdevDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainHubDefFree(virDomainHubDefPtr def)
 {
     if (!def)
@@ -1779,6 +2553,24 @@ void virDomainHubDefFree(virDomainHubDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainHubDefPtr
+virDomainHubDefCopy(virDomainHubDefPtr src)
+{
+    virDomainHubDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainHubDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainRedirdevDefFree(virDomainRedirdevDefPtr def)
 {
     if (!def)
@@ -1790,6 +2582,26 @@ void virDomainRedirdevDefFree(virDomainRedirdevDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainRedirdevDefPtr
+virDomainRedirdevDefCopy(virDomainRedirdevDefPtr src)
+{
+    virDomainRedirdevDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->bus = src->bus;
+
+    if (virDomainChrSourceDefCopyConfig(&def->source.chr,
+                                        &src->source.chr) < 0 ||
+        virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0) {
+        virDomainRedirdevDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
 void virDomainRedirFilterDefFree(virDomainRedirFilterDefPtr def)
 {
     size_t i;
@@ -1804,6 +2616,32 @@ void virDomainRedirFilterDefFree(virDomainRedirFilterDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainRedirFilterDefPtr
+virDomainRedirFilterDefCopy(virDomainRedirFilterDefPtr src)
+{
+    virDomainRedirFilterDefPtr def;
+    size_t i;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    if (src->nusbdevs && VIR_ALLOC_N(def->usbdevs, src->nusbdevs) < 0)
+        goto error;
+
+    for (i = 0; i < src->nusbdevs; i++) {
+        if (VIR_ALLOC(def->usbdevs[i]) < 0)
+            goto error;
+        def->nusbdevs++;
+        *def->usbdevs[i] = *src->usbdevs[i];
+    }
+
+    return def;
+
+ error:
+    virDomainRedirFilterDefFree(def);
+    return NULL;
+}
+
 void virDomainDeviceDefFree(virDomainDeviceDefPtr def)
 {
     if (!def)
@@ -1949,8 +2787,24 @@ virDomainResourceDefFree(virDomainResourceDefPtr resource)
     if (!resource)
         return;
 
-    VIR_FREE(resource->partition);
-    VIR_FREE(resource);
+    VIR_FREE(resource->partition);
+    VIR_FREE(resource);
+}
+
+static virDomainResourceDefPtr
+virDomainResourceDefCopy(virDomainResourceDefPtr src)
+{
+    virDomainResourceDefPtr resource;
+
+    if (VIR_ALLOC(resource) < 0)
+        return NULL;
+
+    if (VIR_STRDUP(resource->partition, src->partition) < 0) {
+        virDomainResourceDefFree(resource);
+        return NULL;
+    }
+
+    return resource;
 }
 
 void
@@ -1963,6 +2817,22 @@ virDomainPanicDefFree(virDomainPanicDefPtr panic)
     VIR_FREE(panic);
 }
 
+static virDomainPanicDefPtr
+virDomainPanicDefCopy(virDomainPanicDefPtr src)
+{
+    virDomainPanicDefPtr panic;
+
+    if (VIR_ALLOC(panic) < 0)
+        return NULL;
+
+    if (virDomainDeviceInfoCopyConfig(&panic->info, &src->info) < 0) {
+        virDomainPanicDefFree(panic);
+        return NULL;
+    }
+
+    return panic;
+}
+
 void virDomainDefFree(virDomainDefPtr def)
 {
     size_t i;
@@ -2114,6 +2984,7 @@ void virDomainDefFree(virDomainDefPtr def)
 static void virDomainObjDispose(void *obj)
 {
     virDomainObjPtr dom = obj;
+    size_t i;
 
     VIR_DEBUG("obj=%p", dom);
     virDomainDefFree(dom->def);
@@ -2123,6 +2994,9 @@ static void virDomainObjDispose(void *obj)
         (dom->privateDataFreeFunc)(dom->privateData);
 
     virDomainSnapshotObjListFree(dom->snapshots);
+
+    for (i = 0; i < VIR_DOMAIN_OBJ_XML_CACHE_SIZE; i++)
+        VIR_FREE(dom->xmlCache[i]);
 }
 
 virDomainObjPtr
@@ -2145,6 +3019,13 @@ virDomainObjNew(virDomainXMLOptionPtr xmlopt)
     if (!(domain->snapshots = virDomainSnapshotObjListNew()))
         goto error;
 
+    /* Start from the current time rather than zero, so that a client
+     * doesn't mistake a domain known to a restarted daemon for an
+     * unchanged one */
+    if (virTimeMillisNow(&domain->generation) < 0)
+        goto error;
+    domain->generation *= 1000;
+
     virObjectLock(domain);
     virDomainObjSetState(domain, VIR_DOMAIN_SHUTOFF,
                                  VIR_DOMAIN_SHUTOFF_UNKNOWN);
@@ -2158,6 +3039,71 @@ virDomainObjNew(virDomainXMLOptionPtr xmlopt)
 }
 
 
+/**
+ * virDomainObjBumpGeneration:
+ * @obj: domain object, must be locked
+ *
+ * Record that @obj->def or @obj->newDef may have been modified: change
+ * the generation counter and drop all cached XML.  Drivers must call
+ * this (directly or through a helper that does) after any change to a
+ * definition that is visible in its XML.
+ */
+void
+virDomainObjBumpGeneration(virDomainObjPtr obj)
+{
+    size_t i;
+
+    obj->generation++;
+    for (i = 0; i < VIR_DOMAIN_OBJ_XML_CACHE_SIZE; i++)
+        VIR_FREE(obj->xmlCache[i]);
+}
+
+
+/**
+ * virDomainObjGetCachedXML:
+ * @obj: domain object, must be locked
+ * @flags: bitwise-OR of virDomainXMLFlags
+ *
+ * Returns the XML previously stored by virDomainObjSetCachedXML for
+ * @flags, or NULL if there is none for the current generation.  The
+ * string is owned by @obj and only valid while @obj stays locked.
+ */
+const char *
+virDomainObjGetCachedXML(virDomainObjPtr obj,
+                         unsigned int flags)
+{
+    if (flags >= VIR_DOMAIN_OBJ_XML_CACHE_SIZE)
+        return NULL;
+
+    return obj->xmlCache[flags];
+}
+
+
+/**
+ * virDomainObjSetCachedXML:
+ * @obj: domain object, must be locked
+ * @flags: bitwise-OR of virDomainXMLFlags @xml was formatted with
+ * @xml: the formatted XML
+ *
+ * Remember a copy of @xml until the next virDomainObjBumpGeneration.
+ * Flag combinations other than the public virDomainXMLFlags are
+ * silently not cached.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virDomainObjSetCachedXML(virDomainObjPtr obj,
+                         unsigned int flags,
+                         const char *xml)
+{
+    if (flags >= VIR_DOMAIN_OBJ_XML_CACHE_SIZE)
+        return 0;
+
+    VIR_FREE(obj->xmlCache[flags]);
+    return VIR_STRDUP(obj->xmlCache[flags], xml);
+}
+
+
 virDomainDefPtr virDomainDefNew(const char *name,
                                 const unsigned char *uuid,
                                 int id)
@@ -2184,6 +3130,8 @@ void virDomainObjAssignDef(virDomainObjPtr domain,
                            bool live,
                            virDomainDefPtr *oldDef)
 {
+    virDomainObjBumpGeneration(domain);
+
     if (oldDef)
         *oldDef = NULL;
     if (virDomainObjIsActive(domain)) {
@@ -2349,6 +3297,9 @@ virDomainObjSetDefTransient(virCapsPtr caps,
     if (!(domain->newDef = virDomainDefCopy(domain->def, caps, xmlopt, false)))
         goto out;
 
+    /* callers are about to modify one of the two definitions */
+    virDomainObjBumpGeneration(domain);
+
     ret = 0;
  out:
     return ret;
@@ -2576,13 +3527,18 @@ virDomainDeviceInfoCopy(virDomainDeviceInfoPtr dst,
     /* first a shallow copy of *everything* */
     *dst = *src;
 
-    /* then redo the two fields that are pointers */
+    /* then redo the fields that are pointers */
     dst->alias = NULL;
     dst->romfile = NULL;
+    if (src->type == VIR_DOMAIN_DEVICE_ADDRESS_TYPE_USB)
+        dst->addr.usb.port = NULL;
 
     if (VIR_STRDUP(dst->alias, src->alias) < 0 ||
         VIR_STRDUP(dst->romfile, src->romfile) < 0)
         return -1;
+    if (src->type == VIR_DOMAIN_DEVICE_ADDRESS_TYPE_USB &&
+        VIR_STRDUP(dst->addr.usb.port, src->addr.usb.port) < 0)
+        return -1;
     return 0;
 }
 
@@ -16479,6 +17435,44 @@ virDomainRNGDefFree(virDomainRNGDefPtr def)
     VIR_FREE(def);
 }
 
+static virDomainRNGDefPtr
+virDomainRNGDefCopy(virDomainRNGDefPtr src)
+{
+    virDomainRNGDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->model = src->model;
+    def->backend = src->backend;
+    def->rate = src->rate;
+    def->period = src->period;
+
+    switch ((virDomainRNGBackend) def->backend) {
+    case VIR_DOMAIN_RNG_BACKEND_RANDOM:
+        if (VIR_STRDUP(def->source.file, src->source.file) < 0)
+            goto error;
+        break;
+    case VIR_DOMAIN_RNG_BACKEND_EGD:
+        if (VIR_ALLOC(def->source.chardev) < 0 ||
+            virDomainChrSourceDefCopyConfig(def->source.chardev,
+                                            src->source.chardev) < 0)
+            goto error;
+        break;
+    case VIR_DOMAIN_RNG_BACKEND_LAST:
+        break;
+    }
+
+    if (virDomainDeviceInfoCopyConfig(&def->info, &src->info) < 0)
+        goto error;
+
+    return def;
+
+ error:
+    virDomainRNGDefFree(def);
+    return NULL;
+}
+
 static void
 virDomainVideoAccelDefFormat(virBufferPtr buf,
                              virDomainVideoAccelDefPtr def)
@@ -18135,6 +19129,9 @@ virDomainSaveStatus(virDomainXMLOptionPtr xmlopt,
     int ret = -1;
     char *xml;
 
+    /* The status is saved after every change to the live state */
+    virDomainObjBumpGeneration(obj);
+
     if (!(xml = virDomainObjFormat(xmlopt, obj, flags)))
         goto cleanup;
 
@@ -18730,6 +19727,359 @@ virDomainDiskDefForeachPath(virDomainDiskDefPtr disk,
 }
 
 
+/* Copies a domain wide security label the way parsing it from
+ * inactive XML would, i.e. without any label generated on startup.  */
+static virSecurityLabelDefPtr
+virSecurityLabelDefCopyConfig(virSecurityLabelDefPtr src)
+{
+    virSecurityLabelDefPtr def;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->type = src->type;
+    def->norelabel = src->norelabel;
+
+    if (VIR_STRDUP(def->model, src->model) < 0)
+        goto error;
+
+    if (STRNEQ_NULLABLE(def->model, "none")) {
+        if (def->type == VIR_DOMAIN_SECLABEL_STATIC &&
+            VIR_STRDUP(def->label, src->label) < 0)
+            goto error;
+        if (def->type == VIR_DOMAIN_SECLABEL_DYNAMIC &&
+            VIR_STRDUP(def->baselabel, src->baselabel) < 0)
+            goto error;
+    }
+
+    return def;
+
+ error:
+    virSecurityLabelDefFree(def);
+    return NULL;
+}
+
+
+#define VIR_DOMAIN_DEF_COPY_DEVICES(devs, ndevs, copyFunc)              \
+    do {                                                                \
+        if (src->ndevs && VIR_ALLOC_N(def->devs, src->ndevs) < 0)       \
+            goto error;                                                 \
+        for (i = 0; i < src->ndevs; i++) {                              \
+            if (!(def->devs[i] = copyFunc(src->devs[i])))               \
+                goto error;                                             \
+            def->ndevs++;                                               \
+        }                                                               \
+    } while (0)
+
+/* Structural equivalent of formatting @src with @flags and parsing it
+ * back as inactive XML: the copy keeps the whole configuration but
+ * none of the state which only exists while the domain runs.  With
+ * VIR_DOMAIN_XML_MIGRATABLE, it also follows the filtering the
+ * formatter applies to migratable XML.  */
+static virDomainDefPtr
+virDomainDefCopyConfig(virDomainDefPtr src,
+                       unsigned int flags)
+{
+    virDomainDefPtr def;
+    size_t i, j;
+
+    if (VIR_ALLOC(def) < 0)
+        return NULL;
+
+    def->virtType = src->virtType;
+    def->id = -1;
+    memcpy(def->uuid, src->uuid, VIR_UUID_BUFLEN);
+    def->blkio.weight = src->blkio.weight;
+    def->mem = src->mem;
+    def->vcpus = src->vcpus;
+    def->maxvcpus = src->maxvcpus;
+    def->placement_mode = src->placement_mode;
+    def->cputune.shares = src->cputune.shares;
+    def->cputune.sharesSpecified = src->cputune.sharesSpecified;
+    def->cputune.period = src->cputune.period;
+    def->cputune.quota = src->cputune.quota;
+    def->cputune.emulator_period = src->cputune.emulator_period;
+    def->cputune.emulator_quota = src->cputune.emulator_quota;
+    def->numatune.memory.mode = src->numatune.memory.mode;
+    def->numatune.memory.placement_mode = src->numatune.memory.placement_mode;
+    def->onReboot = src->onReboot;
+    def->onPoweroff = src->onPoweroff;
+    def->onCrash = src->onCrash;
+    def->onLockFailure = src->onLockFailure;
+    def->pm = src->pm;
+    def->os.arch = src->os.arch;
+    def->os.nBootDevs = src->os.nBootDevs;
+    memcpy(def->os.bootDevs, src->os.bootDevs, sizeof(def->os.bootDevs));
+    def->os.bootmenu = src->os.bootmenu;
+    def->os.smbios_mode = src->os.smbios_mode;
+    def->os.bios = src->os.bios;
+    memcpy(def->features, src->features, sizeof(def->features));
+    def->apic_eoi = src->apic_eoi;
+    memcpy(def->hyperv_features, src->hyperv_features,
+           sizeof(def->hyperv_features));
+    def->hyperv_spinlocks = src->hyperv_spinlocks;
+    def->ns = src->ns;
+
+    /* the start time adjustment of a variable clock is live status */
+    def->clock.offset = src->clock.offset;
+    switch (src->clock.offset) {
+    case VIR_DOMAIN_CLOCK_OFFSET_UTC:
+    case VIR_DOMAIN_CLOCK_OFFSET_LOCALTIME:
+        def->clock.data.utc_reset = src->clock.data.utc_reset;
+        break;
+    case VIR_DOMAIN_CLOCK_OFFSET_VARIABLE:
+        def->clock.data.variable.adjustment =
+            src->clock.data.variable.adjustment;
+        def->clock.data.variable.basis = src->clock.data.variable.basis;
+        break;
+    case VIR_DOMAIN_CLOCK_OFFSET_TIMEZONE:
+        if (VIR_STRDUP(def->clock.data.timezone,
+                       src->clock.data.timezone) < 0)
+            goto error;
+        break;
+    }
+
+    if (VIR_STRDUP(def->name, src->name) < 0 ||
+        VIR_STRDUP(def->title, src->title) < 0 ||
+        VIR_STRDUP(def->description, src->description) < 0 ||
+        VIR_STRDUP(def->emulator, src->emulator) < 0)
+        goto error;
+
+    if (src->blkio.ndevices &&
+        VIR_ALLOC_N(def->blkio.devices, src->blkio.ndevices) < 0)
+        goto error;
+    for (i = 0; i < src->blkio.ndevices; i++) {
+        virBlkioDevicePtr dev = &def->blkio.devices[i];
+
+        def->blkio.ndevices++;
+        dev->weight = src->blkio.devices[i].weight;
+        dev->riops = src->blkio.devices[i].riops;
+        dev->wiops = src->blkio.devices[i].wiops;
+        dev->rbps = src->blkio.devices[i].rbps;
+        dev->wbps = src->blkio.devices[i].wbps;
+        if (VIR_STRDUP(dev->path, src->blkio.devices[i].path) < 0)
+            goto error;
+    }
+
+    /* The cpuset of <vcpu> is neither formatted when it covers every
+     * host CPU nor parsed with automatic placement, and then neither
+     * are the vcpupins inherited from it.  */
+    if (src->cpumask &&
+        src->placement_mode != VIR_DOMAIN_CPU_PLACEMENT_MODE_AUTO &&
+        !virBitmapIsAllSet(src->cpumask) &&
+        !(def->cpumask = virBitmapNewCopy(src->cpumask)))
+        goto error;
+
+    if (src->cputune.nvcpupin &&
+        VIR_ALLOC_N(def->cputune.vcpupin, src->cputune.nvcpupin) < 0)
+        goto error;
+    for (i = 0; i < src->cputune.nvcpupin; i++) {
+        virDomainVcpuPinDefPtr vcpupin;
+
+        if (src->cpumask && !def->cpumask &&
+            virBitmapEqual(src->cpumask, src->cputune.vcpupin[i]->cpumask))
+            continue;
+
+        if (VIR_ALLOC(vcpupin) < 0)
+            goto error;
+        def->cputune.vcpupin[def->cputune.nvcpupin++] = vcpupin;
+        vcpupin->vcpuid = src->cputune.vcpupin[i]->vcpuid;
+        if (!(vcpupin->cpumask =
+              virBitmapNewCopy(src->cputune.vcpupin[i]->cpumask)))
+            goto error;
+    }
+
+    if (src->cputune.emulatorpin &&
+        src->placement_mode != VIR_DOMAIN_CPU_PLACEMENT_MODE_AUTO) {
+        if (VIR_ALLOC(def->cputune.emulatorpin) < 0)
+            goto error;
+        def->cputune.emulatorpin->vcpuid = src->cputune.emulatorpin->vcpuid;
+        if (!(def->cputune.emulatorpin->cpumask =
+              virBitmapNewCopy(src->cputune.emulatorpin->cpumask)))
+            goto error;
+    }
+
+    if (src->numatune.memory.nodemask &&
+        src->numatune.memory.placement_mode ==
+        VIR_NUMA_TUNE_MEM_PLACEMENT_MODE_STATIC &&
+        !(def->numatune.memory.nodemask =
+          virBitmapNewCopy(src->numatune.memory.nodemask)))
+        goto error;
+
+    if (src->resource &&
+        !(def->resource = virDomainResourceDefCopy(src->resource)))
+        goto error;
+
+    if (src->idmap.nuidmap) {
+        if (VIR_ALLOC_N(def->idmap.uidmap, src->idmap.nuidmap) < 0)
+            goto error;
+        def->idmap.nuidmap = src->idmap.nuidmap;
+        memcpy(def->idmap.uidmap, src->idmap.uidmap,
+               src->idmap.nuidmap * sizeof(*src->idmap.uidmap));
+    }
+    if (src->idmap.ngidmap) {
+        if (VIR_ALLOC_N(def->idmap.gidmap, src->idmap.ngidmap) < 0)
+            goto error;
+        def->idmap.ngidmap = src->idmap.ngidmap;
+        memcpy(def->idmap.gidmap, src->idmap.gidmap,
+               src->idmap.ngidmap * sizeof(*src->idmap.gidmap));
+    }
+
+    if (VIR_STRDUP(def->os.type, src->os.type) < 0 ||
+        VIR_STRDUP(def->os.machine, src->os.machine) < 0 ||
+        VIR_STRDUP(def->os.init, src->os.init) < 0 ||
+        VIR_STRDUP(def->os.kernel, src->os.kernel) < 0 ||
+        VIR_STRDUP(def->os.initrd, src->os.initrd) < 0 ||
+        VIR_STRDUP(def->os.cmdline, src->os.cmdline) < 0 ||
+        VIR_STRDUP(def->os.dtb, src->os.dtb) < 0 ||
+        VIR_STRDUP(def->os.root, src->os.root) < 0 ||
+        VIR_STRDUP(def->os.loader, src->os.loader) < 0 ||
+        VIR_STRDUP(def->os.bootloader, src->os.bootloader) < 0 ||
+        VIR_STRDUP(def->os.bootloaderArgs, src->os.bootloaderArgs) < 0)
+        goto error;
+
+    if (src->os.initargv) {
+        for (i = 0; src->os.initargv[i]; i++)
+            ;
+        if (VIR_ALLOC_N(def->os.initargv, i + 1) < 0)
+            goto error;
+        for (i = 0; src->os.initargv[i]; i++) {
+            if (VIR_STRDUP(def->os.initargv[i], src->os.initargv[i]) < 0)
+                goto error;
+        }
+    }
+
+    if (src->clock.ntimers &&
+        VIR_ALLOC_N(def->clock.timers, src->clock.ntimers) < 0)
+        goto error;
+    for (i = 0; i < src->clock.ntimers; i++) {
+        if (VIR_ALLOC(def->clock.timers[i]) < 0)
+            goto error;
+        def->clock.ntimers++;
+        *def->clock.timers[i] = *src->clock.timers[i];
+    }
+
+    if (src->ngraphics && VIR_ALLOC_N(def->graphics, src->ngraphics) < 0)
+        goto error;
+    for (i = 0; i < src->ngraphics; i++) {
+        if (!(def->graphics[i] = virDomainGraphicsDefCopy(src->graphics[i],
+                                                          flags)))
+            goto error;
+        def->ngraphics++;
+    }
+
+    VIR_DOMAIN_DEF_COPY_DEVICES(disks, ndisks, virDomainDiskDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(controllers, ncontrollers,
+                                virDomainControllerDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(fss, nfss, virDomainFSDefCopy);
+    if (src->nnets && VIR_ALLOC_N(def->nets, src->nnets) < 0)
+        goto error;
+    for (i = 0; i < src->nnets; i++) {
+        if (!(def->nets[i] = virDomainNetDefCopy(src->nets[i], flags)))
+            goto error;
+        def->nnets++;
+    }
+
+    VIR_DOMAIN_DEF_COPY_DEVICES(inputs, ninputs, virDomainInputDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(sounds, nsounds, virDomainSoundDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(videos, nvideos, virDomainVideoDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(redirdevs, nredirdevs,
+                                virDomainRedirdevDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(smartcards, nsmartcards,
+                                virDomainSmartcardDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(serials, nserials, virDomainChrDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(parallels, nparallels, virDomainChrDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(channels, nchannels, virDomainChrDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(consoles, nconsoles, virDomainChrDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(leases, nleases, virDomainLeaseDefCopy);
+    VIR_DOMAIN_DEF_COPY_DEVICES(hubs, nhubs, virDomainHubDefCopy);
+
+    /* Interfaces of type hostdev are listed among the hostdevs too,
+     * pointing into the interface itself.  The hostdev of an interface
+     * that only got one as its actual device is not part of the config
+     * and is dropped along with the actual device.  */
+    if (src->nhostdevs && VIR_ALLOC_N(def->hostdevs, src->nhostdevs) < 0)
+        goto error;
+    for (i = 0; i < src->nhostdevs; i++) {
+        virDomainHostdevDefPtr hostdev = src->hostdevs[i];
+
+        if (hostdev->parent.type == VIR_DOMAIN_DEVICE_NET) {
+            for (j = 0; j < src->nnets; j++) {
+                if (src->nets[j] == hostdev->parent.data.net)
+                    break;
+            }
+            if (j == src->nnets) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("cannot find interface of hostdev"));
+                goto error;
+            }
+            if (def->nets[j]->type != VIR_DOMAIN_NET_TYPE_HOSTDEV)
+                continue;
+            def->hostdevs[def->nhostdevs] = &def->nets[j]->data.hostdev.def;
+        } else if (!(def->hostdevs[def->nhostdevs] =
+                     virDomainHostdevDefCopy(hostdev, flags))) {
+            goto error;
+        }
+        def->nhostdevs++;
+    }
+
+    /* Default labels and implicit DAC labels are never formatted.  */
+    if (src->nseclabels &&
+        VIR_ALLOC_N(def->seclabels, src->nseclabels) < 0)
+        goto error;
+    for (i = 0; i < src->nseclabels; i++) {
+        virSecurityLabelDefPtr seclabel = src->seclabels[i];
+
+        if (seclabel->type == VIR_DOMAIN_SECLABEL_DEFAULT ||
+            (seclabel->implicit && STREQ_NULLABLE(seclabel->model, "dac")))
+            continue;
+
+        if (!(def->seclabels[def->nseclabels] =
+              virSecurityLabelDefCopyConfig(seclabel)))
+            goto error;
+        def->nseclabels++;
+    }
+
+    if ((src->watchdog &&
+         !(def->watchdog = virDomainWatchdogDefCopy(src->watchdog))) ||
+        (src->memballoon &&
+         !(def->memballoon = virDomainMemballoonDefCopy(src->memballoon))) ||
+        (src->nvram &&
+         !(def->nvram = virDomainNVRAMDefCopy(src->nvram))) ||
+        (src->tpm &&
+         !(def->tpm = virDomainTPMDefCopy(src->tpm))) ||
+        (src->cpu &&
+         !(def->cpu = virCPUDefCopy(src->cpu))) ||
+        (src->sysinfo &&
+         !(def->sysinfo = virSysinfoDefCopy(src->sysinfo))) ||
+        (src->redirfilter &&
+         !(def->redirfilter = virDomainRedirFilterDefCopy(src->redirfilter))) ||
+        (src->rng &&
+         !(def->rng = virDomainRNGDefCopy(src->rng))) ||
+        (src->panic &&
+         !(def->panic = virDomainPanicDefCopy(src->panic))))
+        goto error;
+
+    if (src->namespaceData &&
+        (src->ns.copy)(src->namespaceData, &def->namespaceData) < 0)
+        goto error;
+
+    if (src->metadata &&
+        !(def->metadata = xmlCopyNode(src->metadata, 1))) {
+        virReportOOMError();
+        goto error;
+    }
+
+    return def;
+
+ error:
+    virDomainDefFree(def);
+    return NULL;
+}
+
+#undef VIR_DOMAIN_DEF_COPY_DEVICES
+
+
 /* Copy src into a new definition; with the quality of the copy
  * depending on the migratable flag (false for transitions between
  * persistent and active, true for transitions across save files or
@@ -18748,7 +20098,11 @@ virDomainDefCopy(virDomainDefPtr src,
     if (migratable)
         write_flags |= VIR_DOMAIN_XML_INACTIVE | VIR_DOMAIN_XML_MIGRATABLE;
 
-    /* Easiest to clone via a round-trip through XML.  */
+    /* Only namespace data the driver can't copy needs a round trip
+     * through XML.  */
+    if (!src->namespaceData || src->ns.copy)
+        return virDomainDefCopyConfig(src, write_flags);
+
     if (!(xml = virDomainDefFormat(src, write_flags)))
         return NULL;
 
@@ -19288,11 +20642,10 @@ virDomainDeviceDefCopy(virDomainDeviceDefPtr src,
 }
 
 struct virDomainListData {
-    virConnectPtr conn;
-    virDomainPtr *domains;
-    virDomainObjListFilter filter;
     unsigned int flags;
-    int ndomains;
+    virDomainObjPtr *vms;
+    virDomainDefPtr defs;
+    size_t nvms;
     bool error;
 };
 
@@ -19304,7 +20657,7 @@ virDomainListPopulate(void *payload,
 {
     struct virDomainListData *data = opaque;
     virDomainObjPtr vm = payload;
-    virDomainPtr dom;
+    virDomainDefPtr def;
 
     if (data->error)
         return;
@@ -19312,11 +20665,6 @@ virDomainListPopulate(void *payload,
     virObjectLock(vm);
     /* check if the domain matches the filter */
 
-    /* filter by the callback function (access control checks) */
-    if (data->filter != NULL &&
-        !data->filter(data->conn, vm->def))
-        goto cleanup;
-
     /* filter by active state */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE) &&
         !((MATCH(VIR_CONNECT_LIST_DOMAINS_ACTIVE) &&
@@ -19371,20 +20719,17 @@ virDomainListPopulate(void *payload,
             goto cleanup;
     }
 
-    /* just count the machines */
-    if (!data->domains) {
-        data->ndomains++;
-        return;
-    }
-
-    if (!(dom = virGetDomain(data->conn, vm->def->name, vm->def->uuid))) {
+    /* the access control checks may block, so they are made on a
+     * copy of the identity of the domain with the domain unlocked */
+    def = &data->defs[data->nvms];
+    if (VIR_STRDUP(def->name, vm->def->name) < 0) {
         data->error = true;
         goto cleanup;
     }
+    memcpy(def->uuid, vm->def->uuid, VIR_UUID_BUFLEN);
+    def->id = vm->def->id;
 
-    dom->id = vm->def->id;
-
-    data->domains[data->ndomains++] = dom;
+    data->vms[data->nvms++] = virObjectRef(vm);
 
  cleanup:
     virObjectUnlock(vm);
@@ -19396,21 +20741,31 @@ int
 virDomainObjListExport(virDomainObjListPtr doms,
                        virConnectPtr conn,
                        virDomainPtr **domains,
-                       virDomainObjListFilter filter,
+                       virDomainObjListBulkFilter filter,
                        unsigned int flags)
 {
+    virDomainPtr *tmp_domains = NULL;
+    virDomainPtr dom;
+    virDomainDefPtr *defs = NULL;
+    bool *allowed = NULL;
+    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    int ndomains = 0;
     int ret = -1;
     size_t i;
 
     struct virDomainListData data = {
-        conn, NULL,
-        filter,
-        flags, 0, false
+        flags, NULL, NULL, 0, false
     };
 
     virObjectLock(doms);
     if (domains &&
-        VIR_ALLOC_N(data.domains, virHashSize(doms->objs) + 1) < 0)
+        VIR_ALLOC_N(tmp_domains, virHashSize(doms->objs) + 1) < 0)
+        goto cleanup;
+
+    if (VIR_ALLOC_N(data.vms, virHashSize(doms->objs)) < 0 ||
+        VIR_ALLOC_N(data.defs, virHashSize(doms->objs)) < 0 ||
+        VIR_ALLOC_N(defs, virHashSize(doms->objs)) < 0 ||
+        VIR_ALLOC_N(allowed, virHashSize(doms->objs)) < 0)
         goto cleanup;
 
     virHashForEach(doms->objs, virDomainListPopulate, &data);
@@ -19418,24 +20773,75 @@ virDomainObjListExport(virDomainObjListPtr doms,
     if (data.error)
         goto cleanup;
 
-    if (data.domains) {
+    for (i = 0; i < data.nvms; i++) {
+        defs[i] = &data.defs[i];
+        allowed[i] = true;
+    }
+
+    /* filter by the callback function (access control checks),
+     * a failed filter denies every domain. The matching domains
+     * are referenced, so the list can be unlocked meanwhile. */
+    if (filter && data.nvms > 0) {
+        virObjectUnlock(doms);
+        ignore_value(filter(conn, defs, data.nvms, allowed));
+        virObjectLock(doms);
+    }
+
+    for (i = 0; i < data.nvms; i++) {
+        virDomainObjPtr vm = data.vms[i];
+
+        if (!allowed[i])
+            continue;
+
+        /* skip domains removed from the list while it was unlocked */
+        virUUIDFormat(data.defs[i].uuid, uuidstr);
+        if (virHashLookup(doms->objs, uuidstr) != vm)
+            continue;
+
+        /* just count the machines */
+        if (!tmp_domains) {
+            ndomains++;
+            continue;
+        }
+
+        if (!(dom = virGetDomain(conn, data.defs[i].name,
+                                 data.defs[i].uuid)))
+            goto cleanup;
+
+        virObjectLock(vm);
+        dom->id = vm->def->id;
+        virObjectUnlock(vm);
+
+        tmp_domains[ndomains++] = dom;
+    }
+
+    if (tmp_domains) {
         /* trim the array to the final size */
-        ignore_value(VIR_REALLOC_N(data.domains, data.ndomains + 1));
-        *domains = data.domains;
-        data.domains = NULL;
+        ignore_value(VIR_REALLOC_N(tmp_domains, ndomains + 1));
+        *domains = tmp_domains;
+        tmp_domains = NULL;
     }
 
-    ret = data.ndomains;
+    ret = ndomains;
 
  cleanup:
-    if (data.domains) {
-        int count = virHashSize(doms->objs);
-        for (i = 0; i < count; i++)
-            virObjectUnref(data.domains[i]);
+    if (tmp_domains) {
+        for (i = 0; i < ndomains; i++)
+            virObjectUnref(tmp_domains[i]);
     }
 
-    VIR_FREE(data.domains);
     virObjectUnlock(doms);
+
+    for (i = 0; i < data.nvms; i++) {
+        virObjectUnref(data.vms[i]);
+        VIR_FREE(data.defs[i].name);
+    }
+
+    VIR_FREE(tmp_domains);
+    VIR_FREE(data.vms);
+    VIR_FREE(data.defs);
+    VIR_FREE(defs);
+    VIR_FREE(allowed);
     return ret;
 }
 
@@ -19724,6 +21130,8 @@ virDomainObjSetMetadata(virDomainObjPtr vm,
                                         &persistentDef) < 0)
         return -1;
 
+    virDomainObjBumpGeneration(vm);
+
     if (flags & VIR_DOMAIN_AFFECT_LIVE)
         if (virDomainDefSetMetadata(vm->def, type, metadata, key, uri) < 0)
             return -1;
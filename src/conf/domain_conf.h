@@ -2013,6 +2013,10 @@ struct _virDomainStateReason {
 
 typedef struct _virDomainObj virDomainObj;
 typedef virDomainObj *virDomainObjPtr;
+/* Number of virDomainGetXMLDesc flag combinations (SECURE, INACTIVE,
+ * UPDATE_CPU and MIGRATABLE) kept in virDomainObj's XML cache */
+# define VIR_DOMAIN_OBJ_XML_CACHE_SIZE 16
+
 struct _virDomainObj {
     virObjectLockable parent;
 
@@ -2035,6 +2039,13 @@ struct _virDomainObj {
     void (*privateDataFreeFunc)(void *);
 
     int taint;
+
+    /* Changes whenever def or newDef may have changed, see
+     * virDomainObjBumpGeneration */
+    unsigned long long generation;
+    /* Formatted XML valid for the current generation, indexed by
+     * virDomainGetXMLDesc flags */
+    char *xmlCache[VIR_DOMAIN_OBJ_XML_CACHE_SIZE];
 };
 
 typedef struct _virDomainObjList virDomainObjList;
@@ -2042,6 +2053,12 @@ typedef virDomainObjList *virDomainObjListPtr;
 
 typedef bool (*virDomainObjListFilter)(virConnectPtr conn,
                                        virDomainDefPtr def);
+/* Decides on a whole set of domains at once, storing each
+ * decision in @allowed. Returns -1 on error, 0 otherwise. */
+typedef int (*virDomainObjListBulkFilter)(virConnectPtr conn,
+                                          virDomainDefPtr *defs,
+                                          size_t ndefs,
+                                          bool *allowed);
 
 
 /* This structure holds various callbacks and data needed
@@ -2115,6 +2132,16 @@ virDomainObjIsActive(virDomainObjPtr dom)
 virDomainObjPtr virDomainObjNew(virDomainXMLOptionPtr caps)
     ATTRIBUTE_NONNULL(1);
 
+void virDomainObjBumpGeneration(virDomainObjPtr obj)
+    ATTRIBUTE_NONNULL(1);
+const char *virDomainObjGetCachedXML(virDomainObjPtr obj,
+                                     unsigned int flags)
+    ATTRIBUTE_NONNULL(1);
+int virDomainObjSetCachedXML(virDomainObjPtr obj,
+                             unsigned int flags,
+                             const char *xml)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(3);
+
 virDomainObjListPtr virDomainObjListNew(void);
 
 virDomainObjPtr virDomainObjListFindByID(virDomainObjListPtr doms,
@@ -2669,7 +2696,7 @@ VIR_ENUM_DECL(virDomainStartupPolicy)
 int virDomainObjListExport(virDomainObjListPtr doms,
                            virConnectPtr conn,
                            virDomainPtr **domains,
-                           virDomainObjListFilter filter,
+                           virDomainObjListBulkFilter filter,
                            unsigned int flags);
 
 int
@@ -4395,41 +4395,83 @@ virNetworkMatch(virNetworkObjPtr netobj,
 }
 #undef MATCH
 
+/*
+ * @lock, if not NULL, is the lock guarding @netobjs that the caller
+ * holds. It is dropped while the access control filter runs, which
+ * only sees copies of the names and UUIDs of the matching networks.
+ */
 int
 virNetworkObjListExport(virConnectPtr conn,
-                        virNetworkObjList netobjs,
+                        virNetworkObjListPtr netobjs,
+                        virMutexPtr lock,
                         virNetworkPtr **nets,
-                        virNetworkObjListFilter filter,
+                        virNetworkObjListBulkFilter filter,
                         unsigned int flags)
 {
     virNetworkPtr *tmp_nets = NULL;
     virNetworkPtr net = NULL;
+    virNetworkDef *stubs = NULL;
+    virNetworkDefPtr *defs = NULL;
+    bool *allowed = NULL;
+    size_t nmatches = 0;
     int nnets = 0;
     int ret = -1;
     size_t i;
 
-    if (nets && VIR_ALLOC_N(tmp_nets, netobjs.count + 1) < 0)
+    if (nets && VIR_ALLOC_N(tmp_nets, netobjs->count + 1) < 0)
         goto cleanup;
 
-    for (i = 0; i < netobjs.count; i++) {
-        virNetworkObjPtr netobj = netobjs.objs[i];
+    if (VIR_ALLOC_N(stubs, netobjs->count) < 0 ||
+        VIR_ALLOC_N(defs, netobjs->count) < 0 ||
+        VIR_ALLOC_N(allowed, netobjs->count) < 0)
+        goto cleanup;
+
+    for (i = 0; i < netobjs->count; i++) {
+        virNetworkObjPtr netobj = netobjs->objs[i];
         virNetworkObjLock(netobj);
-        if ((!filter || filter(conn, netobj->def)) &&
-            virNetworkMatch(netobj, flags)) {
-            if (nets) {
-                if (!(net = virGetNetwork(conn,
-                                          netobj->def->name,
-                                          netobj->def->uuid))) {
-                    virNetworkObjUnlock(netobj);
-                    goto cleanup;
-                }
-                tmp_nets[nnets] = net;
+        if (virNetworkMatch(netobj, flags)) {
+            if (VIR_STRDUP(stubs[nmatches].name, netobj->def->name) < 0) {
+                virNetworkObjUnlock(netobj);
+                goto cleanup;
             }
-            nnets++;
+            memcpy(stubs[nmatches].uuid, netobj->def->uuid,
+                   VIR_UUID_BUFLEN);
+            defs[nmatches] = &stubs[nmatches];
+            allowed[nmatches] = true;
+            nmatches++;
         }
         virNetworkObjUnlock(netobj);
     }
 
+    /* A failed filter denies every network */
+    if (filter && nmatches > 0) {
+        if (lock)
+            virMutexUnlock(lock);
+        ignore_value(filter(conn, defs, nmatches, allowed));
+        if (lock)
+            virMutexLock(lock);
+    }
+
+    for (i = 0; i < nmatches; i++) {
+        virNetworkObjPtr netobj;
+
+        if (!allowed[i])
+            continue;
+
+        /* Skip networks removed while the lock was dropped */
+        if (!(netobj = virNetworkFindByUUID(netobjs, stubs[i].uuid)))
+            continue;
+        virNetworkObjUnlock(netobj);
+
+        if (nets) {
+            if (!(net = virGetNetwork(conn, stubs[i].name,
+                                      stubs[i].uuid)))
+                goto cleanup;
+            tmp_nets[nnets] = net;
+        }
+        nnets++;
+    }
+
     if (tmp_nets) {
         /* trim the array to the final size */
         ignore_value(VIR_REALLOC_N(tmp_nets, nnets + 1));
@@ -4447,6 +4489,12 @@ virNetworkObjListExport(virConnectPtr conn,
         }
     }
 
+    for (i = 0; i < nmatches; i++)
+        VIR_FREE(stubs[i].name);
+
     VIR_FREE(tmp_nets);
+    VIR_FREE(stubs);
+    VIR_FREE(defs);
+    VIR_FREE(allowed);
     return ret;
 }
@@ -331,6 +331,12 @@ void virNetworkObjListFree(virNetworkObjListPtr vms);
 
 typedef bool (*virNetworkObjListFilter)(virConnectPtr conn,
                                         virNetworkDefPtr def);
+/* Decides on a whole set of networks at once, storing each
+ * decision in @allowed. Returns -1 on error, 0 otherwise. */
+typedef int (*virNetworkObjListBulkFilter)(virConnectPtr conn,
+                                           virNetworkDefPtr *defs,
+                                           size_t ndefs,
+                                           bool *allowed);
 
 virNetworkObjPtr virNetworkAssignDef(virNetworkObjListPtr nets,
                                      virNetworkDefPtr def,
@@ -457,9 +463,10 @@ VIR_ENUM_DECL(virNetworkForward)
                  VIR_CONNECT_LIST_NETWORKS_FILTERS_AUTOSTART)
 
 int virNetworkObjListExport(virConnectPtr conn,
-                            virNetworkObjList netobjs,
+                            virNetworkObjListPtr netobjs,
+                            virMutexPtr lock,
                             virNetworkPtr **nets,
-                            virNetworkObjListFilter filter,
+                            virNetworkObjListBulkFilter filter,
                             unsigned int flags);
 
 /* for testing */
@@ -416,6 +416,7 @@ virStoragePoolObjFree(virStoragePoolObjPtr obj)
 
     VIR_FREE(obj->configFile);
     VIR_FREE(obj->autostartLink);
+    virHashFree(obj->watchDirty);
 
     virMutexDestroy(&obj->lock);
 
@@ -757,6 +758,7 @@ virStoragePoolDefParseXML(xmlXPathContextPtr ctxt)
     char *type = NULL;
     char *uuid = NULL;
     char *target_path = NULL;
+    char *watch = NULL;
 
     if (VIR_ALLOC(ret) < 0)
         return NULL;
@@ -897,10 +899,31 @@ virStoragePoolDefParseXML(xmlXPathContextPtr ctxt)
             goto error;
     }
 
+    if ((watch = virXPathString("string(./refresh/@watch)", ctxt))) {
+        if (STREQ(watch, "yes")) {
+            ret->refreshWatch = true;
+        } else if (STRNEQ(watch, "no")) {
+            virReportError(VIR_ERR_XML_ERROR,
+                           _("invalid refresh watch value '%s'"), watch);
+            goto error;
+        }
+
+        if (ret->refreshWatch &&
+            ret->type != VIR_STORAGE_POOL_DIR &&
+            ret->type != VIR_STORAGE_POOL_FS &&
+            ret->type != VIR_STORAGE_POOL_NETFS) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("watching the target is not supported "
+                             "for pool type '%s'"), type);
+            goto error;
+        }
+    }
+
  cleanup:
     VIR_FREE(uuid);
     VIR_FREE(type);
     VIR_FREE(target_path);
+    VIR_FREE(watch);
     return ret;
 
  error:
@@ -1126,6 +1149,10 @@ virStoragePoolDefFormat(virStoragePoolDefPtr def)
         virBufferAdjustIndent(&buf, -2);
         virBufferAddLit(&buf, "</target>\n");
     }
+
+    if (def->refreshWatch)
+        virBufferAddLit(&buf, "<refresh watch='yes'/>\n");
+
     virBufferAdjustIndent(&buf, -2);
     virBufferAddLit(&buf, "</pool>\n");
 
@@ -1687,6 +1714,8 @@ virStoragePoolObjAssignDef(virStoragePoolObjListPtr pools,
     }
     virStoragePoolObjLock(pool);
     pool->active = 0;
+    pool->watchfd = -1;
+    pool->watch = -1;
 
     if (VIR_APPEND_ELEMENT_COPY(pools->objs, pools->count, pool) < 0) {
         virStoragePoolObjUnlock(pool);
@@ -2130,42 +2159,83 @@ virStoragePoolMatch(virStoragePoolObjPtr poolobj,
 }
 #undef MATCH
 
+/*
+ * @lock, if not NULL, is the lock guarding @poolobjs that the caller
+ * holds. It is dropped while the access control filter runs, which
+ * only sees copies of the names and UUIDs of the matching pools.
+ */
 int
 virStoragePoolObjListExport(virConnectPtr conn,
-                            virStoragePoolObjList poolobjs,
+                            virStoragePoolObjListPtr poolobjs,
+                            virMutexPtr lock,
                             virStoragePoolPtr **pools,
-                            virStoragePoolObjListFilter filter,
+                            virStoragePoolObjListBulkFilter filter,
                             unsigned int flags)
 {
     virStoragePoolPtr *tmp_pools = NULL;
     virStoragePoolPtr pool = NULL;
+    virStoragePoolDef *stubs = NULL;
+    virStoragePoolDefPtr *defs = NULL;
+    bool *allowed = NULL;
+    size_t nmatches = 0;
     int npools = 0;
     int ret = -1;
     size_t i;
 
-    if (pools && VIR_ALLOC_N(tmp_pools, poolobjs.count + 1) < 0)
+    if (pools && VIR_ALLOC_N(tmp_pools, poolobjs->count + 1) < 0)
         goto cleanup;
 
-    for (i = 0; i < poolobjs.count; i++) {
-        virStoragePoolObjPtr poolobj = poolobjs.objs[i];
+    if (VIR_ALLOC_N(stubs, poolobjs->count) < 0 ||
+        VIR_ALLOC_N(defs, poolobjs->count) < 0 ||
+        VIR_ALLOC_N(allowed, poolobjs->count) < 0)
+        goto cleanup;
+
+    for (i = 0; i < poolobjs->count; i++) {
+        virStoragePoolObjPtr poolobj = poolobjs->objs[i];
         virStoragePoolObjLock(poolobj);
-        if ((!filter || filter(conn, poolobj->def)) &&
-            virStoragePoolMatch(poolobj, flags)) {
-            if (pools) {
-                if (!(pool = virGetStoragePool(conn,
-                                               poolobj->def->name,
-                                               poolobj->def->uuid,
-                                               NULL, NULL))) {
-                    virStoragePoolObjUnlock(poolobj);
-                    goto cleanup;
-                }
-                tmp_pools[npools] = pool;
+        if (virStoragePoolMatch(poolobj, flags)) {
+            if (VIR_STRDUP(stubs[nmatches].name, poolobj->def->name) < 0) {
+                virStoragePoolObjUnlock(poolobj);
+                goto cleanup;
             }
-            npools++;
+            memcpy(stubs[nmatches].uuid, poolobj->def->uuid,
+                   VIR_UUID_BUFLEN);
+            defs[nmatches] = &stubs[nmatches];
+            allowed[nmatches] = true;
+            nmatches++;
         }
         virStoragePoolObjUnlock(poolobj);
     }
 
+    /* A failed filter denies every pool */
+    if (filter && nmatches > 0) {
+        if (lock)
+            virMutexUnlock(lock);
+        ignore_value(filter(conn, defs, nmatches, allowed));
+        if (lock)
+            virMutexLock(lock);
+    }
+
+    for (i = 0; i < nmatches; i++) {
+        virStoragePoolObjPtr poolobj;
+
+        if (!allowed[i])
+            continue;
+
+        /* Skip pools removed while the lock was dropped */
+        if (!(poolobj = virStoragePoolObjFindByUUID(poolobjs, stubs[i].uuid)))
+            continue;
+        virStoragePoolObjUnlock(poolobj);
+
+        if (pools) {
+            if (!(pool = virGetStoragePool(conn, stubs[i].name,
+                                           stubs[i].uuid, NULL, NULL)))
+                goto cleanup;
+            tmp_pools[npools] = pool;
+        }
+        npools++;
+    }
+
     if (tmp_pools) {
         /* trim the array to the final size */
         ignore_value(VIR_REALLOC_N(tmp_pools, npools + 1));
@@ -2183,6 +2253,12 @@ virStoragePoolObjListExport(virConnectPtr conn,
         }
     }
 
+    for (i = 0; i < nmatches; i++)
+        VIR_FREE(stubs[i].name);
+
     VIR_FREE(tmp_pools);
+    VIR_FREE(stubs);
+    VIR_FREE(defs);
+    VIR_FREE(allowed);
     return ret;
 }
@@ -28,7 +28,9 @@
 # include "virstorageencryption.h"
 # include "virstoragefile.h"
 # include "virbitmap.h"
+# include "virhash.h"
 # include "virthread.h"
+# include "virthreadpool.h"
 
 # include <libxml/tree.h>
 
@@ -247,6 +249,9 @@ struct _virStoragePoolDef {
 
     virStoragePoolSource source;
     virStoragePoolTarget target;
+
+    /* Track changes of the target directory instead of rescanning it */
+    bool refreshWatch;
 };
 
 typedef struct _virStoragePoolObj virStoragePoolObj;
@@ -261,6 +266,11 @@ struct _virStoragePoolObj {
     int autostart;
     unsigned int asyncjobs;
 
+    int watchfd; /* inotify FD of the target directory, or -1 */
+    int watch;   /* event handle of watchfd, or -1 */
+    virHashTablePtr watchDirty; /* names of changed files to re-probe */
+    bool watchOverflow; /* lost track of changes, needs a full refresh */
+
     virStoragePoolDefPtr def;
     virStoragePoolDefPtr newDef;
 
@@ -281,6 +291,7 @@ struct _virStorageDriverState {
     virMutex lock;
 
     virStoragePoolObjList pools;
+    virThreadPoolPtr watchPool; /* applies changes seen by pool watches */
 
     char *configDir;
     char *autostartDir;
@@ -297,6 +308,12 @@ struct _virStoragePoolSourceList {
 
 typedef bool (*virStoragePoolObjListFilter)(virConnectPtr conn,
                                             virStoragePoolDefPtr def);
+/* Decides on a whole set of pools at once, storing each
+ * decision in @allowed. Returns -1 on error, 0 otherwise. */
+typedef int (*virStoragePoolObjListBulkFilter)(virConnectPtr conn,
+                                               virStoragePoolDefPtr *defs,
+                                               size_t ndefs,
+                                               bool *allowed);
 
 static inline int
 virStoragePoolObjIsActive(virStoragePoolObjPtr pool)
@@ -513,9 +530,10 @@ VIR_ENUM_DECL(virStoragePartedFs)
                  VIR_CONNECT_LIST_STORAGE_POOLS_FILTERS_POOL_TYPE)
 
 int virStoragePoolObjListExport(virConnectPtr conn,
-                                virStoragePoolObjList poolobjs,
+                                virStoragePoolObjListPtr poolobjs,
+                                virMutexPtr lock,
                                 virStoragePoolPtr **pools,
-                                virStoragePoolObjListFilter filter,
+                                virStoragePoolObjListBulkFilter filter,
                                 unsigned int flags);
 
 #endif /* __VIR_STORAGE_CONF_H__ */
@@ -33,6 +33,8 @@
 #include "virbuffer.h"
 #include "virendian.h"
 #include "virstring.h"
+#include "virbitmap.h"
+#include "virhash.h"
 
 #define VIR_FROM_THIS VIR_FROM_CPU
 
@@ -54,6 +56,7 @@ struct x86_vendor {
 struct x86_feature {
     char *name;
     virCPUx86Data *data;
+    size_t index;   /* position of the feature in x86_map.features */
 
     struct x86_feature *next;
 };
@@ -81,6 +84,9 @@ struct x86_model {
     char *name;
     const struct x86_vendor *vendor;
     virCPUx86Data *data;
+    /* indexes of features contained in data; only set for models in the
+     * map and only when x86_map.nfeatures is not zero */
+    virBitmapPtr features;
 
     struct x86_model *next;
 };
@@ -89,6 +95,14 @@ struct x86_map {
     struct x86_vendor *vendors;
     struct x86_feature *features;
     struct x86_model *models;
+
+    /* name -> struct x86_feature and name -> struct x86_model lookup
+     * tables, the lists above own the objects */
+    virHashTablePtr featureIndex;
+    virHashTablePtr modelIndex;
+
+    /* number of indexed features or 0 if feature bitmaps cannot be used */
+    size_t nfeatures;
 };
 
 static struct x86_map* virCPUx86Map = NULL;
@@ -386,6 +400,28 @@ x86DataIsSubset(const virCPUx86Data *data,
 }
 
 
+/* checks whether data has at least one of the bits set in bits */
+static bool
+x86DataHasAny(const virCPUx86Data *data,
+              const virCPUx86Data *bits)
+{
+    struct virCPUx86DataIterator iter = virCPUx86DataIteratorInit(bits);
+    const virCPUx86CPUID *cpuid;
+    const virCPUx86CPUID *cpuidBits;
+
+    while ((cpuidBits = x86DataCpuidNext(&iter))) {
+        if ((cpuid = x86DataCpuid(data, cpuidBits->function)) &&
+            ((cpuid->eax & cpuidBits->eax) ||
+             (cpuid->ebx & cpuidBits->ebx) ||
+             (cpuid->ecx & cpuidBits->ecx) ||
+             (cpuid->edx & cpuidBits->edx)))
+            return true;
+    }
+
+    return false;
+}
+
+
 /* also removes all detected features from data */
 static int
 x86DataToCPUFeatures(virCPUDefPtr cpu,
@@ -595,17 +631,7 @@ static struct x86_feature *
 x86FeatureFind(const struct x86_map *map,
                const char *name)
 {
-    struct x86_feature *feature;
-
-    feature = map->features;
-    while (feature != NULL) {
-        if (STREQ(feature->name, name))
-            return feature;
-
-        feature = feature->next;
-    }
-
-    return NULL;
+    return virHashLookup(map->featureIndex, name);
 }
 
 
@@ -710,6 +736,9 @@ x86FeatureLoad(xmlXPathContextPtr ctxt,
             goto error;
     }
 
+    if (virHashAddEntry(map->featureIndex, feature->name, feature) < 0)
+        goto error;
+
     if (map->features == NULL)
         map->features = feature;
     else {
@@ -787,6 +816,7 @@ x86ModelFree(struct x86_model *model)
 
     VIR_FREE(model->name);
     virCPUx86DataFree(model->data);
+    virBitmapFree(model->features);
     VIR_FREE(model);
 }
 
@@ -813,17 +843,7 @@ static struct x86_model *
 x86ModelFind(const struct x86_map *map,
              const char *name)
 {
-    struct x86_model *model;
-
-    model = map->models;
-    while (model != NULL) {
-        if (STREQ(model->name, name))
-            return model;
-
-        model = model->next;
-    }
-
-    return NULL;
+    return virHashLookup(map->modelIndex, name);
 }
 
 
@@ -1048,6 +1068,10 @@ x86ModelLoad(xmlXPathContextPtr ctxt,
             goto error;
     }
 
+    /* a model defined again replaces the previous definition */
+    if (virHashUpdateEntry(map->modelIndex, model->name, model) < 0)
+        goto error;
+
     if (map->models == NULL)
         map->models = model;
     else {
@@ -1075,6 +1099,9 @@ x86MapFree(struct x86_map *map)
     if (map == NULL)
         return;
 
+    virHashFree(map->featureIndex);
+    virHashFree(map->modelIndex);
+
     while (map->features != NULL) {
         struct x86_feature *feature = map->features;
         map->features = feature->next;
@@ -1143,6 +1170,9 @@ x86MapLoadInternalFeatures(struct x86_map *map)
         if (virCPUx86DataAddCPUID(feature->data, &x86_kvm_features[i].cpuid))
             goto error;
 
+        if (virHashAddEntry(map->featureIndex, feature->name, feature) < 0)
+            goto error;
+
         if (map->features == NULL) {
             map->features = feature;
         } else {
@@ -1161,6 +1191,69 @@ x86MapLoadInternalFeatures(struct x86_map *map)
 }
 
 
+/* Numbers all features and records which of them each model consists of
+ * so that CPU data can be decoded using feature bitmaps. Bitmaps describe
+ * the data exactly only if no two features share a CPUID bit, otherwise
+ * map->nfeatures stays 0 and decoding falls back to comparing CPUID data.
+ */
+static int
+x86MapIndexFeatures(struct x86_map *map)
+{
+    struct x86_feature *feature;
+    struct x86_model *model;
+    virCPUx86Data *all = NULL;
+    virCPUx86Data *common = NULL;
+    size_t nfeatures = 0;
+    int ret = -1;
+
+    if (VIR_ALLOC(all) < 0)
+        return -1;
+
+    for (feature = map->features; feature; feature = feature->next) {
+        if (!(common = x86DataCopy(feature->data)))
+            goto cleanup;
+
+        x86DataIntersect(common, all);
+        if (x86DataIsEmpty(feature->data) || !x86DataIsEmpty(common)) {
+            VIR_DEBUG("CPU feature %s overlaps other features, "
+                      "not using feature bitmaps", feature->name);
+            ret = 0;
+            goto cleanup;
+        }
+        virCPUx86DataFree(common);
+        common = NULL;
+
+        if (x86DataAdd(all, feature->data) < 0)
+            goto cleanup;
+
+        feature->index = nfeatures++;
+    }
+
+    if (nfeatures == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    for (model = map->models; model; model = model->next) {
+        if (!(model->features = virBitmapNew(nfeatures)))
+            goto cleanup;
+
+        for (feature = map->features; feature; feature = feature->next) {
+            if (x86DataIsSubset(model->data, feature->data))
+                ignore_value(virBitmapSetBit(model->features, feature->index));
+        }
+    }
+
+    map->nfeatures = nfeatures;
+    ret = 0;
+
+ cleanup:
+    virCPUx86DataFree(common);
+    virCPUx86DataFree(all);
+    return ret;
+}
+
+
 static struct x86_map *
 virCPUx86LoadMap(void)
 {
@@ -1169,12 +1262,19 @@ virCPUx86LoadMap(void)
     if (VIR_ALLOC(map) < 0)
         return NULL;
 
+    if (!(map->featureIndex = virHashCreate(128, NULL)) ||
+        !(map->modelIndex = virHashCreate(32, NULL)))
+        goto error;
+
     if (cpuMapLoad("x86", x86MapLoadCallback, map) < 0)
         goto error;
 
     if (x86MapLoadInternalFeatures(map) < 0)
         goto error;
 
+    if (x86MapIndexFeatures(map) < 0)
+        goto error;
+
     return map;
 
  error:
@@ -1492,6 +1592,55 @@ x86GuestData(virCPUDefPtr host,
 }
 
 
+/* Computes how many features have to be added to or removed from
+ * @candidate to describe CPU @data. When feature bitmaps are available,
+ * @contained holds features fully contained in @data (with vendor bits
+ * removed) and @touched features sharing at least one bit with @data.
+ * Returns 1 and sets @nfeatures if @candidate can be used, 0 if it cannot
+ * be used for a host CPU because it contains features missing in @data,
+ * and -1 on error.
+ */
+static int
+x86DecodeCandidate(const struct x86_model *candidate,
+                   const virCPUx86Data *data,
+                   virBitmapPtr contained,
+                   virBitmapPtr touched,
+                   virBitmapPtr scratch,
+                   bool host,
+                   const struct x86_map *map,
+                   size_t *nfeatures)
+{
+    virCPUDefPtr cpuCandidate;
+    size_t disabled = 0;
+    size_t i;
+
+    if (contained) {
+        ignore_value(virBitmapCopy(scratch, candidate->features));
+        virBitmapSubtract(scratch, touched);
+        disabled = virBitmapCountBits(scratch);
+        if (host && disabled > 0)
+            return 0;
+
+        ignore_value(virBitmapCopy(scratch, contained));
+        virBitmapSubtract(scratch, candidate->features);
+        *nfeatures = disabled + virBitmapCountBits(scratch);
+        return 1;
+    }
+
+    if (!(cpuCandidate = x86DataToCPU(data, candidate, map)))
+        return -1;
+
+    for (i = 0; i < cpuCandidate->nfeatures; i++) {
+        if (cpuCandidate->features[i].policy == VIR_CPU_FEATURE_DISABLE)
+            disabled++;
+    }
+    *nfeatures = cpuCandidate->nfeatures;
+    virCPUDefFree(cpuCandidate);
+
+    return host && disabled > 0 ? 0 : 1;
+}
+
+
 static int
 x86Decode(virCPUDefPtr cpu,
           const virCPUx86Data *data,
@@ -1503,18 +1652,46 @@ x86Decode(virCPUDefPtr cpu,
     int ret = -1;
     const struct x86_map *map;
     const struct x86_model *candidate;
-    virCPUDefPtr cpuCandidate;
+    const struct x86_model *best = NULL;
+    const struct x86_vendor *vendor;
     virCPUDefPtr cpuModel = NULL;
     virCPUx86Data *copy = NULL;
     virCPUx86Data *features = NULL;
-    const virCPUx86Data *cpuData = NULL;
+    virBitmapPtr contained = NULL;
+    virBitmapPtr touched = NULL;
+    virBitmapPtr scratch = NULL;
+    const struct x86_feature *feature;
+    bool host = cpu->type == VIR_CPU_TYPE_HOST;
+    size_t bestFeatures = 0;
+    size_t nfeatures;
     size_t i;
+    int rc;
 
     virCheckFlags(VIR_CONNECT_BASELINE_CPU_EXPAND_FEATURES, -1);
 
     if (!data || !(map = virCPUx86GetMap()))
         return -1;
 
+    if (!(copy = x86DataCopy(data)))
+        goto out;
+    vendor = x86DataToVendor(copy, map);
+
+    if (map->nfeatures) {
+        if (!(contained = virBitmapNew(map->nfeatures)) ||
+            !(touched = virBitmapNew(map->nfeatures)) ||
+            !(scratch = virBitmapNew(map->nfeatures)))
+            goto out;
+
+        for (feature = map->features; feature; feature = feature->next) {
+            if (x86DataIsSubset(copy, feature->data))
+                ignore_value(virBitmapSetBit(contained, feature->index));
+            if (x86DataHasAny(data, feature->data))
+                ignore_value(virBitmapSetBit(touched, feature->index));
+        }
+    }
+    virCPUx86DataFree(copy);
+    copy = NULL;
+
     candidate = map->models;
     while (candidate != NULL) {
         if (!cpuModelIsAllowed(candidate->name, models, nmodels)) {
@@ -1536,59 +1713,51 @@ x86Decode(virCPUDefPtr cpu,
             goto next;
         }
 
-        if (!(cpuCandidate = x86DataToCPU(data, candidate, map)))
-            goto out;
-
-        if (candidate->vendor && cpuCandidate->vendor &&
-            STRNEQ(candidate->vendor->name, cpuCandidate->vendor)) {
+        if (candidate->vendor && vendor &&
+            STRNEQ(candidate->vendor->name, vendor->name)) {
             VIR_DEBUG("CPU vendor %s of model %s differs from %s; ignoring",
                       candidate->vendor->name, candidate->name,
-                      cpuCandidate->vendor);
-            virCPUDefFree(cpuCandidate);
+                      vendor->name);
             goto next;
         }
 
-        if (cpu->type == VIR_CPU_TYPE_HOST) {
-            cpuCandidate->type = VIR_CPU_TYPE_HOST;
-            for (i = 0; i < cpuCandidate->nfeatures; i++) {
-                switch (cpuCandidate->features[i].policy) {
-                case VIR_CPU_FEATURE_DISABLE:
-                    virCPUDefFree(cpuCandidate);
-                    goto next;
-                default:
-                    cpuCandidate->features[i].policy = -1;
-                }
-            }
-        }
+        if ((rc = x86DecodeCandidate(candidate, data, contained, touched,
+                                     scratch, host, map, &nfeatures)) < 0)
+            goto out;
+        if (rc == 0)
+            goto next;
 
-        if (preferred && STREQ(cpuCandidate->model, preferred)) {
-            virCPUDefFree(cpuModel);
-            cpuModel = cpuCandidate;
-            cpuData = candidate->data;
+        if (preferred && STREQ(candidate->name, preferred)) {
+            best = candidate;
             break;
         }
 
-        if (cpuModel == NULL
-            || cpuModel->nfeatures > cpuCandidate->nfeatures) {
-            virCPUDefFree(cpuModel);
-            cpuModel = cpuCandidate;
-            cpuData = candidate->data;
-        } else {
-            virCPUDefFree(cpuCandidate);
+        if (best == NULL || bestFeatures > nfeatures) {
+            best = candidate;
+            bestFeatures = nfeatures;
         }
 
     next:
         candidate = candidate->next;
     }
 
-    if (cpuModel == NULL) {
+    if (best == NULL) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        "%s", _("Cannot find suitable CPU model for given data"));
         goto out;
     }
 
+    if (!(cpuModel = x86DataToCPU(data, best, map)))
+        goto out;
+
+    if (host) {
+        cpuModel->type = VIR_CPU_TYPE_HOST;
+        for (i = 0; i < cpuModel->nfeatures; i++)
+            cpuModel->features[i].policy = -1;
+    }
+
     if (flags & VIR_CONNECT_BASELINE_CPU_EXPAND_FEATURES) {
-        if (!(copy = x86DataCopy(cpuData)) ||
+        if (!(copy = x86DataCopy(best->data)) ||
             !(features = x86DataFromCPUFeatures(cpuModel, map)))
             goto out;
 
@@ -1610,6 +1779,9 @@ x86Decode(virCPUDefPtr cpu,
     virCPUDefFree(cpuModel);
     virCPUx86DataFree(copy);
     virCPUx86DataFree(features);
+    virBitmapFree(contained);
+    virBitmapFree(touched);
+    virBitmapFree(scratch);
     return ret;
 }
 
@@ -134,6 +134,11 @@ typedef char *
                                       const char *virttype,
                                       unsigned int flags);
 
+typedef int
+(*virDrvDomainGetXMLGeneration)(virDomainPtr domain,
+                                unsigned long long *generation,
+                                unsigned int flags);
+
 typedef int
 (*virDrvConnectListDomains)(virConnectPtr conn,
                             int *ids,
@@ -771,6 +776,14 @@ typedef virDomainSnapshotPtr
                                  const char *xmlDesc,
                                  unsigned int flags);
 
+typedef int
+(*virDrvDomainSnapshotCreateGroup)(virConnectPtr conn,
+                                   virDomainPtr *domains,
+                                   const char **xmlDescs,
+                                   unsigned int ndomains,
+                                   virDomainSnapshotPtr **snapshots,
+                                   unsigned int flags);
+
 typedef char *
 (*virDrvDomainSnapshotGetXMLDesc)(virDomainSnapshotPtr snapshot,
                                   unsigned int flags);
@@ -1416,6 +1429,8 @@ struct _virDriver {
     virDrvDomainSetTime domainSetTime;
     virDrvNodeGetFreePages nodeGetFreePages;
     virDrvConnectGetDomainCapabilities connectGetDomainCapabilities;
+    virDrvDomainGetXMLGeneration domainGetXMLGeneration;
+    virDrvDomainSnapshotCreateGroup domainSnapshotCreateGroup;
 };
 
 
@@ -4391,6 +4391,55 @@ virDomainGetXMLDesc(virDomainPtr domain, unsigned int flags)
 }
 
 
+/**
+ * virDomainGetXMLGeneration:
+ * @domain: a domain object
+ * @generation: return location for the generation counter
+ * @flags: extra flags; not used yet, so callers should always pass 0
+ *
+ * Get a counter that changes whenever the XML description of the
+ * domain, as returned by virDomainGetXMLDesc() with any combination of
+ * flags, may have changed.  This is much cheaper than fetching the XML,
+ * so a client polling for changes can fetch it only when the counter
+ * differs from the value seen last time.
+ *
+ * The value has no meaning other than for comparison with values
+ * previously returned for the same domain.  It may change without the
+ * XML actually changing, but the XML never changes without the value
+ * changing.
+ *
+ * Returns 0 in case of success, -1 otherwise.
+ */
+int
+virDomainGetXMLGeneration(virDomainPtr domain,
+                          unsigned long long *generation,
+                          unsigned int flags)
+{
+    virConnectPtr conn;
+
+    VIR_DOMAIN_DEBUG(domain, "generation=%p, flags=%x", generation, flags);
+
+    virResetLastError();
+
+    virCheckDomainReturn(domain, -1);
+    conn = domain->conn;
+
+    virCheckNonNullArgGoto(generation, error);
+
+    if (conn->driver->domainGetXMLGeneration) {
+        if (conn->driver->domainGetXMLGeneration(domain, generation,
+                                                 flags) < 0)
+            goto error;
+        return 0;
+    }
+
+    virReportUnsupportedError();
+ error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
 /**
  * virConnectDomainXMLFromNative:
  * @conn: a connection object
@@ -17559,7 +17608,7 @@ virDomainGetJobInfo(virDomainPtr domain, virDomainJobInfoPtr info)
  * @type: where to store the job type (one of virDomainJobType)
  * @params: where to store job statistics
  * @nparams: number of items in @params
- * @flags: extra flags; not used yet, so callers should always pass 0
+ * @flags: bitwise-OR of virDomainGetJobStatsFlags
  *
  * Extract information about progress of a background job on a domain.
  * Will return an error if the domain is not active. The function returns
@@ -17569,6 +17618,11 @@ virDomainGetJobInfo(virDomainPtr domain, virDomainJobInfoPtr info)
  * may receive fields that they do not understand in case they talk to a
  * newer server.
  *
+ * If @flags includes VIR_DOMAIN_JOB_STATS_START_PHASES, the time spent
+ * in each phase of starting the domain is reported as well, in fields
+ * prefixed with VIR_DOMAIN_JOB_START_PHASE_PREFIX. These are returned
+ * even if no job is active, in which case @type is VIR_DOMAIN_JOB_NONE.
+ *
  * Returns 0 in case of success and -1 in case of failure.
  */
 int
@@ -18479,6 +18533,105 @@ virDomainSnapshotCreateXML(virDomainPtr domain,
 }
 
 
+/**
+ * virDomainSnapshotCreateGroup:
+ * @domains: array of running domains, all from the same connection
+ * @xmlDescs: snapshot XML description for each of @domains
+ * @ndomains: number of entries in @domains and @xmlDescs
+ * @snapshots: return location for the array of created snapshots
+ * @flags: bitwise-OR of virDomainSnapshotCreateFlags
+ *
+ * Creates a disk snapshot of each of @domains, as if
+ * virDomainSnapshotCreateXML() was called for every domain with the
+ * corresponding element of @xmlDescs, except that the snapshots of all
+ * domains are taken at the same time.  This allows taking a snapshot
+ * that is consistent across a group of guests working together, such
+ * as the tiers of an application.
+ *
+ * @flags must include VIR_DOMAIN_SNAPSHOT_CREATE_DISK_ONLY, and may
+ * include VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE,
+ * VIR_DOMAIN_SNAPSHOT_CREATE_NO_METADATA,
+ * VIR_DOMAIN_SNAPSHOT_CREATE_REUSE_EXT and
+ * VIR_DOMAIN_SNAPSHOT_CREATE_ATOMIC, with the same meaning as for
+ * virDomainSnapshotCreateXML().  With VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE,
+ * no snapshot is taken before the file systems of every domain in the
+ * group are frozen, and each domain is thawed as soon as its own
+ * snapshot is done.
+ *
+ * If the snapshot of any domain cannot be started, none is taken.  Once
+ * the snapshots are being taken, a failure in one domain does not undo
+ * the snapshots of the others; the API then fails and the disks of each
+ * domain have to be checked as described for virDomainSnapshotCreateXML().
+ *
+ * On success, @snapshots is set to an array of @ndomains snapshots in the
+ * order of @domains.  The caller is responsible for calling
+ * virDomainSnapshotFree() on each element and then free() on the array.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+virDomainSnapshotCreateGroup(virDomainPtr *domains,
+                             const char **xmlDescs,
+                             unsigned int ndomains,
+                             virDomainSnapshotPtr **snapshots,
+                             unsigned int flags)
+{
+    virConnectPtr conn = NULL;
+    size_t i;
+
+    VIR_DEBUG("domains=%p, xmlDescs=%p, ndomains=%u, snapshots=%p, flags=%x",
+              domains, xmlDescs, ndomains, snapshots, flags);
+
+    virResetLastError();
+
+    if (!domains || !ndomains) {
+        virReportInvalidArg(domains,
+                            _("domains in %s must not be empty"),
+                            __FUNCTION__);
+        goto error;
+    }
+
+    for (i = 0; i < ndomains; i++) {
+        virCheckDomainReturn(domains[i], -1);
+        if (!conn) {
+            conn = domains[i]->conn;
+        } else if (domains[i]->conn != conn) {
+            virReportInvalidArg(domains,
+                                _("domains in %s must all belong to "
+                                  "the same connection"),
+                                __FUNCTION__);
+            goto error;
+        }
+    }
+
+    virCheckNonNullArgGoto(xmlDescs, error);
+    virCheckNonNullArgGoto(snapshots, error);
+    for (i = 0; i < ndomains; i++)
+        virCheckNonNullArgGoto(xmlDescs[i], error);
+    virCheckReadOnlyGoto(conn->flags, error);
+
+    if (!(flags & VIR_DOMAIN_SNAPSHOT_CREATE_DISK_ONLY)) {
+        virReportInvalidArg(flags,
+                            _("%s requires 'disk only' flag"),
+                            __FUNCTION__);
+        goto error;
+    }
+
+    if (conn->driver->domainSnapshotCreateGroup) {
+        if (conn->driver->domainSnapshotCreateGroup(conn, domains, xmlDescs,
+                                                    ndomains, snapshots,
+                                                    flags) < 0)
+            goto error;
+        return 0;
+    }
+
+    virReportUnsupportedError();
+ error:
+    virDispatchError(conn);
+    return -1;
+}
+
+
 /**
  * virDomainSnapshotGetXMLDesc:
  * @snapshot: a domain snapshot object
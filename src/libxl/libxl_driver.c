@@ -4155,7 +4155,7 @@ libxlConnectListAllDomains(virConnectPtr conn,
         return -1;
 
     ret = virDomainObjListExport(driver->domains, conn, domains,
-                                 virConnectListAllDomainsCheckACL, flags);
+                                 virConnectListAllDomainsCheckACLBulk, flags);
 
     return ret;
 }
@@ -3545,7 +3545,7 @@ lxcConnectListAllDomains(virConnectPtr conn,
         return -1;
 
     ret = virDomainObjListExport(driver->domains, conn, domains,
-                                 virConnectListAllDomainsCheckACL, flags);
+                                 virConnectListAllDomainsCheckACLBulk, flags);
     return ret;
 }
 
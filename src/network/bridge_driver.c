@@ -2527,8 +2527,9 @@ networkConnectListAllNetworks(virConnectPtr conn,
         goto cleanup;
 
     networkDriverLock(driver);
-    ret = virNetworkObjListExport(conn, driver->networks, nets,
-                                  virConnectListAllNetworksCheckACL,
+    ret = virNetworkObjListExport(conn, &driver->networks, &driver->lock,
+                                  nets,
+                                  virConnectListAllNetworksCheckACLBulk,
                                   flags);
     networkDriverUnlock(driver);
 
@@ -454,7 +454,8 @@ static int parallelsConnectListAllNetworks(virConnectPtr conn,
     virCheckFlags(VIR_CONNECT_LIST_NETWORKS_FILTERS_ALL, -1);
 
     parallelsDriverLock(privconn);
-    ret = virNetworkObjListExport(conn, privconn->networks, nets, NULL, flags);
+    ret = virNetworkObjListExport(conn, &privconn->networks, NULL,
+                                  nets, NULL, flags);
     parallelsDriverUnlock(privconn);
 
     return ret;
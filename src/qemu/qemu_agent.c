@@ -49,6 +49,8 @@ VIR_LOG_INIT("qemu.qemu_agent");
 
 #define LINE_ENDING "\n"
 
+#define QEMU_AGENT_WAIT_TIME 5
+
 #define DEBUG_IO 0
 #define DEBUG_RAW_IO 0
 
@@ -66,6 +68,10 @@ static struct {
 typedef struct _qemuAgentMessage qemuAgentMessage;
 typedef qemuAgentMessage *qemuAgentMessagePtr;
 
+/* Turns the reply to an asynchronous command into what the
+ * synchronous variant of the command returns */
+typedef int (*qemuAgentReplyParser)(virJSONValuePtr reply);
+
 struct _qemuAgentMessage {
     char *txBuffer;
     int txOffset;
@@ -80,6 +86,30 @@ struct _qemuAgentMessage {
      * fatal error occurred on the monitor channel
      */
     bool finished;
+
+    /* Why the message finished without a reply, if it did */
+    virError error;
+    bool timedOut;
+
+    /* Seconds to wait for the reply, counted from when the message
+     * gets its turn, see qemuAgentSend for the special values */
+    int seconds;
+    bool started;
+    unsigned long long deadline;
+
+    /* ID the agent has to echo for the guest-sync we send ahead of
+     * other commands, 0 for all other messages */
+    unsigned long long syncID;
+
+    /* Asynchronous commands are owned by the agent, which runs
+     * @cb and frees them once they finished */
+    bool async;
+    virJSONValuePtr cmd;
+    qemuAgentReplyParser parse;
+    qemuAgentCompletionCallback cb;
+    void *opaque;
+
+    qemuAgentMessagePtr next;
 };
 
 
@@ -97,10 +127,18 @@ struct _qemuAgent {
 
     qemuAgentCallbacksPtr cb;
 
-    /* If there's a command being processed this will be
-     * non-NULL */
+    /* Commands waiting for the agent, only the first one is
+     * sent and waits for its reply at any time */
     qemuAgentMessagePtr msg;
 
+    /* Fires when the first command runs out of time, or right away
+     * when the next command is due to be started */
+    int timer;
+
+    /* Whether guest-sync succeeded and nothing happened since then
+     * that could leave a stale reply in the channel */
+    bool inSync;
+
     /* Buffer incoming data ready for Agent monitor
      * code to process & find message boundaries */
     size_t bufferOffset;
@@ -324,7 +362,20 @@ qemuAgentIOProcessLine(qemuAgentPtr mon,
         ret = qemuAgentIOProcessEvent(mon, obj);
     } else if (virJSONValueObjectHasKey(obj, "error") == 1 ||
                virJSONValueObjectHasKey(obj, "return") == 1) {
-        if (msg) {
+        if (msg && msg->syncID) {
+            /* Anything but the ID we sent is left over from
+             * an earlier command and is dropped */
+            if (virJSONValueObjectGetNumberUlong(obj, "return", &id) == 0 &&
+                id == msg->syncID) {
+                VIR_DEBUG("Guest returned ID: %llu", id);
+                mon->inSync = true;
+                msg->finished = 1;
+            } else {
+                VIR_DEBUG("Ignoring stale reply while waiting for "
+                          "guest-sync ID %llu", msg->syncID);
+            }
+            ret = 0;
+        } else if (msg) {
             msg->rxObject = obj;
             msg->finished = 1;
             obj = NULL;
@@ -336,7 +387,8 @@ qemuAgentIOProcessLine(qemuAgentPtr mon,
              * which is now processing our previous
              * guest-sync commands. Check if this is
              * the case and don't report an error but
-             * return silently.
+             * return silently. The same goes for any
+             * reply to a command we gave up on.
              */
             if (virJSONValueObjectGetNumberUlong(obj, "return", &id) == 0) {
                 VIR_DEBUG("Ignoring delayed reply to guest-sync: %llu", id);
@@ -344,6 +396,12 @@ qemuAgentIOProcessLine(qemuAgentPtr mon,
                 goto cleanup;
             }
 
+            if (!mon->inSync) {
+                VIR_DEBUG("Ignoring delayed reply to an abandoned command");
+                ret = 0;
+                goto cleanup;
+            }
+
             virReportError(VIR_ERR_INTERNAL_ERROR,
                            _("Unexpected JSON reply '%s'"), line);
         }
@@ -385,6 +443,10 @@ static int qemuAgentIOProcessData(qemuAgentPtr mon,
                 return -1;
             }
             used += got + strlen(LINE_ENDING);
+
+            /* No further reply can belong to this message */
+            if (msg && msg->finished)
+                msg = NULL;
         } else {
             break;
         }
@@ -407,7 +469,8 @@ qemuAgentIOProcess(qemuAgentPtr mon)
     /* See if there's a message ready for reply; that is,
      * one that has completed writing all its data.
      */
-    if (mon->msg && mon->msg->txOffset == mon->msg->txLength)
+    if (mon->msg && mon->msg->started &&
+        mon->msg->txOffset == mon->msg->txLength)
         msg = mon->msg;
 
 #if DEBUG_IO
@@ -440,8 +503,6 @@ qemuAgentIOProcess(qemuAgentPtr mon)
 #if DEBUG_IO
     VIR_DEBUG("Process done %zu used %d", mon->bufferOffset, len);
 #endif
-    if (msg && msg->finished)
-        virCondBroadcast(&mon->notify);
     return len;
 }
 
@@ -485,7 +546,8 @@ qemuAgentIOWrite(qemuAgentPtr mon)
     int done;
 
     /* If no active message, or fully transmitted, then no-op */
-    if (!mon->msg || mon->msg->txOffset == mon->msg->txLength)
+    if (!mon->msg || !mon->msg->started ||
+        mon->msg->txOffset == mon->msg->txLength)
         return 0;
 
     done = safewrite(mon->fd,
@@ -565,7 +627,8 @@ static void qemuAgentUpdateWatch(qemuAgentPtr mon)
     if (mon->lastError.code == VIR_ERR_OK) {
         events |= VIR_EVENT_HANDLE_READABLE;
 
-        if (mon->msg && mon->msg->txOffset < mon->msg->txLength)
+        if (mon->msg && mon->msg->started &&
+            mon->msg->txOffset < mon->msg->txLength)
             events |= VIR_EVENT_HANDLE_WRITABLE;
     }
 
@@ -573,10 +636,272 @@ static void qemuAgentUpdateWatch(qemuAgentPtr mon)
 }
 
 
+static int qemuAgentCheckError(virJSONValuePtr cmd,
+                               virJSONValuePtr reply);
+
+
+static void
+qemuAgentMessageFree(qemuAgentMessagePtr msg)
+{
+    if (!msg)
+        return;
+
+    VIR_FREE(msg->txBuffer);
+    VIR_FREE(msg->rxBuffer);
+    virJSONValueFree(msg->rxObject);
+    virJSONValueFree(msg->cmd);
+    virResetError(&msg->error);
+    VIR_FREE(msg);
+}
+
+
+/*
+ * Takes the first message off the queue. If @failed is true the
+ * message failed with the error currently set, and so does the command
+ * a failed guest-sync was sent for. Anyone waiting for a synchronous
+ * message is woken up, asynchronous ones are moved to @done to have
+ * their callback run once the agent is unlocked.
+ */
+static void
+qemuAgentPopMessage(qemuAgentPtr mon,
+                    bool failed,
+                    bool timedOut,
+                    qemuAgentMessagePtr *done)
+{
+    qemuAgentMessagePtr msg = mon->msg;
+
+    if (!msg)
+        return;
+
+    mon->msg = msg->next;
+    msg->next = NULL;
+    msg->finished = 1;
+    msg->timedOut = timedOut;
+    if (failed)
+        virCopyLastError(&msg->error);
+
+    if (msg->syncID) {
+        qemuAgentMessageFree(msg);
+        if (failed)
+            qemuAgentPopMessage(mon, true, false, done);
+    } else if (msg->async) {
+        while (*done)
+            done = &(*done)->next;
+        *done = msg;
+    } else {
+        virCondBroadcast(&mon->notify);
+    }
+}
+
+
+static qemuAgentMessagePtr
+qemuAgentNewSyncMessage(void)
+{
+    qemuAgentMessagePtr msg;
+    unsigned long long id;
+
+    if (virTimeMillisNow(&id) < 0 ||
+        VIR_ALLOC(msg) < 0)
+        return NULL;
+
+    if (virAsprintf(&msg->txBuffer,
+                    "{\"execute\":\"guest-sync\", "
+                    "\"arguments\":{\"id\":%llu}}\n", id) < 0) {
+        VIR_FREE(msg);
+        return NULL;
+    }
+
+    msg->txLength = strlen(msg->txBuffer);
+    msg->syncID = id;
+    msg->seconds = VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT;
+
+    VIR_DEBUG("Sending guest-sync command with ID: %llu", id);
+    return msg;
+}
+
+
+/*
+ * Gets the first message in the queue going, unless it is already.
+ * A guest-sync is put in front of it if the agent may have a stale
+ * reply pending, so that the reply is not taken for this message's.
+ */
+static void
+qemuAgentStartNext(qemuAgentPtr mon,
+                   qemuAgentMessagePtr *done)
+{
+    qemuAgentMessagePtr msg;
+    unsigned long long now = 0;
+    int timeout = -1;
+
+    while ((msg = mon->msg) && !msg->started) {
+        if (!mon->inSync && !msg->syncID) {
+            qemuAgentMessagePtr sync;
+
+            if (!(sync = qemuAgentNewSyncMessage())) {
+                qemuAgentPopMessage(mon, true, false, done);
+                virResetLastError();
+                continue;
+            }
+            sync->next = msg;
+            mon->msg = msg = sync;
+        }
+
+        msg->started = true;
+        if (msg->seconds > VIR_DOMAIN_QEMU_AGENT_COMMAND_BLOCK &&
+            virTimeMillisNow(&now) == 0) {
+            int seconds = msg->seconds;
+
+            if (seconds == VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT)
+                seconds = QEMU_AGENT_WAIT_TIME;
+            msg->deadline = now + seconds * 1000ull;
+        }
+    }
+
+    if (msg && msg->deadline &&
+        (now || virTimeMillisNow(&now) == 0)) {
+        if (msg->deadline <= now)
+            timeout = 0;
+        else
+            timeout = MIN(msg->deadline - now, INT_MAX);
+    }
+
+    virEventUpdateTimeout(mon->timer, timeout);
+    qemuAgentUpdateWatch(mon);
+}
+
+
+/* Runs the callbacks of the asynchronous messages in @done and frees
+ * them. Call this function without holding the agent lock. */
+static void
+qemuAgentRunCallbacks(qemuAgentPtr mon,
+                      qemuAgentMessagePtr done)
+{
+    while (done) {
+        qemuAgentMessagePtr msg = done;
+        int ret = -1;
+
+        done = msg->next;
+
+        if (msg->error.code != VIR_ERR_OK) {
+            ret = msg->timedOut ? -2 : -1;
+        } else if (!msg->rxObject) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Missing monitor reply object"));
+        } else if (qemuAgentCheckError(msg->cmd, msg->rxObject) == 0) {
+            ret = msg->parse ? (msg->parse)(msg->rxObject) : 0;
+        }
+
+        if (ret < 0 && msg->error.code == VIR_ERR_OK)
+            virCopyLastError(&msg->error);
+        virResetLastError();
+
+        VIR_DEBUG("Finished async command mon=%p ret=%d", mon, ret);
+        if (msg->cb)
+            (msg->cb)(mon, ret, ret < 0 ? &msg->error : NULL, msg->opaque);
+
+        qemuAgentMessageFree(msg);
+    }
+}
+
+
+static void
+qemuAgentTimeout(int timer ATTRIBUTE_UNUSED,
+                 void *opaque)
+{
+    qemuAgentPtr mon = opaque;
+    qemuAgentMessagePtr done = NULL;
+    qemuAgentMessagePtr msg;
+    unsigned long long now;
+
+    virObjectRef(mon);
+    virObjectLock(mon);
+
+    if ((msg = mon->msg) && msg->started && msg->deadline &&
+        virTimeMillisNow(&now) == 0 && now >= msg->deadline) {
+        virReportError(VIR_ERR_AGENT_UNRESPONSIVE, "%s",
+                       _("Guest agent not available for now"));
+        /* The reply may still come and must not be
+         * taken for the reply to the next command */
+        mon->inSync = false;
+        qemuAgentPopMessage(mon, true, true, &done);
+        virResetLastError();
+    }
+
+    if (mon->lastError.code == VIR_ERR_OK)
+        qemuAgentStartNext(mon, &done);
+    else
+        virEventUpdateTimeout(mon->timer, -1);
+
+    virObjectUnlock(mon);
+    qemuAgentRunCallbacks(mon, done);
+    virObjectUnref(mon);
+}
+
+
+/* Appends @msg to the queue, the event loop starts it once it
+ * gets its turn */
+static int
+qemuAgentQueueMessage(qemuAgentPtr mon,
+                      qemuAgentMessagePtr msg)
+{
+    qemuAgentMessagePtr *tail = &mon->msg;
+
+    /* Check whether qemu quit unexpectedly */
+    if (mon->lastError.code != VIR_ERR_OK) {
+        VIR_DEBUG("Attempt to send command while error is set %s",
+                  NULLSTR(mon->lastError.message));
+        virSetError(&mon->lastError);
+        return -1;
+    }
+
+    if (mon->timer < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("guest agent is closed"));
+        return -1;
+    }
+
+    while (*tail)
+        tail = &(*tail)->next;
+    *tail = msg;
+
+    if (mon->msg == msg)
+        virEventUpdateTimeout(mon->timer, 0);
+
+    return 0;
+}
+
+
+/* Takes @msg off the queue without waiting for its reply */
+static void
+qemuAgentUnqueueMessage(qemuAgentPtr mon,
+                        qemuAgentMessagePtr msg)
+{
+    qemuAgentMessagePtr *tmp = &mon->msg;
+
+    while (*tmp && *tmp != msg)
+        tmp = &(*tmp)->next;
+
+    if (!*tmp)
+        return;
+
+    if (msg->started) {
+        /* A reply may still come */
+        mon->inSync = false;
+    }
+
+    *tmp = msg->next;
+    msg->next = NULL;
+
+    if (mon->timer >= 0)
+        virEventUpdateTimeout(mon->timer, 0);
+}
+
+
 static void
 qemuAgentIO(int watch, int fd, int events, void *opaque)
 {
     qemuAgentPtr mon = opaque;
+    qemuAgentMessagePtr done = NULL;
     bool error = false;
     bool eof = false;
 
@@ -623,8 +948,12 @@ qemuAgentIO(int watch, int fd, int events, void *opaque)
                  * give time for that data to be consumed */
                 events = 0;
 
-                if (qemuAgentIOProcess(mon) < 0)
+                if (qemuAgentIOProcess(mon) < 0) {
                     error = true;
+                } else if (mon->msg && mon->msg->finished) {
+                    qemuAgentPopMessage(mon, false, false, &done);
+                    qemuAgentStartNext(mon, &done);
+                }
             }
         }
 
@@ -665,12 +994,15 @@ qemuAgentIO(int watch, int fd, int events, void *opaque)
         }
 
         VIR_DEBUG("Error on monitor %s", NULLSTR(mon->lastError.message));
-        /* If IO process resulted in an error & we have a message,
-         * then wakeup that waiter */
-        if (mon->msg && !mon->msg->finished) {
-            mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
+        /* If IO process resulted in an error & we have messages,
+         * then fail them all and wakeup the waiter */
+        if (mon->msg) {
+            virSetError(&mon->lastError);
+            while (mon->msg)
+                qemuAgentPopMessage(mon, true, false, &done);
+            virResetLastError();
         }
+        virEventUpdateTimeout(mon->timer, -1);
     }
 
     qemuAgentUpdateWatch(mon);
@@ -686,6 +1018,7 @@ qemuAgentIO(int watch, int fd, int events, void *opaque)
         /* Make sure anyone waiting wakes up now */
         virCondSignal(&mon->notify);
         virObjectUnlock(mon);
+        qemuAgentRunCallbacks(mon, done);
         virObjectUnref(mon);
         VIR_DEBUG("Triggering EOF callback");
         (eofNotify)(mon, vm);
@@ -697,11 +1030,13 @@ qemuAgentIO(int watch, int fd, int events, void *opaque)
         /* Make sure anyone waiting wakes up now */
         virCondSignal(&mon->notify);
         virObjectUnlock(mon);
+        qemuAgentRunCallbacks(mon, done);
         virObjectUnref(mon);
         VIR_DEBUG("Triggering error callback");
         (errorNotify)(mon, vm);
     } else {
         virObjectUnlock(mon);
+        qemuAgentRunCallbacks(mon, done);
         virObjectUnref(mon);
     }
 }
@@ -727,6 +1062,7 @@ qemuAgentOpen(virDomainObjPtr vm,
         return NULL;
 
     mon->fd = -1;
+    mon->timer = -1;
     if (virCondInit(&mon->notify) < 0) {
         virReportSystemError(errno, "%s",
                              _("cannot initialize monitor condition"));
@@ -773,6 +1109,15 @@ qemuAgentOpen(virDomainObjPtr vm,
         goto cleanup;
     }
 
+    virObjectRef(mon);
+    if ((mon->timer = virEventAddTimeout(-1, qemuAgentTimeout, mon,
+                                         virObjectFreeCallback)) < 0) {
+        virObjectUnref(mon);
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("unable to register agent timer"));
+        goto cleanup;
+    }
+
     VIR_DEBUG("New mon %p fd =%d watch=%d", mon, mon->fd, mon->watch);
 
     return mon;
@@ -791,6 +1136,8 @@ qemuAgentOpen(virDomainObjPtr vm,
 
 void qemuAgentClose(qemuAgentPtr mon)
 {
+    qemuAgentMessagePtr done = NULL;
+
     if (!mon)
         return;
 
@@ -804,19 +1151,36 @@ void qemuAgentClose(qemuAgentPtr mon)
         VIR_FORCE_CLOSE(mon->fd);
     }
 
+    if (mon->timer >= 0) {
+        virEventRemoveTimeout(mon->timer);
+        mon->timer = -1;
+    }
+
     /* If there is somebody waiting for a message
-     * wake him up. No message will arrive anyway. */
-    if (mon->msg && !mon->msg->finished) {
-        mon->msg->finished = 1;
-        virCondSignal(&mon->notify);
+     * wake him up. No message will arrive anyway. Those
+     * waiting for an event may still consider that a success,
+     * asynchronous commands fail. */
+    if (mon->msg) {
+        virErrorPtr orig_err = virSaveLastError();
+
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("guest agent was closed"));
+        while (mon->msg)
+            qemuAgentPopMessage(mon, mon->msg->async, false, &done);
+
+        if (orig_err) {
+            virSetError(orig_err);
+            virFreeError(orig_err);
+        } else {
+            virResetLastError();
+        }
     }
     virObjectUnlock(mon);
 
+    qemuAgentRunCallbacks(mon, done);
     virObjectUnref(mon);
 }
 
-#define QEMU_AGENT_WAIT_TIME 5
-
 /**
  * qemuAgentSend:
  * @mon: Monitor
@@ -830,7 +1194,8 @@ void qemuAgentClose(qemuAgentPtr mon)
  * VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT(-1) means use default timeout value
  * and VIR_DOMAIN_QEMU_AGENT_COMMAND_NOWAIT(0) makes this this function return
  * immediately without waiting. Any positive value means the number of seconds
- * to wait for the result.
+ * to wait for the result. The time is counted from when @msg is actually
+ * sent, commands queued ahead of it do not eat into it.
  *
  * Returns: 0 on success,
  *          -2 on timeout,
@@ -841,40 +1206,17 @@ static int qemuAgentSend(qemuAgentPtr mon,
                          int seconds)
 {
     int ret = -1;
-    unsigned long long then = 0;
 
-    /* Check whether qemu quit unexpectedly */
-    if (mon->lastError.code != VIR_ERR_OK) {
-        VIR_DEBUG("Attempt to send command while error is set %s",
-                  NULLSTR(mon->lastError.message));
-        virSetError(&mon->lastError);
+    msg->seconds = seconds;
+    if (qemuAgentQueueMessage(mon, msg) < 0)
         return -1;
-    }
-
-    if (seconds > VIR_DOMAIN_QEMU_AGENT_COMMAND_BLOCK) {
-        unsigned long long now;
-        if (virTimeMillisNow(&now) < 0)
-            return -1;
-        if (seconds == VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT)
-            seconds = QEMU_AGENT_WAIT_TIME;
-        then = now + seconds * 1000ull;
-    }
 
-    mon->msg = msg;
-    qemuAgentUpdateWatch(mon);
-
-    while (!mon->msg->finished) {
-        if ((then && virCondWaitUntil(&mon->notify, &mon->parent.lock, then) < 0) ||
-            (!then && virCondWait(&mon->notify, &mon->parent.lock) < 0)) {
-            if (errno == ETIMEDOUT) {
-                virReportError(VIR_ERR_AGENT_UNRESPONSIVE, "%s",
-                               _("Guest agent not available for now"));
-                ret = -2;
-            } else {
-                virReportSystemError(errno, "%s",
-                                     _("Unable to wait on agent monitor "
-                                       "condition"));
-            }
+    while (!msg->finished) {
+        if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to wait on agent monitor "
+                                   "condition"));
+            qemuAgentUnqueueMessage(mon, msg);
             goto cleanup;
         }
     }
@@ -886,85 +1228,21 @@ static int qemuAgentSend(qemuAgentPtr mon,
         goto cleanup;
     }
 
-    ret = 0;
-
- cleanup:
-    mon->msg = NULL;
-    qemuAgentUpdateWatch(mon);
-
-    return ret;
-}
-
-
-/**
- * qemuAgentGuestSync:
- * @mon: Monitor
- *
- * Send guest-sync with unique ID
- * and wait for reply. If we get one, check if
- * received ID is equal to given.
- *
- * Returns: 0 on success,
- *          -1 otherwise
- */
-static int
-qemuAgentGuestSync(qemuAgentPtr mon)
-{
-    int ret = -1;
-    int send_ret;
-    unsigned long long id, id_ret;
-    qemuAgentMessage sync_msg;
-
-    memset(&sync_msg, 0, sizeof(sync_msg));
-
-    if (virTimeMillisNow(&id) < 0)
-        return -1;
-
-    if (virAsprintf(&sync_msg.txBuffer,
-                    "{\"execute\":\"guest-sync\", "
-                    "\"arguments\":{\"id\":%llu}}\n", id) < 0)
-        return -1;
-
-    sync_msg.txLength = strlen(sync_msg.txBuffer);
-
-    VIR_DEBUG("Sending guest-sync command with ID: %llu", id);
-
-    send_ret = qemuAgentSend(mon, &sync_msg,
-                             VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT);
-
-    VIR_DEBUG("qemuAgentSend returned: %d", send_ret);
-
-    if (send_ret < 0)
-        goto cleanup;
-
-    if (!sync_msg.rxObject) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Missing monitor reply object"));
-        goto cleanup;
-    }
-
-    if (virJSONValueObjectGetNumberUlong(sync_msg.rxObject,
-                                         "return", &id_ret) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Malformed return value"));
+    if (msg->error.code != VIR_ERR_OK) {
+        virSetError(&msg->error);
+        if (msg->timedOut)
+            ret = -2;
         goto cleanup;
     }
 
-    VIR_DEBUG("Guest returned ID: %llu", id_ret);
-    if (id_ret != id) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("Guest agent returned ID: %llu instead of %llu"),
-                       id_ret, id);
-        goto cleanup;
-    }
     ret = 0;
 
  cleanup:
-    virJSONValueFree(sync_msg.rxObject);
-    VIR_FREE(sync_msg.txBuffer);
+    virResetError(&msg->error);
     return ret;
 }
 
+
 static const char *
 qemuAgentStringifyErrorClass(const char *klass)
 {
@@ -1090,9 +1368,6 @@ qemuAgentCommand(qemuAgentPtr mon,
 
     *reply = NULL;
 
-    if (qemuAgentGuestSync(mon) < 0)
-        return -1;
-
     memset(&msg, 0, sizeof(msg));
 
     if (!(cmdstr = virJSONValueToString(cmd, false)))
@@ -1132,6 +1407,56 @@ qemuAgentCommand(qemuAgentPtr mon,
     return ret;
 }
 
+/*
+ * Queues @cmd, which is consumed, without waiting for its reply. Once
+ * the command finished, @cb is called from the event loop with what
+ * @parse made of the reply, or -2 on timeout and -1 on error.
+ *
+ * Returns 0 if the command was queued and @cb will be called,
+ * -1 otherwise.
+ */
+static int
+qemuAgentCommandAsync(qemuAgentPtr mon,
+                      virJSONValuePtr cmd,
+                      int seconds,
+                      qemuAgentReplyParser parse,
+                      qemuAgentCompletionCallback cb,
+                      void *opaque)
+{
+    qemuAgentMessagePtr msg = NULL;
+    char *cmdstr = NULL;
+
+    if (VIR_ALLOC(msg) < 0) {
+        virJSONValueFree(cmd);
+        return -1;
+    }
+    msg->cmd = cmd;
+
+    if (!(cmdstr = virJSONValueToString(cmd, false)))
+        goto error;
+    if (virAsprintf(&msg->txBuffer, "%s" LINE_ENDING, cmdstr) < 0)
+        goto error;
+    msg->txLength = strlen(msg->txBuffer);
+    msg->seconds = seconds;
+    msg->async = true;
+    msg->parse = parse;
+    msg->cb = cb;
+    msg->opaque = opaque;
+
+    VIR_DEBUG("Queue command '%s', seconds = %d", cmdstr, seconds);
+
+    if (qemuAgentQueueMessage(mon, msg) < 0)
+        goto error;
+
+    VIR_FREE(cmdstr);
+    return 0;
+
+ error:
+    VIR_FREE(cmdstr);
+    qemuAgentMessageFree(msg);
+    return -1;
+}
+
 static virJSONValuePtr ATTRIBUTE_SENTINEL
 qemuAgentMakeCommand(const char *cmdname,
                      ...)
@@ -1264,19 +1589,32 @@ qemuAgentMakeStringsArray(const char **strings, unsigned int len)
 void qemuAgentNotifyEvent(qemuAgentPtr mon,
                           qemuAgentEvent event)
 {
+    qemuAgentMessagePtr msg;
+
     VIR_DEBUG("mon=%p event=%d", mon, event);
+
+    virObjectLock(mon);
+
+    /* The agent in the guest went away or was restarted,
+     * it has to be synced again before the next command */
+    mon->inSync = false;
+
     if (mon->await_event == event) {
         VIR_DEBUG("Waking up a tragedian");
         mon->await_event = QEMU_AGENT_EVENT_NONE;
         /* somebody waiting for this event, wake him up. */
-        if (mon->msg && !mon->msg->finished) {
-            mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
+        if ((msg = mon->msg) && msg->started &&
+            !msg->async && !msg->syncID) {
+            qemuAgentPopMessage(mon, false, false, NULL);
+            if (mon->timer >= 0)
+                virEventUpdateTimeout(mon->timer, 0);
         }
     } else {
         /* shouldn't happen but one never knows */
         VIR_WARN("Received unexpected event %d", event);
     }
+
+    virObjectUnlock(mon);
 }
 
 VIR_ENUM_DECL(qemuAgentShutdownMode);
@@ -1310,6 +1648,38 @@ int qemuAgentShutdown(qemuAgentPtr mon,
     return ret;
 }
 
+static int
+qemuAgentGetReturnInt(virJSONValuePtr reply)
+{
+    int ret;
+
+    if (virJSONValueObjectGetNumberInt(reply, "return", &ret) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed return value"));
+        return -1;
+    }
+
+    return ret;
+}
+
+static virJSONValuePtr
+qemuAgentMakeFSFreezeCommand(const char **mountpoints,
+                             unsigned int nmountpoints)
+{
+    virJSONValuePtr arg;
+
+    if (mountpoints && nmountpoints) {
+        arg = qemuAgentMakeStringsArray(mountpoints, nmountpoints);
+        if (!arg)
+            return NULL;
+
+        return qemuAgentMakeCommand("guest-fsfreeze-freeze",
+                                    "a:mountpoints", arg, NULL);
+    }
+
+    return qemuAgentMakeCommand("guest-fsfreeze-freeze", NULL);
+}
+
 /*
  * qemuAgentFSFreeze:
  * @mon: Agent
@@ -1328,31 +1698,17 @@ int qemuAgentFSFreeze(qemuAgentPtr mon, const char **mountpoints,
                       unsigned int nmountpoints)
 {
     int ret = -1;
-    virJSONValuePtr cmd, arg;
+    virJSONValuePtr cmd;
     virJSONValuePtr reply = NULL;
 
-    if (mountpoints && nmountpoints) {
-        arg = qemuAgentMakeStringsArray(mountpoints, nmountpoints);
-        if (!arg)
-            return -1;
-
-        cmd = qemuAgentMakeCommand("guest-fsfreeze-freeze",
-                                   "a:mountpoints", arg, NULL);
-    } else {
-        cmd = qemuAgentMakeCommand("guest-fsfreeze-freeze", NULL);
-    }
-
-    if (!cmd)
+    if (!(cmd = qemuAgentMakeFSFreezeCommand(mountpoints, nmountpoints)))
         return -1;
 
     if (qemuAgentCommand(mon, cmd, &reply, true,
                          VIR_DOMAIN_QEMU_AGENT_COMMAND_BLOCK) < 0)
         goto cleanup;
 
-    if (virJSONValueObjectGetNumberInt(reply, "return", &ret) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("malformed return value"));
-    }
+    ret = qemuAgentGetReturnInt(reply);
 
  cleanup:
     virJSONValueFree(cmd);
@@ -1360,6 +1716,39 @@ int qemuAgentFSFreeze(qemuAgentPtr mon, const char **mountpoints,
     return ret;
 }
 
+/*
+ * qemuAgentFSFreezeAsync:
+ * @mon: Agent
+ * @mountpoints: Array of mountpoint paths to be frozen, or NULL for all
+ * @nmountpoints: Number of mountpoints to be frozen, or 0 for all
+ * @seconds: how long to wait for the reply, as in qemuAgentSend
+ * @cb: called once the command finished
+ * @opaque: passed to @cb
+ *
+ * Like qemuAgentFSFreeze, but returns as soon as the command is
+ * queued. @cb gets the number of frozen file systems, or -1 on
+ * error and -2 on timeout. It is called from the event loop, so
+ * it must neither block nor lock the domain.
+ *
+ * Returns: 0 if the command was queued,
+ *          -1 on error, @cb is not called then.
+ */
+int qemuAgentFSFreezeAsync(qemuAgentPtr mon,
+                           const char **mountpoints,
+                           unsigned int nmountpoints,
+                           int seconds,
+                           qemuAgentCompletionCallback cb,
+                           void *opaque)
+{
+    virJSONValuePtr cmd;
+
+    if (!(cmd = qemuAgentMakeFSFreezeCommand(mountpoints, nmountpoints)))
+        return -1;
+
+    return qemuAgentCommandAsync(mon, cmd, seconds,
+                                 qemuAgentGetReturnInt, cb, opaque);
+}
+
 /*
  * qemuAgentFSThaw:
  * @mon: Agent
@@ -1386,10 +1775,7 @@ int qemuAgentFSThaw(qemuAgentPtr mon)
                          VIR_DOMAIN_QEMU_AGENT_COMMAND_BLOCK) < 0)
         goto cleanup;
 
-    if (virJSONValueObjectGetNumberInt(reply, "return", &ret) < 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("malformed return value"));
-    }
+    ret = qemuAgentGetReturnInt(reply);
 
  cleanup:
     virJSONValueFree(cmd);
@@ -1397,6 +1783,33 @@ int qemuAgentFSThaw(qemuAgentPtr mon)
     return ret;
 }
 
+/*
+ * qemuAgentFSThawAsync:
+ * @mon: Agent
+ * @seconds: how long to wait for the reply, as in qemuAgentSend
+ * @cb: called once the command finished
+ * @opaque: passed to @cb
+ *
+ * Like qemuAgentFSThaw, but returns as soon as the command is
+ * queued. See qemuAgentFSFreezeAsync for how @cb is called.
+ *
+ * Returns: 0 if the command was queued,
+ *          -1 on error, @cb is not called then.
+ */
+int qemuAgentFSThawAsync(qemuAgentPtr mon,
+                         int seconds,
+                         qemuAgentCompletionCallback cb,
+                         void *opaque)
+{
+    virJSONValuePtr cmd;
+
+    if (!(cmd = qemuAgentMakeCommand("guest-fsfreeze-thaw", NULL)))
+        return -1;
+
+    return qemuAgentCommandAsync(mon, cmd, seconds,
+                                 qemuAgentGetReturnInt, cb, opaque);
+}
+
 VIR_ENUM_DECL(qemuAgentSuspendMode);
 
 VIR_ENUM_IMPL(qemuAgentSuspendMode,
@@ -49,6 +49,14 @@ qemuAgentPtr qemuAgentOpen(virDomainObjPtr vm,
 
 void qemuAgentClose(qemuAgentPtr mon);
 
+/* Reports the result of an asynchronous command, @err is
+ * set if @ret is negative. Runs from the event loop with
+ * the agent unlocked. */
+typedef void (*qemuAgentCompletionCallback)(qemuAgentPtr mon,
+                                            int ret,
+                                            virErrorPtr err,
+                                            void *opaque);
+
 typedef enum {
     QEMU_AGENT_EVENT_NONE = 0,
     QEMU_AGENT_EVENT_SHUTDOWN,
@@ -73,6 +81,16 @@ int qemuAgentShutdown(qemuAgentPtr mon,
 int qemuAgentFSFreeze(qemuAgentPtr mon,
                       const char **mountpoints, unsigned int nmountpoints);
 int qemuAgentFSThaw(qemuAgentPtr mon);
+int qemuAgentFSFreezeAsync(qemuAgentPtr mon,
+                           const char **mountpoints,
+                           unsigned int nmountpoints,
+                           int seconds,
+                           qemuAgentCompletionCallback cb,
+                           void *opaque);
+int qemuAgentFSThawAsync(qemuAgentPtr mon,
+                         int seconds,
+                         qemuAgentCompletionCallback cb,
+                         void *opaque);
 
 int qemuAgentSuspend(qemuAgentPtr mon,
                      unsigned int target);
@@ -40,6 +40,8 @@
 #include "qemu_monitor.h"
 #include "virstring.h"
 #include "qemu_hostdev.h"
+#include "viratomic.h"
+#include "virthread.h"
 
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -275,6 +277,9 @@ struct _virQEMUCaps {
     bool usedQMP;
 
     char *binary;
+    /* Fingerprint of the binary the capabilities were probed from */
+    off_t size;
+    time_t mtime;
     time_t ctime;
 
     virBitmapPtr flags;
@@ -296,6 +301,10 @@ struct _virQEMUCaps {
 struct _virQEMUCapsCache {
     virMutex lock;
     virHashTablePtr binaries;
+    /* Binaries being probed right now, and the condition signalled
+     * whenever such a probe finishes */
+    virHashTablePtr probing;
+    virCond probed;
     char *libDir;
     char *cacheDir;
     uid_t runUid;
@@ -694,6 +703,12 @@ virQEMUCapsIsValidForKVM(virArch hostarch,
     return false;
 }
 
+static const char *const virQEMUCapsKVMBinaries[] = {
+    "/usr/libexec/qemu-kvm", /* RHEL */
+    "qemu-kvm", /* Fedora */
+    "kvm", /* Upstream .spec */
+};
+
 static int
 virQEMUCapsInitGuest(virCapsPtr caps,
                      virQEMUCapsCachePtr cache,
@@ -727,12 +742,8 @@ virQEMUCapsInitGuest(virCapsPtr caps,
      * The latter simply needs "-cpu qemu32"
      */
     if (virQEMUCapsIsValidForKVM(hostarch, guestarch)) {
-        const char *const kvmbins[] = { "/usr/libexec/qemu-kvm", /* RHEL */
-                                        "qemu-kvm", /* Fedora */
-                                        "kvm" }; /* Upstream .spec */
-
-        for (i = 0; i < ARRAY_CARDINALITY(kvmbins); ++i) {
-            kvmbin = virFindFileInPath(kvmbins[i]);
+        for (i = 0; i < ARRAY_CARDINALITY(virQEMUCapsKVMBinaries); ++i) {
+            kvmbin = virFindFileInPath(virQEMUCapsKVMBinaries[i]);
 
             if (!kvmbin)
                 continue;
@@ -950,6 +961,112 @@ virQEMUCapsInitPages(virCapsPtr caps)
 }
 
 
+#define VIR_QEMU_CAPS_PROBE_WORKERS 8
+
+typedef struct _virQEMUCapsProbeData virQEMUCapsProbeData;
+typedef virQEMUCapsProbeData *virQEMUCapsProbeDataPtr;
+struct _virQEMUCapsProbeData {
+    virQEMUCapsCachePtr cache;
+    char **binaries;
+    size_t nbinaries;
+    int next;
+};
+
+
+static void
+virQEMUCapsCacheProbeWorker(void *opaque)
+{
+    virQEMUCapsProbeDataPtr data = opaque;
+    int i;
+
+    while ((i = virAtomicIntAdd(&data->next, 1)) < data->nbinaries) {
+        virObjectUnref(virQEMUCapsCacheLookup(data->cache,
+                                              data->binaries[i]));
+        /* Failures are reported by the lookup that needs the binary */
+        virResetLastError();
+    }
+}
+
+
+static int
+virQEMUCapsProbeDataAdd(virQEMUCapsProbeDataPtr data, char *binary)
+{
+    size_t i;
+
+    for (i = 0; i < data->nbinaries; i++) {
+        if (STREQ(data->binaries[i], binary)) {
+            VIR_FREE(binary);
+            return 0;
+        }
+    }
+
+    if (VIR_APPEND_ELEMENT(data->binaries, data->nbinaries, binary) < 0) {
+        VIR_FREE(binary);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Look up the capabilities of every binary virQEMUCapsInitGuest may
+ * use, in parallel.  Each binary not cached in memory or on disk yet
+ * costs a QEMU process and a QMP conversation, which add up to seconds
+ * with a dozen emulators installed.  Errors are ignored here.
+ */
+static void
+virQEMUCapsCacheProbeAll(virQEMUCapsCachePtr cache,
+                         virArch hostarch)
+{
+    virQEMUCapsProbeData data = { .cache = cache };
+    virThread threads[VIR_QEMU_CAPS_PROBE_WORKERS];
+    size_t nthreads = 0;
+    char *binary;
+    size_t i;
+
+    for (i = 0; i < VIR_ARCH_LAST; i++) {
+        if ((binary = virQEMUCapsFindBinaryForArch(hostarch, i)) &&
+            virQEMUCapsProbeDataAdd(&data, binary) < 0)
+            goto cleanup;
+    }
+
+    for (i = 0; i < ARRAY_CARDINALITY(virQEMUCapsKVMBinaries); i++) {
+        if ((binary = virFindFileInPath(virQEMUCapsKVMBinaries[i]))) {
+            if (virQEMUCapsProbeDataAdd(&data, binary) < 0)
+                goto cleanup;
+            break;
+        }
+    }
+
+    for (i = 0; i < VIR_QEMU_CAPS_PROBE_WORKERS; i++) {
+        /* The calling thread does its share of the work too */
+        if (i + 1 >= data.nbinaries)
+            break;
+
+        if (virThreadCreate(&threads[nthreads], true,
+                            virQEMUCapsCacheProbeWorker, &data) < 0) {
+            /* Whatever threads we have will do the work */
+            VIR_WARN("Unable to create capabilities probe thread");
+            virResetLastError();
+            break;
+        }
+        nthreads++;
+    }
+
+    /* Also takes care of everything if no thread could be created */
+    virQEMUCapsCacheProbeWorker(&data);
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+
+ cleanup:
+    virResetLastError();
+    for (i = 0; i < data.nbinaries; i++)
+        VIR_FREE(data.binaries[i]);
+    VIR_FREE(data.binaries);
+}
+
+
 virCapsPtr virQEMUCapsInit(virQEMUCapsCachePtr cache)
 {
     virCapsPtr caps;
@@ -984,6 +1101,10 @@ virCapsPtr virQEMUCapsInit(virQEMUCapsCachePtr cache)
     virCapabilitiesAddHostMigrateTransport(caps,
                                            "tcp");
 
+    /* Get the capabilities of all binaries that are not cached yet at
+     * once, rather than one after another below */
+    virQEMUCapsCacheProbeAll(cache, hostarch);
+
     /* QEMU can support pretty much every arch that exists,
      * so just probe for them all - we gracefully fail
      * if a qemu-system-$ARCH binary can't be found
@@ -2470,6 +2591,8 @@ int virQEMUCapsProbeQMP(virQEMUCapsPtr qemuCaps,
  * Parsing a doc that looks like
  *
  * <qemuCaps>
+ *   <qemusize>12345678</qemusize>
+ *   <qemumtime>234235253</qemumtime>
  *   <qemuctime>234235253</qemuctime>
  *   <selfctime>234235253</selfctime>
  *   <usedQMP/>
@@ -2484,6 +2607,7 @@ int virQEMUCapsProbeQMP(virQEMUCapsPtr qemuCaps,
  */
 static int
 virQEMUCapsLoadCache(virQEMUCapsPtr qemuCaps, const char *filename,
+                     off_t *qemusize, time_t *qemumtime,
                      time_t *qemuctime, time_t *selfctime)
 {
     xmlDocPtr doc = NULL;
@@ -2513,6 +2637,16 @@ virQEMUCapsLoadCache(virQEMUCapsPtr qemuCaps, const char *filename,
         goto cleanup;
     }
 
+    /* Older caches only recorded the ctime; -1 never matches a binary
+     * so such a cache is discarded */
+    if (virXPathLongLong("string(./qemusize)", ctxt, &l) < 0)
+        l = -1;
+    *qemusize = (off_t)l;
+
+    if (virXPathLongLong("string(./qemumtime)", ctxt, &l) < 0)
+        l = -1;
+    *qemumtime = (time_t)l;
+
     if (virXPathLongLong("string(./qemuctime)", ctxt, &l) < 0) {
         virReportError(VIR_ERR_XML_ERROR, "%s",
                        _("missing qemuctime in QEMU capabilities XML"));
@@ -2658,6 +2792,10 @@ virQEMUCapsSaveCache(virQEMUCapsPtr qemuCaps, const char *filename)
     virBufferAddLit(&buf, "<qemuCaps>\n");
     virBufferAdjustIndent(&buf, 2);
 
+    virBufferAsprintf(&buf, "<qemusize>%lld</qemusize>\n",
+                      (long long)qemuCaps->size);
+    virBufferAsprintf(&buf, "<qemumtime>%lld</qemumtime>\n",
+                      (long long)qemuCaps->mtime);
     virBufferAsprintf(&buf, "<qemuctime>%llu</qemuctime>\n",
                       (long long)qemuCaps->ctime);
     virBufferAsprintf(&buf, "<selfctime>%llu</selfctime>\n",
@@ -2796,6 +2934,8 @@ virQEMUCapsInitCached(virQEMUCapsPtr qemuCaps, const char *cacheDir)
     int ret = -1;
     char *binaryhash = NULL;
     struct stat sb;
+    off_t qemusize;
+    time_t qemumtime;
     time_t qemuctime;
     time_t selfctime;
 
@@ -2830,7 +2970,8 @@ virQEMUCapsInitCached(virQEMUCapsPtr qemuCaps, const char *cacheDir)
         goto cleanup;
     }
 
-    if (virQEMUCapsLoadCache(qemuCaps, capsfile, &qemuctime, &selfctime) < 0) {
+    if (virQEMUCapsLoadCache(qemuCaps, capsfile, &qemusize, &qemumtime,
+                             &qemuctime, &selfctime) < 0) {
         virErrorPtr err = virGetLastError();
         VIR_WARN("Failed to load cached caps from '%s' for '%s': %s",
                  capsfile, qemuCaps->binary, err ? NULLSTR(err->message) :
@@ -2841,12 +2982,17 @@ virQEMUCapsInitCached(virQEMUCapsPtr qemuCaps, const char *cacheDir)
         goto cleanup;
     }
 
-    /* Discard if cache is older that QEMU binary */
-    if (qemuctime != qemuCaps->ctime ||
+    /* Discard if cache doesn't match the QEMU binary or is older than
+     * libvirtd */
+    if (qemusize != qemuCaps->size ||
+        qemumtime != qemuCaps->mtime ||
+        qemuctime != qemuCaps->ctime ||
         selfctime < virGetSelfLastChanged()) {
         VIR_DEBUG("Outdated cached capabilities '%s' for '%s' "
-                  "(%lld vs %lld, %lld vs %lld)",
+                  "(%lld vs %lld, %lld vs %lld, %lld vs %lld, %lld vs %lld)",
                   capsfile, qemuCaps->binary,
+                  (long long)qemusize, (long long)qemuCaps->size,
+                  (long long)qemumtime, (long long)qemuCaps->mtime,
                   (long long)qemuctime, (long long)qemuCaps->ctime,
                   (long long)selfctime, (long long)virGetSelfLastChanged());
         ignore_value(unlink(capsfile));
@@ -3147,6 +3293,8 @@ virQEMUCapsInitQMPMonitor(virQEMUCapsPtr qemuCaps,
     return ret;
 }
 
+static int virQEMUCapsProbeCounter;
+
 static int
 virQEMUCapsInitQMP(virQEMUCapsPtr qemuCaps,
                    const char *libDir,
@@ -3164,11 +3312,16 @@ virQEMUCapsInitQMP(virQEMUCapsPtr qemuCaps,
     pid_t pid = 0;
     virDomainObjPtr vm = NULL;
     virDomainXMLOptionPtr xmlopt = NULL;
+    int probe;
 
-    /* the ".sock" sufix is important to avoid a possible clash with a qemu
+    /* Binaries may be probed in parallel, so each probe gets its own
+     * socket and pidfile.
+     * The ".sock" sufix is important to avoid a possible clash with a qemu
      * domain called "capabilities"
      */
-    if (virAsprintf(&monpath, "%s/%s", libDir, "capabilities.monitor.sock") < 0)
+    probe = virAtomicIntInc(&virQEMUCapsProbeCounter);
+    if (virAsprintf(&monpath, "%s/capabilities.%d.monitor.sock",
+                    libDir, probe) < 0)
         goto cleanup;
     if (virAsprintf(&monarg, "unix:%s,server,nowait", monpath) < 0)
         goto cleanup;
@@ -3179,7 +3332,8 @@ virQEMUCapsInitQMP(virQEMUCapsPtr qemuCaps,
      * -daemonize we need QEMU to be allowed to create them, rather
      * than libvirtd. So we're using libDir which QEMU can write to
      */
-    if (virAsprintf(&pidfile, "%s/%s", libDir, "capabilities.pidfile") < 0)
+    if (virAsprintf(&pidfile, "%s/capabilities.%d.pidfile",
+                    libDir, probe) < 0)
         goto cleanup;
 
     memset(&config, 0, sizeof(config));
@@ -3276,7 +3430,6 @@ virQEMUCapsInitQMP(virQEMUCapsPtr qemuCaps,
     virCommandAbort(cmd);
     virCommandFree(cmd);
     VIR_FREE(monarg);
-    VIR_FREE(monpath);
     virObjectUnref(vm);
     virObjectUnref(xmlopt);
 
@@ -3293,6 +3446,11 @@ virQEMUCapsInitQMP(virQEMUCapsPtr qemuCaps,
         unlink(pidfile);
         VIR_FREE(pidfile);
     }
+    if (monpath) {
+        /* Each probe has its own socket, don't leave them piling up */
+        unlink(monpath);
+        VIR_FREE(monpath);
+    }
     return ret;
 }
 
@@ -3339,6 +3497,8 @@ virQEMUCapsPtr virQEMUCapsNewForBinary(const char *binary,
                              binary);
         goto error;
     }
+    qemuCaps->size = sb.st_size;
+    qemuCaps->mtime = sb.st_mtime;
     qemuCaps->ctime = sb.st_ctime;
 
     /* Make sure the binary we are about to try exec'ing exists.
@@ -3389,7 +3549,9 @@ bool virQEMUCapsIsValid(virQEMUCapsPtr qemuCaps)
     if (stat(qemuCaps->binary, &sb) < 0)
         return false;
 
-    return sb.st_ctime == qemuCaps->ctime;
+    return (sb.st_size == qemuCaps->size &&
+            sb.st_mtime == qemuCaps->mtime &&
+            sb.st_ctime == qemuCaps->ctime);
 }
 
 
@@ -3411,8 +3573,18 @@ virQEMUCapsCacheNew(const char *libDir,
         return NULL;
     }
 
+    if (virCondInit(&cache->probed) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to initialize condition"));
+        virMutexDestroy(&cache->lock);
+        VIR_FREE(cache);
+        return NULL;
+    }
+
     if (!(cache->binaries = virHashCreate(10, virObjectFreeHashData)))
         goto error;
+    if (!(cache->probing = virHashCreate(10, NULL)))
+        goto error;
     if (VIR_STRDUP(cache->libDir, libDir) < 0)
         goto error;
     if (VIR_STRDUP(cache->cacheDir, cacheDir) < 0)
@@ -3434,6 +3606,17 @@ virQEMUCapsCacheLookup(virQEMUCapsCachePtr cache, const char *binary)
 {
     virQEMUCapsPtr ret = NULL;
     virMutexLock(&cache->lock);
+
+    /* Rather than probing the same binary twice, wait for the probe
+     * another thread is already running */
+    while (virHashLookup(cache->probing, binary)) {
+        if (virCondWait(&cache->probed, &cache->lock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("failed to wait for capabilities probe"));
+            goto cleanup;
+        }
+    }
+
     ret = virHashLookup(cache->binaries, binary);
     if (ret &&
         !virQEMUCapsIsValid(ret)) {
@@ -3443,11 +3626,22 @@ virQEMUCapsCacheLookup(virQEMUCapsCachePtr cache, const char *binary)
         ret = NULL;
     }
     if (!ret) {
+        /* Probing runs QEMU and takes a while, don't hold up lookups
+         * of other binaries meanwhile */
+        if (virHashAddEntry(cache->probing, binary, cache) < 0)
+            goto cleanup;
+        virMutexUnlock(&cache->lock);
+
         VIR_DEBUG("Creating capabilities for %s",
                   binary);
         ret = virQEMUCapsNewForBinary(binary, cache->libDir,
                                       cache->cacheDir,
                                       cache->runUid, cache->runGid);
+
+        virMutexLock(&cache->lock);
+        virHashRemoveEntry(cache->probing, binary);
+        virCondBroadcast(&cache->probed);
+
         if (ret) {
             VIR_DEBUG("Caching capabilities %p for %s",
                       ret, binary);
@@ -3457,6 +3651,8 @@ virQEMUCapsCacheLookup(virQEMUCapsCachePtr cache, const char *binary)
             }
         }
     }
+
+ cleanup:
     VIR_DEBUG("Returning caps %p for %s", ret, binary);
     virObjectRef(ret);
     virMutexUnlock(&cache->lock);
@@ -3517,6 +3713,8 @@ virQEMUCapsCacheFree(virQEMUCapsCachePtr cache)
     VIR_FREE(cache->libDir);
     VIR_FREE(cache->cacheDir);
     virHashFree(cache->binaries);
+    virHashFree(cache->probing);
+    virCondDestroy(&cache->probed);
     virMutexDestroy(&cache->lock);
     VIR_FREE(cache);
 }
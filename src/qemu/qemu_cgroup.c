@@ -34,6 +34,7 @@
 #include "virscsi.h"
 #include "virstring.h"
 #include "virfile.h"
+#include "virtime.h"
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
@@ -892,12 +893,16 @@ qemuSetupCgroupEmulatorPin(virCgroupPtr cgroup,
 int
 qemuSetupCgroupForVcpu(virDomainObjPtr vm)
 {
-    virCgroupPtr cgroup_vcpu = NULL;
+    virCgroupPtr *cgroup_vcpus = NULL;
+    char **cpus = NULL;
     qemuDomainObjPrivatePtr priv = vm->privateData;
     virDomainDefPtr def = vm->def;
-    size_t i, j;
+    size_t i;
+    int ret = -1;
     unsigned long long period = vm->def->cputune.period;
     long long quota = vm->def->cputune.quota;
+    unsigned long long then = 0;
+    unsigned long long now = 0;
 
     if ((period || quota) &&
         !virCgroupHasController(priv->cgroup, VIR_CGROUP_CONTROLLER_CPU)) {
@@ -929,49 +934,65 @@ qemuSetupCgroupForVcpu(virDomainObjPtr vm)
         return 0;
     }
 
-    for (i = 0; i < priv->nvcpupids; i++) {
-        if (virCgroupNewVcpu(priv->cgroup, i, true, &cgroup_vcpu) < 0)
-            goto cleanup;
+    ignore_value(virTimeMillisNow(&then));
 
-        /* move the thread for vcpu to sub dir */
-        if (virCgroupAddTask(cgroup_vcpu, priv->vcpupids[i]) < 0)
+    /* Set vcpupin in cgroup if vcpupin xml is provided. The pinning is
+     * handed over when the groups are created, so that a pinned vcpu's
+     * cpuset is written only once. */
+    if (virCgroupHasController(priv->cgroup, VIR_CGROUP_CONTROLLER_CPUSET) &&
+        def->cputune.nvcpupin) {
+        if (VIR_ALLOC_N(cpus, priv->nvcpupids) < 0)
             goto cleanup;
 
-        if (period || quota) {
-            if (qemuSetupCgroupVcpuBW(cgroup_vcpu, period, quota) < 0)
+        for (i = 0; i < def->cputune.nvcpupin; i++) {
+            virDomainVcpuPinDefPtr pin = def->cputune.vcpupin[i];
+
+            if (pin->vcpuid < 0 || pin->vcpuid >= priv->nvcpupids ||
+                cpus[pin->vcpuid])
+                continue;
+
+            if (!(cpus[pin->vcpuid] = virBitmapFormat(pin->cpumask)))
                 goto cleanup;
         }
+    }
 
-        /* Set vcpupin in cgroup if vcpupin xml is provided */
-        if (virCgroupHasController(priv->cgroup, VIR_CGROUP_CONTROLLER_CPUSET)) {
-            /* find the right CPU to pin, otherwise
-             * qemuSetupCgroupVcpuPin will fail. */
-            for (j = 0; j < def->cputune.nvcpupin; j++) {
-                if (def->cputune.vcpupin[j]->vcpuid != i)
-                    continue;
-
-                if (qemuSetupCgroupVcpuPin(cgroup_vcpu,
-                                           def->cputune.vcpupin,
-                                           def->cputune.nvcpupin,
-                                           i) < 0)
-                    goto cleanup;
+    if (virCgroupNewVcpus(priv->cgroup, priv->nvcpupids,
+                          cpus, &cgroup_vcpus) < 0)
+        goto cleanup;
 
-                break;
-            }
-        }
+    for (i = 0; i < priv->nvcpupids; i++) {
+        /* move the thread for vcpu to sub dir */
+        if (virCgroupAddTask(cgroup_vcpus[i], priv->vcpupids[i]) < 0)
+            goto error;
 
-        virCgroupFree(&cgroup_vcpu);
+        if (period || quota) {
+            if (qemuSetupCgroupVcpuBW(cgroup_vcpus[i], period, quota) < 0)
+                goto error;
+        }
     }
 
-    return 0;
+    if (virTimeMillisNow(&now) == 0)
+        VIR_DEBUG("Set up cgroups of %d vcpus for domain %s in %llu ms",
+                  priv->nvcpupids, vm->def->name, now - then);
+
+    ret = 0;
 
  cleanup:
-    if (cgroup_vcpu) {
-        virCgroupRemove(cgroup_vcpu);
-        virCgroupFree(&cgroup_vcpu);
+    if (cgroup_vcpus) {
+        for (i = 0; i < priv->nvcpupids; i++)
+            virCgroupFree(&cgroup_vcpus[i]);
+        VIR_FREE(cgroup_vcpus);
+    }
+    if (cpus) {
+        for (i = 0; i < priv->nvcpupids; i++)
+            VIR_FREE(cpus[i]);
+        VIR_FREE(cpus);
     }
+    return ret;
 
-    return -1;
+ error:
+    virCgroupRemove(cgroup_vcpus[i]);
+    goto cleanup;
 }
 
 int
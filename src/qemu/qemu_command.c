@@ -5938,6 +5938,237 @@ qemuBuildClockArgStr(virDomainClockDefPtr def)
 }
 
 
+/*
+ * Derive the CPU model and features to use for the guest CPU @def->cpu
+ * on @host.  This is by far the most expensive part of building a
+ * command line, as it matches CPU data against every model QEMU
+ * knows about.
+ */
+static int
+qemuBuildCpuModelArgStr(const virDomainDef *def,
+                        virCPUDefPtr host,
+                        virQEMUCapsPtr qemuCaps,
+                        virBufferPtr buf,
+                        bool *hasHwVirt,
+                        bool migrating)
+{
+    virCPUDefPtr guest = NULL;
+    virCPUDefPtr cpu = NULL;
+    size_t ncpus = 0;
+    char **cpus = NULL;
+    virCPUDataPtr data = NULL;
+    char *compare_msg = NULL;
+    virCPUCompareResult cmp;
+    const char *preferred;
+    int ret = -1;
+    size_t i;
+
+    if (!host ||
+        !host->model ||
+        (ncpus = virQEMUCapsGetCPUDefinitions(qemuCaps, &cpus)) == 0) {
+        virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
+                       _("CPU specification not supported by hypervisor"));
+        goto cleanup;
+    }
+
+    if (!(cpu = virCPUDefCopy(def->cpu)))
+        goto cleanup;
+
+    if (cpu->mode != VIR_CPU_MODE_CUSTOM &&
+        !migrating &&
+        cpuUpdate(cpu, host) < 0)
+        goto cleanup;
+
+    cmp = cpuGuestData(host, cpu, &data, &compare_msg);
+    switch (cmp) {
+    case VIR_CPU_COMPARE_INCOMPATIBLE:
+        if (compare_msg) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("guest and host CPU are not compatible: %s"),
+                           compare_msg);
+        } else {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
+                           _("guest CPU is not compatible with host CPU"));
+        }
+        /* fall through */
+    case VIR_CPU_COMPARE_ERROR:
+        goto cleanup;
+
+    default:
+        break;
+    }
+
+    /* Only 'svm' requires --enable-nesting. The nested
+     * 'vmx' patches now simply hook off the CPU features
+     */
+    if (def->os.arch == VIR_ARCH_X86_64 ||
+        def->os.arch == VIR_ARCH_I686) {
+        int hasSVM = cpuHasFeature(data, "svm");
+        if (hasSVM < 0)
+            goto cleanup;
+        *hasHwVirt = hasSVM > 0 ? true : false;
+    }
+
+    if (cpu->mode == VIR_CPU_MODE_HOST_PASSTHROUGH) {
+        const char *mode = virCPUModeTypeToString(cpu->mode);
+        if (!virQEMUCapsGet(qemuCaps, QEMU_CAPS_CPU_HOST)) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("CPU mode '%s' is not supported by QEMU"
+                             " binary"), mode);
+            goto cleanup;
+        }
+        if (def->virtType != VIR_DOMAIN_VIRT_KVM) {
+            virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
+                           _("CPU mode '%s' is only supported with kvm"),
+                           mode);
+            goto cleanup;
+        }
+        virBufferAddLit(buf, "host");
+    } else {
+        if (VIR_ALLOC(guest) < 0)
+            goto cleanup;
+        if (VIR_STRDUP(guest->vendor_id, cpu->vendor_id) < 0)
+            goto cleanup;
+
+        guest->arch = host->arch;
+        if (cpu->match == VIR_CPU_MATCH_MINIMUM)
+            preferred = host->model;
+        else
+            preferred = cpu->model;
+
+        guest->type = VIR_CPU_TYPE_GUEST;
+        guest->fallback = cpu->fallback;
+        if (cpuDecode(guest, data, (const char **)cpus, ncpus, preferred) < 0)
+            goto cleanup;
+
+        virBufferAdd(buf, guest->model, -1);
+        if (guest->vendor_id)
+            virBufferAsprintf(buf, ",vendor=%s", guest->vendor_id);
+        for (i = 0; i < guest->nfeatures; i++) {
+            char sign;
+            if (guest->features[i].policy == VIR_CPU_FEATURE_DISABLE)
+                sign = '-';
+            else
+                sign = '+';
+
+            virBufferAsprintf(buf, ",%c%s", sign, guest->features[i].name);
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(compare_msg);
+    cpuDataFree(data);
+    virCPUDefFree(guest);
+    virCPUDefFree(cpu);
+    return ret;
+}
+
+
+/*
+ * Everything the result of qemuBuildCpuModelArgStr depends on: the
+ * guest and host CPU definitions, the CPU models known to QEMU, and
+ * the few other inputs it looks at.
+ */
+static char *
+qemuCpuModelArgCacheKey(const virDomainDef *def,
+                        virCPUDefPtr host,
+                        virQEMUCapsPtr qemuCaps,
+                        bool migrating)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *guestxml = NULL;
+    char *hostxml = NULL;
+    char **cpus = NULL;
+    size_t ncpus;
+    size_t i;
+
+    /* Host-model CPUs may already have their model and vendor filled
+     * in, which plain formatting would leave out of the key */
+    if (!(guestxml = virCPUDefFormat(def->cpu,
+                                     VIR_DOMAIN_XML_UPDATE_CPU)) ||
+        (host && !(hostxml = virCPUDefFormat(host,
+                                             VIR_DOMAIN_XML_UPDATE_CPU)))) {
+        VIR_FREE(guestxml);
+        return NULL;
+    }
+
+    virBufferAsprintf(&buf, "%s %d %d %d\n",
+                      virArchToString(def->os.arch), def->virtType,
+                      virQEMUCapsGet(qemuCaps, QEMU_CAPS_CPU_HOST),
+                      migrating);
+
+    ncpus = virQEMUCapsGetCPUDefinitions(qemuCaps, &cpus);
+    for (i = 0; i < ncpus; i++)
+        virBufferAsprintf(&buf, "%s,", cpus[i]);
+    virBufferAddLit(&buf, "\n");
+    virBufferAdd(&buf, guestxml, -1);
+    virBufferAdd(&buf, hostxml, -1);
+
+    VIR_FREE(guestxml);
+    VIR_FREE(hostxml);
+
+    if (virBufferCheckError(&buf) < 0)
+        return NULL;
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+/*
+ * Like qemuBuildCpuModelArgStr, but reuse the result computed for an
+ * earlier domain with an identical guest CPU on the same host, which
+ * is the common case when starting many similar domains.
+ */
+static int
+qemuBuildCpuModelArgStrCached(virQEMUDriverPtr driver,
+                              const virDomainDef *def,
+                              virCPUDefPtr host,
+                              virQEMUCapsPtr qemuCaps,
+                              virBufferPtr buf,
+                              bool *hasHwVirt,
+                              bool migrating)
+{
+    virBuffer model = VIR_BUFFER_INITIALIZER;
+    char *str = NULL;
+    char *key = NULL;
+    int ret = -1;
+    int rc;
+
+    if (!driver->cpuModelArgs)
+        return qemuBuildCpuModelArgStr(def, host, qemuCaps, buf,
+                                       hasHwVirt, migrating);
+
+    if (!(key = qemuCpuModelArgCacheKey(def, host, qemuCaps, migrating)))
+        goto cleanup;
+
+    if ((rc = virQEMUDriverLookupCpuModelArg(driver, key,
+                                             &str, hasHwVirt)) < 0)
+        goto cleanup;
+
+    if (rc == 0) {
+        if (qemuBuildCpuModelArgStr(def, host, qemuCaps, &model,
+                                    hasHwVirt, migrating) < 0 ||
+            virBufferCheckError(&model) < 0)
+            goto cleanup;
+
+        str = virBufferContentAndReset(&model);
+        if (virQEMUDriverAddCpuModelArg(driver, key, str, *hasHwVirt) < 0)
+            goto cleanup;
+    }
+
+    virBufferAdd(buf, str, -1);
+    ret = 0;
+
+ cleanup:
+    virBufferFreeAndReset(&model);
+    VIR_FREE(str);
+    VIR_FREE(key);
+    return ret;
+}
+
+
 static int
 qemuBuildCpuArgStr(virQEMUDriverPtr driver,
                    const virDomainDef *def,
@@ -5949,14 +6180,8 @@ qemuBuildCpuArgStr(virQEMUDriverPtr driver,
                    bool migrating)
 {
     virCPUDefPtr host = NULL;
-    virCPUDefPtr guest = NULL;
-    virCPUDefPtr cpu = NULL;
-    size_t ncpus = 0;
-    char **cpus = NULL;
     const char *default_model;
-    virCPUDataPtr data = NULL;
     bool have_cpu = false;
-    char *compare_msg = NULL;
     int ret = -1;
     virBuffer buf = VIR_BUFFER_INITIALIZER;
     size_t i;
@@ -5976,100 +6201,9 @@ qemuBuildCpuArgStr(virQEMUDriverPtr driver,
 
     if (def->cpu &&
         (def->cpu->mode != VIR_CPU_MODE_CUSTOM || def->cpu->model)) {
-        virCPUCompareResult cmp;
-        const char *preferred;
-
-        if (!host ||
-            !host->model ||
-            (ncpus = virQEMUCapsGetCPUDefinitions(qemuCaps, &cpus)) == 0) {
-            virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
-                           _("CPU specification not supported by hypervisor"));
-            goto cleanup;
-        }
-
-        if (!(cpu = virCPUDefCopy(def->cpu)))
+        if (qemuBuildCpuModelArgStrCached(driver, def, host, qemuCaps, &buf,
+                                          hasHwVirt, migrating) < 0)
             goto cleanup;
-
-        if (cpu->mode != VIR_CPU_MODE_CUSTOM &&
-            !migrating &&
-            cpuUpdate(cpu, host) < 0)
-            goto cleanup;
-
-        cmp = cpuGuestData(host, cpu, &data, &compare_msg);
-        switch (cmp) {
-        case VIR_CPU_COMPARE_INCOMPATIBLE:
-            if (compare_msg) {
-                virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
-                               _("guest and host CPU are not compatible: %s"),
-                               compare_msg);
-            } else {
-                virReportError(VIR_ERR_CONFIG_UNSUPPORTED, "%s",
-                               _("guest CPU is not compatible with host CPU"));
-            }
-            /* fall through */
-        case VIR_CPU_COMPARE_ERROR:
-            goto cleanup;
-
-        default:
-            break;
-        }
-
-        /* Only 'svm' requires --enable-nesting. The nested
-         * 'vmx' patches now simply hook off the CPU features
-         */
-        if (def->os.arch == VIR_ARCH_X86_64 ||
-            def->os.arch == VIR_ARCH_I686) {
-            int hasSVM = cpuHasFeature(data, "svm");
-            if (hasSVM < 0)
-                goto cleanup;
-            *hasHwVirt = hasSVM > 0 ? true : false;
-        }
-
-        if (cpu->mode == VIR_CPU_MODE_HOST_PASSTHROUGH) {
-            const char *mode = virCPUModeTypeToString(cpu->mode);
-            if (!virQEMUCapsGet(qemuCaps, QEMU_CAPS_CPU_HOST)) {
-                virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
-                               _("CPU mode '%s' is not supported by QEMU"
-                                 " binary"), mode);
-                goto cleanup;
-            }
-            if (def->virtType != VIR_DOMAIN_VIRT_KVM) {
-                virReportError(VIR_ERR_CONFIG_UNSUPPORTED,
-                               _("CPU mode '%s' is only supported with kvm"),
-                               mode);
-                goto cleanup;
-            }
-            virBufferAddLit(&buf, "host");
-        } else {
-            if (VIR_ALLOC(guest) < 0)
-                goto cleanup;
-            if (VIR_STRDUP(guest->vendor_id, cpu->vendor_id) < 0)
-                goto cleanup;
-
-            guest->arch = host->arch;
-            if (cpu->match == VIR_CPU_MATCH_MINIMUM)
-                preferred = host->model;
-            else
-                preferred = cpu->model;
-
-            guest->type = VIR_CPU_TYPE_GUEST;
-            guest->fallback = cpu->fallback;
-            if (cpuDecode(guest, data, (const char **)cpus, ncpus, preferred) < 0)
-                goto cleanup;
-
-            virBufferAdd(&buf, guest->model, -1);
-            if (guest->vendor_id)
-                virBufferAsprintf(&buf, ",vendor=%s", guest->vendor_id);
-            for (i = 0; i < guest->nfeatures; i++) {
-                char sign;
-                if (guest->features[i].policy == VIR_CPU_FEATURE_DISABLE)
-                    sign = '-';
-                else
-                    sign = '+';
-
-                virBufferAsprintf(&buf, ",%c%s", sign, guest->features[i].name);
-            }
-        }
         have_cpu = true;
     } else {
         /*
@@ -6174,14 +6308,12 @@ qemuBuildCpuArgStr(virQEMUDriverPtr driver,
     ret = 0;
 
  cleanup:
-    VIR_FREE(compare_msg);
-    cpuDataFree(data);
-    virCPUDefFree(guest);
-    virCPUDefFree(cpu);
+    virBufferFreeAndReset(&buf);
     virObjectUnref(caps);
     return ret;
 }
 
+
 static int
 qemuBuildObsoleteAccelArg(virCommandPtr cmd,
                           const virDomainDef *def,
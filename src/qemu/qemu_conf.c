@@ -257,6 +257,8 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged)
 
     cfg->logTimestamp = true;
 
+    cfg->statsSampleDomainsPerWorker = 16;
+
     return cfg;
 
  error:
@@ -581,6 +583,26 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
 
     GET_VALUE_BOOL("log_timestamp", cfg->logTimestamp);
 
+    p = virConfGetValue(conf, "stats_sample_interval");
+    CHECK_TYPE("stats_sample_interval", VIR_CONF_LONG);
+    if (p) {
+        if (p->l < 0 || p->l > QEMU_STATS_SAMPLE_MAX_INTERVAL) {
+            virReportError(VIR_ERR_CONF_SYNTAX,
+                           _("stats_sample_interval must be between "
+                             "0 and %d"), QEMU_STATS_SAMPLE_MAX_INTERVAL);
+            goto cleanup;
+        }
+        cfg->statsSampleInterval = p->l;
+    }
+    GET_VALUE_LONG("stats_sample_domains_per_worker",
+                   cfg->statsSampleDomainsPerWorker);
+    if (cfg->statsSampleDomainsPerWorker == 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                       _("stats_sample_domains_per_worker must be "
+                         "greater than 0"));
+        goto cleanup;
+    }
+
     ret = 0;
 
  cleanup:
@@ -707,6 +729,107 @@ virCapsPtr virQEMUDriverGetCapabilities(virQEMUDriverPtr driver,
     return ret;
 }
 
+typedef struct _virQEMUDriverCpuModelArg virQEMUDriverCpuModelArg;
+typedef virQEMUDriverCpuModelArg *virQEMUDriverCpuModelArgPtr;
+struct _virQEMUDriverCpuModelArg {
+    char *model;
+    bool hasHwVirt;
+};
+
+/* Bound the number of distinct guest/host CPU combinations remembered */
+#define QEMU_CPU_MODEL_ARG_CACHE_MAX 64
+
+static void
+virQEMUDriverCpuModelArgFree(void *payload,
+                             const void *name ATTRIBUTE_UNUSED)
+{
+    virQEMUDriverCpuModelArgPtr arg = payload;
+
+    if (!arg)
+        return;
+
+    VIR_FREE(arg->model);
+    VIR_FREE(arg);
+}
+
+virHashTablePtr
+virQEMUDriverCpuModelArgCacheNew(void)
+{
+    return virHashCreate(QEMU_CPU_MODEL_ARG_CACHE_MAX,
+                         virQEMUDriverCpuModelArgFree);
+}
+
+/**
+ * virQEMUDriverLookupCpuModelArg:
+ * @driver: the QEMU driver
+ * @key: description of the guest and host CPU
+ * @model: filled with a copy of the cached CPU model argument
+ * @hasHwVirt: filled with whether that CPU model enables nesting
+ *
+ * Returns 1 if a result was cached for @key, 0 if not, -1 on error.
+ */
+int
+virQEMUDriverLookupCpuModelArg(virQEMUDriverPtr driver,
+                               const char *key,
+                               char **model,
+                               bool *hasHwVirt)
+{
+    virQEMUDriverCpuModelArgPtr arg;
+    int ret = 0;
+
+    qemuDriverLock(driver);
+    if ((arg = virHashLookup(driver->cpuModelArgs, key))) {
+        if (VIR_STRDUP(*model, arg->model) < 0) {
+            ret = -1;
+        } else {
+            *hasHwVirt = arg->hasHwVirt;
+            ret = 1;
+        }
+    }
+    qemuDriverUnlock(driver);
+    return ret;
+}
+
+/**
+ * virQEMUDriverAddCpuModelArg:
+ * @driver: the QEMU driver
+ * @key: description of the guest and host CPU
+ * @model: the CPU model argument computed for @key
+ * @hasHwVirt: whether @model enables nesting
+ *
+ * Remember @model for later lookups of @key.  The cache is emptied
+ * once it holds QEMU_CPU_MODEL_ARG_CACHE_MAX entries.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virQEMUDriverAddCpuModelArg(virQEMUDriverPtr driver,
+                            const char *key,
+                            const char *model,
+                            bool hasHwVirt)
+{
+    virQEMUDriverCpuModelArgPtr arg;
+    int ret = -1;
+
+    if (VIR_ALLOC(arg) < 0 ||
+        VIR_STRDUP(arg->model, model) < 0)
+        goto cleanup;
+    arg->hasHwVirt = hasHwVirt;
+
+    qemuDriverLock(driver);
+    if (virHashSize(driver->cpuModelArgs) >= QEMU_CPU_MODEL_ARG_CACHE_MAX)
+        virHashRemoveAll(driver->cpuModelArgs);
+    if (virHashUpdateEntry(driver->cpuModelArgs, key, arg) == 0) {
+        arg = NULL;
+        ret = 0;
+    }
+    qemuDriverUnlock(driver);
+
+ cleanup:
+    virQEMUDriverCpuModelArgFree(arg, NULL);
+    return ret;
+}
+
 struct _qemuSharedDeviceEntry {
     size_t ref;
     char **domains; /* array of domain names */
@@ -56,6 +56,10 @@
 
 # define QEMU_DRIVER_NAME "QEMU"
 
+/* Upper bound of stats_sample_interval, in seconds. Keeps the sampling
+ * timeout in milliseconds well within an int */
+# define QEMU_STATS_SAMPLE_MAX_INTERVAL (24 * 60 * 60)
+
 typedef struct _virQEMUDriver virQEMUDriver;
 typedef virQEMUDriver *virQEMUDriverPtr;
 
@@ -170,6 +174,9 @@ struct _virQEMUDriverConfig {
     int migrationPortMax;
 
     bool logTimestamp;
+
+    unsigned int statsSampleInterval;
+    unsigned int statsSampleDomainsPerWorker;
 };
 
 /* Main driver state */
@@ -241,6 +248,19 @@ struct _virQEMUDriver {
 
     /* Immutable pointer, self-clocking APIs */
     virCloseCallbacksPtr closeCallbacks;
+
+    /* Immutable pointer, self-locking APIs */
+    virThreadPoolPtr statsPool;
+
+    /* Immutable */
+    int statsTimer;
+
+    /* Atomic inc/dec only */
+    int statsSampleInflight;
+
+    /* Immutable pointer, require lock to access the table. Guest CPU
+     * arguments computed by qemuBuildCommandLine */
+    virHashTablePtr cpuModelArgs;
 };
 
 typedef struct _qemuDomainCmdlineDef qemuDomainCmdlineDef;
@@ -266,6 +286,15 @@ int virQEMUDriverConfigLoadFile(virQEMUDriverConfigPtr cfg,
 virQEMUDriverConfigPtr virQEMUDriverGetConfig(virQEMUDriverPtr driver);
 
 virCapsPtr virQEMUDriverCreateCapabilities(virQEMUDriverPtr driver);
+virHashTablePtr virQEMUDriverCpuModelArgCacheNew(void);
+int virQEMUDriverLookupCpuModelArg(virQEMUDriverPtr driver,
+                                   const char *key,
+                                   char **model,
+                                   bool *hasHwVirt);
+int virQEMUDriverAddCpuModelArg(virQEMUDriverPtr driver,
+                                const char *key,
+                                const char *model,
+                                bool hasHwVirt);
 virCapsPtr virQEMUDriverGetCapabilities(virQEMUDriverPtr driver,
                                         bool refresh);
 
@@ -74,6 +74,21 @@ VIR_ENUM_IMPL(qemuDomainAsyncJob, QEMU_ASYNC_JOB_LAST,
               "snapshot",
 );
 
+VIR_ENUM_IMPL(qemuDomainStartPhase, QEMU_DOMAIN_START_PHASE_LAST,
+              "caps",
+              "hostdev",
+              "prepare",
+              "command",
+              "spawn",
+              "cgroup",
+              "label",
+              "monitor",
+              "probe",
+              "tune",
+              "devices",
+              "resume",
+);
+
 
 const char *
 qemuDomainAsyncJobPhaseToString(qemuDomainAsyncJob job,
@@ -253,6 +268,7 @@ qemuDomainObjPrivateFree(void *data)
     virDomainChrSourceDefFree(priv->monConfig);
     qemuDomainObjFreeJob(priv);
     VIR_FREE(priv->vcpupids);
+    qemuDomainStatsCacheClear(priv);
     VIR_FREE(priv->lockState);
     VIR_FREE(priv->origname);
 
@@ -363,6 +379,20 @@ qemuDomainObjPrivateXMLFormat(virBufferPtr buf, void *data)
     if (priv->quiesced)
         virBufferAddLit(buf, "<quiesced/>\n");
 
+    if (priv->nstartPhases) {
+        size_t i;
+        virBufferAsprintf(buf, "<startPhases start='%llu'>\n",
+                          priv->startTime);
+        virBufferAdjustIndent(buf, 2);
+        for (i = 0; i < priv->nstartPhases; i++) {
+            virBufferAsprintf(buf, "<phase name='%s' time='%llu'/>\n",
+                              qemuDomainStartPhaseTypeToString(i),
+                              priv->startPhases[i]);
+        }
+        virBufferAdjustIndent(buf, -2);
+        virBufferAddLit(buf, "</startPhases>\n");
+    }
+
     return 0;
 }
 
@@ -526,6 +556,42 @@ qemuDomainObjPrivateXMLParse(xmlXPathContextPtr ctxt, void *data)
 
     priv->quiesced = virXPathBoolean("boolean(./quiesced)", ctxt) == 1;
 
+    if ((n = virXPathNodeSet("./startPhases/phase", ctxt, &nodes)) < 0)
+        goto error;
+    if (n > 0 &&
+        virXPathULongLong("string(./startPhases/@start)", ctxt,
+                          &priv->startTime) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("failed to parse start phases"));
+        goto error;
+    }
+    for (i = 0; i < n; i++) {
+        int phase;
+
+        tmp = virXMLPropString(nodes[i], "name");
+        if (!tmp || (phase = qemuDomainStartPhaseTypeFromString(tmp)) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unknown start phase %s"), NULLSTR(tmp));
+            VIR_FREE(tmp);
+            goto error;
+        }
+        VIR_FREE(tmp);
+
+        if (!(tmp = virXMLPropString(nodes[i], "time")) ||
+            virStrToLong_ull(tmp, NULL, 10, &priv->startPhases[phase]) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Invalid time of start phase %s"),
+                           qemuDomainStartPhaseTypeToString(phase));
+            VIR_FREE(tmp);
+            goto error;
+        }
+        VIR_FREE(tmp);
+
+        if (phase >= priv->nstartPhases)
+            priv->nstartPhases = phase + 1;
+    }
+    VIR_FREE(nodes);
+
     return 0;
 
  error:
@@ -692,11 +758,53 @@ qemuDomainDefNamespaceHref(void)
 }
 
 
+static int
+qemuDomainDefNamespaceCopy(void *srcdata,
+                           void **data)
+{
+    qemuDomainCmdlineDefPtr src = srcdata;
+    qemuDomainCmdlineDefPtr cmd = NULL;
+    size_t i;
+
+    if (VIR_ALLOC(cmd) < 0)
+        return -1;
+
+    if (src->num_args && VIR_ALLOC_N(cmd->args, src->num_args) < 0)
+        goto error;
+
+    for (i = 0; i < src->num_args; i++) {
+        if (VIR_STRDUP(cmd->args[i], src->args[i]) < 0)
+            goto error;
+        cmd->num_args++;
+    }
+
+    if (src->num_env &&
+        (VIR_ALLOC_N(cmd->env_name, src->num_env) < 0 ||
+         VIR_ALLOC_N(cmd->env_value, src->num_env) < 0))
+        goto error;
+
+    for (i = 0; i < src->num_env; i++) {
+        cmd->num_env++;
+        if (VIR_STRDUP(cmd->env_name[i], src->env_name[i]) < 0 ||
+            VIR_STRDUP(cmd->env_value[i], src->env_value[i]) < 0)
+            goto error;
+    }
+
+    *data = cmd;
+    return 0;
+
+ error:
+    qemuDomainDefNamespaceFree(cmd);
+    return -1;
+}
+
+
 virDomainXMLNamespace virQEMUDriverDomainXMLNamespace = {
     .parse = qemuDomainDefNamespaceParse,
     .free = qemuDomainDefNamespaceFree,
     .format = qemuDomainDefNamespaceFormatXML,
     .href = qemuDomainDefNamespaceHref,
+    .copy = qemuDomainDefNamespaceCopy,
 };
 
 
@@ -1024,6 +1132,7 @@ qemuDomainObjDiscardAsyncJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
         qemuDomainObjResetJob(priv);
     qemuDomainObjResetAsyncJob(priv);
     qemuDomainObjSaveJob(driver, obj);
+    virDomainObjBumpGeneration(obj);
 }
 
 void
@@ -1064,7 +1173,8 @@ static int ATTRIBUTE_NONNULL(1)
 qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
                               virDomainObjPtr obj,
                               qemuDomainJob job,
-                              qemuDomainAsyncJob asyncJob)
+                              qemuDomainAsyncJob asyncJob,
+                              bool nowait)
 {
     qemuDomainObjPrivatePtr priv = obj->privateData;
     unsigned long long now;
@@ -1096,6 +1206,11 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
         goto error;
     }
 
+    if (nowait &&
+        (priv->job.active ||
+         (!nested && !qemuDomainNestedJobAllowed(priv, job))))
+        goto busy;
+
     while (!nested && !qemuDomainNestedJobAllowed(priv, job)) {
         VIR_DEBUG("Waiting for async job (vm=%p name=%s)", obj, obj->def->name);
         if (virCondWaitUntil(&priv->job.asyncCond, &obj->parent.lock, then) < 0)
@@ -1138,6 +1253,17 @@ qemuDomainObjBeginJobInternal(virQEMUDriverPtr driver,
     virObjectUnref(cfg);
     return 0;
 
+ busy:
+    VIR_DEBUG("Not waiting for job %s (vm=%p name=%s), current job is "
+              "(%s, %s)",
+              qemuDomainJobTypeToString(job), obj, obj->def->name,
+              qemuDomainJobTypeToString(priv->job.active),
+              qemuDomainAsyncJobTypeToString(priv->job.asyncJob));
+    priv->jobs_queued--;
+    virObjectUnref(obj);
+    virObjectUnref(cfg);
+    return 1;
+
  error:
     VIR_WARN("Cannot start job (%s, %s) for domain %s;"
              " current job is (%s, %s) owned by (%llu, %llu)",
@@ -1183,7 +1309,7 @@ int qemuDomainObjBeginJob(virQEMUDriverPtr driver,
                           qemuDomainJob job)
 {
     if (qemuDomainObjBeginJobInternal(driver, obj, job,
-                                      QEMU_ASYNC_JOB_NONE) < 0)
+                                      QEMU_ASYNC_JOB_NONE, false) < 0)
         return -1;
     else
         return 0;
@@ -1194,12 +1320,56 @@ int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
                                qemuDomainAsyncJob asyncJob)
 {
     if (qemuDomainObjBeginJobInternal(driver, obj, QEMU_JOB_ASYNC,
-                                      asyncJob) < 0)
+                                      asyncJob, false) < 0)
         return -1;
     else
         return 0;
 }
 
+/*
+ * obj must be locked before calling
+ *
+ * Like qemuDomainObjBeginJob, but never waits: if another job (or an
+ * async job which doesn't allow @job) currently holds the domain, the
+ * call returns immediately.
+ *
+ * Returns 0 if the job was started, 1 if the domain is busy (no error
+ * is reported in that case), -1 on error.
+ */
+int qemuDomainObjBeginJobNowait(virQEMUDriverPtr driver,
+                                virDomainObjPtr obj,
+                                qemuDomainJob job)
+{
+    int rc;
+
+    if ((rc = qemuDomainObjBeginJobInternal(driver, obj, job,
+                                            QEMU_ASYNC_JOB_NONE, true)) < 0)
+        return -1;
+    return rc;
+}
+
+/*
+ * obj must be locked before calling
+ *
+ * Starts a QEMU_JOB_QUERY job for a read-only statistics query. If
+ * @haveCache is true and the domain is currently busy with another job,
+ * the caller is told to serve the values cached by its previous query
+ * instead of queueing behind that job, which may run for a long time
+ * (migration, block job abort, ...).
+ *
+ * Returns 0 if the job was started, 1 if cached values should be used,
+ * -1 on error.
+ */
+int qemuDomainObjBeginQueryJob(virQEMUDriverPtr driver,
+                               virDomainObjPtr obj,
+                               bool haveCache)
+{
+    if (haveCache)
+        return qemuDomainObjBeginJobNowait(driver, obj, QEMU_JOB_QUERY);
+
+    return qemuDomainObjBeginJob(driver, obj, QEMU_JOB_QUERY);
+}
+
 static int ATTRIBUTE_RETURN_CHECK
 qemuDomainObjBeginNestedJob(virQEMUDriverPtr driver,
                             virDomainObjPtr obj,
@@ -1220,7 +1390,8 @@ qemuDomainObjBeginNestedJob(virQEMUDriverPtr driver,
 
     return qemuDomainObjBeginJobInternal(driver, obj,
                                          QEMU_JOB_ASYNC_NESTED,
-                                         QEMU_ASYNC_JOB_NONE);
+                                         QEMU_ASYNC_JOB_NONE,
+                                         false);
 }
 
 
@@ -1248,6 +1419,9 @@ bool qemuDomainObjEndJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
     qemuDomainObjResetJob(priv);
     if (qemuDomainTrackJob(job))
         qemuDomainObjSaveJob(driver, obj);
+    /* Anything but a query may have changed the definition */
+    if (job != QEMU_JOB_QUERY)
+        virDomainObjBumpGeneration(obj);
     virCondSignal(&priv->job.cond);
 
     return virObjectUnref(obj);
@@ -1266,6 +1440,7 @@ qemuDomainObjEndAsyncJob(virQEMUDriverPtr driver, virDomainObjPtr obj)
 
     qemuDomainObjResetAsyncJob(priv);
     qemuDomainObjSaveJob(driver, obj);
+    virDomainObjBumpGeneration(obj);
     virCondBroadcast(&priv->job.asyncCond);
 
     return virObjectUnref(obj);
@@ -1459,33 +1634,322 @@ void qemuDomainObjExitRemote(virDomainObjPtr obj)
 }
 
 
+/*
+ * Remembers the block statistics of the disk @alias, as just read from
+ * the monitor, so that they can be served while the domain is busy.
+ */
+int
+qemuDomainStatsCacheSetBlock(qemuDomainObjPrivatePtr priv,
+                             const char *alias,
+                             const qemuBlockStats *stats)
+{
+    qemuBlockStatsPtr entry;
+
+    if (!priv->blockStats &&
+        !(priv->blockStats = virHashCreate(10, virHashValueFree)))
+        return -1;
+
+    if (!(entry = virHashLookup(priv->blockStats, alias))) {
+        if (VIR_ALLOC(entry) < 0)
+            return -1;
+        if (virHashAddEntry(priv->blockStats, alias, entry) < 0) {
+            VIR_FREE(entry);
+            return -1;
+        }
+    }
+
+    *entry = *stats;
+    if (virTimeMillisNow(&entry->timestamp) < 0)
+        entry->timestamp = 0;
+
+    return 0;
+}
+
+
+qemuBlockStatsPtr
+qemuDomainStatsCacheGetBlock(qemuDomainObjPrivatePtr priv,
+                             const char *alias)
+{
+    if (!priv->blockStats || !alias)
+        return NULL;
+
+    return virHashLookup(priv->blockStats, alias);
+}
+
+
+/*
+ * Remembers the balloon statistics just read from the monitor. The
+ * cached array is replaced as a whole.
+ */
+int
+qemuDomainStatsCacheSetMemory(qemuDomainObjPrivatePtr priv,
+                              virDomainMemoryStatPtr stats,
+                              size_t nstats)
+{
+    virDomainMemoryStatPtr copy = NULL;
+
+    if (nstats && VIR_ALLOC_N(copy, nstats) < 0)
+        return -1;
+
+    if (nstats)
+        memcpy(copy, stats, sizeof(*stats) * nstats);
+
+    VIR_FREE(priv->memStats);
+    priv->memStats = copy;
+    priv->nmemStats = nstats;
+    if (virTimeMillisNow(&priv->memStatsTimestamp) < 0)
+        priv->memStatsTimestamp = 0;
+
+    return 0;
+}
+
+
+/*
+ * Looks up the current balloon size in the cached balloon statistics.
+ * Returns true and sets @balloon (in KiB) if they have it.
+ */
+bool
+qemuDomainStatsCacheGetBalloon(qemuDomainObjPrivatePtr priv,
+                               unsigned long long *balloon)
+{
+    size_t i;
+
+    for (i = 0; i < priv->nmemStats; i++) {
+        if (priv->memStats[i].tag == VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON) {
+            *balloon = priv->memStats[i].val;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+int
+qemuDomainStatsCacheSetInterface(qemuDomainObjPrivatePtr priv,
+                                 const char *ifname,
+                                 const virDomainInterfaceStatsStruct *stats)
+{
+    qemuInterfaceStatsPtr entry;
+
+    if (!priv->interfaceStats &&
+        !(priv->interfaceStats = virHashCreate(10, virHashValueFree)))
+        return -1;
+
+    if (!(entry = virHashLookup(priv->interfaceStats, ifname))) {
+        if (VIR_ALLOC(entry) < 0)
+            return -1;
+        if (virHashAddEntry(priv->interfaceStats, ifname, entry) < 0) {
+            VIR_FREE(entry);
+            return -1;
+        }
+    }
+
+    entry->stats = *stats;
+    if (virTimeMillisNow(&entry->timestamp) < 0)
+        entry->timestamp = 0;
+
+    return 0;
+}
+
+
+qemuInterfaceStatsPtr
+qemuDomainStatsCacheGetInterface(qemuDomainObjPrivatePtr priv,
+                                 const char *ifname)
+{
+    if (!priv->interfaceStats || !ifname)
+        return NULL;
+
+    return virHashLookup(priv->interfaceStats, ifname);
+}
+
+
+void
+qemuDomainStatsCacheClear(qemuDomainObjPrivatePtr priv)
+{
+    virHashFree(priv->blockStats);
+    priv->blockStats = NULL;
+    priv->nblockStatsParams = 0;
+    VIR_FREE(priv->memStats);
+    priv->nmemStats = 0;
+    priv->memStatsTimestamp = 0;
+    virHashFree(priv->interfaceStats);
+    priv->interfaceStats = NULL;
+    priv->cpuTime = 0;
+    priv->cpuTimeTimestamp = 0;
+}
+
+
+/*
+ * Returns true if background stats sampling is enabled and a value
+ * sampled at @timestamp is recent enough to be served to API callers
+ * without querying the domain again.
+ */
+bool
+qemuDomainStatsCacheIsFresh(virQEMUDriverPtr driver,
+                            unsigned long long timestamp)
+{
+    virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+    unsigned long long now;
+    bool ret = false;
+
+    if (cfg->statsSampleInterval == 0 || timestamp == 0)
+        goto cleanup;
+
+    if (virTimeMillisNow(&now) < 0)
+        goto cleanup;
+
+    ret = now - timestamp < cfg->statsSampleInterval * 1000ull;
+
+ cleanup:
+    virObjectUnref(cfg);
+    return ret;
+}
+
+
+/* Returns a copy of @cpu updated to the host CPU in @caps, or NULL on
+ * error.  */
+static virCPUDefPtr
+qemuDomainCPUDefCopyUpdated(virCapsPtr caps,
+                            virCPUDefPtr cpu)
+{
+    virCPUDefPtr ret;
+
+    if (!caps->host.cpu ||
+        !caps->host.cpu->model) {
+        virReportError(VIR_ERR_OPERATION_FAILED,
+                       "%s", _("cannot get host CPU capabilities"));
+        return NULL;
+    }
+
+    if (!(ret = virCPUDefCopy(cpu)) ||
+        cpuUpdate(ret, caps->host.cpu) < 0) {
+        virCPUDefFree(ret);
+        return NULL;
+    }
+
+    return ret;
+}
+
+
+static bool
+qemuDomainCPUNeedsUpdate(virCPUDefPtr cpu,
+                         unsigned int flags)
+{
+    return (flags & VIR_DOMAIN_XML_UPDATE_CPU) &&
+        cpu &&
+        (cpu->mode != VIR_CPU_MODE_CUSTOM || cpu->model);
+}
+
+
+/* Finds the default USB controller and pci-root of @def, which are left
+ * out of migratable XML to keep it compatible with older versions of
+ * libvirt.  Those didn't support them in the XML but always added them
+ * to qemu anyway.  Returns how many of the two were found.  */
+static int
+qemuDomainDefFindDefaultControllers(virDomainDefPtr def,
+                                    virDomainControllerDefPtr *usbret,
+                                    virDomainControllerDefPtr *pciret)
+{
+    virDomainControllerDefPtr usb = NULL, pci = NULL;
+    size_t i;
+    int found = 0;
+
+    /* If only the default USB controller is present, we can remove it */
+    for (i = 0; i < def->ncontrollers; i++) {
+        if (def->controllers[i]->type == VIR_DOMAIN_CONTROLLER_TYPE_USB) {
+            if (usb) {
+                usb = NULL;
+                break;
+            }
+            usb = def->controllers[i];
+        }
+    }
+    if (usb && usb->idx == 0 && usb->model == -1) {
+        VIR_DEBUG("Removing default USB controller from domain '%s'"
+                  " for migration compatibility", def->name);
+        found++;
+    } else {
+        usb = NULL;
+    }
+
+    /* Remove the default PCI controller if there is only one present
+     * and its model is pci-root */
+    for (i = 0; i < def->ncontrollers; i++) {
+        if (def->controllers[i]->type == VIR_DOMAIN_CONTROLLER_TYPE_PCI) {
+            if (pci) {
+                pci = NULL;
+                break;
+            }
+            pci = def->controllers[i];
+        }
+    }
+
+    if (pci && pci->idx == 0 &&
+        pci->model == VIR_DOMAIN_CONTROLLER_MODEL_PCI_ROOT) {
+        VIR_DEBUG("Removing default pci-root from domain '%s'"
+                  " for migration compatibility", def->name);
+        found++;
+    } else {
+        pci = NULL;
+    }
+
+    *usbret = usb;
+    *pciret = pci;
+    return found;
+}
+
+
+/* Copies @src the way formatting it with @flags and parsing the result
+ * back as inactive XML would, without going through XML.  */
 virDomainDefPtr
 qemuDomainDefCopy(virQEMUDriverPtr driver,
                   virDomainDefPtr src,
                   unsigned int flags)
 {
-    virBuffer buf = VIR_BUFFER_INITIALIZER;
     virDomainDefPtr ret = NULL;
     virCapsPtr caps = NULL;
-    char *xml = NULL;
-
-    if (qemuDomainDefFormatBuf(driver, src, flags, &buf) < 0)
-        goto cleanup;
-
-    xml = virBufferContentAndReset(&buf);
+    virCPUDefPtr cpu;
+    virDomainControllerDefPtr usb, pci;
+    size_t i;
 
     if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
         goto cleanup;
 
-    if (!(ret = virDomainDefParseString(xml, caps, driver->xmlopt,
-                                        QEMU_EXPECTED_VIRT_TYPES,
-                                        VIR_DOMAIN_XML_INACTIVE)))
+    if (!(ret = virDomainDefCopy(src, caps, driver->xmlopt,
+                                 !!(flags & VIR_DOMAIN_XML_MIGRATABLE))))
         goto cleanup;
 
+    if (qemuDomainCPUNeedsUpdate(ret->cpu, flags)) {
+        if (!(cpu = qemuDomainCPUDefCopyUpdated(caps, ret->cpu)))
+            goto error;
+        virCPUDefFree(ret->cpu);
+        ret->cpu = cpu;
+    }
+
+    /* Parsing migratable XML adds the default controllers back, so
+     * they lose whatever they don't get by default.  */
+    if ((flags & VIR_DOMAIN_XML_MIGRATABLE) &&
+        qemuDomainDefFindDefaultControllers(ret, &usb, &pci) > 0) {
+        for (i = ret->ncontrollers; i > 0; i--) {
+            if (ret->controllers[i - 1] == usb ||
+                ret->controllers[i - 1] == pci)
+                virDomainControllerDefFree(virDomainControllerRemove(ret,
+                                                                     i - 1));
+        }
+
+        if (virDomainDefPostParse(ret, caps, driver->xmlopt) < 0)
+            goto error;
+    }
+
  cleanup:
-    VIR_FREE(xml);
     virObjectUnref(caps);
     return ret;
+
+ error:
+    virDomainDefFree(ret);
+    ret = NULL;
+    goto cleanup;
 }
 
 int
@@ -1505,70 +1969,18 @@ qemuDomainDefFormatBuf(virQEMUDriverPtr driver,
         goto cleanup;
 
     /* Update guest CPU requirements according to host CPU */
-    if ((flags & VIR_DOMAIN_XML_UPDATE_CPU) &&
-        def_cpu &&
-        (def_cpu->mode != VIR_CPU_MODE_CUSTOM || def_cpu->model)) {
-        if (!caps->host.cpu ||
-            !caps->host.cpu->model) {
-            virReportError(VIR_ERR_OPERATION_FAILED,
-                           "%s", _("cannot get host CPU capabilities"));
-            goto cleanup;
-        }
-
-        if (!(cpu = virCPUDefCopy(def_cpu)) ||
-            cpuUpdate(cpu, caps->host.cpu) < 0)
+    if (qemuDomainCPUNeedsUpdate(def_cpu, flags)) {
+        if (!(cpu = qemuDomainCPUDefCopyUpdated(caps, def_cpu)))
             goto cleanup;
         def->cpu = cpu;
     }
 
     if ((flags & VIR_DOMAIN_XML_MIGRATABLE)) {
         size_t i;
-        int toremove = 0;
-        virDomainControllerDefPtr usb = NULL, pci = NULL;
-
-        /* If only the default USB controller is present, we can remove it
-         * and make the XML compatible with older versions of libvirt which
-         * didn't support USB controllers in the XML but always added the
-         * default one to qemu anyway.
-         */
-        for (i = 0; i < def->ncontrollers; i++) {
-            if (def->controllers[i]->type == VIR_DOMAIN_CONTROLLER_TYPE_USB) {
-                if (usb) {
-                    usb = NULL;
-                    break;
-                }
-                usb = def->controllers[i];
-            }
-        }
-        if (usb && usb->idx == 0 && usb->model == -1) {
-            VIR_DEBUG("Removing default USB controller from domain '%s'"
-                      " for migration compatibility", def->name);
-            toremove++;
-        } else {
-            usb = NULL;
-        }
-
-        /* Remove the default PCI controller if there is only one present
-         * and its model is pci-root */
-        for (i = 0; i < def->ncontrollers; i++) {
-            if (def->controllers[i]->type == VIR_DOMAIN_CONTROLLER_TYPE_PCI) {
-                if (pci) {
-                    pci = NULL;
-                    break;
-                }
-                pci = def->controllers[i];
-            }
-        }
-
-        if (pci && pci->idx == 0 &&
-            pci->model == VIR_DOMAIN_CONTROLLER_MODEL_PCI_ROOT) {
-            VIR_DEBUG("Removing default pci-root from domain '%s'"
-                      " for migration compatibility", def->name);
-            toremove++;
-        } else {
-            pci = NULL;
-        }
+        int toremove;
+        virDomainControllerDefPtr usb, pci;
 
+        toremove = qemuDomainDefFindDefaultControllers(def, &usb, &pci);
         if (toremove) {
             controllers = def->controllers;
             ncontrollers = def->ncontrollers;
@@ -2477,10 +2889,12 @@ qemuDomainDetermineDiskChain(virQEMUDriverPtr driver,
         goto cleanup;
 
     if (disk->src->backingStore) {
-        if (force)
-            virStorageSourceBackingStoreClear(disk->src);
-        else
+        if (!force)
             goto cleanup;
+
+        /* the chain was changed behind our back, don't trust the cache */
+        virStorageFileMetadataCacheInvalidate(disk->src);
+        virStorageSourceBackingStoreClear(disk->src);
     }
 
     qemuDomainGetImageIds(cfg, vm, disk->src, &uid, &gid);
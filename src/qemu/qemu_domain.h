@@ -100,6 +100,27 @@ typedef enum {
 } qemuDomainAsyncJob;
 VIR_ENUM_DECL(qemuDomainAsyncJob)
 
+/* Steps of qemuProcessStart, in the order they are run, whose duration
+ * is recorded in the domain's private data.
+ */
+typedef enum {
+    QEMU_DOMAIN_START_PHASE_CAPS = 0, /* Emulator capabilities lookup */
+    QEMU_DOMAIN_START_PHASE_HOSTDEV,  /* Network, host and chr devices */
+    QEMU_DOMAIN_START_PHASE_PREPARE,  /* Labels, logs, numad, disks, ... */
+    QEMU_DOMAIN_START_PHASE_COMMAND,  /* Building the command line */
+    QEMU_DOMAIN_START_PHASE_SPAWN,    /* Running QEMU until it waits for us */
+    QEMU_DOMAIN_START_PHASE_CGROUP,   /* Domain cgroup placement */
+    QEMU_DOMAIN_START_PHASE_LABEL,    /* Security labelling */
+    QEMU_DOMAIN_START_PHASE_MONITOR,  /* Monitor, first queries and agent */
+    QEMU_DOMAIN_START_PHASE_PROBE,    /* Checking the guest CPU */
+    QEMU_DOMAIN_START_PHASE_TUNE,     /* vCPU and emulator cgroups, pinning */
+    QEMU_DOMAIN_START_PHASE_DEVICES,  /* Passwords, links, devices, balloon */
+    QEMU_DOMAIN_START_PHASE_RESUME,   /* Starting guest CPUs */
+
+    QEMU_DOMAIN_START_PHASE_LAST
+} qemuDomainStartPhase;
+VIR_ENUM_DECL(qemuDomainStartPhase)
+
 struct qemuDomainJobObj {
     virCond cond;                       /* Use to coordinate jobs */
     qemuDomainJob active;               /* Currently running job */
@@ -120,6 +141,13 @@ struct qemuDomainJobObj {
 typedef void (*qemuDomainCleanupCallback)(virQEMUDriverPtr driver,
                                           virDomainObjPtr vm);
 
+typedef struct _qemuInterfaceStats qemuInterfaceStats;
+typedef qemuInterfaceStats *qemuInterfaceStatsPtr;
+struct _qemuInterfaceStats {
+    virDomainInterfaceStatsStruct stats;
+    unsigned long long timestamp;   /* when the values were sampled (ms) */
+};
+
 typedef struct _qemuDomainObjPrivate qemuDomainObjPrivate;
 typedef qemuDomainObjPrivate *qemuDomainObjPrivatePtr;
 struct _qemuDomainObjPrivate {
@@ -174,6 +202,24 @@ struct _qemuDomainObjPrivate {
     bool hookRun;  /* true if there was a hook run over this domain */
 
     bool quiesced; /* true if filesystems are quiesced */
+
+    /* Last statistics read from the monitor. Read-only stats queries
+     * return these instead of queueing behind another job. */
+    virHashTablePtr blockStats; /* disk alias -> qemuBlockStats */
+    int nblockStatsParams;
+    virDomainMemoryStatPtr memStats;
+    size_t nmemStats;
+    unsigned long long memStatsTimestamp; /* ms */
+
+    /* Filled only by the background stats sampler */
+    virHashTablePtr interfaceStats; /* ifname -> qemuInterfaceStats */
+    unsigned long long cpuTime;
+    unsigned long long cpuTimeTimestamp; /* ms */
+
+    /* How long each phase of the last qemuProcessStart took */
+    unsigned long long startTime; /* ms */
+    unsigned long long startPhases[QEMU_DOMAIN_START_PHASE_LAST]; /* ms */
+    size_t nstartPhases; /* number of phases finished */
 };
 
 typedef enum {
@@ -209,6 +255,14 @@ int qemuDomainObjBeginAsyncJob(virQEMUDriverPtr driver,
                                virDomainObjPtr obj,
                                qemuDomainAsyncJob asyncJob)
     ATTRIBUTE_RETURN_CHECK;
+int qemuDomainObjBeginJobNowait(virQEMUDriverPtr driver,
+                                virDomainObjPtr obj,
+                                qemuDomainJob job)
+    ATTRIBUTE_RETURN_CHECK;
+int qemuDomainObjBeginQueryJob(virQEMUDriverPtr driver,
+                               virDomainObjPtr obj,
+                               bool haveCache)
+    ATTRIBUTE_RETURN_CHECK;
 
 bool qemuDomainObjEndJob(virQEMUDriverPtr driver,
                          virDomainObjPtr obj)
@@ -252,6 +306,34 @@ void qemuDomainObjEnterRemote(virDomainObjPtr obj)
 void qemuDomainObjExitRemote(virDomainObjPtr obj)
     ATTRIBUTE_NONNULL(1);
 
+int qemuDomainStatsCacheSetBlock(qemuDomainObjPrivatePtr priv,
+                                 const char *alias,
+                                 const qemuBlockStats *stats)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+qemuBlockStatsPtr qemuDomainStatsCacheGetBlock(qemuDomainObjPrivatePtr priv,
+                                               const char *alias)
+    ATTRIBUTE_NONNULL(1);
+int qemuDomainStatsCacheSetMemory(qemuDomainObjPrivatePtr priv,
+                                  virDomainMemoryStatPtr stats,
+                                  size_t nstats)
+    ATTRIBUTE_NONNULL(1);
+bool qemuDomainStatsCacheGetBalloon(qemuDomainObjPrivatePtr priv,
+                                    unsigned long long *balloon)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+int qemuDomainStatsCacheSetInterface(qemuDomainObjPrivatePtr priv,
+                                     const char *ifname,
+                                     const virDomainInterfaceStatsStruct *stats)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
+qemuInterfaceStatsPtr
+qemuDomainStatsCacheGetInterface(qemuDomainObjPrivatePtr priv,
+                                 const char *ifname)
+    ATTRIBUTE_NONNULL(1);
+void qemuDomainStatsCacheClear(qemuDomainObjPrivatePtr priv)
+    ATTRIBUTE_NONNULL(1);
+bool qemuDomainStatsCacheIsFresh(virQEMUDriverPtr driver,
+                                 unsigned long long timestamp)
+    ATTRIBUTE_NONNULL(1);
+
 virDomainDefPtr qemuDomainDefCopy(virQEMUDriverPtr driver,
                                   virDomainDefPtr src,
                                   unsigned int flags);
@@ -45,6 +45,7 @@
 
 
 #include "qemu_driver.h"
+#include "qemu_driverpriv.h"
 #include "qemu_agent.h"
 #include "qemu_conf.h"
 #include "qemu_capabilities.h"
@@ -83,6 +84,7 @@
 #include "fdstream.h"
 #include "configmake.h"
 #include "virthreadpool.h"
+#include "viratomic.h"
 #include "locking/lock_manager.h"
 #include "locking/domain_lock.h"
 #include "virkeycode.h"
@@ -109,6 +111,8 @@ VIR_LOG_INIT("qemu.qemu_driver");
 
 #define QEMU_NB_PER_CPU_STAT_PARAM 2
 
+#define QEMU_STATS_SAMPLE_MAX_WORKERS 16
+
 #define QEMU_SCHED_MIN_PERIOD              1000LL
 #define QEMU_SCHED_MAX_PERIOD           1000000LL
 #define QEMU_SCHED_MIN_QUOTA               1000LL
@@ -146,6 +150,9 @@ static void processGuestPanicEvent(virQEMUDriverPtr driver,
 
 static void qemuProcessEventHandler(void *data, void *opaque);
 
+static void qemuDomainStatsSampleTimer(int timer, void *opaque);
+static void qemuDomainStatsSampleWorker(void *data, void *opaque);
+
 static int qemuStateCleanup(void);
 
 static int qemuDomainObjStart(virConnectPtr conn,
@@ -585,6 +592,7 @@ qemuStateInitialize(bool privileged,
 
     if (VIR_ALLOC(qemu_driver) < 0)
         return -1;
+    qemu_driver->statsTimer = -1;
 
     if (virMutexInit(&qemu_driver->lock) < 0) {
         VIR_ERROR(_("cannot initialize mutex"));
@@ -745,6 +753,9 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->qemuCapsCache)
         goto error;
 
+    if (!(qemu_driver->cpuModelArgs = virQEMUDriverCpuModelArgCacheNew()))
+        goto error;
+
     if ((qemu_driver->caps = virQEMUDriverCreateCapabilities(qemu_driver)) == NULL)
         goto error;
 
@@ -836,6 +847,22 @@ qemuStateInitialize(bool privileged,
     if (!qemu_driver->workerPool)
         goto error;
 
+    if (cfg->statsSampleInterval > 0) {
+        qemu_driver->statsPool = virThreadPoolNew(0,
+                                                  QEMU_STATS_SAMPLE_MAX_WORKERS,
+                                                  0,
+                                                  qemuDomainStatsSampleWorker,
+                                                  qemu_driver);
+        if (!qemu_driver->statsPool)
+            goto error;
+
+        if ((qemu_driver->statsTimer =
+             virEventAddTimeout(cfg->statsSampleInterval * 1000,
+                                qemuDomainStatsSampleTimer,
+                                qemu_driver, NULL)) < 0)
+            goto error;
+    }
+
     virObjectUnref(conn);
 
     virNWFilterRegisterCallbackDriver(&qemuCallbackDriver);
@@ -981,11 +1008,15 @@ qemuStateCleanup(void)
         return -1;
 
     virNWFilterUnRegisterCallbackDriver(&qemuCallbackDriver);
+    if (qemu_driver->statsTimer >= 0)
+        virEventRemoveTimeout(qemu_driver->statsTimer);
+    virThreadPoolFree(qemu_driver->statsPool);
     virObjectUnref(qemu_driver->config);
     virObjectUnref(qemu_driver->hostdevMgr);
     virHashFree(qemu_driver->sharedDevices);
     virObjectUnref(qemu_driver->caps);
     virQEMUCapsCacheFree(qemu_driver->qemuCapsCache);
+    virHashFree(qemu_driver->cpuModelArgs);
 
     virObjectUnref(qemu_driver->domains);
     virObjectUnref(qemu_driver->remotePorts);
@@ -1329,6 +1360,291 @@ qemuGetProcessInfo(unsigned long long *cpuTime, int *lastCpu, long *vm_rss,
 }
 
 
+/*
+ * Fills @cpuTimes and @lastCpus for the first @ntimes vCPUs of @vm.
+ * Only the vCPU thread IDs cached in the private data are used, so this
+ * never talks to the monitor and needs nothing but the domain object
+ * lock.  The run time comes from schedstat, which the scheduler keeps
+ * in nanoseconds, rather than from the jiffies of the stat file.  The
+ * stat file still has to be read for the pCPU, and for the run time on
+ * hosts without schedstat.
+ */
+static int
+qemuDomainHelperGetVcpuTimes(virDomainObjPtr vm,
+                             unsigned long long *cpuTimes,
+                             int *lastCpus,
+                             int ntimes)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    size_t i;
+    int rc;
+
+    if (ntimes > priv->nvcpupids)
+        ntimes = priv->nvcpupids;
+
+    for (i = 0; i < ntimes; i++) {
+        if ((rc = virProcessGetSchedstat(vm->pid, priv->vcpupids[i],
+                                         &cpuTimes[i])) < 0)
+            return -1;
+
+        if (qemuGetProcessInfo(rc == 0 ? NULL : &cpuTimes[i], &lastCpus[i],
+                               NULL, vm->pid, priv->vcpupids[i]) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("cannot get vCPU placement & pCPU time"));
+            return -1;
+        }
+    }
+
+    return ntimes;
+}
+
+
+/*
+ * Background stats sampling: every stats_sample_interval seconds the
+ * timer below starts a round on the statsPool. The round collects all
+ * running domains and hands them out in batches of
+ * stats_sample_domains_per_worker to the statsPool workers. Samples are
+ * kept in qemuDomainObjPrivate and served by the stats APIs while they
+ * are fresh.
+ */
+typedef struct _qemuDomainStatsSampleBatch qemuDomainStatsSampleBatch;
+typedef qemuDomainStatsSampleBatch *qemuDomainStatsSampleBatchPtr;
+struct _qemuDomainStatsSampleBatch {
+    bool collect; /* start of a round rather than domains to sample */
+    size_t ndoms;
+    virDomainObjPtr *doms;
+};
+
+static void qemuDomainStatsSampleRound(virQEMUDriverPtr driver);
+
+static void
+qemuDomainStatsSampleOne(virQEMUDriverPtr driver,
+                         virDomainObjPtr vm)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virDomainMemoryStatStruct memstats[VIR_DOMAIN_MEMORY_STAT_NR];
+    qemuBlockStatsPtr blockstats = NULL;
+    int *blockrc = NULL;
+    const char **aliases = NULL;
+    unsigned long long cpuTime;
+    int nmemstats = -1;
+    int nparams = -1;
+    size_t ndisks;
+    size_t i;
+
+    if (!virDomainObjIsActive(vm))
+        return;
+
+    if (qemuGetProcessInfo(&cpuTime, NULL, NULL, vm->pid, 0) == 0 &&
+        virTimeMillisNow(&priv->cpuTimeTimestamp) == 0)
+        priv->cpuTime = cpuTime;
+
+    /* Don't compete with API callers or long running jobs for the
+     * monitor, the previous sample stays around until the next round */
+    if (qemuDomainObjBeginJobNowait(driver, vm, QEMU_JOB_QUERY) != 0)
+        goto cleanup;
+
+    if (!virDomainObjIsActive(vm))
+        goto endjob;
+
+    ndisks = vm->def->ndisks;
+    if (VIR_ALLOC_N(blockstats, ndisks) < 0 ||
+        VIR_ALLOC_N(blockrc, ndisks) < 0 ||
+        VIR_ALLOC_N(aliases, ndisks) < 0)
+        goto endjob;
+
+    for (i = 0; i < ndisks; i++)
+        aliases[i] = vm->def->disks[i]->info.alias;
+
+    /* The cache must not be touched while the domain is unlocked */
+    qemuDomainObjEnterMonitor(driver, vm);
+    if (qemuMonitorGetDomainStats(priv->mon, ndisks, aliases,
+                                  blockstats, blockrc,
+                                  priv->nblockStatsParams == 0 ?
+                                  &nparams : NULL,
+                                  memstats, VIR_DOMAIN_MEMORY_STAT_NR,
+                                  &nmemstats) < 0) {
+        for (i = 0; i < ndisks; i++)
+            blockrc[i] = -1;
+        nparams = nmemstats = -1;
+    }
+    qemuDomainObjExitMonitor(driver, vm);
+
+    if (nparams >= 0)
+        priv->nblockStatsParams = nparams;
+
+    for (i = 0; i < ndisks; i++) {
+        const char *alias = vm->def->disks[i]->info.alias;
+
+        if (blockrc[i] == 0)
+            ignore_value(qemuDomainStatsCacheSetBlock(priv, alias,
+                                                      &blockstats[i]));
+    }
+
+    if (nmemstats >= 0)
+        ignore_value(qemuDomainStatsCacheSetMemory(priv, memstats, nmemstats));
+
+ endjob:
+    ignore_value(qemuDomainObjEndJob(driver, vm));
+
+ cleanup:
+    /* Failures are not interesting to anyone but the debug log */
+    virResetLastError();
+    VIR_FREE(blockstats);
+    VIR_FREE(blockrc);
+    VIR_FREE(aliases);
+}
+
+
+static void
+qemuDomainStatsSampleWorker(void *data, void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    qemuDomainStatsSampleBatchPtr batch = data;
+    size_t i;
+
+    if (batch->collect)
+        qemuDomainStatsSampleRound(driver);
+
+    for (i = 0; i < batch->ndoms; i++) {
+        virDomainObjPtr vm = batch->doms[i];
+
+        virObjectLock(vm);
+        qemuDomainStatsSampleOne(driver, vm);
+        virObjectUnlock(vm);
+        virObjectUnref(vm);
+    }
+
+    VIR_FREE(batch->doms);
+    VIR_FREE(batch);
+    ignore_value(virAtomicIntDecAndTest(&driver->statsSampleInflight));
+}
+
+
+struct qemuDomainStatsSampleCollectData {
+    size_t ndoms;
+    virDomainObjPtr *doms;
+    virHashTablePtr ifstats;
+};
+
+static int
+qemuDomainStatsSampleCollect(virDomainObjPtr vm,
+                             void *opaque)
+{
+    struct qemuDomainStatsSampleCollectData *data = opaque;
+    int ret = 0;
+
+    virObjectLock(vm);
+    if (virDomainObjIsActive(vm)) {
+        size_t i;
+
+        /* Interface counters of all domains come from a single read of
+         * the host's interface list, no need to hand them to workers */
+        for (i = 0; data->ifstats && i < vm->def->nnets; i++) {
+            const char *ifname = vm->def->nets[i]->ifname;
+            virDomainInterfaceStatsPtr ifstats;
+
+            if (ifname && (ifstats = virHashLookup(data->ifstats, ifname)))
+                ignore_value(qemuDomainStatsCacheSetInterface(vm->privateData,
+                                                              ifname,
+                                                              ifstats));
+        }
+
+        if (VIR_APPEND_ELEMENT_COPY(data->doms, data->ndoms, vm) < 0)
+            ret = -1;
+        else
+            virObjectRef(vm);
+    }
+    virObjectUnlock(vm);
+
+    return ret;
+}
+
+
+/* Runs in a statsPool worker, which counts as in flight until the
+ * batches are handed out */
+static void
+qemuDomainStatsSampleRound(virQEMUDriverPtr driver)
+{
+    virQEMUDriverConfigPtr cfg = virQEMUDriverGetConfig(driver);
+    struct qemuDomainStatsSampleCollectData data = { 0, NULL, NULL };
+    qemuDomainStatsSampleBatchPtr batch = NULL;
+    size_t i;
+
+#ifdef __linux__
+    data.ifstats = linuxDomainInterfaceStatsAll();
+#endif
+
+    ignore_value(virDomainObjListForEach(driver->domains,
+                                         qemuDomainStatsSampleCollect,
+                                         &data));
+
+    for (i = 0; i < data.ndoms; i += batch->ndoms) {
+        if (VIR_ALLOC(batch) < 0)
+            goto cleanup;
+
+        batch->ndoms = MIN(cfg->statsSampleDomainsPerWorker, data.ndoms - i);
+        if (VIR_ALLOC_N(batch->doms, batch->ndoms) < 0) {
+            VIR_FREE(batch);
+            goto cleanup;
+        }
+
+        /* The batch takes over the references */
+        memcpy(batch->doms, data.doms + i, sizeof(*data.doms) * batch->ndoms);
+        memset(data.doms + i, 0, sizeof(*data.doms) * batch->ndoms);
+
+        virAtomicIntInc(&driver->statsSampleInflight);
+        if (virThreadPoolSendJob(driver->statsPool, 0, batch) < 0) {
+            ignore_value(virAtomicIntDecAndTest(&driver->statsSampleInflight));
+            memcpy(data.doms + i, batch->doms,
+                   sizeof(*data.doms) * batch->ndoms);
+            VIR_FREE(batch->doms);
+            VIR_FREE(batch);
+            goto cleanup;
+        }
+    }
+
+ cleanup:
+    virResetLastError();
+    for (i = 0; i < data.ndoms; i++)
+        virObjectUnref(data.doms[i]);
+    VIR_FREE(data.doms);
+    virHashFree(data.ifstats);
+    virObjectUnref(cfg);
+}
+
+
+static void
+qemuDomainStatsSampleTimer(int timer ATTRIBUTE_UNUSED,
+                           void *opaque)
+{
+    virQEMUDriverPtr driver = opaque;
+    qemuDomainStatsSampleBatchPtr batch;
+
+    if (virAtomicIntGet(&driver->statsSampleInflight) > 0) {
+        VIR_DEBUG("Previous stats sampling round still running, skipping");
+        return;
+    }
+
+    /* Even collecting the domains and reading the host's interface
+     * counters takes too long for the event loop, leave it to a worker */
+    if (VIR_ALLOC(batch) < 0)
+        goto error;
+    batch->collect = true;
+
+    virAtomicIntInc(&driver->statsSampleInflight);
+    if (virThreadPoolSendJob(driver->statsPool, 0, batch) < 0) {
+        ignore_value(virAtomicIntDecAndTest(&driver->statsSampleInflight));
+        VIR_FREE(batch);
+        goto error;
+    }
+    return;
+
+ error:
+    virResetLastError();
+}
+
+
 static virDomainPtr qemuDomainLookupByID(virConnectPtr conn,
                                          int id)
 {
@@ -2473,6 +2789,7 @@ static int qemuDomainGetInfo(virDomainPtr dom,
     virDomainObjPtr vm;
     int ret = -1;
     int err;
+    int rc;
     unsigned long long balloon;
 
     if (!(vm = qemuDomObjFromDomain(dom)))
@@ -2486,7 +2803,12 @@ static int qemuDomainGetInfo(virDomainPtr dom,
     if (!virDomainObjIsActive(vm)) {
         info->cpuTime = 0;
     } else {
-        if (qemuGetProcessInfo(&(info->cpuTime), NULL, NULL, vm->pid, 0) < 0) {
+        qemuDomainObjPrivatePtr priv = vm->privateData;
+
+        if (qemuDomainStatsCacheIsFresh(driver, priv->cpuTimeTimestamp)) {
+            info->cpuTime = priv->cpuTime;
+        } else if (qemuGetProcessInfo(&(info->cpuTime), NULL, NULL,
+                                      vm->pid, 0) < 0) {
             virReportError(VIR_ERR_OPERATION_FAILED, "%s",
                            _("cannot read cputime for domain"));
             goto cleanup;
@@ -2503,27 +2825,40 @@ static int qemuDomainGetInfo(virDomainPtr dom,
             info->memory = vm->def->mem.max_balloon;
         } else if (virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_BALLOON_EVENT)) {
             info->memory = vm->def->mem.cur_balloon;
+        } else if (qemuDomainStatsCacheIsFresh(driver,
+                                               priv->memStatsTimestamp) &&
+                   qemuDomainStatsCacheGetBalloon(priv, &balloon)) {
+            info->memory = balloon;
         } else if (qemuDomainJobAllowed(priv, QEMU_JOB_QUERY)) {
-            if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0)
-                goto cleanup;
-            if (!virDomainObjIsActive(vm))
-                err = 0;
-            else {
-                qemuDomainObjEnterMonitor(driver, vm);
-                err = qemuMonitorGetBalloonInfo(priv->mon, &balloon);
-                qemuDomainObjExitMonitor(driver, vm);
-            }
-            if (!qemuDomainObjEndJob(driver, vm)) {
-                vm = NULL;
+            if ((rc = qemuDomainObjBeginJobNowait(driver, vm,
+                                                  QEMU_JOB_QUERY)) < 0)
                 goto cleanup;
+            if (rc > 0) {
+                /* Another job holds the domain, don't queue behind it
+                 * just to refresh the balloon size */
+                err = -1;
+            } else {
+                if (!virDomainObjIsActive(vm))
+                    err = 0;
+                else {
+                    qemuDomainObjEnterMonitor(driver, vm);
+                    err = qemuMonitorGetBalloonInfo(priv->mon, &balloon);
+                    qemuDomainObjExitMonitor(driver, vm);
+                }
+                if (!qemuDomainObjEndJob(driver, vm)) {
+                    vm = NULL;
+                    goto cleanup;
+                }
             }
 
             if (err < 0) {
                 /* We couldn't get current memory allocation but that's not
-                 * a show stopper; we wouldn't get it if there was a job
-                 * active either
+                 * a show stopper; the last balloon size read from the
+                 * monitor is served instead, if there is one
                  */
-                info->memory = vm->def->mem.cur_balloon;
+                if (!qemuDomainStatsCacheGetBalloon(priv, &balloon))
+                    balloon = vm->def->mem.cur_balloon;
+                info->memory = balloon;
             } else if (err == 0) {
                 /* Balloon not supported, so maxmem is always the allocation */
                 info->memory = vm->def->mem.max_balloon;
@@ -2531,7 +2866,9 @@ static int qemuDomainGetInfo(virDomainPtr dom,
                 info->memory = balloon;
             }
         } else {
-            info->memory = vm->def->mem.cur_balloon;
+            if (!qemuDomainStatsCacheGetBalloon(priv, &balloon))
+                balloon = vm->def->mem.cur_balloon;
+            info->memory = balloon;
         }
     } else {
         info->memory = vm->def->mem.cur_balloon;
@@ -4882,6 +5219,8 @@ qemuDomainGetVcpus(virDomainPtr dom,
     int v, maxcpu, hostcpus;
     int ret = -1;
     qemuDomainObjPrivatePtr priv;
+    unsigned long long *cpuTimes = NULL;
+    int *lastCpus = NULL;
 
     if (!(vm = qemuDomObjFromDomain(dom)))
         goto cleanup;
@@ -4912,19 +5251,23 @@ qemuDomainGetVcpus(virDomainPtr dom,
     if (maxinfo >= 1) {
         if (info != NULL) {
             memset(info, 0, sizeof(*info) * maxinfo);
+            if (priv->vcpupids != NULL) {
+                if (VIR_ALLOC_N(cpuTimes, maxinfo) < 0 ||
+                    VIR_ALLOC_N(lastCpus, maxinfo) < 0)
+                    goto cleanup;
+
+                if (qemuDomainHelperGetVcpuTimes(vm, cpuTimes, lastCpus,
+                                                 maxinfo) < 0)
+                    goto cleanup;
+            }
+
             for (i = 0; i < maxinfo; i++) {
                 info[i].number = i;
                 info[i].state = VIR_VCPU_RUNNING;
 
-                if (priv->vcpupids != NULL &&
-                    qemuGetProcessInfo(&(info[i].cpuTime),
-                                       &(info[i].cpu),
-                                       NULL,
-                                       vm->pid,
-                                       priv->vcpupids[i]) < 0) {
-                    virReportSystemError(errno, "%s",
-                                         _("cannot get vCPU placement & pCPU time"));
-                    goto cleanup;
+                if (priv->vcpupids != NULL) {
+                    info[i].cpuTime = cpuTimes[i];
+                    info[i].cpu = lastCpus[i];
                 }
             }
         }
@@ -4961,6 +5304,8 @@ qemuDomainGetVcpus(virDomainPtr dom,
  cleanup:
     if (vm)
         virObjectUnlock(vm);
+    VIR_FREE(cpuTimes);
+    VIR_FREE(lastCpus);
     return ret;
 }
 
@@ -5759,6 +6104,9 @@ static char *qemuDomainGetXMLDesc(virDomainPtr dom,
     unsigned long long balloon;
     int err = 0;
     qemuDomainObjPrivatePtr priv;
+    unsigned int cacheFlags = flags;
+    const char *cached;
+    bool cacheable;
 
     /* Flags checked by virDomainDefFormat */
 
@@ -5798,17 +6146,64 @@ static char *qemuDomainGetXMLDesc(virDomainPtr dom,
             }
             if (err < 0)
                 goto cleanup;
-            if (err > 0)
+            if (err > 0 && vm->def->mem.cur_balloon != balloon) {
                 vm->def->mem.cur_balloon = balloon;
+                virDomainObjBumpGeneration(vm);
+            }
             /* err == 0 indicates no balloon support, so ignore it */
         }
     }
 
+    /* Definitions are modified either within a job, which bumps the
+     * generation when it ends, or by event handlers that bump it
+     * themselves.  So the cached XML is only up to date while no job
+     * is running. */
+    cacheable = (priv->job.active == QEMU_JOB_NONE &&
+                 priv->job.asyncJob == QEMU_ASYNC_JOB_NONE);
+
+    if (cacheable && (cached = virDomainObjGetCachedXML(vm, cacheFlags))) {
+        ignore_value(VIR_STRDUP(ret, cached));
+        goto cleanup;
+    }
+
     if ((flags & VIR_DOMAIN_XML_MIGRATABLE))
         flags |= QEMU_DOMAIN_FORMAT_LIVE_FLAGS;
 
     ret = qemuDomainFormatXML(driver, vm, flags);
 
+    if (ret && cacheable &&
+        virDomainObjSetCachedXML(vm, cacheFlags, ret) < 0)
+        VIR_FREE(ret);
+
+ cleanup:
+    if (vm)
+        virObjectUnlock(vm);
+    return ret;
+}
+
+
+static int
+qemuDomainGetXMLGeneration(virDomainPtr dom,
+                           unsigned long long *generation,
+                           unsigned int flags)
+{
+    virDomainObjPtr vm;
+    int ret = -1;
+
+    virCheckFlags(0, -1);
+
+    if (!(vm = qemuDomObjFromDomain(dom)))
+        goto cleanup;
+
+    if (virDomainGetXMLGenerationEnsureACL(dom->conn, vm->def) < 0)
+        goto cleanup;
+
+    /* Without balloon events the current memory size is only refreshed
+     * by qemuDomainGetXMLDesc, so a change in it shows up here only
+     * after the XML was fetched. */
+    *generation = vm->generation;
+    ret = 0;
+
  cleanup:
     if (vm)
         virObjectUnlock(vm);
@@ -9515,6 +9910,17 @@ qemuDomainBlockResize(virDomainPtr dom,
     return ret;
 }
 
+static void
+qemuDomainBlockStatsFill(struct _virDomainBlockStats *stats,
+                         qemuBlockStatsPtr src)
+{
+    stats->rd_req = src->rd_req;
+    stats->rd_bytes = src->rd_bytes;
+    stats->wr_req = src->wr_req;
+    stats->wr_bytes = src->wr_bytes;
+    stats->errs = src->errs;
+}
+
 /* This uses the 'info blockstats' monitor command which was
  * integrated into both qemu & kvm in late 2007.  If the command is
  * not supported we detect this and return the appropriate error.
@@ -9526,10 +9932,13 @@ qemuDomainBlockStats(virDomainPtr dom,
 {
     virQEMUDriverPtr driver = dom->conn->privateData;
     int idx;
+    int rc;
     int ret = -1;
     virDomainObjPtr vm;
     virDomainDiskDefPtr disk = NULL;
     qemuDomainObjPrivatePtr priv;
+    qemuBlockStatsPtr cached = NULL;
+    qemuBlockStats tmp;
 
     if (!*path) {
         virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
@@ -9543,9 +9952,27 @@ qemuDomainBlockStats(virDomainPtr dom,
     if (virDomainBlockStatsEnsureACL(dom->conn, vm->def) < 0)
         goto cleanup;
 
-    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0)
+    priv = vm->privateData;
+
+    if (virDomainObjIsActive(vm) &&
+        (idx = virDomainDiskIndexByName(vm->def, path, false)) >= 0)
+        cached = qemuDomainStatsCacheGetBlock(priv,
+                                              vm->def->disks[idx]->info.alias);
+
+    /* A recent enough sample doesn't need a trip to the monitor */
+    if (cached && qemuDomainStatsCacheIsFresh(driver, cached->timestamp))
+        rc = 1;
+    else if ((rc = qemuDomainObjBeginQueryJob(driver, vm, !!cached)) < 0)
         goto cleanup;
 
+    if (rc > 0) {
+        VIR_DEBUG("returning block stats of %s of domain %s "
+                  "sampled at %llu", path, vm->def->name, cached->timestamp);
+        qemuDomainBlockStatsFill(stats, cached);
+        ret = 0;
+        goto cleanup;
+    }
+
     if (!virDomainObjIsActive(vm)) {
         virReportError(VIR_ERR_OPERATION_INVALID,
                        "%s", _("domain is not running"));
@@ -9565,22 +9992,27 @@ qemuDomainBlockStats(virDomainPtr dom,
         goto endjob;
     }
 
-    priv = vm->privateData;
-
     qemuDomainObjEnterMonitor(driver, vm);
-    ret = qemuMonitorGetBlockStatsInfo(priv->mon,
-                                       disk->info.alias,
-                                       &stats->rd_req,
-                                       &stats->rd_bytes,
-                                       NULL,
-                                       &stats->wr_req,
-                                       &stats->wr_bytes,
-                                       NULL,
-                                       NULL,
-                                       NULL,
-                                       &stats->errs);
+    rc = qemuMonitorGetBlockStatsInfo(priv->mon,
+                                      disk->info.alias,
+                                      &tmp.rd_req,
+                                      &tmp.rd_bytes,
+                                      &tmp.rd_total_times,
+                                      &tmp.wr_req,
+                                      &tmp.wr_bytes,
+                                      &tmp.wr_total_times,
+                                      &tmp.flush_req,
+                                      &tmp.flush_total_times,
+                                      &tmp.errs);
     qemuDomainObjExitMonitor(driver, vm);
 
+    if (rc < 0)
+        goto endjob;
+
+    ignore_value(qemuDomainStatsCacheSetBlock(priv, disk->info.alias, &tmp));
+    qemuDomainBlockStatsFill(stats, &tmp);
+    ret = 0;
+
  endjob:
     if (!qemuDomainObjEndJob(driver, vm))
         vm = NULL;
@@ -9592,41 +10024,159 @@ qemuDomainBlockStats(virDomainPtr dom,
 }
 
 static int
-qemuDomainBlockStatsFlags(virDomainPtr dom,
-                          const char *path,
-                          virTypedParameterPtr params,
-                          int *nparams,
-                          unsigned int flags)
+qemuDomainBlockStatsToParams(qemuBlockStatsPtr stats,
+                             virTypedParameterPtr params,
+                             int *nparams)
 {
-    virQEMUDriverPtr driver = dom->conn->privateData;
-    int idx;
-    int tmp, ret = -1;
-    virDomainObjPtr vm;
-    virDomainDiskDefPtr disk = NULL;
-    qemuDomainObjPrivatePtr priv;
-    long long rd_req, rd_bytes, wr_req, wr_bytes, rd_total_times;
-    long long wr_total_times, flush_req, flush_total_times, errs;
     virTypedParameterPtr param;
+    int tmp = 0;
 
-    virCheckFlags(VIR_TYPED_PARAM_STRING_OKAY, -1);
+    if (tmp < *nparams && stats->wr_bytes != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_WRITE_BYTES,
+                                    VIR_TYPED_PARAM_LLONG, stats->wr_bytes) < 0)
+            return -1;
+        tmp++;
+    }
 
-    if (!*path) {
-        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
-                       _("summary statistics are not supported yet"));
-        return ret;
+    if (tmp < *nparams && stats->wr_req != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_WRITE_REQ,
+                                    VIR_TYPED_PARAM_LLONG, stats->wr_req) < 0)
+            return -1;
+        tmp++;
     }
 
-    /* We don't return strings, and thus trivially support this flag.  */
-    flags &= ~VIR_TYPED_PARAM_STRING_OKAY;
+    if (tmp < *nparams && stats->rd_bytes != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_READ_BYTES,
+                                    VIR_TYPED_PARAM_LLONG, stats->rd_bytes) < 0)
+            return -1;
+        tmp++;
+    }
 
-    if (!(vm = qemuDomObjFromDomain(dom)))
-        goto cleanup;
+    if (tmp < *nparams && stats->rd_req != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_READ_REQ,
+                                    VIR_TYPED_PARAM_LLONG, stats->rd_req) < 0)
+            return -1;
+        tmp++;
+    }
+
+    if (tmp < *nparams && stats->flush_req != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_FLUSH_REQ,
+                                    VIR_TYPED_PARAM_LLONG,
+                                    stats->flush_req) < 0)
+            return -1;
+        tmp++;
+    }
+
+    if (tmp < *nparams && stats->wr_total_times != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param,
+                                    VIR_DOMAIN_BLOCK_STATS_WRITE_TOTAL_TIMES,
+                                    VIR_TYPED_PARAM_LLONG,
+                                    stats->wr_total_times) < 0)
+            return -1;
+        tmp++;
+    }
+
+    if (tmp < *nparams && stats->rd_total_times != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param,
+                                    VIR_DOMAIN_BLOCK_STATS_READ_TOTAL_TIMES,
+                                    VIR_TYPED_PARAM_LLONG,
+                                    stats->rd_total_times) < 0)
+            return -1;
+        tmp++;
+    }
+
+    if (tmp < *nparams && stats->flush_total_times != -1) {
+        param = &params[tmp];
+        if (virTypedParameterAssign(param,
+                                    VIR_DOMAIN_BLOCK_STATS_FLUSH_TOTAL_TIMES,
+                                    VIR_TYPED_PARAM_LLONG,
+                                    stats->flush_total_times) < 0)
+            return -1;
+        tmp++;
+    }
+
+    /* Field 'errs' is meaningless for QEMU, won't set it. */
+
+    *nparams = tmp;
+    return 0;
+}
+
+static int
+qemuDomainBlockStatsFlags(virDomainPtr dom,
+                          const char *path,
+                          virTypedParameterPtr params,
+                          int *nparams,
+                          unsigned int flags)
+{
+    virQEMUDriverPtr driver = dom->conn->privateData;
+    int idx;
+    int tmp, rc, ret = -1;
+    virDomainObjPtr vm;
+    virDomainDiskDefPtr disk = NULL;
+    qemuDomainObjPrivatePtr priv;
+    qemuBlockStatsPtr cached = NULL;
+    qemuBlockStats stats;
+    bool haveCache = false;
+
+    virCheckFlags(VIR_TYPED_PARAM_STRING_OKAY, -1);
+
+    if (!*path) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("summary statistics are not supported yet"));
+        return ret;
+    }
+
+    /* We don't return strings, and thus trivially support this flag.  */
+    flags &= ~VIR_TYPED_PARAM_STRING_OKAY;
+
+    if (!(vm = qemuDomObjFromDomain(dom)))
+        goto cleanup;
 
     if (virDomainBlockStatsFlagsEnsureACL(dom->conn, vm->def) < 0)
         goto cleanup;
 
-    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0)
+    priv = vm->privateData;
+
+    if (virDomainObjIsActive(vm) && priv->nblockStatsParams > 0) {
+        if (*nparams == 0) {
+            haveCache = true;
+        } else if ((idx = virDomainDiskIndexByName(vm->def, path,
+                                                   false)) >= 0) {
+            disk = vm->def->disks[idx];
+            cached = qemuDomainStatsCacheGetBlock(priv, disk->info.alias);
+            haveCache = !!cached;
+        }
+    }
+
+    /* The number of parameters never changes while the domain runs and
+     * a recent enough sample doesn't need a trip to the monitor */
+    if (haveCache &&
+        (*nparams == 0 ||
+         qemuDomainStatsCacheIsFresh(driver, cached->timestamp)))
+        rc = 1;
+    else if ((rc = qemuDomainObjBeginQueryJob(driver, vm, haveCache)) < 0)
+        goto cleanup;
+
+    if (rc > 0) {
+        VIR_DEBUG("returning cached block stats of %s of domain %s",
+                  path, vm->def->name);
+        if (*nparams == 0) {
+            *nparams = priv->nblockStatsParams;
+            ret = 0;
+        } else {
+            if (*nparams > priv->nblockStatsParams)
+                *nparams = priv->nblockStatsParams;
+            ret = qemuDomainBlockStatsToParams(cached, params, nparams);
+        }
         goto cleanup;
+    }
 
     if (!virDomainObjIsActive(vm)) {
         virReportError(VIR_ERR_OPERATION_INVALID,
@@ -9650,13 +10200,15 @@ qemuDomainBlockStatsFlags(virDomainPtr dom,
         }
     }
 
-    priv = vm->privateData;
     VIR_DEBUG("priv=%p, params=%p, flags=%x", priv, params, flags);
 
     qemuDomainObjEnterMonitor(driver, vm);
     tmp = *nparams;
     ret = qemuMonitorGetBlockStatsParamsNumber(priv->mon, nparams);
 
+    if (ret == 0)
+        priv->nblockStatsParams = *nparams;
+
     if (tmp == 0 || ret < 0) {
         qemuDomainObjExitMonitor(driver, vm);
         goto endjob;
@@ -9664,114 +10216,81 @@ qemuDomainBlockStatsFlags(virDomainPtr dom,
 
     ret = qemuMonitorGetBlockStatsInfo(priv->mon,
                                        disk->info.alias,
-                                       &rd_req,
-                                       &rd_bytes,
-                                       &rd_total_times,
-                                       &wr_req,
-                                       &wr_bytes,
-                                       &wr_total_times,
-                                       &flush_req,
-                                       &flush_total_times,
-                                       &errs);
+                                       &stats.rd_req,
+                                       &stats.rd_bytes,
+                                       &stats.rd_total_times,
+                                       &stats.wr_req,
+                                       &stats.wr_bytes,
+                                       &stats.wr_total_times,
+                                       &stats.flush_req,
+                                       &stats.flush_total_times,
+                                       &stats.errs);
 
     qemuDomainObjExitMonitor(driver, vm);
 
     if (ret < 0)
         goto endjob;
 
-    tmp = 0;
-    ret = -1;
+    ignore_value(qemuDomainStatsCacheSetBlock(priv, disk->info.alias, &stats));
 
-    if (tmp < *nparams && wr_bytes != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_WRITE_BYTES,
-                                    VIR_TYPED_PARAM_LLONG, wr_bytes) < 0)
-            goto endjob;
-        tmp++;
-    }
+    ret = qemuDomainBlockStatsToParams(&stats, params, nparams);
 
-    if (tmp < *nparams && wr_req != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_WRITE_REQ,
-                                    VIR_TYPED_PARAM_LLONG, wr_req) < 0)
-            goto endjob;
-        tmp++;
-    }
+ endjob:
+    if (!qemuDomainObjEndJob(driver, vm))
+        vm = NULL;
 
-    if (tmp < *nparams && rd_bytes != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_READ_BYTES,
-                                    VIR_TYPED_PARAM_LLONG, rd_bytes) < 0)
-            goto endjob;
-        tmp++;
-    }
+ cleanup:
+    if (vm)
+        virObjectUnlock(vm);
+    return ret;
+}
 
-    if (tmp < *nparams && rd_req != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_READ_REQ,
-                                    VIR_TYPED_PARAM_LLONG, rd_req) < 0)
-            goto endjob;
-        tmp++;
-    }
+#ifdef __linux__
+/* Reads the counters of all host interfaces in one go and returns those
+ * of @path. The counters of @vm's other interfaces are cached as well,
+ * for callers going through all of them. */
+static int
+qemuDomainInterfaceStatsFromHost(virDomainObjPtr vm,
+                                 const char *path,
+                                 struct _virDomainInterfaceStats *stats)
+{
+    virHashTablePtr table;
+    virDomainInterfaceStatsPtr found;
+    size_t i;
+    int ret = -1;
 
-    if (tmp < *nparams && flush_req != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param, VIR_DOMAIN_BLOCK_STATS_FLUSH_REQ,
-                                    VIR_TYPED_PARAM_LLONG, flush_req) < 0)
-            goto endjob;
-        tmp++;
-    }
+    if (!(table = linuxDomainInterfaceStatsAll()))
+        return -1;
 
-    if (tmp < *nparams && wr_total_times != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param,
-                                    VIR_DOMAIN_BLOCK_STATS_WRITE_TOTAL_TIMES,
-                                    VIR_TYPED_PARAM_LLONG, wr_total_times) < 0)
-            goto endjob;
-        tmp++;
+    if (!(found = virHashLookup(table, path))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("interface '%s' not found"), path);
+        goto cleanup;
     }
+    memcpy(stats, found, sizeof(*stats));
 
-    if (tmp < *nparams && rd_total_times != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param,
-                                    VIR_DOMAIN_BLOCK_STATS_READ_TOTAL_TIMES,
-                                    VIR_TYPED_PARAM_LLONG, rd_total_times) < 0)
-            goto endjob;
-        tmp++;
-    }
+    for (i = 0; i < vm->def->nnets; i++) {
+        const char *ifname = vm->def->nets[i]->ifname;
 
-    if (tmp < *nparams && flush_total_times != -1) {
-        param = &params[tmp];
-        if (virTypedParameterAssign(param,
-                                    VIR_DOMAIN_BLOCK_STATS_FLUSH_TOTAL_TIMES,
-                                    VIR_TYPED_PARAM_LLONG,
-                                    flush_total_times) < 0)
-            goto endjob;
-        tmp++;
+        if (ifname && (found = virHashLookup(table, ifname)))
+            ignore_value(qemuDomainStatsCacheSetInterface(vm->privateData,
+                                                          ifname, found));
     }
 
-    /* Field 'errs' is meaningless for QEMU, won't set it. */
-
     ret = 0;
-    *nparams = tmp;
-
- endjob:
-    if (!qemuDomainObjEndJob(driver, vm))
-        vm = NULL;
-
  cleanup:
-    if (vm)
-        virObjectUnlock(vm);
+    virHashFree(table);
     return ret;
 }
 
-#ifdef __linux__
 static int
 qemuDomainInterfaceStats(virDomainPtr dom,
                          const char *path,
                          struct _virDomainInterfaceStats *stats)
 {
+    virQEMUDriverPtr driver = dom->conn->privateData;
     virDomainObjPtr vm;
+    qemuInterfaceStatsPtr cached;
     size_t i;
     int ret = -1;
 
@@ -9796,9 +10315,13 @@ qemuDomainInterfaceStats(virDomainPtr dom,
         }
     }
 
-    if (ret == 0)
-        ret = linuxDomainInterfaceStats(path, stats);
-    else
+    if (ret == 0) {
+        cached = qemuDomainStatsCacheGetInterface(vm->privateData, path);
+        if (cached && qemuDomainStatsCacheIsFresh(driver, cached->timestamp))
+            memcpy(stats, &cached->stats, sizeof(*stats));
+        else
+            ret = qemuDomainInterfaceStatsFromHost(vm, path, stats);
+    } else
         virReportError(VIR_ERR_INVALID_ARG,
                        _("invalid path, '%s' is not a known interface"), path);
 
@@ -10122,6 +10645,9 @@ qemuDomainMemoryStats(virDomainPtr dom,
 {
     virQEMUDriverPtr driver = dom->conn->privateData;
     virDomainObjPtr vm;
+    qemuDomainObjPrivatePtr priv;
+    unsigned long long timestamp = 0;
+    int rc;
     int ret = -1;
 
     virCheckFlags(0, -1);
@@ -10132,32 +10658,58 @@ qemuDomainMemoryStats(virDomainPtr dom,
     if (virDomainMemoryStatsEnsureACL(dom->conn, vm->def) < 0)
         goto cleanup;
 
-    if (qemuDomainObjBeginJob(driver, vm, QEMU_JOB_QUERY) < 0)
-        goto cleanup;
+    priv = vm->privateData;
 
-    if (!virDomainObjIsActive(vm)) {
+    if (virDomainObjIsActive(vm) &&
+        qemuDomainStatsCacheIsFresh(driver, priv->memStatsTimestamp))
+        rc = 1;
+    else if ((rc = qemuDomainObjBeginQueryJob(driver, vm,
+                                              virDomainObjIsActive(vm) &&
+                                              priv->memStatsTimestamp)) < 0)
+        goto cleanup;
+
+    if (rc > 0) {
+        /* Either the last sample is recent enough or another job holds
+         * the domain, return what we saw last time */
+        ret = MIN(priv->nmemStats, nr_stats);
+        memcpy(stats, priv->memStats, sizeof(*stats) * ret);
+        timestamp = priv->memStatsTimestamp;
+    } else if (!virDomainObjIsActive(vm)) {
         virReportError(VIR_ERR_OPERATION_INVALID,
                        "%s", _("domain is not running"));
+        goto endjob;
     } else {
-        qemuDomainObjPrivatePtr priv = vm->privateData;
         qemuDomainObjEnterMonitor(driver, vm);
         ret = qemuMonitorGetMemoryStats(priv->mon, stats, nr_stats);
         qemuDomainObjExitMonitor(driver, vm);
 
-        if (ret >= 0 && ret < nr_stats) {
-            long rss;
-            if (qemuGetProcessInfo(NULL, NULL, &rss, vm->pid, 0) < 0) {
-                virReportError(VIR_ERR_OPERATION_FAILED, "%s",
-                               _("cannot get RSS for domain"));
-            } else {
-                stats[ret].tag = VIR_DOMAIN_MEMORY_STAT_RSS;
-                stats[ret].val = rss;
-                ret++;
-            }
+        if (ret >= 0)
+            ignore_value(qemuDomainStatsCacheSetMemory(priv, stats, ret));
+        timestamp = priv->memStatsTimestamp;
+    }
 
+    if (ret >= 0 && ret < nr_stats) {
+        long rss;
+        if (qemuGetProcessInfo(NULL, NULL, &rss, vm->pid, 0) < 0) {
+            virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                           _("cannot get RSS for domain"));
+        } else {
+            stats[ret].tag = VIR_DOMAIN_MEMORY_STAT_RSS;
+            stats[ret].val = rss;
+            ret++;
         }
     }
 
+    if (ret >= 0 && ret < nr_stats && timestamp) {
+        stats[ret].tag = VIR_DOMAIN_MEMORY_STAT_LAST_UPDATE;
+        stats[ret].val = timestamp / 1000;
+        ret++;
+    }
+
+    if (rc > 0)
+        goto cleanup;
+
+ endjob:
     if (!qemuDomainObjEndJob(driver, vm))
         vm = NULL;
 
@@ -11617,6 +12169,28 @@ static int qemuDomainGetJobInfo(virDomainPtr dom,
 }
 
 
+static int
+qemuDomainGetStartPhaseParams(qemuDomainObjPrivatePtr priv,
+                              virTypedParameterPtr *par,
+                              int *npar,
+                              int *maxpar)
+{
+    char field[VIR_TYPED_PARAM_FIELD_LENGTH];
+    size_t i;
+
+    for (i = 0; i < priv->nstartPhases; i++) {
+        snprintf(field, sizeof(field), "%s%s",
+                 VIR_DOMAIN_JOB_START_PHASE_PREFIX,
+                 qemuDomainStartPhaseTypeToString(i));
+        if (virTypedParamsAddULLong(par, npar, maxpar, field,
+                                    priv->startPhases[i]) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
 static int
 qemuDomainGetJobStats(virDomainPtr dom,
                       int *type,
@@ -11631,7 +12205,7 @@ qemuDomainGetJobStats(virDomainPtr dom,
     int npar = 0;
     int ret = -1;
 
-    virCheckFlags(0, -1);
+    virCheckFlags(VIR_DOMAIN_JOB_STATS_START_PHASES, -1);
 
     if (!(vm = qemuDomObjFromDomain(dom)))
         goto cleanup;
@@ -11647,10 +12221,14 @@ qemuDomainGetJobStats(virDomainPtr dom,
         goto cleanup;
     }
 
+    if (flags & VIR_DOMAIN_JOB_STATS_START_PHASES &&
+        qemuDomainGetStartPhaseParams(priv, &par, &npar, &maxpar) < 0)
+        goto cleanup;
+
     if (!priv->job.asyncJob || priv->job.dump_memory_only) {
         *type = VIR_DOMAIN_JOB_NONE;
-        *params = NULL;
-        *nparams = 0;
+        *params = par;
+        *nparams = npar;
         ret = 0;
         goto cleanup;
     }
@@ -13308,6 +13886,37 @@ qemuDomainSnapshotCreateActiveExternal(virConnectPtr conn,
 }
 
 
+/* Saves the metadata of the just created @snap and links it into the
+ * snapshot tree of @vm. On failure, @snap is forgotten. */
+static int
+qemuDomainSnapshotCommitMetadata(virDomainObjPtr vm,
+                                 virDomainSnapshotObjPtr snap,
+                                 virQEMUDriverConfigPtr cfg,
+                                 bool update_current)
+{
+    virDomainSnapshotObjPtr other;
+
+    if (qemuDomainSnapshotWriteMetadata(vm, snap, cfg->snapshotDir) < 0) {
+        /* if writing of metadata fails, error out rather than trying
+         * to silently carry on  without completing the snapshot */
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unable to save metadata for snapshot %s"),
+                       snap->def->name);
+        virDomainSnapshotObjListRemove(vm->snapshots, snap);
+        return -1;
+    }
+
+    if (update_current)
+        vm->current_snapshot = snap;
+    other = virDomainSnapshotFindByName(vm->snapshots, snap->def->parent);
+    snap->parent = other;
+    other->nchildren++;
+    snap->sibling = other->first_child;
+    other->first_child = snap;
+    return 0;
+}
+
+
 static virDomainSnapshotPtr
 qemuDomainSnapshotCreateXML(virDomainPtr domain,
                             const char *xmlDesc,
@@ -13323,7 +13932,6 @@ qemuDomainSnapshotCreateXML(virDomainPtr domain,
     bool update_current = true;
     bool redefine = flags & VIR_DOMAIN_SNAPSHOT_CREATE_REDEFINE;
     unsigned int parse_flags = VIR_DOMAIN_SNAPSHOT_PARSE_DISKS;
-    virDomainSnapshotObjPtr other = NULL;
     int align_location = VIR_DOMAIN_SNAPSHOT_LOCATION_INTERNAL;
     int align_match = true;
     virQEMUDriverConfigPtr cfg = NULL;
@@ -13530,25 +14138,10 @@ qemuDomainSnapshotCreateXML(virDomainPtr domain,
  cleanup:
     if (vm) {
         if (snapshot && !(flags & VIR_DOMAIN_SNAPSHOT_CREATE_NO_METADATA)) {
-            if (qemuDomainSnapshotWriteMetadata(vm, snap,
-                                                cfg->snapshotDir) < 0) {
-                /* if writing of metadata fails, error out rather than trying
-                 * to silently carry on  without completing the snapshot */
+            if (qemuDomainSnapshotCommitMetadata(vm, snap, cfg,
+                                                 update_current) < 0) {
                 virDomainSnapshotFree(snapshot);
                 snapshot = NULL;
-                virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("unable to save metadata for snapshot %s"),
-                               snap->def->name);
-                virDomainSnapshotObjListRemove(vm->snapshots, snap);
-            } else {
-                if (update_current)
-                    vm->current_snapshot = snap;
-                other = virDomainSnapshotFindByName(vm->snapshots,
-                                                    snap->def->parent);
-                snap->parent = other;
-                other->nchildren++;
-                snap->sibling = other->first_child;
-                other->first_child = snap;
             }
         } else if (snap) {
             virDomainSnapshotObjListRemove(vm->snapshots, snap);
@@ -13562,6 +14155,630 @@ qemuDomainSnapshotCreateXML(virDomainPtr domain,
     return snapshot;
 }
 
+/* How long a group member waits for its guest to freeze, in seconds */
+#define QEMU_DOMAIN_SNAPSHOT_GROUP_FREEZE_TIMEOUT 60
+
+/* How many group members take their snapshot at the same time */
+#define QEMU_DOMAIN_SNAPSHOT_GROUP_MAX_WORKERS 8
+
+
+int
+qemuDomainSnapshotGroupInit(qemuDomainSnapshotGroupPtr group,
+                            virQEMUDriverPtr driver,
+                            size_t nmembers)
+{
+    size_t i;
+
+    memset(group, 0, sizeof(*group));
+
+    if (virMutexInit(&group->lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize mutex"));
+        return -1;
+    }
+    if (virCondInit(&group->cond) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize condition variable"));
+        virMutexDestroy(&group->lock);
+        return -1;
+    }
+    if (VIR_ALLOC_N(group->members, nmembers) < 0) {
+        ignore_value(virCondDestroy(&group->cond));
+        virMutexDestroy(&group->lock);
+        return -1;
+    }
+
+    group->driver = driver;
+    group->nmembers = nmembers;
+    for (i = 0; i < nmembers; i++) {
+        group->members[i].group = group;
+        group->members[i].ret = -1;
+    }
+    return 0;
+}
+
+
+void
+qemuDomainSnapshotGroupClear(qemuDomainSnapshotGroupPtr group)
+{
+    size_t i;
+
+    if (!group->members)
+        return;
+
+    for (i = 0; i < group->nmembers; i++)
+        virFreeError(group->members[i].err);
+    VIR_FREE(group->members);
+    group->nmembers = 0;
+    ignore_value(virCondDestroy(&group->cond));
+    virMutexDestroy(&group->lock);
+}
+
+
+/* Parses the snapshot definition of a group member and starts the
+ * snapshot job on its locked @vm, which is unlocked on return. Only
+ * what can be checked without touching the guest is done here, so
+ * that a bad member fails the group before any guest is frozen. */
+static int
+qemuDomainSnapshotGroupPrepare(virQEMUDriverPtr driver,
+                               virCapsPtr caps,
+                               virQEMUDriverConfigPtr cfg,
+                               qemuDomainSnapshotGroupMemberPtr member,
+                               virDomainObjPtr vm,
+                               const char *xmlDesc,
+                               unsigned int flags)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virDomainSnapshotDefPtr def = NULL;
+    virDomainSnapshotObjPtr snap = NULL;
+    bool update_current = !(flags & VIR_DOMAIN_SNAPSHOT_CREATE_NO_METADATA);
+    unsigned int parse_flags = VIR_DOMAIN_SNAPSHOT_PARSE_DISKS |
+                               VIR_DOMAIN_SNAPSHOT_PARSE_OFFLINE;
+    char *xml = NULL;
+    int ret = -1;
+
+    if (qemuDomainObjBeginAsyncJob(driver, vm, QEMU_ASYNC_JOB_SNAPSHOT) < 0)
+        goto cleanup;
+
+    if (!virDomainObjIsActive(vm)) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("domain '%s' is not running"), vm->def->name);
+        goto endjob;
+    }
+    if (qemuProcessAutoDestroyActive(driver, vm)) {
+        virReportError(VIR_ERR_OPERATION_INVALID,
+                       _("domain '%s' is marked for auto destroy"),
+                       vm->def->name);
+        goto endjob;
+    }
+    if (virDomainHasDiskMirror(vm)) {
+        virReportError(VIR_ERR_BLOCK_COPY_ACTIVE,
+                       _("domain '%s' has active block job"), vm->def->name);
+        goto endjob;
+    }
+
+    /* Without a transaction the guest would have to be paused to
+     * snapshot all its disks at the same point in time */
+    if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_TRANSACTION)) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED,
+                       _("QEMU binary of domain '%s' does not support "
+                         "transactions needed for group snapshots"),
+                       vm->def->name);
+        goto endjob;
+    }
+
+    if (flags & VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE) {
+        if (priv->quiesced) {
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("domain '%s' is already quiesced"),
+                           vm->def->name);
+            goto endjob;
+        }
+        if (!qemuDomainAgentAvailable(priv, true))
+            goto endjob;
+    }
+
+    if (!(def = virDomainSnapshotDefParseString(xmlDesc, caps, driver->xmlopt,
+                                                QEMU_EXPECTED_VIRT_TYPES,
+                                                parse_flags)))
+        goto endjob;
+
+    if (update_current &&
+        (strchr(def->name, '/') || def->name[0] == '.')) {
+        virReportError(VIR_ERR_XML_DETAIL,
+                       _("invalid snapshot name '%s': name can't contain "
+                         "'/' or start with '.'"),
+                       def->name);
+        goto endjob;
+    }
+
+    if (!(xml = qemuDomainDefFormatLive(driver, vm->def, true, true)) ||
+        !(def->dom = virDomainDefParseString(xml, caps, driver->xmlopt,
+                                             QEMU_EXPECTED_VIRT_TYPES,
+                                             VIR_DOMAIN_XML_INACTIVE)))
+        goto endjob;
+
+    def->state = VIR_DOMAIN_DISK_SNAPSHOT;
+    def->memory = VIR_DOMAIN_SNAPSHOT_LOCATION_NONE;
+    member->flags = flags;
+    if (virDomainSnapshotAlignDisks(def, VIR_DOMAIN_SNAPSHOT_LOCATION_EXTERNAL,
+                                    false) < 0 ||
+        qemuDomainSnapshotPrepare(member->domain->conn, vm, def,
+                                  &member->flags) < 0)
+        goto endjob;
+
+    if (!(snap = virDomainSnapshotAssignDef(vm->snapshots, def)))
+        goto endjob;
+    def = NULL;
+
+    if (update_current)
+        snap->def->current = true;
+    if (vm->current_snapshot) {
+        if (VIR_STRDUP(snap->def->parent,
+                       vm->current_snapshot->def->name) < 0)
+            goto endjob;
+        if (update_current) {
+            vm->current_snapshot->def->current = false;
+            if (qemuDomainSnapshotWriteMetadata(vm, vm->current_snapshot,
+                                                cfg->snapshotDir) < 0)
+                goto endjob;
+            vm->current_snapshot = NULL;
+        }
+    }
+
+    member->vm = vm;
+    member->snap = snap;
+    ret = 0;
+
+    /* The job is carried on by the thread of the member */
+    qemuDomainObjReleaseAsyncJob(vm);
+
+ endjob:
+    if (ret < 0) {
+        if (snap)
+            virDomainSnapshotObjListRemove(vm->snapshots, snap);
+        if (!qemuDomainObjEndAsyncJob(driver, vm))
+            vm = NULL;
+    }
+
+ cleanup:
+    if (vm)
+        virObjectUnlock(vm);
+    virDomainSnapshotDefFree(def);
+    VIR_FREE(xml);
+    return ret;
+}
+
+
+/* Records the result of the freeze of a group member, which fails
+ * the group unless the guest froze. Runs from the event loop, so it
+ * can't take the domain lock. */
+static void
+qemuDomainSnapshotGroupFrozen(qemuAgentPtr agent ATTRIBUTE_UNUSED,
+                              int ret,
+                              virErrorPtr err,
+                              void *opaque)
+{
+    qemuDomainSnapshotGroupMemberPtr member = opaque;
+    qemuDomainSnapshotGroupPtr group = member->group;
+
+    virMutexLock(&group->lock);
+    member->freeze = ret;
+    member->freezeDone = true;
+    group->nfreezing--;
+    if (ret < 0) {
+        if (err) {
+            virSetError(err);
+            member->err = virSaveLastError();
+            virResetLastError();
+        }
+        group->failed = true;
+    }
+    virCondBroadcast(&group->cond);
+    virMutexUnlock(&group->lock);
+}
+
+
+/* Queues the freeze of the guest of @member through its locked @agent,
+ * with @seconds for the guest to answer. Returns 0 if the freeze was
+ * queued, its result is then recorded once the reply comes back. */
+int
+qemuDomainSnapshotGroupQueueFreeze(qemuAgentPtr agent,
+                                   qemuDomainSnapshotGroupMemberPtr member,
+                                   int seconds)
+{
+    qemuDomainSnapshotGroupPtr group = member->group;
+    int ret;
+
+    /* The reply may come before the command returns */
+    virMutexLock(&group->lock);
+    member->freezeQueued = true;
+    group->nfreezing++;
+    virMutexUnlock(&group->lock);
+
+    if ((ret = qemuAgentFSFreezeAsync(agent, NULL, 0, seconds,
+                                      qemuDomainSnapshotGroupFrozen,
+                                      member)) < 0) {
+        virMutexLock(&group->lock);
+        member->freezeQueued = false;
+        group->nfreezing--;
+        virMutexUnlock(&group->lock);
+    }
+
+    return ret;
+}
+
+
+/* Fails the group because of @member, with the last reported error */
+void
+qemuDomainSnapshotGroupFail(qemuDomainSnapshotGroupMemberPtr member)
+{
+    qemuDomainSnapshotGroupPtr group = member->group;
+
+    virMutexLock(&group->lock);
+    if (!member->err && virGetLastError())
+        member->err = virSaveLastError();
+    group->failed = true;
+    virMutexUnlock(&group->lock);
+}
+
+
+/* Waits until every freeze queued for the group got its reply, even
+ * if the group failed already, since the replies refer to members.
+ * Returns true if all members can take their snapshot. */
+bool
+qemuDomainSnapshotGroupWaitFrozen(qemuDomainSnapshotGroupPtr group)
+{
+    bool ret;
+
+    virMutexLock(&group->lock);
+    while (group->nfreezing > 0) {
+        if (virCondWait(&group->cond, &group->lock) < 0) {
+            virReportSystemError(errno, "%s",
+                                 _("Unable to wait on group snapshot "
+                                   "condition"));
+            group->failed = true;
+            break;
+        }
+    }
+    ret = !group->failed;
+    virMutexUnlock(&group->lock);
+
+    return ret;
+}
+
+
+/* Returns 1 if the guest of @member is frozen, -1 if it might be, as
+ * its freeze failed or timed out, and 0 if it was never asked to
+ * freeze. Only valid once qemuDomainSnapshotGroupWaitFrozen returned. */
+int
+qemuDomainSnapshotGroupThawMode(qemuDomainSnapshotGroupMemberPtr member)
+{
+    if (!member->freezeQueued)
+        return 0;
+    return member->freeze < 0 ? -1 : 1;
+}
+
+
+/* Like qemuDomainSnapshotFSFreeze, except that the freeze is only
+ * queued, with a bounded time to finish. Returns 0 if it was queued,
+ * -1 otherwise. */
+static int
+qemuDomainSnapshotGroupFreeze(virQEMUDriverPtr driver,
+                              virDomainObjPtr vm,
+                              qemuDomainSnapshotGroupMemberPtr member)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    virQEMUDriverConfigPtr cfg;
+    int timeout = QEMU_DOMAIN_SNAPSHOT_GROUP_FREEZE_TIMEOUT;
+    int ret = -1;
+
+    if (priv->quiesced) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("domain is already quiesced"));
+        return -1;
+    }
+
+    if (!qemuDomainAgentAvailable(priv, true))
+        return -1;
+
+    priv->quiesced = true;
+
+    cfg = virQEMUDriverGetConfig(driver);
+    if (virDomainSaveStatus(driver->xmlopt, cfg->stateDir, vm) < 0)
+        goto cleanup;
+
+    qemuDomainObjEnterAgent(vm);
+    ret = qemuDomainSnapshotGroupQueueFreeze(priv->agent, member, timeout);
+    qemuDomainObjExitAgent(vm);
+
+ cleanup:
+    if (ret < 0) {
+        /* Nothing was sent to the guest */
+        priv->quiesced = false;
+        ignore_value(virDomainSaveStatus(driver->xmlopt, cfg->stateDir, vm));
+    }
+    virObjectUnref(cfg);
+    return ret;
+}
+
+
+/* Takes the snapshot of one group member, unless the group failed, and
+ * thaws its guest right after, rather than when the whole group is
+ * done. Runs in the worker pool of the group. */
+static void
+qemuDomainSnapshotGroupWorker(void *jobdata,
+                              void *opaque ATTRIBUTE_UNUSED)
+{
+    qemuDomainSnapshotGroupMemberPtr member = jobdata;
+    qemuDomainSnapshotGroupPtr group = member->group;
+    virQEMUDriverPtr driver = group->driver;
+    virDomainObjPtr vm = member->vm;
+    int thaw = qemuDomainSnapshotGroupThawMode(member);
+    bool ready;
+
+    virMutexLock(&group->lock);
+    ready = !group->failed;
+    virMutexUnlock(&group->lock);
+
+    virObjectLock(vm);
+
+    /* Take over the job from the thread which started it */
+    qemuDomainObjSetJobPhase(driver, vm, 0);
+
+    if (ready &&
+        qemuDomainSnapshotCreateDiskActive(driver, vm, member->snap,
+                                           member->flags,
+                                           QEMU_ASYNC_JOB_SNAPSHOT) == 0)
+        member->ret = 0;
+
+    if (thaw != 0 &&
+        qemuDomainSnapshotFSThaw(driver, vm, thaw > 0) < 0 &&
+        thaw > 0)
+        member->ret = -1;
+
+    /* Members that gave up because of another one have no error,
+     * and a failed freeze already recorded its own */
+    if (member->ret < 0 && !member->err && virGetLastError())
+        member->err = virSaveLastError();
+
+    qemuDomainObjReleaseAsyncJob(vm);
+    virObjectUnlock(vm);
+
+    virMutexLock(&group->lock);
+    group->nrunning--;
+    virCondBroadcast(&group->cond);
+    virMutexUnlock(&group->lock);
+}
+
+
+/* Ends the snapshot job of a group member and saves the metadata
+ * of its snapshot, if it was taken. Returns the new snapshot. */
+static virDomainSnapshotPtr
+qemuDomainSnapshotGroupFinish(virQEMUDriverPtr driver,
+                              virQEMUDriverConfigPtr cfg,
+                              qemuDomainSnapshotGroupMemberPtr member)
+{
+    virDomainObjPtr vm = member->vm;
+    virDomainSnapshotObjPtr snap = member->snap;
+    virDomainSnapshotPtr snapshot = NULL;
+
+    member->vm = NULL;
+    member->snap = NULL;
+
+    virObjectLock(vm);
+
+    if (!qemuDomainObjEndAsyncJob(driver, vm)) {
+        /* Only possible if a transient vm quit while our locks were down,
+         * in which case we don't want to save snapshot metadata.
+         */
+        virReportError(VIR_ERR_OPERATION_FAILED,
+                       _("domain '%s' quit while taking the snapshot"),
+                       member->domain->name);
+        return NULL;
+    }
+
+    if (member->ret == 0)
+        snapshot = virGetDomainSnapshot(member->domain, snap->def->name);
+
+    if (snapshot && !(member->flags & VIR_DOMAIN_SNAPSHOT_CREATE_NO_METADATA)) {
+        if (qemuDomainSnapshotCommitMetadata(vm, snap, cfg, true) < 0) {
+            virDomainSnapshotFree(snapshot);
+            snapshot = NULL;
+        }
+    } else {
+        virDomainSnapshotObjListRemove(vm->snapshots, snap);
+    }
+
+    virObjectUnlock(vm);
+    return snapshot;
+}
+
+
+static int
+qemuDomainSnapshotCreateGroup(virConnectPtr conn,
+                              virDomainPtr *domains,
+                              const char **xmlDescs,
+                              unsigned int ndomains,
+                              virDomainSnapshotPtr **snapshots,
+                              unsigned int flags)
+{
+    virQEMUDriverPtr driver = conn->privateData;
+    qemuDomainSnapshotGroup group;
+    virDomainSnapshotPtr *snaps = NULL;
+    virDomainObjPtr vm;
+    virQEMUDriverConfigPtr cfg = NULL;
+    virCapsPtr caps = NULL;
+    virErrorPtr orig_err = NULL;
+    virThreadPoolPtr pool = NULL;
+    int ret = -1;
+    int rc;
+    size_t i, j;
+
+    virCheckFlags(VIR_DOMAIN_SNAPSHOT_CREATE_NO_METADATA |
+                  VIR_DOMAIN_SNAPSHOT_CREATE_DISK_ONLY |
+                  VIR_DOMAIN_SNAPSHOT_CREATE_REUSE_EXT |
+                  VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE |
+                  VIR_DOMAIN_SNAPSHOT_CREATE_ATOMIC, -1);
+
+    memset(&group, 0, sizeof(group));
+
+    for (i = 0; i < ndomains; i++) {
+        for (j = 0; j < i; j++) {
+            if (memcmp(domains[i]->uuid, domains[j]->uuid,
+                       VIR_UUID_BUFLEN) == 0) {
+                virReportError(VIR_ERR_INVALID_ARG,
+                               _("domain '%s' is listed more than once"),
+                               domains[i]->name);
+                return -1;
+            }
+        }
+    }
+
+    if (qemuDomainSnapshotGroupInit(&group, driver, ndomains) < 0 ||
+        VIR_ALLOC_N(snaps, ndomains + 1) < 0)
+        goto cleanup;
+
+    cfg = virQEMUDriverGetConfig(driver);
+    if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
+        goto cleanup;
+
+    /* Check and start the job of every member before any guest
+     * is frozen, the freeze must not wait on anything but the
+     * guest agents */
+    for (i = 0; i < ndomains; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+
+        member->domain = domains[i];
+
+        if (!(vm = qemuDomObjFromDomain(domains[i])))
+            goto cleanup;
+
+        if (virDomainSnapshotCreateGroupEnsureACL(conn, vm->def, flags) < 0) {
+            virObjectUnlock(vm);
+            goto cleanup;
+        }
+
+        if (qemuDomainSnapshotGroupPrepare(driver, caps, cfg, member, vm,
+                                           xmlDescs[i], flags) < 0)
+            goto cleanup;
+    }
+
+    /* Queue the freezes of all guests at once, so that the whole group
+     * waits for the slowest guest rather than for the sum of them */
+    for (i = 0; i < ndomains; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+
+        if (!(member->flags & VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE))
+            continue;
+
+        vm = member->vm;
+        virObjectLock(vm);
+        qemuDomainObjSetJobPhase(driver, vm, 0);
+        rc = qemuDomainSnapshotGroupFreeze(driver, vm, member);
+        if (rc < 0)
+            qemuDomainSnapshotGroupFail(member);
+        qemuDomainObjReleaseAsyncJob(vm);
+        virObjectUnlock(vm);
+
+        if (rc < 0)
+            break;
+    }
+
+    /* Every guest frozen so far must get its reply before the group
+     * goes on, whether it failed or not, so that it can be thawed */
+    ignore_value(qemuDomainSnapshotGroupWaitFrozen(&group));
+
+    /* Each member is snapshotted and thawed by a pool worker, or by
+     * this thread if the pool can't take it */
+    pool = virThreadPoolNew(0, MIN(ndomains,
+                                   QEMU_DOMAIN_SNAPSHOT_GROUP_MAX_WORKERS),
+                            0, qemuDomainSnapshotGroupWorker, NULL);
+    for (i = 0; i < ndomains; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+
+        virMutexLock(&group.lock);
+        group.nrunning++;
+        virMutexUnlock(&group.lock);
+
+        if (!pool || virThreadPoolSendJob(pool, 0, member) < 0) {
+            if (!member->err && virGetLastError())
+                member->err = virSaveLastError();
+            virMutexLock(&group.lock);
+            group.failed = true;
+            virMutexUnlock(&group.lock);
+            qemuDomainSnapshotGroupWorker(member, NULL);
+        }
+    }
+
+    virMutexLock(&group.lock);
+    while (group.nrunning > 0) {
+        if (virCondWait(&group.cond, &group.lock) < 0) {
+            /* Freeing the pool below waits for the running jobs */
+            virReportSystemError(errno, "%s",
+                                 _("Unable to wait on group snapshot "
+                                   "condition"));
+            break;
+        }
+    }
+    virMutexUnlock(&group.lock);
+    virThreadPoolFree(pool);
+
+    ret = 0;
+    for (i = 0; i < ndomains; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+
+        if (!(snaps[i] = qemuDomainSnapshotGroupFinish(driver, cfg, member))) {
+            if (!member->err && virGetLastError())
+                member->err = virSaveLastError();
+            ret = -1;
+        }
+    }
+
+    if (ret == 0) {
+        *snapshots = snaps;
+        snaps = NULL;
+    }
+
+ cleanup:
+    orig_err = virSaveLastError();
+    for (i = 0; i < group.nmembers; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+
+        /* members that were prepared but never got to run */
+        if (member->vm)
+            ignore_value(qemuDomainSnapshotGroupFinish(driver, cfg, member));
+    }
+
+    if (ret < 0) {
+        /* Report what made the first member fail, the others
+         * may only have given up because of it */
+        for (i = 0; i < group.nmembers; i++) {
+            if (group.members[i].err &&
+                group.members[i].err->code != VIR_ERR_OK)
+                break;
+        }
+        if (i < group.nmembers)
+            virSetError(group.members[i].err);
+        else if (orig_err)
+            virSetError(orig_err);
+    }
+    virFreeError(orig_err);
+
+    qemuDomainSnapshotGroupClear(&group);
+    if (snaps) {
+        for (i = 0; i < ndomains; i++) {
+            if (snaps[i])
+                virDomainSnapshotFree(snaps[i]);
+        }
+        VIR_FREE(snaps);
+    }
+    virObjectUnref(caps);
+    virObjectUnref(cfg);
+    return ret;
+}
+
+
 static int qemuDomainSnapshotListNames(virDomainPtr domain, char **names,
                                        int nameslen,
                                        unsigned int flags)
@@ -16341,7 +17558,7 @@ qemuConnectListAllDomains(virConnectPtr conn,
         goto cleanup;
 
     ret = virDomainObjListExport(driver->domains, conn, domains,
-                                 virConnectListAllDomainsCheckACL, flags);
+                                 virConnectListAllDomainsCheckACLBulk, flags);
 
  cleanup:
     return ret;
@@ -17155,6 +18372,8 @@ static virDriver qemuDriver = {
     .domainSetTime = qemuDomainSetTime, /* 1.2.5 */
     .nodeGetFreePages = qemuNodeGetFreePages, /* 1.2.6 */
     .connectGetDomainCapabilities = qemuConnectGetDomainCapabilities, /* 1.2.7 */
+    .domainGetXMLGeneration = qemuDomainGetXMLGeneration, /* 1.2.8 */
+    .domainSnapshotCreateGroup = qemuDomainSnapshotCreateGroup, /* 1.2.8 */
 };
 
 
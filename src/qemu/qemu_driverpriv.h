@@ -0,0 +1,77 @@
+/*
+ * qemu_driverpriv.h: private declarations for the QEMU driver
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __QEMU_DRIVERPRIV_H__
+# define __QEMU_DRIVERPRIV_H__
+
+# include "domain_conf.h"
+# include "qemu_agent.h"
+# include "qemu_conf.h"
+
+/*
+ * This header file should never be used outside unit tests.
+ */
+
+typedef struct _qemuDomainSnapshotGroup qemuDomainSnapshotGroup;
+typedef qemuDomainSnapshotGroup *qemuDomainSnapshotGroupPtr;
+
+typedef struct _qemuDomainSnapshotGroupMember qemuDomainSnapshotGroupMember;
+typedef qemuDomainSnapshotGroupMember *qemuDomainSnapshotGroupMemberPtr;
+struct _qemuDomainSnapshotGroupMember {
+    qemuDomainSnapshotGroupPtr group;
+    virDomainPtr domain;
+    virDomainObjPtr vm;         /* set while the snapshot job runs */
+    virDomainSnapshotObjPtr snap;
+    unsigned int flags;         /* as adjusted by qemuDomainSnapshotPrepare */
+
+    bool freezeQueued;          /* guest-fsfreeze was sent to the agent */
+    bool freezeDone;            /* ... and its reply came back */
+    int freeze;                 /* its result, as of qemuAgentFSFreeze */
+    int ret;
+    virErrorPtr err;
+};
+
+struct _qemuDomainSnapshotGroup {
+    virQEMUDriverPtr driver;
+
+    virMutex lock;
+    virCond cond;
+    size_t nfreezing;           /* freezes still waiting for their reply */
+    size_t nrunning;            /* snapshot jobs not finished yet */
+    bool failed;                /* a member can't take its snapshot */
+
+    qemuDomainSnapshotGroupMemberPtr members;
+    size_t nmembers;
+};
+
+int qemuDomainSnapshotGroupInit(qemuDomainSnapshotGroupPtr group,
+                                virQEMUDriverPtr driver,
+                                size_t nmembers);
+void qemuDomainSnapshotGroupClear(qemuDomainSnapshotGroupPtr group);
+
+int qemuDomainSnapshotGroupQueueFreeze(qemuAgentPtr agent,
+                                       qemuDomainSnapshotGroupMemberPtr member,
+                                       int seconds);
+void qemuDomainSnapshotGroupFail(qemuDomainSnapshotGroupMemberPtr member);
+bool qemuDomainSnapshotGroupWaitFrozen(qemuDomainSnapshotGroupPtr group);
+int qemuDomainSnapshotGroupThawMode(qemuDomainSnapshotGroupMemberPtr member);
+
+#endif /* __QEMU_DRIVERPRIV_H__ */
@@ -68,8 +68,9 @@ struct _qemuMonitor {
     qemuMonitorCallbacksPtr cb;
     void *callbackOpaque;
 
-    /* If there's a command being processed this will be
-     * non-NULL */
+    /* If there are commands being processed this points to the
+     * oldest one. Any others follow it through msg->next and are
+     * answered in the order they were sent. */
     qemuMonitorMessagePtr msg;
 
     /* Buffer incoming data ready for Text/QMP monitor
@@ -368,6 +369,52 @@ qemuMonitorGetErrorFromLog(qemuMonitorPtr mon)
 }
 
 
+/* Returns the first queued message which is not fully written yet */
+static qemuMonitorMessagePtr
+qemuMonitorTxMessage(qemuMonitorPtr mon)
+{
+    qemuMonitorMessagePtr msg;
+
+    for (msg = mon->msg; msg; msg = msg->next) {
+        if (msg->txOffset < msg->txLength)
+            return msg;
+    }
+
+    return NULL;
+}
+
+
+/* Returns the oldest message still waiting for its reply, if it has
+ * been completely written already */
+static qemuMonitorMessagePtr
+qemuMonitorRxMessage(qemuMonitorPtr mon)
+{
+    qemuMonitorMessagePtr msg = mon->msg;
+
+    while (msg && msg->finished)
+        msg = msg->next;
+
+    if (msg && msg->txOffset < msg->txLength)
+        return NULL;
+
+    return msg;
+}
+
+
+/* Wakes up everyone waiting for a reply, used when the monitor
+ * cannot deliver any more replies */
+static void
+qemuMonitorFinishMessages(qemuMonitorPtr mon)
+{
+    qemuMonitorMessagePtr msg;
+
+    for (msg = mon->msg; msg; msg = msg->next)
+        msg->finished = 1;
+
+    virCondSignal(&mon->notify);
+}
+
+
 /* This method processes data that has been received
  * from the monitor. Looking for async events and
  * replies/errors.
@@ -380,8 +427,7 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
 
     /* See if there's a message & whether its ready for its reply
      * ie whether its completed writing all its data */
-    if (mon->msg && mon->msg->txOffset == mon->msg->txLength)
-        msg = mon->msg;
+    msg = qemuMonitorRxMessage(mon);
 
 #if DEBUG_IO
 # if DEBUG_RAW_IO
@@ -423,7 +469,8 @@ qemuMonitorIOProcess(qemuMonitorPtr mon)
 #if DEBUG_IO
     VIR_DEBUG("Process done %d used %d", (int)mon->bufferOffset, len);
 #endif
-    if (msg && msg->finished)
+    /* Any of the queued messages may have got its reply */
+    if (msg && len)
         virCondBroadcast(&mon->notify);
     return len;
 }
@@ -473,54 +520,63 @@ qemuMonitorIOWriteWithFD(qemuMonitorPtr mon,
 /*
  * Called when the monitor is able to write data
  * Call this function while holding the monitor lock.
+ *
+ * Queued messages are written back to back until the
+ * socket would block.
  */
 static int
 qemuMonitorIOWrite(qemuMonitorPtr mon)
 {
+    qemuMonitorMessagePtr msg;
+    int total = 0;
     int done;
 
-    /* If no active message, or fully transmitted, the no-op */
-    if (!mon->msg || mon->msg->txOffset == mon->msg->txLength)
-        return 0;
-
-    if (mon->msg->txFD != -1 && !mon->hasSendFD) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Monitor does not support sending of file descriptors"));
-        return -1;
-    }
-
-    if (mon->msg->txFD == -1)
-        done = write(mon->fd,
-                     mon->msg->txBuffer + mon->msg->txOffset,
-                     mon->msg->txLength - mon->msg->txOffset);
-    else
-        done = qemuMonitorIOWriteWithFD(mon,
-                                        mon->msg->txBuffer + mon->msg->txOffset,
-                                        mon->msg->txLength - mon->msg->txOffset,
-                                        mon->msg->txFD);
-
-    PROBE(QEMU_MONITOR_IO_WRITE,
-          "mon=%p buf=%s len=%d ret=%d errno=%d",
-          mon,
-          mon->msg->txBuffer + mon->msg->txOffset,
-          mon->msg->txLength - mon->msg->txOffset,
-          done, errno);
+    while ((msg = qemuMonitorTxMessage(mon))) {
+        if (msg->txFD != -1 && !mon->hasSendFD) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Monitor does not support sending of file descriptors"));
+            return -1;
+        }
 
-    if (mon->msg->txFD != -1)
-        PROBE(QEMU_MONITOR_IO_SEND_FD,
-              "mon=%p fd=%d ret=%d errno=%d",
-              mon, mon->msg->txFD, done, errno);
+        if (msg->txFD == -1)
+            done = write(mon->fd,
+                         msg->txBuffer + msg->txOffset,
+                         msg->txLength - msg->txOffset);
+        else
+            done = qemuMonitorIOWriteWithFD(mon,
+                                            msg->txBuffer + msg->txOffset,
+                                            msg->txLength - msg->txOffset,
+                                            msg->txFD);
+
+        PROBE(QEMU_MONITOR_IO_WRITE,
+              "mon=%p buf=%s len=%d ret=%d errno=%d",
+              mon,
+              msg->txBuffer + msg->txOffset,
+              msg->txLength - msg->txOffset,
+              done, errno);
+
+        if (msg->txFD != -1)
+            PROBE(QEMU_MONITOR_IO_SEND_FD,
+                  "mon=%p fd=%d ret=%d errno=%d",
+                  mon, msg->txFD, done, errno);
+
+        if (done < 0) {
+            if (errno == EAGAIN)
+                return total;
 
-    if (done < 0) {
-        if (errno == EAGAIN)
-            return 0;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to write to monitor"));
+            return -1;
+        }
+        msg->txOffset += done;
+        total += done;
 
-        virReportSystemError(errno, "%s",
-                             _("Unable to write to monitor"));
-        return -1;
+        /* Short write, wait until the socket is writable again */
+        if (msg->txOffset < msg->txLength)
+            break;
     }
-    mon->msg->txOffset += done;
-    return done;
+
+    return total;
 }
 
 /*
@@ -587,8 +643,7 @@ static void qemuMonitorUpdateWatch(qemuMonitorPtr mon)
     if (mon->lastError.code == VIR_ERR_OK) {
         events |= VIR_EVENT_HANDLE_READABLE;
 
-        if ((mon->msg && mon->msg->txOffset < mon->msg->txLength) &&
-            !mon->waitGreeting)
+        if (qemuMonitorTxMessage(mon) && !mon->waitGreeting)
             events |= VIR_EVENT_HANDLE_WRITABLE;
     }
 
@@ -712,12 +767,10 @@ qemuMonitorIO(int watch, int fd, int events, void *opaque)
         }
 
         VIR_DEBUG("Error on monitor %s", NULLSTR(mon->lastError.message));
-        /* If IO process resulted in an error & we have a message,
-         * then wakeup that waiter */
-        if (mon->msg && !mon->msg->finished) {
-            mon->msg->finished = 1;
-            virCondSignal(&mon->notify);
-        }
+        /* If IO process resulted in an error & we have messages,
+         * then wakeup their waiter */
+        if (mon->msg)
+            qemuMonitorFinishMessages(mon);
     }
 
     qemuMonitorUpdateWatch(mon);
@@ -924,8 +977,7 @@ void qemuMonitorClose(qemuMonitorPtr mon)
                 virResetLastError();
             }
         }
-        mon->msg->finished = 1;
-        virCondSignal(&mon->notify);
+        qemuMonitorFinishMessages(mon);
     }
 
     /* Propagate existing monitor error in case the current thread has no
@@ -950,8 +1002,35 @@ char *qemuMonitorNextCommandID(qemuMonitorPtr mon)
 
 int qemuMonitorSend(qemuMonitorPtr mon,
                     qemuMonitorMessagePtr msg)
+{
+    return qemuMonitorSendMessages(mon, &msg, 1);
+}
+
+
+/**
+ * qemuMonitorSendMessages:
+ * @mon: monitor object
+ * @msgs: messages to send
+ * @nmsgs: number of messages in @msgs
+ *
+ * Writes all @msgs to the monitor without waiting for a reply in
+ * between and then waits until every one of them is answered. The
+ * JSON monitor matches each reply to its message by the QMP "id".
+ * The text monitor cannot tell its replies apart reliably, so it
+ * still gets one message at a time.
+ *
+ * Returns 0 on success, -1 if any message could not be completed.
+ * Replies that did arrive are left in the messages either way.
+ */
+int qemuMonitorSendMessages(qemuMonitorPtr mon,
+                            qemuMonitorMessagePtr *msgs,
+                            size_t nmsgs)
 {
     int ret = -1;
+    size_t i;
+
+    if (!nmsgs)
+        return 0;
 
     /* Check whether qemu quit unexpectedly */
     if (mon->lastError.code != VIR_ERR_OK) {
@@ -961,18 +1040,32 @@ int qemuMonitorSend(qemuMonitorPtr mon,
         return -1;
     }
 
-    mon->msg = msg;
-    qemuMonitorUpdateWatch(mon);
+    if (!mon->json && nmsgs > 1) {
+        for (i = 0; i < nmsgs; i++) {
+            if (qemuMonitorSendMessages(mon, &msgs[i], 1) < 0)
+                return -1;
+        }
+        return 0;
+    }
 
-    PROBE(QEMU_MONITOR_SEND_MSG,
-          "mon=%p msg=%s fd=%d",
-          mon, mon->msg->txBuffer, mon->msg->txFD);
+    for (i = 0; i < nmsgs; i++) {
+        msgs[i]->next = i + 1 < nmsgs ? msgs[i + 1] : NULL;
 
-    while (!mon->msg->finished) {
-        if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("Unable to wait on monitor condition"));
-            goto cleanup;
+        PROBE(QEMU_MONITOR_SEND_MSG,
+              "mon=%p msg=%s fd=%d",
+              mon, msgs[i]->txBuffer, msgs[i]->txFD);
+    }
+
+    mon->msg = msgs[0];
+    qemuMonitorUpdateWatch(mon);
+
+    for (i = 0; i < nmsgs; i++) {
+        while (!msgs[i]->finished) {
+            if (virCondWait(&mon->notify, &mon->parent.lock) < 0) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("Unable to wait on monitor condition"));
+                goto cleanup;
+            }
         }
     }
 
@@ -1776,6 +1869,86 @@ int qemuMonitorGetBlockStatsParamsNumber(qemuMonitorPtr mon,
     return ret;
 }
 
+/**
+ * qemuMonitorGetDomainStats:
+ * @mon: monitor object
+ * @ndevs: number of disks in @devs
+ * @devs: aliases of the disks to get statistics for, may contain NULL
+ * @blockstats: filled with the statistics of each disk in @devs
+ * @blockrc: set to 0 for each disk whose statistics were read, -1 if not
+ * @nblockparams: if not NULL, set to the number of block statistics
+ * @memstats: filled with the memory statistics
+ * @nr_memstats: number of elements in @memstats
+ * @nmemstats: set to the number of memory statistics returned
+ *
+ * Collects what qemuMonitorGetBlockStatsInfo,
+ * qemuMonitorGetBlockStatsParamsNumber and qemuMonitorGetMemoryStats
+ * would return, with a single round trip on the JSON monitor. Failing
+ * to get one kind of statistics does not affect the others, those
+ * that could not be read are marked by -1.
+ *
+ * Returns 0 on success, -1 if talking to the monitor failed.
+ */
+int qemuMonitorGetDomainStats(qemuMonitorPtr mon,
+                              size_t ndevs,
+                              const char *const *devs,
+                              qemuBlockStatsPtr blockstats,
+                              int *blockrc,
+                              int *nblockparams,
+                              virDomainMemoryStatPtr memstats,
+                              unsigned int nr_memstats,
+                              int *nmemstats)
+{
+    size_t i;
+    VIR_DEBUG("mon=%p ndevs=%zu nblockparams=%p nr_memstats=%u",
+              mon, ndevs, nblockparams, nr_memstats);
+
+    if (!mon) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("monitor must not be NULL"));
+        return -1;
+    }
+
+    if (mon->json) {
+        ignore_value(qemuMonitorFindBalloonObjectPath(mon, mon->vm, "/"));
+        mon->ballooninit = true;
+        return qemuMonitorJSONGetDomainStats(mon, mon->balloonpath,
+                                             ndevs, devs,
+                                             blockstats, blockrc,
+                                             nblockparams,
+                                             memstats, nr_memstats,
+                                             nmemstats);
+    }
+
+    for (i = 0; i < ndevs; i++) {
+        qemuBlockStatsPtr stats = &blockstats[i];
+
+        if (!devs[i]) {
+            blockrc[i] = -1;
+            continue;
+        }
+
+        blockrc[i] = qemuMonitorTextGetBlockStatsInfo(mon, devs[i],
+                                                      &stats->rd_req,
+                                                      &stats->rd_bytes,
+                                                      &stats->rd_total_times,
+                                                      &stats->wr_req,
+                                                      &stats->wr_bytes,
+                                                      &stats->wr_total_times,
+                                                      &stats->flush_req,
+                                                      &stats->flush_total_times,
+                                                      &stats->errs);
+    }
+
+    if (nblockparams &&
+        qemuMonitorTextGetBlockStatsParamsNumber(mon, nblockparams) < 0)
+        *nblockparams = -1;
+
+    *nmemstats = qemuMonitorTextGetMemoryStats(mon, memstats, nr_memstats);
+
+    return 0;
+}
+
 int qemuMonitorGetBlockExtent(qemuMonitorPtr mon,
                               const char *dev_name,
                               unsigned long long *extent)
@@ -2909,6 +3082,59 @@ int qemuMonitorGetPtyPaths(qemuMonitorPtr mon,
 }
 
 
+/**
+ * qemuMonitorGetStartupInfo:
+ * @mon: monitor object
+ * @paths: hash table to fill with pty paths of character devices
+ * @pids: filled with thread ids of vCPUs
+ * @npids: filled with the number of @pids, or -1 if unknown
+ * @aliases: filled with aliases of devices known to QEMU, may be NULL
+ *
+ * Runs the queries needed once a new QEMU process is up, at the same
+ * time if the monitor allows it. Failing to find the vCPU threads is
+ * not an error as some QEMU versions are unable to tell.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+qemuMonitorGetStartupInfo(qemuMonitorPtr mon,
+                          virHashTablePtr paths,
+                          int **pids,
+                          int *npids,
+                          char ***aliases)
+{
+    VIR_DEBUG("mon=%p paths=%p aliases=%p", mon, paths, aliases);
+
+    if (!mon) {
+        virReportError(VIR_ERR_INVALID_ARG, "%s",
+                       _("monitor must not be NULL"));
+        return -1;
+    }
+
+    if (mon->json)
+        return qemuMonitorJSONGetStartupInfo(mon, paths, pids, npids, aliases);
+
+    if (aliases) {
+        virReportError(VIR_ERR_OPERATION_UNSUPPORTED, "%s",
+                       _("JSON monitor is required"));
+        return -1;
+    }
+
+    *pids = NULL;
+    *npids = -1;
+
+    if (qemuMonitorTextGetPtyPaths(mon, paths) < 0)
+        return -1;
+
+    if ((*npids = qemuMonitorTextGetCPUInfo(mon, pids)) < 0) {
+        virResetLastError();
+        *npids = -1;
+    }
+
+    return 0;
+}
+
+
 int qemuMonitorAttachPCIDiskController(qemuMonitorPtr mon,
                                        const char *bus,
                                        virDevicePCIAddress *guestAddr)
@@ -58,6 +58,8 @@ struct _qemuMonitorMessage {
     int rxLength;
     /* Used by the JSON monitor to hold reply / error */
     void *rxObject;
+    /* Used by the JSON monitor to match the reply to the message */
+    char *id;
 
     /* True if rxBuffer / rxObject are ready, or a
      * fatal error occurred on the monitor channel
@@ -66,6 +68,10 @@ struct _qemuMonitorMessage {
 
     qemuMonitorPasswordHandler passwordHandler;
     void *passwordOpaque;
+
+    /* Message sent right after this one, without waiting for
+     * this one's reply */
+    qemuMonitorMessagePtr next;
 };
 
 
@@ -226,6 +232,9 @@ int qemuMonitorSetLink(qemuMonitorPtr mon,
 char *qemuMonitorNextCommandID(qemuMonitorPtr mon);
 int qemuMonitorSend(qemuMonitorPtr mon,
                     qemuMonitorMessagePtr msg);
+int qemuMonitorSendMessages(qemuMonitorPtr mon,
+                            qemuMonitorMessagePtr *msgs,
+                            size_t nmsgs);
 virJSONValuePtr qemuMonitorGetOptions(qemuMonitorPtr mon)
     ATTRIBUTE_NONNULL(1);
 void qemuMonitorSetOptions(qemuMonitorPtr mon, virJSONValuePtr options)
@@ -335,6 +344,21 @@ struct qemuDomainDiskInfo *
 qemuMonitorBlockInfoLookup(virHashTablePtr blockInfo,
                            const char *devname);
 
+typedef struct _qemuBlockStats qemuBlockStats;
+typedef qemuBlockStats *qemuBlockStatsPtr;
+struct _qemuBlockStats {
+    long long rd_req;
+    long long rd_bytes;
+    long long rd_total_times;
+    long long wr_req;
+    long long wr_bytes;
+    long long wr_total_times;
+    long long flush_req;
+    long long flush_total_times;
+    long long errs;
+    unsigned long long timestamp;   /* when the values were sampled (ms) */
+};
+
 int qemuMonitorGetBlockStatsInfo(qemuMonitorPtr mon,
                                  const char *dev_name,
                                  long long *rd_req,
@@ -348,6 +372,15 @@ int qemuMonitorGetBlockStatsInfo(qemuMonitorPtr mon,
                                  long long *errs);
 int qemuMonitorGetBlockStatsParamsNumber(qemuMonitorPtr mon,
                                          int *nparams);
+int qemuMonitorGetDomainStats(qemuMonitorPtr mon,
+                              size_t ndevs,
+                              const char *const *devs,
+                              qemuBlockStatsPtr blockstats,
+                              int *blockrc,
+                              int *nblockparams,
+                              virDomainMemoryStatPtr memstats,
+                              unsigned int nr_memstats,
+                              int *nmemstats);
 
 int qemuMonitorGetBlockExtent(qemuMonitorPtr mon,
                               const char *dev_name,
@@ -591,6 +624,11 @@ int qemuMonitorRemoveNetdev(qemuMonitorPtr mon,
 
 int qemuMonitorGetPtyPaths(qemuMonitorPtr mon,
                            virHashTablePtr paths);
+int qemuMonitorGetStartupInfo(qemuMonitorPtr mon,
+                              virHashTablePtr paths,
+                              int **pids,
+                              int *npids,
+                              char ***aliases);
 
 int qemuMonitorAttachPCIDiskController(qemuMonitorPtr mon,
                                        const char *bus,
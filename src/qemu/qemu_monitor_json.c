@@ -168,6 +168,39 @@ qemuMonitorJSONIOProcessEvent(qemuMonitorPtr mon,
     return 0;
 }
 
+/*
+ * Finds the message among those queued from @msg on that @reply
+ * answers. QEMU copies the "id" of a command into its reply, except
+ * when it could not parse the command at all. Replies without an id,
+ * or with one we never sent, are given to the oldest message waiting
+ * for a reply since QEMU answers in order anyway.
+ */
+static qemuMonitorMessagePtr
+qemuMonitorJSONFindMessage(qemuMonitorMessagePtr msg,
+                           virJSONValuePtr reply)
+{
+    const char *id = virJSONValueObjectGetString(reply, "id");
+    qemuMonitorMessagePtr oldest = NULL;
+
+    for (; msg; msg = msg->next) {
+        if (msg->finished)
+            continue;
+        /* No reply can arrive before the command was fully sent */
+        if (msg->txOffset < msg->txLength)
+            break;
+        if (!oldest)
+            oldest = msg;
+        if (!id || STREQ_NULLABLE(msg->id, id))
+            return msg;
+    }
+
+    if (oldest)
+        VIR_DEBUG("No message with id '%s', using '%s'",
+                  NULLSTR(id), NULLSTR(oldest->id));
+    return oldest;
+}
+
+
 static int
 qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
                              const char *line,
@@ -197,7 +230,7 @@ qemuMonitorJSONIOProcessLine(qemuMonitorPtr mon,
                virJSONValueObjectHasKey(obj, "return") == 1) {
         PROBE(QEMU_MONITOR_RECV_REPLY,
               "mon=%p reply=%s", mon, line);
-        if (msg) {
+        if ((msg = qemuMonitorJSONFindMessage(msg, obj))) {
             msg->rxObject = obj;
             msg->finished = 1;
             obj = NULL;
@@ -249,27 +282,24 @@ int qemuMonitorJSONIOProcess(qemuMonitorPtr mon,
     return used;
 }
 
+/* Fills in @msg to send @cmd tagged with a fresh command id */
 static int
-qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
-                             virJSONValuePtr cmd,
-                             int scm_fd,
-                             virJSONValuePtr *reply)
+qemuMonitorJSONPrepareMessage(qemuMonitorPtr mon,
+                              virJSONValuePtr cmd,
+                              int scm_fd,
+                              qemuMonitorMessagePtr msg)
 {
     int ret = -1;
-    qemuMonitorMessage msg;
     char *cmdstr = NULL;
-    char *id = NULL;
     virJSONValuePtr exe;
 
-    *reply = NULL;
-
-    memset(&msg, 0, sizeof(msg));
+    memset(msg, 0, sizeof(*msg));
 
     exe = virJSONValueObjectGet(cmd, "execute");
     if (exe) {
-        if (!(id = qemuMonitorNextCommandID(mon)))
+        if (!(msg->id = qemuMonitorNextCommandID(mon)))
             goto cleanup;
-        if (virJSONValueObjectAppendString(cmd, "id", id) < 0) {
+        if (virJSONValueObjectAppendString(cmd, "id", msg->id) < 0) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                            _("Unable to append command 'id' string"));
             goto cleanup;
@@ -278,13 +308,35 @@ qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
 
     if (!(cmdstr = virJSONValueToString(cmd, false)))
         goto cleanup;
-    if (virAsprintf(&msg.txBuffer, "%s\r\n", cmdstr) < 0)
+    if (virAsprintf(&msg->txBuffer, "%s\r\n", cmdstr) < 0)
         goto cleanup;
-    msg.txLength = strlen(msg.txBuffer);
-    msg.txFD = scm_fd;
+    msg->txLength = strlen(msg->txBuffer);
+    msg->txFD = scm_fd;
 
     VIR_DEBUG("Send command '%s' for write with FD %d", cmdstr, scm_fd);
 
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(cmdstr);
+    return ret;
+}
+
+
+static int
+qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
+                             virJSONValuePtr cmd,
+                             int scm_fd,
+                             virJSONValuePtr *reply)
+{
+    int ret = -1;
+    qemuMonitorMessage msg;
+
+    *reply = NULL;
+
+    if (qemuMonitorJSONPrepareMessage(mon, cmd, scm_fd, &msg) < 0)
+        goto cleanup;
+
     ret = qemuMonitorSend(mon, &msg);
 
     VIR_DEBUG("Receive command reply ret=%d rxObject=%p",
@@ -302,10 +354,66 @@ qemuMonitorJSONCommandWithFd(qemuMonitorPtr mon,
     }
 
  cleanup:
-    VIR_FREE(id);
-    VIR_FREE(cmdstr);
     VIR_FREE(msg.txBuffer);
+    VIR_FREE(msg.id);
+
+    return ret;
+}
+
+
+/*
+ * Sends all @ncmds commands in @cmds at once and stores their
+ * replies in @replies. Either all replies are returned or none.
+ */
+static int
+qemuMonitorJSONCommands(qemuMonitorPtr mon,
+                        virJSONValuePtr *cmds,
+                        size_t ncmds,
+                        virJSONValuePtr *replies)
+{
+    int ret = -1;
+    qemuMonitorMessagePtr msgs = NULL;
+    qemuMonitorMessagePtr *queue = NULL;
+    size_t i;
+
+    memset(replies, 0, sizeof(*replies) * ncmds);
+
+    if (VIR_ALLOC_N(msgs, ncmds) < 0 ||
+        VIR_ALLOC_N(queue, ncmds) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ncmds; i++) {
+        if (qemuMonitorJSONPrepareMessage(mon, cmds[i], -1, &msgs[i]) < 0)
+            goto cleanup;
+        queue[i] = &msgs[i];
+    }
+
+    if (qemuMonitorSendMessages(mon, queue, ncmds) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ncmds; i++) {
+        if (!msgs[i].rxObject) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Missing monitor reply object"));
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < ncmds; i++) {
+        replies[i] = msgs[i].rxObject;
+        msgs[i].rxObject = NULL;
+    }
+
+    ret = 0;
 
+ cleanup:
+    for (i = 0; msgs && i < ncmds; i++) {
+        VIR_FREE(msgs[i].txBuffer);
+        VIR_FREE(msgs[i].id);
+        virJSONValueFree(msgs[i].rxObject);
+    }
+    VIR_FREE(msgs);
+    VIR_FREE(queue);
     return ret;
 }
 
@@ -1401,6 +1509,44 @@ int qemuMonitorJSONGetVirtType(qemuMonitorPtr mon,
 }
 
 
+/* Parses the reply to query-balloon. Returns 1 and sets @currmem if
+ * the balloon is active, 0 if it is not and -1 on error */
+static int
+qemuMonitorJSONExtractBalloonInfo(virJSONValuePtr cmd,
+                                  virJSONValuePtr reply,
+                                  unsigned long long *currmem)
+{
+    virJSONValuePtr data;
+    unsigned long long mem;
+
+    *currmem = 0;
+
+    /* See if balloon soft-failed */
+    if (qemuMonitorJSONHasError(reply, "DeviceNotActive") ||
+        qemuMonitorJSONHasError(reply, "KVMMissingCap"))
+        return 0;
+
+    /* See if any other fatal error occurred */
+    if (qemuMonitorJSONCheckError(cmd, reply) < 0)
+        return -1;
+
+    if (!(data = virJSONValueObjectGet(reply, "return"))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("info balloon reply was missing return data"));
+        return -1;
+    }
+
+    if (virJSONValueObjectGetNumberUlong(data, "actual", &mem) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("info balloon reply was missing balloon data"));
+        return -1;
+    }
+
+    *currmem = (mem/1024);
+    return 1;
+}
+
+
 /*
  * Returns: 0 if balloon not supported, +1 if balloon query worked
  * or -1 on failure
@@ -1420,40 +1566,9 @@ int qemuMonitorJSONGetBalloonInfo(qemuMonitorPtr mon,
 
     ret = qemuMonitorJSONCommand(mon, cmd, &reply);
 
-    if (ret == 0) {
-        /* See if balloon soft-failed */
-        if (qemuMonitorJSONHasError(reply, "DeviceNotActive") ||
-            qemuMonitorJSONHasError(reply, "KVMMissingCap"))
-            goto cleanup;
-
-        /* See if any other fatal error occurred */
-        ret = qemuMonitorJSONCheckError(cmd, reply);
-
-        /* Success */
-        if (ret == 0) {
-            virJSONValuePtr data;
-            unsigned long long mem;
-
-            if (!(data = virJSONValueObjectGet(reply, "return"))) {
-                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                               _("info balloon reply was missing return data"));
-                ret = -1;
-                goto cleanup;
-            }
-
-            if (virJSONValueObjectGetNumberUlong(data, "actual", &mem) < 0) {
-                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                               _("info balloon reply was missing balloon data"));
-                ret = -1;
-                goto cleanup;
-            }
-
-            *currmem = (mem/1024);
-            ret = 1;
-        }
-    }
+    if (ret == 0)
+        ret = qemuMonitorJSONExtractBalloonInfo(cmd, reply, currmem);
 
- cleanup:
     virJSONValueFree(cmd);
     virJSONValueFree(reply);
     return ret;
@@ -1497,39 +1612,33 @@ int qemuMonitorJSONGetBalloonInfo(qemuMonitorPtr mon,
     }
 
 
-int qemuMonitorJSONGetMemoryStats(qemuMonitorPtr mon,
-                                  char *balloonpath,
+/* Parses the replies to query-balloon and, if @statsCmd was sent, to
+ * the qom-get of the balloon statistics */
+static int
+qemuMonitorJSONExtractMemoryStats(virJSONValuePtr balloonCmd,
+                                  virJSONValuePtr balloonReply,
+                                  virJSONValuePtr statsCmd,
+                                  virJSONValuePtr statsReply,
                                   virDomainMemoryStatPtr stats,
                                   unsigned int nr_stats)
 {
     int ret;
-    virJSONValuePtr cmd = NULL;
-    virJSONValuePtr reply = NULL;
     virJSONValuePtr data;
     virJSONValuePtr statsdata;
     unsigned long long mem;
     int got = 0;
 
-    ret = qemuMonitorJSONGetBalloonInfo(mon, &mem);
+    ret = qemuMonitorJSONExtractBalloonInfo(balloonCmd, balloonReply, &mem);
     if (ret == 1 && (got < nr_stats)) {
         stats[got].tag = VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON;
         stats[got].val = mem;
         got++;
     }
 
-    if (!balloonpath)
-        goto cleanup;
-
-    if (!(cmd = qemuMonitorJSONMakeCommand("qom-get",
-                                           "s:path", balloonpath,
-                                           "s:property", "guest-stats",
-                                           NULL)))
-        goto cleanup;
-
-    if ((ret = qemuMonitorJSONCommand(mon, cmd, &reply)) < 0)
+    if (!statsCmd)
         goto cleanup;
 
-    if ((data = virJSONValueObjectGet(reply, "error"))) {
+    if ((data = virJSONValueObjectGet(statsReply, "error"))) {
         const char *klass = virJSONValueObjectGetString(data, "class");
         const char *desc = virJSONValueObjectGetString(data, "desc");
 
@@ -1541,10 +1650,10 @@ int qemuMonitorJSONGetMemoryStats(qemuMonitorPtr mon,
         }
     }
 
-    if ((ret = qemuMonitorJSONCheckError(cmd, reply)) < 0)
+    if ((ret = qemuMonitorJSONCheckError(statsCmd, statsReply)) < 0)
         goto cleanup;
 
-    if (!(data = virJSONValueObjectGet(reply, "return"))) {
+    if (!(data = virJSONValueObjectGet(statsReply, "return"))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("qom-get reply was missing return data"));
         goto cleanup;
@@ -1570,9 +1679,6 @@ int qemuMonitorJSONGetMemoryStats(qemuMonitorPtr mon,
 
 
  cleanup:
-    virJSONValueFree(cmd);
-    virJSONValueFree(reply);
-
     if (got > 0)
         ret = got;
 
@@ -1581,6 +1687,48 @@ int qemuMonitorJSONGetMemoryStats(qemuMonitorPtr mon,
 #undef GET_BALLOON_STATS
 
 
+static virJSONValuePtr
+qemuMonitorJSONMakeMemoryStatsCommand(const char *balloonpath)
+{
+    return qemuMonitorJSONMakeCommand("qom-get",
+                                      "s:path", balloonpath,
+                                      "s:property", "guest-stats",
+                                      NULL);
+}
+
+
+int qemuMonitorJSONGetMemoryStats(qemuMonitorPtr mon,
+                                  char *balloonpath,
+                                  virDomainMemoryStatPtr stats,
+                                  unsigned int nr_stats)
+{
+    int ret = -1;
+    virJSONValuePtr cmds[2] = { NULL, NULL };
+    virJSONValuePtr replies[2] = { NULL, NULL };
+    size_t ncmds = balloonpath ? 2 : 1;
+    size_t i;
+
+    if (!(cmds[0] = qemuMonitorJSONMakeCommand("query-balloon", NULL)) ||
+        (balloonpath &&
+         !(cmds[1] = qemuMonitorJSONMakeMemoryStatsCommand(balloonpath))))
+        goto cleanup;
+
+    if (qemuMonitorJSONCommands(mon, cmds, ncmds, replies) < 0)
+        goto cleanup;
+
+    ret = qemuMonitorJSONExtractMemoryStats(cmds[0], replies[0],
+                                            cmds[1], replies[1],
+                                            stats, nr_stats);
+
+ cleanup:
+    for (i = 0; i < ARRAY_CARDINALITY(cmds); i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
+    return ret;
+}
+
+
 /*
  * Using the provided balloonpath, determine if we need to set the
  * collection interval property to enable statistics gathering.
@@ -1700,7 +1848,10 @@ int qemuMonitorJSONGetBlockInfo(qemuMonitorPtr mon,
 }
 
 
-int qemuMonitorJSONGetBlockStatsInfo(qemuMonitorPtr mon,
+/* Looks up the statistics of @dev_name in the reply to query-blockstats,
+ * counters QEMU does not report are set to -1 */
+static int
+qemuMonitorJSONExtractBlockStatsInfo(virJSONValuePtr reply,
                                      const char *dev_name,
                                      long long *rd_req,
                                      long long *rd_bytes,
@@ -1712,12 +1863,9 @@ int qemuMonitorJSONGetBlockStatsInfo(qemuMonitorPtr mon,
                                      long long *flush_total_times,
                                      long long *errs)
 {
-    int ret;
+    int ret = -1;
     size_t i;
     bool found = false;
-    virJSONValuePtr cmd = qemuMonitorJSONMakeCommand("query-blockstats",
-                                                     NULL);
-    virJSONValuePtr reply = NULL;
     virJSONValuePtr devices;
 
     *rd_req = *rd_bytes = -1;
@@ -1732,17 +1880,6 @@ int qemuMonitorJSONGetBlockStatsInfo(qemuMonitorPtr mon,
     if (flush_total_times)
         *flush_total_times = -1;
 
-    if (!cmd)
-        return -1;
-
-    ret = qemuMonitorJSONCommand(mon, cmd, &reply);
-
-    if (ret == 0)
-        ret = qemuMonitorJSONCheckError(cmd, reply);
-    if (ret < 0)
-        goto cleanup;
-    ret = -1;
-
     devices = virJSONValueObjectGet(reply, "return");
     if (!devices || devices->type != VIR_JSON_TYPE_ARRAY) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -1854,23 +1991,26 @@ int qemuMonitorJSONGetBlockStatsInfo(qemuMonitorPtr mon,
     ret = 0;
 
  cleanup:
-    virJSONValueFree(cmd);
-    virJSONValueFree(reply);
     return ret;
 }
 
 
-int qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorPtr mon,
-                                             int *nparams)
+int qemuMonitorJSONGetBlockStatsInfo(qemuMonitorPtr mon,
+                                     const char *dev_name,
+                                     long long *rd_req,
+                                     long long *rd_bytes,
+                                     long long *rd_total_times,
+                                     long long *wr_req,
+                                     long long *wr_bytes,
+                                     long long *wr_total_times,
+                                     long long *flush_req,
+                                     long long *flush_total_times,
+                                     long long *errs)
 {
-    int ret, num = 0;
-    size_t i;
+    int ret;
     virJSONValuePtr cmd = qemuMonitorJSONMakeCommand("query-blockstats",
                                                      NULL);
     virJSONValuePtr reply = NULL;
-    virJSONValuePtr devices = NULL;
-    virJSONValuePtr dev = NULL;
-    virJSONValuePtr stats = NULL;
 
     if (!cmd)
         return -1;
@@ -1879,15 +2019,39 @@ int qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorPtr mon,
 
     if (ret == 0)
         ret = qemuMonitorJSONCheckError(cmd, reply);
-    if (ret < 0)
-        goto cleanup;
-    ret = -1;
+    if (ret == 0)
+        ret = qemuMonitorJSONExtractBlockStatsInfo(reply, dev_name,
+                                                   rd_req, rd_bytes,
+                                                   rd_total_times,
+                                                   wr_req, wr_bytes,
+                                                   wr_total_times,
+                                                   flush_req,
+                                                   flush_total_times,
+                                                   errs);
+
+    virJSONValueFree(cmd);
+    virJSONValueFree(reply);
+    return ret;
+}
+
+
+/* Counts the block statistics QEMU reports in the reply to
+ * query-blockstats */
+static int
+qemuMonitorJSONExtractBlockStatsParamsNumber(virJSONValuePtr reply,
+                                             int *nparams)
+{
+    int num = 0;
+    size_t i;
+    virJSONValuePtr devices = NULL;
+    virJSONValuePtr dev = NULL;
+    virJSONValuePtr stats = NULL;
 
     devices = virJSONValueObjectGet(reply, "return");
     if (!devices || devices->type != VIR_JSON_TYPE_ARRAY) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("blockstats reply was missing device list"));
-        goto cleanup;
+        return -1;
     }
 
     dev = virJSONValueArrayGet(devices, 0);
@@ -1895,14 +2059,14 @@ int qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorPtr mon,
     if (!dev || dev->type != VIR_JSON_TYPE_OBJECT) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("blockstats device entry was not in expected format"));
-        goto cleanup;
+        return -1;
     }
 
     if ((stats = virJSONValueObjectGet(dev, "stats")) == NULL ||
         stats->type != VIR_JSON_TYPE_OBJECT) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("blockstats stats entry was not in expected format"));
-        goto cleanup;
+        return -1;
     }
 
     for (i = 0; i < stats->data.object.npairs; i++) {
@@ -1925,14 +2089,111 @@ int qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorPtr mon,
     }
 
     *nparams = num;
-    ret = 0;
+    return 0;
+}
+
+
+int qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorPtr mon,
+                                             int *nparams)
+{
+    int ret;
+    virJSONValuePtr cmd = qemuMonitorJSONMakeCommand("query-blockstats",
+                                                     NULL);
+    virJSONValuePtr reply = NULL;
+
+    if (!cmd)
+        return -1;
+
+    ret = qemuMonitorJSONCommand(mon, cmd, &reply);
+
+    if (ret == 0)
+        ret = qemuMonitorJSONCheckError(cmd, reply);
+    if (ret == 0)
+        ret = qemuMonitorJSONExtractBlockStatsParamsNumber(reply, nparams);
 
- cleanup:
     virJSONValueFree(cmd);
     virJSONValueFree(reply);
     return ret;
 }
 
+
+/*
+ * Sends query-blockstats, query-balloon and, if the balloon supports
+ * it, the query for the guest memory statistics in one go.
+ */
+int qemuMonitorJSONGetDomainStats(qemuMonitorPtr mon,
+                                  char *balloonpath,
+                                  size_t ndevs,
+                                  const char *const *devs,
+                                  qemuBlockStatsPtr blockstats,
+                                  int *blockrc,
+                                  int *nblockparams,
+                                  virDomainMemoryStatPtr memstats,
+                                  unsigned int nr_memstats,
+                                  int *nmemstats)
+{
+    int ret = -1;
+    virJSONValuePtr cmds[3] = { NULL, NULL, NULL };
+    virJSONValuePtr replies[3] = { NULL, NULL, NULL };
+    size_t ncmds = balloonpath ? 3 : 2;
+    size_t i;
+
+    if (!(cmds[0] = qemuMonitorJSONMakeCommand("query-blockstats", NULL)) ||
+        !(cmds[1] = qemuMonitorJSONMakeCommand("query-balloon", NULL)) ||
+        (balloonpath &&
+         !(cmds[2] = qemuMonitorJSONMakeMemoryStatsCommand(balloonpath))))
+        goto cleanup;
+
+    if (qemuMonitorJSONCommands(mon, cmds, ncmds, replies) < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONCheckError(cmds[0], replies[0]) < 0) {
+        for (i = 0; i < ndevs; i++)
+            blockrc[i] = -1;
+        if (nblockparams)
+            *nblockparams = -1;
+    } else {
+        for (i = 0; i < ndevs; i++) {
+            qemuBlockStatsPtr stats = &blockstats[i];
+
+            if (!devs[i]) {
+                blockrc[i] = -1;
+                continue;
+            }
+
+            blockrc[i] =
+                qemuMonitorJSONExtractBlockStatsInfo(replies[0], devs[i],
+                                                     &stats->rd_req,
+                                                     &stats->rd_bytes,
+                                                     &stats->rd_total_times,
+                                                     &stats->wr_req,
+                                                     &stats->wr_bytes,
+                                                     &stats->wr_total_times,
+                                                     &stats->flush_req,
+                                                     &stats->flush_total_times,
+                                                     &stats->errs);
+        }
+
+        if (nblockparams &&
+            qemuMonitorJSONExtractBlockStatsParamsNumber(replies[0],
+                                                         nblockparams) < 0)
+            *nblockparams = -1;
+    }
+
+    *nmemstats = qemuMonitorJSONExtractMemoryStats(cmds[1], replies[1],
+                                                   cmds[2], replies[2],
+                                                   memstats, nr_memstats);
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < ARRAY_CARDINALITY(cmds); i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
+    return ret;
+}
+
 int qemuMonitorJSONGetBlockExtent(qemuMonitorPtr mon,
                                   const char *dev_name,
                                   unsigned long long *extent)
@@ -4738,13 +4999,11 @@ int qemuMonitorJSONGetObjectTypes(qemuMonitorPtr mon,
 }
 
 
-int qemuMonitorJSONGetObjectListPaths(qemuMonitorPtr mon,
-                                      const char *path,
+static int
+qemuMonitorJSONExtractObjectListPaths(virJSONValuePtr reply,
                                       qemuMonitorJSONListPathPtr **paths)
 {
-    int ret;
-    virJSONValuePtr cmd;
-    virJSONValuePtr reply = NULL;
+    int ret = -1;
     virJSONValuePtr data;
     qemuMonitorJSONListPathPtr *pathlist = NULL;
     int n = 0;
@@ -4752,21 +5011,6 @@ int qemuMonitorJSONGetObjectListPaths(qemuMonitorPtr mon,
 
     *paths = NULL;
 
-    if (!(cmd = qemuMonitorJSONMakeCommand("qom-list",
-                                           "s:path", path,
-                                           NULL)))
-        return -1;
-
-    ret = qemuMonitorJSONCommand(mon, cmd, &reply);
-
-    if (ret == 0)
-        ret = qemuMonitorJSONCheckError(cmd, reply);
-
-    if (ret < 0)
-        goto cleanup;
-
-    ret = -1;
-
     if (!(data = virJSONValueObjectGet(reply, "return"))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
                        _("qom-list reply was missing return data"));
@@ -4822,6 +5066,33 @@ int qemuMonitorJSONGetObjectListPaths(qemuMonitorPtr mon,
             qemuMonitorJSONListPathFree(pathlist[i]);
         VIR_FREE(pathlist);
     }
+    return ret;
+}
+
+
+int qemuMonitorJSONGetObjectListPaths(qemuMonitorPtr mon,
+                                      const char *path,
+                                      qemuMonitorJSONListPathPtr **paths)
+{
+    int ret;
+    virJSONValuePtr cmd;
+    virJSONValuePtr reply = NULL;
+
+    *paths = NULL;
+
+    if (!(cmd = qemuMonitorJSONMakeCommand("qom-list",
+                                           "s:path", path,
+                                           NULL)))
+        return -1;
+
+    ret = qemuMonitorJSONCommand(mon, cmd, &reply);
+
+    if (ret == 0)
+        ret = qemuMonitorJSONCheckError(cmd, reply);
+
+    if (ret == 0)
+        ret = qemuMonitorJSONExtractObjectListPaths(reply, paths);
+
     virJSONValueFree(cmd);
     virJSONValueFree(reply);
     return ret;
@@ -5624,9 +5895,10 @@ qemuMonitorJSONDetachCharDev(qemuMonitorPtr mon,
 }
 
 
-int
-qemuMonitorJSONGetDeviceAliases(qemuMonitorPtr mon,
-                                char ***aliases)
+/* Turns the reply to qom-list of /machine/peripheral into device aliases */
+static int
+qemuMonitorJSONExtractDeviceAliases(virJSONValuePtr reply,
+                                    char ***aliases)
 {
     qemuMonitorJSONListPathPtr *paths = NULL;
     char **alias;
@@ -5636,8 +5908,7 @@ qemuMonitorJSONGetDeviceAliases(qemuMonitorPtr mon,
 
     *aliases = NULL;
 
-    n = qemuMonitorJSONGetObjectListPaths(mon, "/machine/peripheral", &paths);
-    if (n < 0)
+    if ((n = qemuMonitorJSONExtractObjectListPaths(reply, &paths)) < 0)
         return -1;
 
     if (VIR_ALLOC_N(*aliases, n + 1) < 0)
@@ -5662,6 +5933,100 @@ qemuMonitorJSONGetDeviceAliases(qemuMonitorPtr mon,
 }
 
 
+int
+qemuMonitorJSONGetDeviceAliases(qemuMonitorPtr mon,
+                                char ***aliases)
+{
+    int ret;
+    virJSONValuePtr cmd;
+    virJSONValuePtr reply = NULL;
+
+    *aliases = NULL;
+
+    if (!(cmd = qemuMonitorJSONMakeCommand("qom-list",
+                                           "s:path", "/machine/peripheral",
+                                           NULL)))
+        return -1;
+
+    ret = qemuMonitorJSONCommand(mon, cmd, &reply);
+
+    if (ret == 0)
+        ret = qemuMonitorJSONCheckError(cmd, reply);
+
+    if (ret == 0)
+        ret = qemuMonitorJSONExtractDeviceAliases(reply, aliases);
+
+    virJSONValueFree(cmd);
+    virJSONValueFree(reply);
+    return ret;
+}
+
+
+/*
+ * The queries needed right after the monitor is connected don't depend
+ * on each other, so they are sent in one go rather than one by one.
+ */
+int
+qemuMonitorJSONGetStartupInfo(qemuMonitorPtr mon,
+                              virHashTablePtr paths,
+                              int **pids,
+                              int *npids,
+                              char ***aliases)
+{
+    int ret = -1;
+    virJSONValuePtr cmds[3] = { NULL, NULL, NULL };
+    virJSONValuePtr replies[3] = { NULL, NULL, NULL };
+    size_t ncmds = aliases ? 3 : 2;
+    size_t i;
+
+    *pids = NULL;
+    *npids = -1;
+    if (aliases)
+        *aliases = NULL;
+
+    if (!(cmds[0] = qemuMonitorJSONMakeCommand("query-chardev", NULL)) ||
+        !(cmds[1] = qemuMonitorJSONMakeCommand("query-cpus", NULL)) ||
+        (aliases &&
+         !(cmds[2] = qemuMonitorJSONMakeCommand("qom-list",
+                                                "s:path",
+                                                "/machine/peripheral",
+                                                NULL))))
+        goto cleanup;
+
+    if (qemuMonitorJSONCommands(mon, cmds, ncmds, replies) < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONCheckError(cmds[0], replies[0]) < 0 ||
+        qemuMonitorJSONExtractPtyPaths(replies[0], paths) < 0)
+        goto cleanup;
+
+    /* Not being able to find vCPU threads is not fatal */
+    if (qemuMonitorJSONCheckError(cmds[1], replies[1]) < 0 ||
+        (*npids = qemuMonitorJSONExtractCPUInfo(replies[1], pids)) < 0) {
+        virResetLastError();
+        *npids = -1;
+    }
+
+    if (aliases &&
+        (qemuMonitorJSONCheckError(cmds[2], replies[2]) < 0 ||
+         qemuMonitorJSONExtractDeviceAliases(replies[2], aliases) < 0))
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    if (ret < 0) {
+        VIR_FREE(*pids);
+        *npids = -1;
+    }
+    for (i = 0; i < ARRAY_CARDINALITY(cmds); i++) {
+        virJSONValueFree(cmds[i]);
+        virJSONValueFree(replies[i]);
+    }
+    return ret;
+}
+
+
 static int
 qemuMonitorJSONParseCPUx86FeatureWord(virJSONValuePtr data,
                                       virCPUx86CPUID *cpuid)
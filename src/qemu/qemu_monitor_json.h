@@ -81,6 +81,16 @@ int qemuMonitorJSONGetBlockStatsInfo(qemuMonitorPtr mon,
                                      long long *errs);
 int qemuMonitorJSONGetBlockStatsParamsNumber(qemuMonitorPtr mon,
                                              int *nparams);
+int qemuMonitorJSONGetDomainStats(qemuMonitorPtr mon,
+                                  char *balloonpath,
+                                  size_t ndevs,
+                                  const char *const *devs,
+                                  qemuBlockStatsPtr blockstats,
+                                  int *blockrc,
+                                  int *nblockparams,
+                                  virDomainMemoryStatPtr memstats,
+                                  unsigned int nr_memstats,
+                                  int *nmemstats);
 int qemuMonitorJSONGetBlockExtent(qemuMonitorPtr mon,
                                   const char *dev_name,
                                   unsigned long long *extent);
@@ -433,6 +443,12 @@ int qemuMonitorJSONDetachCharDev(qemuMonitorPtr mon,
 int qemuMonitorJSONGetDeviceAliases(qemuMonitorPtr mon,
                                     char ***aliases);
 
+int qemuMonitorJSONGetStartupInfo(qemuMonitorPtr mon,
+                                  virHashTablePtr paths,
+                                  int **pids,
+                                  int *npids,
+                                  char ***aliases);
+
 int qemuMonitorJSONGetGuestCPU(qemuMonitorPtr mon,
                                virArch arch,
                                virCPUDataPtr *data);
@@ -66,6 +66,11 @@
 #include "virnuma.h"
 #include "virstring.h"
 #include "virhostdev.h"
+#include "virprobe.h"
+
+#ifdef WITH_DTRACE_PROBES
+# include "libvirt_qemu_probes.h"
+#endif
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
@@ -1047,6 +1052,7 @@ qemuProcessHandleBlockJob(qemuMonitorPtr mon ATTRIBUTE_UNUSED,
                 disk->mirroring = false;
             }
         }
+        virDomainObjBumpGeneration(vm);
     }
 
     virObjectUnlock(vm);
@@ -1898,6 +1904,43 @@ qemuProcessFindCharDevicePTYs(virDomainObjPtr vm,
 }
 
 
+/* Takes over @cpupids, the thread ids of vCPUs found by
+ * qemuMonitorGetStartupInfo */
+static int
+qemuProcessSetVcpuPIDs(virDomainObjPtr vm,
+                       int *cpupids,
+                       int ncpupids)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+
+    /* failure to get the VCPU<-> PID mapping or to execute the query
+     * command will not be treated fatal as some versions of qemu don't
+     * support this command */
+    if (ncpupids <= 0) {
+        VIR_FREE(cpupids);
+
+        priv->nvcpupids = 1;
+        if (VIR_ALLOC_N(priv->vcpupids, priv->nvcpupids) < 0)
+            return -1;
+        priv->vcpupids[0] = vm->pid;
+        return 0;
+    }
+
+    if (ncpupids != vm->def->vcpus) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("got wrong number of vCPU pids from QEMU monitor. "
+                         "got %d, wanted %d"),
+                       ncpupids, vm->def->vcpus);
+        VIR_FREE(cpupids);
+        return -1;
+    }
+
+    priv->nvcpupids = ncpupids;
+    priv->vcpupids = cpupids;
+    return 0;
+}
+
+
 static int
 qemuProcessWaitForMonitor(virQEMUDriverPtr driver,
                           virDomainObjPtr vm,
@@ -1909,6 +1952,10 @@ qemuProcessWaitForMonitor(virQEMUDriverPtr driver,
     int logfd = -1;
     int ret = -1;
     virHashTablePtr paths = NULL;
+    int *cpupids = NULL;
+    int ncpupids = -1;
+    char **aliases = NULL;
+    bool needAliases = virQEMUCapsGet(qemuCaps, QEMU_CAPS_DEVICE_DEL_EVENT);
     qemuDomainObjPrivatePtr priv;
 
     if (pos != -1 &&
@@ -1932,22 +1979,38 @@ qemuProcessWaitForMonitor(virQEMUDriverPtr driver,
     /* Try to get the pty path mappings again via the monitor. This is much more
      * reliable if it's available.
      * Note that the monitor itself can be on a pty, so we still need to try the
-     * log output method. */
+     * log output method. The vCPU threads and device aliases are fetched
+     * at the same time to save round trips to the monitor. */
     paths = virHashCreate(0, virHashValueFree);
     if (paths == NULL)
         goto cleanup;
 
     priv = vm->privateData;
     qemuDomainObjEnterMonitor(driver, vm);
-    ret = qemuMonitorGetPtyPaths(priv->mon, paths);
+    ret = qemuMonitorGetStartupInfo(priv->mon, paths, &cpupids, &ncpupids,
+                                    needAliases ? &aliases : NULL);
     qemuDomainObjExitMonitor(driver, vm);
 
-    VIR_DEBUG("qemuMonitorGetPtyPaths returned %i", ret);
+    VIR_DEBUG("qemuMonitorGetStartupInfo returned %i", ret);
     if (ret == 0)
         ret = qemuProcessFindCharDevicePTYsMonitor(vm, qemuCaps, paths);
 
+    if (ret == 0) {
+        VIR_DEBUG("Detecting VCPU PIDs");
+        ret = qemuProcessSetVcpuPIDs(vm, cpupids, ncpupids);
+        cpupids = NULL;
+    }
+
+    if (ret == 0 && needAliases) {
+        virStringFreeList(priv->qemuDevices);
+        priv->qemuDevices = aliases;
+        aliases = NULL;
+    }
+
  cleanup:
     virHashFree(paths);
+    VIR_FREE(cpupids);
+    virStringFreeList(aliases);
 
     if (pos != -1 && kill(vm->pid, 0) == -1 && errno == ESRCH) {
         int len;
@@ -1982,45 +2045,6 @@ qemuProcessWaitForMonitor(virQEMUDriverPtr driver,
     return ret;
 }
 
-static int
-qemuProcessDetectVcpuPIDs(virQEMUDriverPtr driver,
-                          virDomainObjPtr vm)
-{
-    pid_t *cpupids = NULL;
-    int ncpupids;
-    qemuDomainObjPrivatePtr priv = vm->privateData;
-
-    qemuDomainObjEnterMonitor(driver, vm);
-    /* failure to get the VCPU<-> PID mapping or to execute the query
-     * command will not be treated fatal as some versions of qemu don't
-     * support this command */
-    if ((ncpupids = qemuMonitorGetCPUInfo(priv->mon, &cpupids)) <= 0) {
-        qemuDomainObjExitMonitor(driver, vm);
-        virResetLastError();
-
-        priv->nvcpupids = 1;
-        if (VIR_ALLOC_N(priv->vcpupids, priv->nvcpupids) < 0)
-            return -1;
-        priv->vcpupids[0] = vm->pid;
-        return 0;
-    }
-    qemuDomainObjExitMonitor(driver, vm);
-
-    if (ncpupids != vm->def->vcpus) {
-        virReportError(VIR_ERR_INTERNAL_ERROR,
-                       _("got wrong number of vCPU pids from QEMU monitor. "
-                         "got %d, wanted %d"),
-                       ncpupids, vm->def->vcpus);
-        VIR_FREE(cpupids);
-        return -1;
-    }
-
-    priv->nvcpupids = ncpupids;
-    priv->vcpupids = cpupids;
-    return 0;
-}
-
-
 /* Helper to prepare cpumap for affinity setting, convert
  * NUMA nodeset into cpuset if @nodemask is not NULL, otherwise
  * just return a new allocated bitmap.
@@ -3663,6 +3687,33 @@ qemuProcessVerifyGuestCPU(virQEMUDriverPtr driver, virDomainObjPtr vm)
 }
 
 
+/*
+ * Records the time spent in @phase of starting @vm, which began at
+ * @then. @then is moved to the end of the phase.
+ */
+static void
+qemuProcessStartPhaseDone(virDomainObjPtr vm,
+                          qemuDomainStartPhase phase,
+                          unsigned long long *then)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    unsigned long long now;
+
+    if (virTimeMillisNow(&now) < 0) {
+        virResetLastError();
+        now = *then;
+    }
+
+    priv->startPhases[phase] = now - *then;
+    priv->nstartPhases = phase + 1;
+    *then = now;
+
+    PROBE(QEMU_PROCESS_START_PHASE,
+          "vm=%p name=%s phase=%s time=%llu",
+          vm, vm->def->name, qemuDomainStartPhaseTypeToString(phase),
+          priv->startPhases[phase]);
+}
+
 int qemuProcessStart(virConnectPtr conn,
                      virQEMUDriverPtr driver,
                      virDomainObjPtr vm,
@@ -3689,6 +3740,7 @@ int qemuProcessStart(virConnectPtr conn,
     virQEMUDriverConfigPtr cfg;
     virCapsPtr caps = NULL;
     unsigned int hostdev_flags = 0;
+    unsigned long long then = 0;
 
     VIR_DEBUG("vm=%p name=%s id=%d pid=%llu",
               vm, vm->def->name, vm->def->id,
@@ -3727,6 +3779,11 @@ int qemuProcessStart(virConnectPtr conn,
         return -1;
     }
 
+    priv->nstartPhases = 0;
+    if (virTimeMillisNow(&priv->startTime) < 0)
+        goto cleanup;
+    then = priv->startTime;
+
     if (!(caps = virQEMUDriverGetCapabilities(driver, false)))
         goto cleanup;
 
@@ -3767,6 +3824,7 @@ int qemuProcessStart(virConnectPtr conn,
     if (!(priv->qemuCaps = virQEMUCapsCacheLookupCopy(driver->qemuCapsCache,
                                                       vm->def->emulator)))
         goto cleanup;
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_CAPS, &then);
 
     /* network devices must be "prepared" before hostdevs, because
      * setting up a network device might create a new hostdev that
@@ -3792,6 +3850,7 @@ int qemuProcessStart(virConnectPtr conn,
                                qemuProcessPrepareChardevDevice,
                                NULL) < 0)
         goto cleanup;
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_HOSTDEV, &then);
 
     /* If you are using a SecurityDriver with dynamic labelling,
        then generate a security label for isolation */
@@ -3964,6 +4023,7 @@ int qemuProcessStart(virConnectPtr conn,
                              priv->pidfile);
         goto cleanup;
     }
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_PREPARE, &then);
 
     /*
      * Normally PCI addresses are assigned in the virDomainCreate
@@ -3984,6 +4044,7 @@ int qemuProcessStart(virConnectPtr conn,
                                      migrateFrom, stdin_fd, snapshot, vmop,
                                      &buildCommandLineCallbacks, false)))
         goto cleanup;
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_COMMAND, &then);
 
     /* now that we know it is about to start call the hook if present */
     if (virHookPresent(VIR_HOOK_DRIVER_QEMU)) {
@@ -4096,6 +4157,7 @@ int qemuProcessStart(virConnectPtr conn,
         qemuProcessReadChildErrors(driver, vm, pos);
         goto cleanup;
     }
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_SPAWN, &then);
 
     VIR_DEBUG("Setting up domain cgroup (if required)");
     if (qemuSetupCgroup(driver, vm, nodemask) < 0)
@@ -4106,6 +4168,7 @@ int qemuProcessStart(virConnectPtr conn,
     if (!vm->def->cputune.emulatorpin &&
         qemuProcessInitCpuAffinity(driver, vm, nodemask) < 0)
         goto cleanup;
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_CGROUP, &then);
 
     VIR_DEBUG("Setting domain security labels");
     if (virSecurityManagerSetAllLabel(driver->securityManager,
@@ -4135,6 +4198,7 @@ int qemuProcessStart(virConnectPtr conn,
             virSecurityManagerSetImageFDLabel(driver->securityManager, vm->def, stdin_fd) < 0)
             goto cleanup;
     }
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_LABEL, &then);
 
     VIR_DEBUG("Labelling done, completing handshake to child");
     if (virCommandHandshakeNotify(cmd) < 0) {
@@ -4165,14 +4229,12 @@ int qemuProcessStart(virConnectPtr conn,
         virResetLastError();
         priv->agentError = true;
     }
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_MONITOR, &then);
 
     VIR_DEBUG("Detecting if required emulator features are present");
     if (!qemuProcessVerifyGuestCPU(driver, vm))
         goto cleanup;
-
-    VIR_DEBUG("Detecting VCPU PIDs");
-    if (qemuProcessDetectVcpuPIDs(driver, vm) < 0)
-        goto cleanup;
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_PROBE, &then);
 
     VIR_DEBUG("Setting cgroup for each VCPU (if required)");
     if (qemuSetupCgroupForVcpu(vm) < 0)
@@ -4189,6 +4251,7 @@ int qemuProcessStart(virConnectPtr conn,
     VIR_DEBUG("Setting affinity of emulator threads");
     if (qemuProcessSetEmulatorAffinities(conn, vm) < 0)
         goto cleanup;
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_TUNE, &then);
 
     VIR_DEBUG("Setting any required VM passwords");
     if (qemuProcessInitPasswords(conn, driver, vm) < 0)
@@ -4214,10 +4277,6 @@ int qemuProcessStart(virConnectPtr conn,
 
     qemuDomainObjExitMonitor(driver, vm);
 
-    VIR_DEBUG("Fetching list of active devices");
-    if (qemuDomainUpdateDeviceList(driver, vm) < 0)
-        goto cleanup;
-
     /* Technically, qemuProcessStart can be called from inside
      * QEMU_ASYNC_JOB_MIGRATION_IN, but we are okay treating this like
      * a sync job since no other job can call into the domain until
@@ -4238,6 +4297,7 @@ int qemuProcessStart(virConnectPtr conn,
         goto cleanup;
     }
     qemuDomainObjExitMonitor(driver, vm);
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_DEVICES, &then);
 
     if (!(flags & VIR_QEMU_PROCESS_START_PAUSED)) {
         VIR_DEBUG("Starting domain CPUs");
@@ -4256,6 +4316,7 @@ int qemuProcessStart(virConnectPtr conn,
                              VIR_DOMAIN_PAUSED_MIGRATION :
                              VIR_DOMAIN_PAUSED_USER);
     }
+    qemuProcessStartPhaseDone(vm, QEMU_DOMAIN_START_PHASE_RESUME, &then);
 
     if (flags & VIR_QEMU_PROCESS_START_AUTODESTROY &&
         qemuProcessAutoDestroyAdd(driver, vm, conn) < 0)
@@ -4601,6 +4662,7 @@ void qemuProcessStop(virQEMUDriverPtr driver,
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, reason);
     VIR_FREE(priv->vcpupids);
     priv->nvcpupids = 0;
+    qemuDomainStatsCacheClear(priv);
     virObjectUnref(priv->qemuCaps);
     priv->qemuCaps = NULL;
     VIR_FREE(priv->pidfile);
@@ -4622,6 +4684,7 @@ void qemuProcessStop(virQEMUDriverPtr driver,
         vm->def->id = -1;
         vm->newDef = NULL;
     }
+    virDomainObjBumpGeneration(vm);
 
     if (orig_err) {
         virSetError(orig_err);
@@ -4789,10 +4852,6 @@ int qemuProcessAttach(virConnectPtr conn ATTRIBUTE_UNUSED,
         priv->agentError = true;
     }
 
-    VIR_DEBUG("Detecting VCPU PIDs");
-    if (qemuProcessDetectVcpuPIDs(driver, vm) < 0)
-        goto error;
-
     /* If we have -device, then addresses are assigned explicitly.
      * If not, then we have to detect dynamic ones here */
     if (!virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_DEVICE)) {
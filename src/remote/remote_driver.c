@@ -6790,6 +6790,88 @@ remoteDomainSnapshotListAllChildren(virDomainSnapshotPtr parent,
     return rv;
 }
 
+static int
+remoteDomainSnapshotCreateGroup(virConnectPtr conn,
+                                virDomainPtr *domains,
+                                const char **xmlDescs,
+                                unsigned int ndomains,
+                                virDomainSnapshotPtr **snapshots,
+                                unsigned int flags)
+{
+    int rv = -1;
+    size_t i;
+    virDomainSnapshotPtr *snaps = NULL;
+    remote_domain_snapshot_create_group_args args;
+    remote_domain_snapshot_create_group_ret ret;
+
+    struct private_data *priv = conn->privateData;
+
+    remoteDriverLock(priv);
+
+    memset(&args, 0, sizeof(args));
+    memset(&ret, 0, sizeof(ret));
+
+    if (ndomains > REMOTE_DOMAIN_SNAPSHOT_GROUP_MAX) {
+        virReportError(VIR_ERR_RPC,
+                       _("Too many domains '%u' for limit '%d'"),
+                       ndomains, REMOTE_DOMAIN_SNAPSHOT_GROUP_MAX);
+        goto done;
+    }
+
+    if (VIR_ALLOC_N(args.doms.doms_val, ndomains) < 0)
+        goto done;
+    args.doms.doms_len = ndomains;
+    for (i = 0; i < ndomains; i++)
+        make_nonnull_domain(&args.doms.doms_val[i], domains[i]);
+    args.xml_descs.xml_descs_val = (char **) xmlDescs;
+    args.xml_descs.xml_descs_len = ndomains;
+    args.flags = flags;
+
+    if (call(conn,
+             priv,
+             0,
+             REMOTE_PROC_DOMAIN_SNAPSHOT_CREATE_GROUP,
+             (xdrproc_t) xdr_remote_domain_snapshot_create_group_args,
+             (char *) &args,
+             (xdrproc_t) xdr_remote_domain_snapshot_create_group_ret,
+             (char *) &ret) == -1)
+        goto done;
+
+    if (ret.snaps.snaps_len != ndomains) {
+        virReportError(VIR_ERR_RPC,
+                       _("Got '%u' domain snapshots, expected '%u'"),
+                       ret.snaps.snaps_len, ndomains);
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(snaps, ndomains + 1) < 0)
+        goto cleanup;
+    for (i = 0; i < ndomains; i++) {
+        snaps[i] = get_nonnull_domain_snapshot(domains[i], ret.snaps.snaps_val[i]);
+        if (!snaps[i])
+            goto cleanup;
+    }
+    *snapshots = snaps;
+    snaps = NULL;
+
+    rv = 0;
+
+ cleanup:
+    if (snaps) {
+        for (i = 0; i < ndomains; i++)
+            if (snaps[i])
+                virDomainSnapshotFree(snaps[i]);
+        VIR_FREE(snaps);
+    }
+
+    xdr_free((xdrproc_t) xdr_remote_domain_snapshot_create_group_ret, (char *) &ret);
+
+ done:
+    VIR_FREE(args.doms.doms_val);
+    remoteDriverUnlock(priv);
+    return rv;
+}
+
 static int
 remoteNodeGetMemoryParameters(virConnectPtr conn,
                               virTypedParameterPtr params,
@@ -8008,6 +8090,8 @@ static virDriver remote_driver = {
     .domainSetTime = remoteDomainSetTime, /* 1.2.5 */
     .nodeGetFreePages = remoteNodeGetFreePages, /* 1.2.6 */
     .connectGetDomainCapabilities = remoteConnectGetDomainCapabilities, /* 1.2.7 */
+    .domainGetXMLGeneration = remoteDomainGetXMLGeneration, /* 1.2.8 */
+    .domainSnapshotCreateGroup = remoteDomainSnapshotCreateGroup, /* 1.2.8 */
 };
 
 static virNetworkDriver network_driver = {
@@ -148,6 +148,9 @@ const REMOTE_DOMAIN_MEMORY_STATS_MAX = 1024;
 /* Upper limit on lists of domain snapshots. */
 const REMOTE_DOMAIN_SNAPSHOT_LIST_MAX = 1024;
 
+/* Upper limit on number of domains in a group snapshot. */
+const REMOTE_DOMAIN_SNAPSHOT_GROUP_MAX = 256;
+
 /* Maximum length of a block peek buffer message.
  * Note applications need to be aware of this limit and issue multiple
  * requests for large amounts of data.
@@ -3057,6 +3060,25 @@ struct remote_network_get_dhcp_leases_ret {
     unsigned int ret;
 };
 
+struct remote_domain_get_xml_generation_args {
+    remote_nonnull_domain dom;
+    unsigned int flags;
+};
+
+struct remote_domain_get_xml_generation_ret {
+    unsigned hyper generation; /* insert@1 */
+};
+
+struct remote_domain_snapshot_create_group_args {
+    remote_nonnull_domain doms<REMOTE_DOMAIN_SNAPSHOT_GROUP_MAX>;
+    remote_nonnull_string xml_descs<REMOTE_DOMAIN_SNAPSHOT_GROUP_MAX>;
+    unsigned int flags;
+};
+
+struct remote_domain_snapshot_create_group_ret {
+    remote_nonnull_domain_snapshot snaps<REMOTE_DOMAIN_SNAPSHOT_GROUP_MAX>;
+};
+
 /*----- Protocol. -----*/
 
 /* Define the program number, protocol version and procedure numbers here. */
@@ -5420,5 +5442,18 @@ enum remote_procedure {
      * @generate: both
      * @acl: connect:write
      */
-    REMOTE_PROC_CONNECT_GET_DOMAIN_CAPABILITIES = 342
+    REMOTE_PROC_CONNECT_GET_DOMAIN_CAPABILITIES = 342,
+
+    /**
+     * @generate: both
+     * @acl: domain:read
+     */
+    REMOTE_PROC_DOMAIN_GET_XML_GENERATION = 343,
+
+    /**
+     * @generate: none
+     * @acl: domain:snapshot
+     * @acl: domain:fs_freeze:VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE
+     */
+    REMOTE_PROC_DOMAIN_SNAPSHOT_CREATE_GROUP = 344
 };
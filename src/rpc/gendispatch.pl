@@ -1714,6 +1714,9 @@ elsif ($mode eq "client") {
             }
             if (defined $call->{aclfilter}) {
                 print $apiname . "CheckACL;\n";
+                if (defined &acl_bulk_object($call)) {
+                    print $apiname . "CheckACLBulk;\n";
+                }
             }
             print $apiname . "EnsureACL;\n";
         } elsif ($mode eq "aclapi") {
@@ -1722,6 +1725,82 @@ elsif ($mode eq "client") {
             &generate_acl($call, $call->{acl}, "Ensure");
             if (defined $call->{aclfilter}) {
                 &generate_acl($call, $call->{aclfilter}, "Check");
+                if (defined &acl_bulk_object($call)) {
+                    &generate_acl_bulk($call, $call->{aclfilter});
+                }
+            }
+        }
+
+        # The ListAll filters on objects which the access manager can
+        # check in bulk also get a variant deciding on a whole list
+        # at once
+        sub acl_bulk_object {
+            my $call = shift;
+            my $acl = $call->{aclfilter};
+
+            return undef unless $call->{ProcName} =~ /^ConnectListAll/;
+            return undef unless $#{$acl} == 0;
+
+            my @bits = split /:/, $acl->[0];
+            return undef if defined $bits[2];
+            return undef unless grep { $_ eq $bits[0] } qw(domain network storage_pool);
+
+            return $bits[0];
+        }
+
+        sub generate_acl_bulk {
+            my $call = shift;
+            my $acl = shift;
+
+            my @bits = split /:/, $acl->[0];
+
+            my $apiname = "vir" . $call->{ProcName};
+            if ($structprefix eq "qemu") {
+                $apiname =~ s/(vir(Connect)?Domain)/${1}Qemu/;
+            } elsif ($structprefix eq "lxc") {
+                $apiname =~ s/virDomain/virDomainLxc/;
+            }
+            $apiname .= "CheckACLBulk";
+
+            my $object = $bits[0];
+            $object =~ s/^(\w)/uc $1/e;
+            $object =~ s/_(\w)/uc $1/e;
+            my $objecttype = "vir" . $object . "DefPtr";
+            my $method = "virAccessManagerCheck" . $object . "s";
+            my $perm = "vir_access_perm_" . $bits[0] . "_" . $bits[1];
+            $perm =~ tr/a-z/A-Z/;
+
+            my @argdecls = ("virConnectPtr conn",
+                            "$objecttype *defs",
+                            "size_t ndefs",
+                            "bool *allowed");
+
+            if ($mode eq "aclheader") {
+                print "extern int $apiname(" . join(", ", @argdecls) . ");\n";
+            } else {
+                my $space = ' ' x length("    if ((rv = $method(");
+
+                print "/* Returns: -1 on error (all denied), 0 with decisions in allowed */\n";
+                print "int $apiname(" . join(", ", @argdecls) . ")\n";
+                print "{\n";
+                print "    virAccessManagerPtr mgr;\n";
+                print "    size_t i;\n";
+                print "    int rv;\n";
+                print "\n";
+                print "    if (!(mgr = virAccessManagerGetDefault())) {\n";
+                print "        virResetLastError();\n";
+                print "        for (i = 0; i < ndefs; i++)\n";
+                print "            allowed[i] = false;\n";
+                print "        return -1;\n";
+                print "    }\n";
+                print "\n";
+                print "    if ((rv = $method(mgr, conn->driver->name,\n";
+                print "$space" . "defs, ndefs, $perm,\n";
+                print "$space" . "allowed)) < 0)\n";
+                print "        virResetLastError();\n";
+                print "    virObjectUnref(mgr);\n";
+                print "    return rv;\n";
+                print "}\n\n";
             }
         }
 
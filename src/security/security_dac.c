@@ -288,6 +288,25 @@ virSecurityDACRestoreSecurityFileLabel(const char *path)
 }
 
 
+/* Like virSecurityDACSetOwnership, but skips the chown if @path is
+ * owned by @uid:@gid already, as images shared by many domains are. */
+static int
+virSecurityDACSetImageOwnership(const char *path,
+                                uid_t uid,
+                                gid_t gid)
+{
+    struct stat sb;
+
+    if (stat(path, &sb) == 0 && sb.st_uid == uid && sb.st_gid == gid) {
+        VIR_DEBUG("Owner of '%s' is %ld:%ld already",
+                  path, (long) uid, (long) gid);
+        return 0;
+    }
+
+    return virSecurityDACSetOwnership(path, uid, gid);
+}
+
+
 static int
 virSecurityDACSetSecurityImageLabel(virSecurityManagerPtr mgr,
                                     virDomainDefPtr def,
@@ -323,7 +342,7 @@ virSecurityDACSetSecurityImageLabel(virSecurityManagerPtr mgr,
             return -1;
     }
 
-    return virSecurityDACSetOwnership(src->path, user, group);
+    return virSecurityDACSetImageOwnership(src->path, user, group);
 }
 
 
@@ -942,6 +961,19 @@ virSecurityDACSetChardevCallback(virDomainDefPtr def,
 }
 
 
+static int
+virSecurityDACSetSecurityAllDiskLabel(virSecurityManagerPtr mgr,
+                                      virDomainDefPtr def,
+                                      virDomainDiskDefPtr disk)
+{
+    /* XXX fixme - we need to recursively label the entire tree :-( */
+    if (virDomainDiskGetType(disk) == VIR_STORAGE_TYPE_DIR)
+        return 0;
+
+    return virSecurityDACSetSecurityDiskLabel(mgr, def, disk);
+}
+
+
 static int
 virSecurityDACSetSecurityAllLabel(virSecurityManagerPtr mgr,
                                   virDomainDefPtr def,
@@ -958,15 +990,10 @@ virSecurityDACSetSecurityAllLabel(virSecurityManagerPtr mgr,
     if (!priv->dynamicOwnership || (secdef && secdef->norelabel))
         return 0;
 
-    for (i = 0; i < def->ndisks; i++) {
-        /* XXX fixme - we need to recursively label the entire tree :-( */
-        if (virDomainDiskGetType(def->disks[i]) == VIR_STORAGE_TYPE_DIR)
-            continue;
-        if (virSecurityDACSetSecurityDiskLabel(mgr,
-                                               def,
-                                               def->disks[i]) < 0)
-            return -1;
-    }
+    if (virSecurityManagerLabelDisks(mgr, def,
+                                     virSecurityDACSetSecurityAllDiskLabel) < 0)
+        return -1;
+
     for (i = 0; i < def->nhostdevs; i++) {
         if (virSecurityDACSetSecurityHostdevLabel(mgr,
                                                   def,
@@ -21,18 +21,25 @@
  */
 #include <config.h>
 
+
 #include "security_driver.h"
 #include "security_stack.h"
 #include "security_dac.h"
 #include "virerror.h"
 #include "viralloc.h"
+#include "viratomic.h"
 #include "virobject.h"
 #include "virlog.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_SECURITY
 
 VIR_LOG_INIT("security.security_manager");
 
+/* Upper bound on the number of threads labelling disks of a single
+ * domain */
+#define VIR_SECURITY_MANAGER_LABEL_WORKERS 8
+
 struct _virSecurityManager {
     virObjectLockable parent;
 
@@ -901,3 +908,106 @@ virSecurityManagerSetHugepages(virSecurityManagerPtr mgr,
 
     return 0;
 }
+
+
+typedef struct _virSecurityManagerDiskJob virSecurityManagerDiskJob;
+typedef virSecurityManagerDiskJob *virSecurityManagerDiskJobPtr;
+struct _virSecurityManagerDiskJob {
+    virSecurityManagerPtr mgr;
+    virDomainDefPtr def;
+    virSecurityManagerDiskLabelFunc func;
+
+    int next;
+    int failed;
+
+    /* first error reported by a worker, protected by @lock */
+    virMutex lock;
+    virErrorPtr error;
+};
+
+
+static void
+virSecurityManagerDiskWorker(void *opaque)
+{
+    virSecurityManagerDiskJobPtr job = opaque;
+    int i;
+
+    while (!virAtomicIntGet(&job->failed) &&
+           (i = virAtomicIntAdd(&job->next, 1)) < job->def->ndisks) {
+        if (job->func(job->mgr, job->def, job->def->disks[i]) < 0) {
+            virAtomicIntSet(&job->failed, 1);
+            virMutexLock(&job->lock);
+            if (!job->error)
+                job->error = virSaveLastError();
+            virMutexUnlock(&job->lock);
+        }
+    }
+}
+
+
+/**
+ * virSecurityManagerLabelDisks:
+ * @mgr: security manager
+ * @def: domain definition
+ * @func: callback labelling a single disk of @def
+ *
+ * Calls @func for every disk of @def, using up to
+ * VIR_SECURITY_MANAGER_LABEL_WORKERS threads including the caller.
+ * Relabelling each image of a backing chain, possibly over NFS, adds up
+ * quickly for domains with many disks. Disks are independent of each
+ * other, so @func must only touch @disk and the files it refers to.
+ * No more disks are started once @func fails for one of them.
+ *
+ * Returns 0 on success, -1 with the first error reported by @func set
+ * otherwise.
+ */
+int
+virSecurityManagerLabelDisks(virSecurityManagerPtr mgr,
+                             virDomainDefPtr def,
+                             virSecurityManagerDiskLabelFunc func)
+{
+    virSecurityManagerDiskJob job = {
+        .mgr = mgr, .def = def, .func = func,
+    };
+    virThread threads[VIR_SECURITY_MANAGER_LABEL_WORKERS - 1];
+    size_t nthreads = 0;
+    size_t i;
+    int ret = 0;
+
+    if (virMutexInit(&job.lock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize mutex"));
+        return -1;
+    }
+
+    for (i = 0; i < ARRAY_CARDINALITY(threads); i++) {
+        /* The calling thread labels disks too */
+        if (i + 1 >= def->ndisks)
+            break;
+
+        if (virThreadCreate(&threads[nthreads], true,
+                            virSecurityManagerDiskWorker, &job) < 0) {
+            /* Whatever threads we have will do the work */
+            VIR_WARN("Unable to create disk labelling thread");
+            virResetLastError();
+            break;
+        }
+        nthreads++;
+    }
+
+    virSecurityManagerDiskWorker(&job);
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+
+    if (job.failed) {
+        if (job.error) {
+            virSetError(job.error);
+            virFreeError(job.error);
+        }
+        ret = -1;
+    }
+
+    virMutexDestroy(&job.lock);
+    return ret;
+}
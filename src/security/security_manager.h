@@ -131,4 +131,11 @@ int virSecurityManagerRestoreImageLabel(virSecurityManagerPtr mgr,
                                         virDomainDefPtr vm,
                                         virStorageSourcePtr src);
 
+typedef int (*virSecurityManagerDiskLabelFunc)(virSecurityManagerPtr mgr,
+                                               virDomainDefPtr def,
+                                               virDomainDiskDefPtr disk);
+int virSecurityManagerLabelDisks(virSecurityManagerPtr mgr,
+                                 virDomainDefPtr def,
+                                 virSecurityManagerDiskLabelFunc func);
+
 #endif /* VIR_SECURITY_MANAGER_H__ */
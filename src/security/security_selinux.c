@@ -928,15 +928,30 @@ virSecuritySELinuxSetFileconHelper(const char *path, char *tcon, bool optional)
 }
 
 static int
-virSecuritySELinuxSetFileconOptional(const char *path, char *tcon)
+virSecuritySELinuxSetFilecon(const char *path, char *tcon)
 {
-    return virSecuritySELinuxSetFileconHelper(path, tcon, true);
+    return virSecuritySELinuxSetFileconHelper(path, tcon, false);
 }
 
+/* Like virSecuritySELinuxSetFileconHelper, but skips the relabelling if
+ * @path carries @tcon already, as images shared by many domains do. */
 static int
-virSecuritySELinuxSetFilecon(const char *path, char *tcon)
+virSecuritySELinuxSetImageFilecon(const char *path,
+                                  char *tcon,
+                                  bool optional)
 {
-    return virSecuritySELinuxSetFileconHelper(path, tcon, false);
+    security_context_t econ;
+
+    if (getfilecon_raw(path, &econ) >= 0) {
+        if (STREQ(tcon, econ)) {
+            VIR_DEBUG("SELinux context on '%s' is '%s' already", path, tcon);
+            freecon(econ);
+            return 0;
+        }
+        freecon(econ);
+    }
+
+    return virSecuritySELinuxSetFileconHelper(path, tcon, optional);
 }
 
 static int
@@ -1212,23 +1227,25 @@ virSecuritySELinuxSetSecurityImageLabelInternal(virSecurityManagerPtr mgr,
         return 0;
 
     if (disk_seclabel && !disk_seclabel->norelabel && disk_seclabel->label) {
-        ret = virSecuritySELinuxSetFilecon(src->path, disk_seclabel->label);
+        ret = virSecuritySELinuxSetImageFilecon(src->path,
+                                                disk_seclabel->label, false);
     } else if (first) {
         if (src->shared) {
-            ret = virSecuritySELinuxSetFileconOptional(src->path,
-                                                       data->file_context);
+            ret = virSecuritySELinuxSetImageFilecon(src->path,
+                                                    data->file_context, true);
         } else if (src->readonly) {
-            ret = virSecuritySELinuxSetFileconOptional(src->path,
-                                                       data->content_context);
+            ret = virSecuritySELinuxSetImageFilecon(src->path,
+                                                    data->content_context,
+                                                    true);
         } else if (secdef->imagelabel) {
-            ret = virSecuritySELinuxSetFileconOptional(src->path,
-                                                       secdef->imagelabel);
+            ret = virSecuritySELinuxSetImageFilecon(src->path,
+                                                    secdef->imagelabel, true);
         } else {
             ret = 0;
         }
     } else {
-        ret = virSecuritySELinuxSetFileconOptional(src->path,
-                                                   data->content_context);
+        ret = virSecuritySELinuxSetImageFilecon(src->path,
+                                                data->content_context, true);
     }
 
     if (ret == 1 && !disk_seclabel) {
@@ -2235,6 +2252,22 @@ virSecuritySELinuxSetSecuritySmartcardCallback(virDomainDefPtr def,
 }
 
 
+static int
+virSecuritySELinuxSetSecurityAllDiskLabel(virSecurityManagerPtr mgr,
+                                          virDomainDefPtr def,
+                                          virDomainDiskDefPtr disk)
+{
+    /* XXX fixme - we need to recursively label the entire tree :-( */
+    if (virDomainDiskGetType(disk) == VIR_STORAGE_TYPE_DIR) {
+        VIR_WARN("Unable to relabel directory tree %s for disk %s",
+                 virDomainDiskGetSource(disk), disk->dst);
+        return 0;
+    }
+
+    return virSecuritySELinuxSetSecurityDiskLabel(mgr, def, disk);
+}
+
+
 static int
 virSecuritySELinuxSetSecurityAllLabel(virSecurityManagerPtr mgr,
                                       virDomainDefPtr def,
@@ -2251,18 +2284,9 @@ virSecuritySELinuxSetSecurityAllLabel(virSecurityManagerPtr mgr,
     if (secdef->norelabel || data->skipAllLabel)
         return 0;
 
-    for (i = 0; i < def->ndisks; i++) {
-        /* XXX fixme - we need to recursively label the entire tree :-( */
-        if (virDomainDiskGetType(def->disks[i]) == VIR_STORAGE_TYPE_DIR) {
-            VIR_WARN("Unable to relabel directory tree %s for disk %s",
-                     virDomainDiskGetSource(def->disks[i]),
-                     def->disks[i]->dst);
-            continue;
-        }
-        if (virSecuritySELinuxSetSecurityDiskLabel(mgr,
-                                         def, def->disks[i]) < 0)
-            return -1;
-    }
+    if (virSecurityManagerLabelDisks(
+            mgr, def, virSecuritySELinuxSetSecurityAllDiskLabel) < 0)
+        return -1;
     /* XXX fixme process  def->fss if relabel == true */
 
     for (i = 0; i < def->nhostdevs; i++) {
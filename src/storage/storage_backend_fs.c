@@ -51,6 +51,10 @@
 #include "virfile.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virthread.h"
+#include "viratomic.h"
+#include "virhash.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -822,6 +826,662 @@ virStorageBackendFileSystemBuild(virConnectPtr conn ATTRIBUTE_UNUSED,
 }
 
 
+/* Number of threads probing volumes in parallel during a pool refresh */
+#define VIR_STORAGE_FS_REFRESH_WORKERS 8
+
+/* Directory holding the per-pool probe caches, NULL if disabled */
+static char *virStorageBackendFileSystemCacheDir;
+
+/**
+ * virStorageBackendFileSystemSetCacheDir:
+ * @dir: directory to keep the probe caches in, or NULL to disable them
+ *
+ * Pool refresh remembers the result of probing each image header
+ * together with the file's identity and timestamps, so the next
+ * refresh (also after a daemon restart) only re-probes files which
+ * changed in the meantime.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendFileSystemSetCacheDir(const char *dir)
+{
+    char *tmp = NULL;
+
+    if (VIR_STRDUP(tmp, dir) < 0)
+        return -1;
+
+    VIR_FREE(virStorageBackendFileSystemCacheDir);
+    virStorageBackendFileSystemCacheDir = tmp;
+    return 0;
+}
+
+
+typedef struct _virStorageFSCacheEntry virStorageFSCacheEntry;
+typedef virStorageFSCacheEntry *virStorageFSCacheEntryPtr;
+struct _virStorageFSCacheEntry {
+    /* Identity of the probed file */
+    unsigned long long dev;
+    unsigned long long ino;
+    unsigned long long size;
+    struct timespec mtime;
+    struct timespec ctime;
+
+    /* Result of the probe */
+    int format;
+    unsigned long long capacity;
+    char *compat;
+    virBitmapPtr features;
+    char *backingStore;
+    int backingStoreFormat;
+};
+
+static void
+virStorageBackendFileSystemCacheEntryFree(void *payload,
+                                          const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageFSCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    VIR_FREE(entry->compat);
+    virBitmapFree(entry->features);
+    VIR_FREE(entry->backingStore);
+    VIR_FREE(entry);
+}
+
+
+static bool
+virStorageBackendFileSystemCacheEntryMatch(virStorageFSCacheEntryPtr entry,
+                                           const struct stat *sb)
+{
+    struct timespec mtime = get_stat_mtime(sb);
+    struct timespec ctime = get_stat_ctime(sb);
+
+    return entry->dev == sb->st_dev &&
+        entry->ino == sb->st_ino &&
+        entry->size == sb->st_size &&
+        entry->mtime.tv_sec == mtime.tv_sec &&
+        entry->mtime.tv_nsec == mtime.tv_nsec &&
+        entry->ctime.tv_sec == ctime.tv_sec &&
+        entry->ctime.tv_nsec == ctime.tv_nsec;
+}
+
+
+static char *
+virStorageBackendFileSystemCachePath(virStoragePoolObjPtr pool)
+{
+    char *path = NULL;
+
+    if (!virStorageBackendFileSystemCacheDir)
+        return NULL;
+
+    ignore_value(virAsprintf(&path, "%s/%s.xml",
+                             virStorageBackendFileSystemCacheDir,
+                             pool->def->name));
+    return path;
+}
+
+
+/**
+ * virStorageBackendFileSystemCacheRemove:
+ * @pool: pool being undefined or deleted
+ *
+ * Drop the probe cache of @pool, so that it is neither left behind
+ * nor picked up by another pool defined later with the same name.
+ */
+void
+virStorageBackendFileSystemCacheRemove(virStoragePoolObjPtr pool)
+{
+    char *path;
+
+    if (!(path = virStorageBackendFileSystemCachePath(pool)))
+        return;
+
+    if (unlink(path) < 0 && errno != ENOENT) {
+        char ebuf[1024];
+        VIR_WARN("Failed to remove probe cache '%s': %s",
+                 path, virStrerror(errno, ebuf, sizeof(ebuf)));
+    }
+    VIR_FREE(path);
+}
+
+
+static int
+virStorageBackendFileSystemCacheParseEntry(xmlXPathContextPtr ctxt,
+                                           virHashTablePtr cache)
+{
+    virStorageFSCacheEntryPtr entry = NULL;
+    unsigned long long mtime_nsec, ctime_nsec;
+    unsigned long long mtime_sec, ctime_sec;
+    char *name = NULL;
+    char *format = NULL;
+    char *features = NULL;
+    int ret = -1;
+
+    if (VIR_ALLOC(entry) < 0)
+        goto cleanup;
+
+    if (!(name = virXPathString("string(./@name)", ctxt)) ||
+        !(format = virXPathString("string(./format)", ctxt)) ||
+        virXPathULongLong("string(./@dev)", ctxt, &entry->dev) < 0 ||
+        virXPathULongLong("string(./@ino)", ctxt, &entry->ino) < 0 ||
+        virXPathULongLong("string(./@size)", ctxt, &entry->size) < 0 ||
+        virXPathULongLong("string(./@mtime)", ctxt, &mtime_sec) < 0 ||
+        virXPathULongLong("string(./@mtime_nsec)", ctxt, &mtime_nsec) < 0 ||
+        virXPathULongLong("string(./@ctime)", ctxt, &ctime_sec) < 0 ||
+        virXPathULongLong("string(./@ctime_nsec)", ctxt, &ctime_nsec) < 0 ||
+        virXPathULongLong("string(./capacity)", ctxt, &entry->capacity) < 0)
+        goto cleanup;
+
+    entry->mtime.tv_sec = mtime_sec;
+    entry->mtime.tv_nsec = mtime_nsec;
+    entry->ctime.tv_sec = ctime_sec;
+    entry->ctime.tv_nsec = ctime_nsec;
+
+    if ((entry->format = virStorageFileFormatTypeFromString(format)) < 0)
+        goto cleanup;
+
+    entry->compat = virXPathString("string(./compat)", ctxt);
+
+    /* An empty feature set differs from none at all */
+    if (virXPathBoolean("boolean(./features)", ctxt) > 0) {
+        if (!(features = virXPathString("string(./features)", ctxt))) {
+            if (!(entry->features =
+                  virBitmapNew(VIR_STORAGE_FILE_FEATURE_LAST)))
+                goto cleanup;
+        } else if (virBitmapParse(features, 0, &entry->features,
+                                  VIR_STORAGE_FILE_FEATURE_LAST) < 0) {
+            goto cleanup;
+        }
+    }
+
+    if ((entry->backingStore = virXPathString("string(./backingStore)",
+                                              ctxt))) {
+        VIR_FREE(format);
+        if (!(format = virXPathString("string(./backingStore/@format)",
+                                      ctxt)) ||
+            (entry->backingStoreFormat =
+             virStorageFileFormatTypeFromString(format)) < 0)
+            goto cleanup;
+    }
+
+    if (virHashAddEntry(cache, name, entry) < 0)
+        goto cleanup;
+    entry = NULL;
+
+    ret = 0;
+ cleanup:
+    virStorageBackendFileSystemCacheEntryFree(entry, NULL);
+    VIR_FREE(name);
+    VIR_FREE(format);
+    VIR_FREE(features);
+    return ret;
+}
+
+
+/*
+ * Load the probe cache of @pool. A missing, stale or unparsable cache
+ * is not an error, it merely means that all volumes get probed again.
+ */
+static virHashTablePtr
+virStorageBackendFileSystemCacheLoad(virStoragePoolObjPtr pool)
+{
+    virHashTablePtr cache = NULL;
+    xmlDocPtr xml = NULL;
+    xmlXPathContextPtr ctxt = NULL;
+    xmlNodePtr *nodes = NULL;
+    char *path = NULL;
+    char *target = NULL;
+    int n;
+    size_t i;
+
+    if (!(cache = virHashCreate(256,
+                                virStorageBackendFileSystemCacheEntryFree)))
+        return NULL;
+
+    if (!(path = virStorageBackendFileSystemCachePath(pool)) ||
+        !virFileExists(path))
+        goto cleanup;
+
+    if (!(xml = virXMLParseFileCtxt(path, &ctxt)))
+        goto error;
+
+    if (!(target = virXPathString("string(/poolcache/@path)", ctxt)) ||
+        STRNEQ(target, pool->def->target.path)) {
+        VIR_DEBUG("Ignoring probe cache '%s' of a different target", path);
+        goto cleanup;
+    }
+
+    if ((n = virXPathNodeSet("/poolcache/volume", ctxt, &nodes)) < 0)
+        goto error;
+
+    for (i = 0; i < n; i++) {
+        ctxt->node = nodes[i];
+        if (virStorageBackendFileSystemCacheParseEntry(ctxt, cache) < 0)
+            goto error;
+    }
+
+ cleanup:
+    VIR_FREE(nodes);
+    VIR_FREE(target);
+    VIR_FREE(path);
+    xmlXPathFreeContext(ctxt);
+    xmlFreeDoc(xml);
+    return cache;
+
+ error:
+    VIR_WARN("Ignoring unusable probe cache '%s'", NULLSTR(path));
+    virResetLastError();
+    virHashRemoveAll(cache);
+    goto cleanup;
+}
+
+
+typedef struct _virStorageFSProbeJob virStorageFSProbeJob;
+typedef virStorageFSProbeJob *virStorageFSProbeJobPtr;
+struct _virStorageFSProbeJob {
+    virStorageVolDefPtr vol;
+    /* Result of the previous probe, NULL if there's none */
+    virStorageFSCacheEntryPtr cached;
+    struct stat sb;
+    bool cacheable;
+
+    int rc;
+    virErrorPtr err;
+};
+
+typedef struct _virStorageFSProbeData virStorageFSProbeData;
+typedef virStorageFSProbeData *virStorageFSProbeDataPtr;
+struct _virStorageFSProbeData {
+    virStorageFSProbeJobPtr jobs;
+    size_t njobs;
+    int next;
+};
+
+
+static int
+virStorageBackendFileSystemProbeCached(virStorageFSProbeJobPtr job)
+{
+    virStorageVolDefPtr vol = job->vol;
+    virStorageFSCacheEntryPtr cached = job->cached;
+    int rc;
+
+    /* Ownership, permissions and allocation are cheap to get and not
+     * covered by the cache, only skip reading the image header */
+    rc = virStorageBackendUpdateVolTargetInfo(&vol->target, true, false,
+                                              VIR_STORAGE_VOL_FS_PROBE_FLAGS);
+    if (rc < 0)
+        return rc;
+
+    vol->target.format = cached->format;
+    if (cached->capacity)
+        vol->target.capacity = cached->capacity;
+
+    if (VIR_STRDUP(vol->target.compat, cached->compat) < 0 ||
+        VIR_STRDUP(vol->backingStore.path, cached->backingStore) < 0)
+        return -1;
+
+    if (cached->features &&
+        !(vol->target.features = virBitmapNewCopy(cached->features)))
+        return -1;
+
+    vol->backingStore.format = cached->backingStoreFormat;
+    return 0;
+}
+
+
+static void
+virStorageBackendFileSystemProbeVol(virStorageFSProbeJobPtr job)
+{
+    virStorageVolDefPtr vol = job->vol;
+    char *backingStore = NULL;
+    int backingStoreFormat = VIR_STORAGE_FILE_AUTO;
+    int rc;
+
+    if (stat(vol->target.path, &job->sb) < 0) {
+        /* Dangling symlinks and the like are skipped by the probe */
+        job->cached = NULL;
+    } else {
+        job->cacheable = true;
+    }
+
+    if (job->cached &&
+        virStorageBackendFileSystemCacheEntryMatch(job->cached, &job->sb)) {
+        VIR_DEBUG("Using cached probe result for '%s'", vol->target.path);
+        rc = virStorageBackendFileSystemProbeCached(job);
+    } else {
+        job->cached = NULL;
+        rc = virStorageBackendProbeTarget(&vol->target,
+                                          &backingStore,
+                                          &backingStoreFormat,
+                                          &vol->target.encryption);
+        if (rc == -3) {
+            /* The backing file is currently unavailable, its format is not
+             * explicitly specified, the probe to auto detect the format
+             * failed: continue with faked RAW format, since AUTO will
+             * break virStorageVolTargetDefFormat() generating the line
+             * <format type='...'/>. Probe it again next time. */
+            backingStoreFormat = VIR_STORAGE_FILE_RAW;
+            job->cacheable = false;
+            rc = 0;
+        }
+
+        vol->backingStore.path = backingStore;
+        vol->backingStore.format = backingStoreFormat;
+
+        /* The secret is looked up on demand, don't bother caching */
+        if (vol->target.encryption)
+            job->cacheable = false;
+    }
+
+    if (rc < 0) {
+        /* Silently ignore non-regular files,
+         * eg '.' '..', 'lost+found', dangling symbolic link */
+        if (rc != -2)
+            job->err = virSaveLastError();
+        job->rc = rc;
+        return;
+    }
+
+    /* directory based volume */
+    if (vol->target.format == VIR_STORAGE_FILE_DIR)
+        vol->type = VIR_STORAGE_VOL_DIR;
+
+    if (vol->backingStore.path != NULL) {
+        ignore_value(virStorageBackendUpdateVolTargetInfo(
+                                           &vol->backingStore, true, false,
+                                           VIR_STORAGE_VOL_OPEN_DEFAULT));
+        /* If this failed, the backing file is currently unavailable,
+         * the capacity, allocation, owner, group and mode are unknown.
+         * An error message was raised, but we just continue. */
+    }
+
+    job->rc = 0;
+}
+
+
+static void
+virStorageBackendFileSystemProbeWorker(void *opaque)
+{
+    virStorageFSProbeDataPtr data = opaque;
+    int i;
+
+    while ((i = virAtomicIntAdd(&data->next, 1)) < data->njobs)
+        virStorageBackendFileSystemProbeVol(&data->jobs[i]);
+}
+
+
+/*
+ * Probe all volumes of @data, in parallel if there are enough of them.
+ * Each probe mostly waits for I/O, which on network file systems
+ * easily dominates the time a refresh holds the pool locked.
+ */
+static void
+virStorageBackendFileSystemProbeAll(virStorageFSProbeDataPtr data)
+{
+    virThread threads[VIR_STORAGE_FS_REFRESH_WORKERS];
+    size_t nthreads = 0;
+    size_t i;
+
+    for (i = 0; i < VIR_STORAGE_FS_REFRESH_WORKERS; i++) {
+        /* The calling thread does its share of the work too */
+        if (i + 1 >= data->njobs)
+            break;
+
+        if (virThreadCreate(&threads[nthreads], true,
+                            virStorageBackendFileSystemProbeWorker,
+                            data) < 0) {
+            /* Whatever threads we have will do the work */
+            VIR_WARN("Unable to create volume probe thread");
+            virResetLastError();
+            break;
+        }
+        nthreads++;
+    }
+
+    /* Also takes care of everything if no thread could be created */
+    virStorageBackendFileSystemProbeWorker(data);
+
+    for (i = 0; i < nthreads; i++)
+        virThreadJoin(&threads[i]);
+}
+
+
+static void
+virStorageBackendFileSystemCacheSave(virStoragePoolObjPtr pool,
+                                     virStorageFSProbeDataPtr data)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    char *path = NULL;
+    char *xml = NULL;
+    char *features = NULL;
+    size_t i;
+
+    if (!(path = virStorageBackendFileSystemCachePath(pool)))
+        return;
+
+    virBufferAddLit(&buf, "<poolcache");
+    virBufferEscapeString(&buf, " path='%s'", pool->def->target.path);
+    virBufferAddLit(&buf, ">\n");
+    virBufferAdjustIndent(&buf, 2);
+
+    for (i = 0; i < data->njobs; i++) {
+        virStorageFSProbeJobPtr job = &data->jobs[i];
+        virStorageVolDefPtr vol = job->vol;
+        struct timespec mtime = get_stat_mtime(&job->sb);
+        struct timespec ctime = get_stat_ctime(&job->sb);
+
+        if (job->rc < 0 || !job->cacheable)
+            continue;
+
+        virBufferEscapeString(&buf, "<volume name='%s'", vol->name);
+        virBufferAsprintf(&buf, " dev='%llu' ino='%llu' size='%llu'",
+                          (unsigned long long) job->sb.st_dev,
+                          (unsigned long long) job->sb.st_ino,
+                          (unsigned long long) job->sb.st_size);
+        virBufferAsprintf(&buf, " mtime='%llu' mtime_nsec='%ld'",
+                          (unsigned long long) mtime.tv_sec, mtime.tv_nsec);
+        virBufferAsprintf(&buf, " ctime='%llu' ctime_nsec='%ld'>\n",
+                          (unsigned long long) ctime.tv_sec, ctime.tv_nsec);
+        virBufferAdjustIndent(&buf, 2);
+
+        virBufferAsprintf(&buf, "<format>%s</format>\n",
+                          virStorageFileFormatTypeToString(vol->target.format));
+        virBufferAsprintf(&buf, "<capacity>%llu</capacity>\n",
+                          vol->target.capacity);
+        virBufferEscapeString(&buf, "<compat>%s</compat>\n",
+                              vol->target.compat);
+
+        if (vol->target.features) {
+            if (!(features = virBitmapFormat(vol->target.features)))
+                goto error;
+            virBufferEscapeString(&buf, "<features>%s</features>\n", features);
+            VIR_FREE(features);
+        }
+
+        if (vol->backingStore.path) {
+            int format = vol->backingStore.format;
+
+            virBufferAsprintf(&buf, "<backingStore format='%s'>",
+                              virStorageFileFormatTypeToString(format));
+            virBufferEscapeString(&buf, "%s</backingStore>\n",
+                                  vol->backingStore.path);
+        }
+
+        virBufferAdjustIndent(&buf, -2);
+        virBufferAddLit(&buf, "</volume>\n");
+    }
+
+    virBufferAdjustIndent(&buf, -2);
+    virBufferAddLit(&buf, "</poolcache>\n");
+
+    if (virBufferCheckError(&buf) < 0)
+        goto error;
+
+    xml = virBufferContentAndReset(&buf);
+
+    if (virFileMakePath(virStorageBackendFileSystemCacheDir) < 0) {
+        virReportSystemError(errno, _("cannot create directory '%s'"),
+                             virStorageBackendFileSystemCacheDir);
+        goto error;
+    }
+
+    if (virXMLSaveFile(path, NULL, NULL, xml) < 0)
+        goto error;
+
+ cleanup:
+    VIR_FREE(features);
+    VIR_FREE(xml);
+    VIR_FREE(path);
+    return;
+
+ error:
+    /* The next refresh will merely have to probe everything again */
+    VIR_WARN("Unable to save probe cache of pool '%s'", pool->def->name);
+    virResetLastError();
+    virBufferFreeAndReset(&buf);
+    unlink(path);
+    goto cleanup;
+}
+
+
+static int
+virStorageBackendFileSystemUpdateSize(virStoragePoolObjPtr pool)
+{
+    struct statvfs sb;
+
+    if (statvfs(pool->def->target.path, &sb) < 0) {
+        virReportSystemError(errno,
+                             _("cannot statvfs path '%s'"),
+                             pool->def->target.path);
+        return -1;
+    }
+    pool->def->capacity = ((unsigned long long)sb.f_frsize *
+                           (unsigned long long)sb.f_blocks);
+    pool->def->available = ((unsigned long long)sb.f_bfree *
+                            (unsigned long long)sb.f_frsize);
+    pool->def->allocation = pool->def->capacity - pool->def->available;
+
+    return 0;
+}
+
+
+/**
+ * virStorageBackendFileSystemProbeVolByName:
+ * @path: target directory of a directory based pool
+ * @name: name of a file in @path
+ * @vol: filled with the volume found in the file
+ *
+ * Probe the file @name without touching the pool, so that no lock needs
+ * to be held meanwhile. @vol is set to NULL if the file is gone or not
+ * a volume.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendFileSystemProbeVolByName(const char *path,
+                                          const char *name,
+                                          virStorageVolDefPtr *vol)
+{
+    virStorageFSProbeJob job;
+    int ret = -1;
+
+    memset(&job, 0, sizeof(job));
+    *vol = NULL;
+
+    if (VIR_ALLOC(job.vol) < 0 ||
+        VIR_STRDUP(job.vol->name, name) < 0 ||
+        virAsprintf(&job.vol->target.path, "%s/%s", path, name) < 0 ||
+        VIR_STRDUP(job.vol->key, job.vol->target.path) < 0)
+        goto cleanup;
+
+    job.vol->type = VIR_STORAGE_VOL_FILE;
+    job.vol->target.format = VIR_STORAGE_FILE_RAW;
+
+    virStorageBackendFileSystemProbeVol(&job);
+
+    if (job.rc == -2) {
+        /* Gone, or no longer something we consider a volume */
+        ret = 0;
+    } else if (job.rc < 0) {
+        virSetError(job.err);
+    } else {
+        *vol = job.vol;
+        job.vol = NULL;
+        ret = 0;
+    }
+
+ cleanup:
+    virStorageVolDefFree(job.vol);
+    virFreeError(job.err);
+    return ret;
+}
+
+
+/**
+ * virStorageBackendFileSystemUpdateVol:
+ * @pool: an active directory based pool
+ * @name: name of a file in the pool's target directory
+ * @vol: what virStorageBackendFileSystemProbeVolByName found in it
+ *
+ * Bring the pool's volume @name in line with @vol: add or replace the
+ * volume, or drop it if @vol is NULL. Volumes which libvirt is currently
+ * building or copying from are left alone. Pool sizing is updated as
+ * well. Takes over @vol in any case.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virStorageBackendFileSystemUpdateVol(virStoragePoolObjPtr pool,
+                                     const char *name,
+                                     virStorageVolDefPtr vol)
+{
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < pool->volumes.count; i++) {
+        if (STREQ(pool->volumes.objs[i]->name, name))
+            break;
+    }
+
+    if (i < pool->volumes.count &&
+        (pool->volumes.objs[i]->building || pool->volumes.objs[i]->in_use)) {
+        VIR_DEBUG("Volume '%s' is busy, ignoring change", name);
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (!vol) {
+        if (i < pool->volumes.count) {
+            VIR_DEBUG("Removing volume '%s' from pool '%s'",
+                      name, pool->def->name);
+            virStorageVolDefFree(pool->volumes.objs[i]);
+            VIR_DELETE_ELEMENT(pool->volumes.objs, i, pool->volumes.count);
+        }
+    } else if (i < pool->volumes.count) {
+        VIR_DEBUG("Updating volume '%s' of pool '%s'", name, pool->def->name);
+        virStorageVolDefFree(pool->volumes.objs[i]);
+        pool->volumes.objs[i] = vol;
+        vol = NULL;
+    } else {
+        VIR_DEBUG("Adding volume '%s' to pool '%s'", name, pool->def->name);
+        if (VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count,
+                               vol) < 0)
+            goto cleanup;
+    }
+
+    if (virStorageBackendFileSystemUpdateSize(pool) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virStorageVolDefFree(vol);
+    return ret;
+}
+
+
 /**
  * Iterate over the pool's directory and enumerate all disk images
  * within it. This is non-recursive.
@@ -832,9 +1492,13 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
 {
     DIR *dir;
     struct dirent *ent;
-    struct statvfs sb;
     virStorageVolDefPtr vol = NULL;
+    virStorageFSProbeData data = { NULL, 0, 0 };
+    virStorageFSProbeJob job;
+    virHashTablePtr cache = NULL;
     int direrr;
+    size_t i;
+    int ret = -1;
 
     if (!(dir = opendir(pool->def->target.path))) {
         virReportSystemError(errno,
@@ -843,11 +1507,10 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
         goto cleanup;
     }
 
-    while ((direrr = virDirRead(dir, &ent, pool->def->target.path)) > 0) {
-        int ret;
-        char *backingStore;
-        int backingStoreFormat;
+    if (!(cache = virStorageBackendFileSystemCacheLoad(pool)))
+        goto cleanup;
 
+    while ((direrr = virDirRead(dir, &ent, pool->def->target.path)) > 0) {
         if (VIR_ALLOC(vol) < 0)
             goto cleanup;
 
@@ -864,71 +1527,61 @@ virStorageBackendFileSystemRefresh(virConnectPtr conn ATTRIBUTE_UNUSED,
         if (VIR_STRDUP(vol->key, vol->target.path) < 0)
             goto cleanup;
 
-        if ((ret = virStorageBackendProbeTarget(&vol->target,
-                                                &backingStore,
-                                                &backingStoreFormat,
-                                                &vol->target.encryption)) < 0) {
-            if (ret == -2) {
-                /* Silently ignore non-regular files,
-                 * eg '.' '..', 'lost+found', dangling symbolic link */
-                virStorageVolDefFree(vol);
-                vol = NULL;
-                continue;
-            } else if (ret == -3) {
-                /* The backing file is currently unavailable, its format is not
-                 * explicitly specified, the probe to auto detect the format
-                 * failed: continue with faked RAW format, since AUTO will
-                 * break virStorageVolTargetDefFormat() generating the line
-                 * <format type='...'/>. */
-                backingStoreFormat = VIR_STORAGE_FILE_RAW;
-            } else
-                goto cleanup;
-        }
+        memset(&job, 0, sizeof(job));
+        job.vol = vol;
+        job.cached = virHashLookup(cache, vol->name);
 
-        /* directory based volume */
-        if (vol->target.format == VIR_STORAGE_FILE_DIR)
-            vol->type = VIR_STORAGE_VOL_DIR;
+        if (VIR_APPEND_ELEMENT(data.jobs, data.njobs, job) < 0)
+            goto cleanup;
+        vol = NULL;
+    }
+    if (direrr < 0)
+        goto cleanup;
+    closedir(dir);
+    dir = NULL;
+
+    virStorageBackendFileSystemProbeAll(&data);
 
-        if (backingStore != NULL) {
-            vol->backingStore.path = backingStore;
-            vol->backingStore.format = backingStoreFormat;
+    for (i = 0; i < data.njobs; i++) {
+        if (data.jobs[i].rc == -2)
+            continue;
 
-            ignore_value(virStorageBackendUpdateVolTargetInfo(
-                                               &vol->backingStore, true, false,
-                                               VIR_STORAGE_VOL_OPEN_DEFAULT));
-            /* If this failed, the backing file is currently unavailable,
-             * the capacity, allocation, owner, group and mode are unknown.
-             * An error message was raised, but we just continue. */
+        if (data.jobs[i].rc < 0) {
+            virSetError(data.jobs[i].err);
+            goto cleanup;
         }
+    }
 
+    virStorageBackendFileSystemCacheSave(pool, &data);
 
-        if (VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count, vol) < 0)
+    for (i = 0; i < data.njobs; i++) {
+        if (data.jobs[i].rc < 0)
+            continue;
+
+        /* Clears data.jobs[i].vol, the pool owns the volume now */
+        if (VIR_APPEND_ELEMENT(pool->volumes.objs, pool->volumes.count,
+                               data.jobs[i].vol) < 0)
             goto cleanup;
     }
-    if (direrr < 0)
-        goto cleanup;
-    closedir(dir);
 
-    if (statvfs(pool->def->target.path, &sb) < 0) {
-        virReportSystemError(errno,
-                             _("cannot statvfs path '%s'"),
-                             pool->def->target.path);
-        return -1;
-    }
-    pool->def->capacity = ((unsigned long long)sb.f_frsize *
-                           (unsigned long long)sb.f_blocks);
-    pool->def->available = ((unsigned long long)sb.f_bfree *
-                            (unsigned long long)sb.f_frsize);
-    pool->def->allocation = pool->def->capacity - pool->def->available;
+    if (virStorageBackendFileSystemUpdateSize(pool) < 0)
+        goto cleanup;
 
-    return 0;
+    ret = 0;
 
  cleanup:
     if (dir)
         closedir(dir);
     virStorageVolDefFree(vol);
-    virStoragePoolObjClearVols(pool);
-    return -1;
+    for (i = 0; i < data.njobs; i++) {
+        virStorageVolDefFree(data.jobs[i].vol);
+        virFreeError(data.jobs[i].err);
+    }
+    VIR_FREE(data.jobs);
+    virHashFree(cache);
+    if (ret < 0)
+        virStoragePoolObjClearVols(pool);
+    return ret;
 }
 
 
@@ -978,6 +1631,8 @@ virStorageBackendFileSystemDelete(virConnectPtr conn ATTRIBUTE_UNUSED,
         return -1;
     }
 
+    virStorageBackendFileSystemCacheRemove(pool);
+
     return 0;
 }
 
@@ -38,6 +38,15 @@ typedef enum {
 } virStoragePoolProbeResult;
 extern virStorageBackend virStorageBackendDirectory;
 
+int virStorageBackendFileSystemSetCacheDir(const char *dir);
+void virStorageBackendFileSystemCacheRemove(virStoragePoolObjPtr pool);
+int virStorageBackendFileSystemProbeVolByName(const char *path,
+                                              const char *name,
+                                              virStorageVolDefPtr *vol);
+int virStorageBackendFileSystemUpdateVol(virStoragePoolObjPtr pool,
+                                         const char *name,
+                                         virStorageVolDefPtr vol);
+
 extern virStorageFileBackend virStorageFileBackendFile;
 extern virStorageFileBackend virStorageFileBackendBlock;
 #endif /* __VIR_STORAGE_BACKEND_FS_H__ */
@@ -69,6 +69,7 @@ virStorageBackendLogicalSetActive(virStoragePoolObjPtr pool,
 struct virStorageBackendLogicalPoolVolData {
     virStoragePoolObjPtr pool;
     virStorageVolDefPtr vol;
+    bool gotSize;
 };
 
 static int
@@ -89,6 +90,21 @@ virStorageBackendLogicalMakeVol(char **const groups,
     int err, nextents, nvars, ret = -1;
     const char *attrs = groups[9];
 
+    /* Every row carries the size of the volume group as well, which
+     * saves a separate vgs run when refreshing the whole pool */
+    if (data->vol == NULL && !data->gotSize) {
+        if (virStrToLong_ull(groups[10], NULL, 10,
+                             &pool->def->capacity) < 0 ||
+            virStrToLong_ull(groups[11], NULL, 10,
+                             &pool->def->available) < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("malformed volume group size value"));
+            return -1;
+        }
+        pool->def->allocation = pool->def->capacity - pool->def->available;
+        data->gotSize = true;
+    }
+
     /* Skip inactive volume */
     if (attrs[4] != 'a')
         return 0;
@@ -272,22 +288,31 @@ virStorageBackendLogicalMakeVol(char **const groups,
     return ret;
 }
 
+/*
+ * Fill in the volumes of @pool, or only @vol if it is not NULL. In the
+ * latter case lvs is asked about that single volume only, so picking up
+ * a newly created volume doesn't cost a scan of the whole volume group.
+ * Returns -1 on error, 0 otherwise; @gotSize tells whether the size of
+ * the volume group was filled in as well, which requires at least one
+ * volume to exist.
+ */
 static int
 virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
-                                virStorageVolDefPtr vol)
+                                virStorageVolDefPtr vol,
+                                bool *gotSize)
 {
     /*
      * # lvs --separator , --noheadings --units b --unbuffered --nosuffix --options \
-     * "lv_name,origin,uuid,devices,seg_size,vg_extent_size,size,lv_attr" VGNAME
+     * "lv_name,origin,uuid,devices,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free" VGNAME
      *
-     * RootLV,,06UgP5-2rhb-w3Bo-3mdR-WeoL-pytO-SAa2ky,/dev/hda2(0),5234491392,33554432,5234491392,-wi-ao
-     * SwapLV,,oHviCK-8Ik0-paqS-V20c-nkhY-Bm1e-zgzU0M,/dev/hda2(156),1040187392,33554432,1040187392,-wi-ao
-     * Test2,,3pg3he-mQsA-5Sui-h0i6-HNmc-Cz7W-QSndcR,/dev/hda2(219),1073741824,33554432,1073741824,owi-a-
-     * Test3,,UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht,/dev/hda2(251),2181038080,33554432,2181038080,-wi-a-
-     * Test3,Test2,UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht,/dev/hda2(187),1040187392,33554432,1040187392,swi-a-
+     * RootLV,,06UgP5-2rhb-w3Bo-3mdR-WeoL-pytO-SAa2ky,/dev/hda2(0),5234491392,33554432,5234491392,-wi-ao,10603200512,4328521728
+     * SwapLV,,oHviCK-8Ik0-paqS-V20c-nkhY-Bm1e-zgzU0M,/dev/hda2(156),1040187392,33554432,1040187392,-wi-ao,10603200512,4328521728
+     * Test2,,3pg3he-mQsA-5Sui-h0i6-HNmc-Cz7W-QSndcR,/dev/hda2(219),1073741824,33554432,1073741824,owi-a-,10603200512,4328521728
+     * Test3,,UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht,/dev/hda2(251),2181038080,33554432,2181038080,-wi-a-,10603200512,4328521728
+     * Test3,Test2,UB5hFw-kmlm-LSoX-EI1t-ioVd-h7GL-M0W8Ht,/dev/hda2(187),1040187392,33554432,1040187392,swi-a-,10603200512,4328521728
      *
      * Pull out name, origin, & uuid, device, device extent start #,
-     * segment size, extent size, size, attrs
+     * segment size, extent size, size, attrs, VG size, VG free
      *
      * NB can be multiple rows per volume if they have many extents
      *
@@ -299,16 +324,17 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
      *    striped, so "," is not a suitable separator either (rhbz 727474).
      */
     const char *regexes[] = {
-       "^\\s*(\\S+)#(\\S*)#(\\S+)#(\\S+)#(\\S+)#([0-9]+)#(\\S+)#([0-9]+)#([0-9]+)#(\\S+)#?\\s*$"
+       "^\\s*(\\S+)#(\\S*)#(\\S+)#(\\S+)#(\\S+)#([0-9]+)#(\\S+)#([0-9]+)#([0-9]+)#(\\S+)#([0-9]+)#([0-9]+)#?\\s*$"
     };
     int vars[] = {
-        10
+        12
     };
     int ret = -1;
     virCommandPtr cmd;
     struct virStorageBackendLogicalPoolVolData cbdata = {
         .pool = pool,
         .vol = vol,
+        .gotSize = false,
     };
 
     cmd = virCommandNewArgList(LVS,
@@ -318,9 +344,12 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                                "--unbuffered",
                                "--nosuffix",
                                "--options",
-                               "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr",
-                               pool->def->source.name,
+                               "lv_name,origin,uuid,devices,segtype,stripes,seg_size,vg_extent_size,size,lv_attr,vg_size,vg_free",
                                NULL);
+    if (vol)
+        virCommandAddArgFormat(cmd, "%s/%s", pool->def->source.name, vol->name);
+    else
+        virCommandAddArg(cmd, pool->def->source.name);
     if (virCommandRunRegex(cmd,
                            1,
                            regexes,
@@ -330,6 +359,9 @@ virStorageBackendLogicalFindLVs(virStoragePoolObjPtr pool,
                            "lvs") < 0)
         goto cleanup;
 
+    if (gotSize)
+        *gotSize = cbdata.gotSize;
+
     ret = 0;
  cleanup:
     virCommandFree(cmd);
@@ -584,14 +616,22 @@ virStorageBackendLogicalRefreshPool(virConnectPtr conn ATTRIBUTE_UNUSED,
         2
     };
     virCommandPtr cmd = NULL;
+    bool gotSize = false;
     int ret = -1;
 
     virFileWaitForDevices();
 
     /* Get list of all logical volumes */
-    if (virStorageBackendLogicalFindLVs(pool, NULL) < 0)
+    if (virStorageBackendLogicalFindLVs(pool, NULL, &gotSize) < 0)
         goto cleanup;
 
+    /* lvs reported the volume group size along with the volumes, an
+     * empty volume group needs to be asked about explicitly */
+    if (gotSize) {
+        ret = 0;
+        goto cleanup;
+    }
+
     cmd = virCommandNewArgList(VGS,
                                "--separator", ":",
                                "--noheadings",
@@ -791,7 +831,7 @@ virStorageBackendLogicalCreateVol(virConnectPtr conn,
     }
 
     /* Fill in data about this new vol */
-    if (virStorageBackendLogicalFindLVs(pool, vol) < 0) {
+    if (virStorageBackendLogicalFindLVs(pool, vol, NULL) < 0) {
         virReportSystemError(errno,
                              _("cannot find newly created volume '%s'"),
                              vol->target.path);
@@ -40,9 +40,16 @@
 #include "datatypes.h"
 #include "driver.h"
 #include "storage_driver.h"
+#include "storage_driverpriv.h"
 #include "storage_conf.h"
 #include "viralloc.h"
 #include "storage_backend.h"
+#if WITH_STORAGE_DIR
+# include "storage_backend_fs.h"
+#endif
+#if WITH_STORAGE_DIR && HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+#endif
 #include "virlog.h"
 #include "virfile.h"
 #include "fdstream.h"
@@ -50,6 +57,9 @@
 #include "virstring.h"
 #include "viraccessapicheck.h"
 #include "dirname.h"
+#include "virthread.h"
+#include "virtime.h"
+#include "stat-time.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -68,6 +78,409 @@ static void storageDriverUnlock(virStorageDriverStatePtr driver)
     virMutexUnlock(&driver->lock);
 }
 
+#if WITH_STORAGE_DIR && HAVE_SYS_INOTIFY_H
+/* Must be called with the pool locked */
+static void
+storagePoolWatchStop(virStoragePoolObjPtr pool)
+{
+    if (pool->watch >= 0) {
+        virEventRemoveHandle(pool->watch);
+        pool->watch = -1;
+    }
+    VIR_FORCE_CLOSE(pool->watchfd);
+    virHashFree(pool->watchDirty);
+    pool->watchDirty = NULL;
+    pool->watchOverflow = false;
+}
+
+
+static void
+storagePoolWatchFree(void *opaque)
+{
+    VIR_FREE(opaque);
+}
+
+
+/*
+ * Full refresh of a watched pool whose changes could not be tracked
+ * individually. Must be called with the pool locked, returns -1 if the
+ * refresh failed and the pool was stopped. The caller has to remove
+ * the pool then if it is transient.
+ */
+static int
+storagePoolWatchRefresh(virStoragePoolObjPtr pool)
+{
+    virStorageBackendPtr backend;
+
+    pool->watchOverflow = false;
+    virHashRemoveAll(pool->watchDirty);
+
+    if (!(backend = virStorageBackendForType(pool->def->type)))
+        goto error;
+
+    VIR_DEBUG("Refreshing pool '%s' after losing track of changes",
+              pool->def->name);
+
+    virStoragePoolObjClearVols(pool);
+    if (backend->refreshPool(NULL, pool) < 0) {
+        if (backend->stopPool)
+            backend->stopPool(NULL, pool);
+        goto error;
+    }
+
+    return 0;
+
+ error:
+    VIR_ERROR(_("Failed to refresh storage pool '%s': %s"),
+              pool->def->name, virGetLastErrorMessage());
+    storagePoolWatchStop(pool);
+    pool->active = 0;
+    return -1;
+}
+
+
+/*
+ * Reads the pending events of the watch on @pool and marks the files
+ * they name dirty. Stops the watch if the target directory went away.
+ * Must be called with the pool locked, returns true if there are
+ * changes to catch up on.
+ */
+static bool
+storagePoolWatchRead(virStoragePoolObjPtr pool)
+{
+    char buf[4096];
+    struct inotify_event *e;
+    ssize_t got;
+    char *tmp;
+    bool gone = false;
+
+    while (true) {
+        if ((got = read(pool->watchfd, buf, sizeof(buf))) < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN) {
+                VIR_WARN("Unable to read changes of pool '%s'",
+                         pool->def->name);
+                pool->watchOverflow = true;
+            }
+            break;
+        }
+
+        for (tmp = buf; tmp + sizeof(*e) <= buf + got;
+             tmp += sizeof(*e) + e->len) {
+            VIR_WARNINGS_NO_CAST_ALIGN
+            e = (struct inotify_event *)tmp;
+            VIR_WARNINGS_RESET
+
+            if (e->mask & IN_Q_OVERFLOW)
+                pool->watchOverflow = true;
+            if (e->mask & (IN_DELETE_SELF | IN_MOVE_SELF |
+                           IN_UNMOUNT | IN_IGNORED))
+                gone = true;
+
+            if (pool->watchOverflow || gone || !e->len)
+                continue;
+
+            if (virHashUpdateEntry(pool->watchDirty, e->name,
+                                   (void *) 1) < 0) {
+                /* Lost this one, catch up with a full refresh */
+                virResetLastError();
+                pool->watchOverflow = true;
+            }
+        }
+    }
+
+    if (gone) {
+        VIR_WARN("Target of storage pool '%s' went away, "
+                 "not watching it anymore", pool->def->name);
+        storagePoolWatchStop(pool);
+        return false;
+    }
+
+    return pool->watchOverflow || virHashSize(pool->watchDirty) > 0;
+}
+
+
+/*
+ * Re-probes the files marked dirty on @pool and updates the volume
+ * list accordingly. If @unlock is true, the pool is unlocked while
+ * probing and looked up again by @name afterwards, the return value
+ * is the pool then, locked, or NULL if it went away meanwhile.
+ */
+static virStoragePoolObjPtr
+storagePoolWatchUpdateDirty(virStorageDriverStatePtr driver,
+                            virStoragePoolObjPtr pool,
+                            const char *name,
+                            bool unlock)
+{
+    virHashTablePtr dirty = pool->watchDirty;
+    virHashKeyValuePairPtr files = NULL;
+    virStorageVolDefPtr *vols = NULL;
+    char *path = NULL;
+    size_t nfiles;
+    size_t i;
+
+    if (!(pool->watchDirty = virHashCreate(16, NULL))) {
+        pool->watchDirty = dirty;
+        goto error;
+    }
+
+    nfiles = virHashSize(dirty);
+    if (!(files = virHashGetItems(dirty, NULL)) ||
+        VIR_ALLOC_N(vols, nfiles) < 0 ||
+        VIR_STRDUP(path, pool->def->target.path) < 0)
+        goto error;
+
+    if (unlock)
+        virStoragePoolObjUnlock(pool);
+
+    for (i = 0; i < nfiles; i++) {
+        if (virStorageBackendFileSystemProbeVolByName(path, files[i].key,
+                                                      &vols[i]) < 0) {
+            /* Leave the volume as it is */
+            VIR_WARN("Unable to probe volume '%s' of pool '%s': %s",
+                     (const char *) files[i].key, name,
+                     virGetLastErrorMessage());
+            virResetLastError();
+            files[i].key = NULL;
+        }
+    }
+
+    if (unlock) {
+        storageDriverLock(driver);
+        pool = virStoragePoolObjFindByName(&driver->pools, name);
+        storageDriverUnlock(driver);
+
+        if (pool && (!virStoragePoolObjIsActive(pool) || pool->watch < 0 ||
+                     STRNEQ(path, pool->def->target.path))) {
+            virStoragePoolObjUnlock(pool);
+            pool = NULL;
+        }
+    }
+
+    for (i = 0; pool && i < nfiles; i++) {
+        if (!files[i].key)
+            continue;
+
+        if (virStorageBackendFileSystemUpdateVol(pool, files[i].key,
+                                                 vols[i]) < 0) {
+            VIR_WARN("Unable to update volume '%s' of pool '%s': %s",
+                     (const char *) files[i].key, name,
+                     virGetLastErrorMessage());
+            virResetLastError();
+        }
+        vols[i] = NULL;
+    }
+
+ cleanup:
+    for (i = 0; vols && i < nfiles; i++)
+        virStorageVolDefFree(vols[i]);
+    VIR_FREE(vols);
+    VIR_FREE(files);
+    VIR_FREE(path);
+    virHashFree(dirty);
+    return pool;
+
+ error:
+    /* Lost track of the dirty files, catch up with a full refresh */
+    virResetLastError();
+    pool->watchOverflow = true;
+    if (dirty == pool->watchDirty)
+        dirty = NULL;
+    goto cleanup;
+}
+
+
+/*
+ * Catches up with the changes seen by a healthy watch of @pool, so that
+ * an explicit refresh only needs to re-probe the files which changed.
+ * Returns false if the pool is not watched, or if the watch lost track
+ * of changes, the caller has to rescan the whole pool then. Must be
+ * called with the driver and the pool locked.
+ */
+static bool
+storagePoolWatchSync(virStorageDriverStatePtr driver,
+                     virStoragePoolObjPtr pool)
+{
+    if (pool->watch < 0)
+        return false;
+
+    if (storagePoolWatchRead(pool) && !pool->watchOverflow)
+        storagePoolWatchUpdateDirty(driver, pool, pool->def->name, false);
+
+    if (pool->watch < 0)
+        return false;
+
+    if (pool->watchOverflow) {
+        pool->watchOverflow = false;
+        virHashRemoveAll(pool->watchDirty);
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Catches up with the changes read by storagePoolWatchEvent. Runs in
+ * the watch worker, probing files with neither the driver nor the pool
+ * locked, so that neither the event loop nor other APIs have to wait.
+ */
+static void
+storagePoolWatchHandler(void *data, void *opaque)
+{
+    char *name = data;
+    virStorageDriverStatePtr driver = opaque;
+    virStoragePoolObjPtr pool;
+
+    storageDriverLock(driver);
+    pool = virStoragePoolObjFindByName(&driver->pools, name);
+    storageDriverUnlock(driver);
+
+    if (!pool)
+        goto cleanup;
+
+    if (!virStoragePoolObjIsActive(pool) || pool->watch < 0)
+        goto cleanup;
+
+    if (!pool->watchOverflow && virHashSize(pool->watchDirty) > 0)
+        pool = storagePoolWatchUpdateDirty(driver, pool, name, true);
+
+    if (pool && pool->watchOverflow &&
+        storagePoolWatchRefresh(pool) < 0 && !pool->configFile) {
+        virStoragePoolObjUnlock(pool);
+
+        storageDriverLock(driver);
+        if ((pool = virStoragePoolObjFindByName(&driver->pools, name)) &&
+            !virStoragePoolObjIsActive(pool) && !pool->configFile) {
+            virStoragePoolObjRemove(&driver->pools, pool);
+            pool = NULL;
+        }
+        storageDriverUnlock(driver);
+    }
+
+ cleanup:
+    if (pool)
+        virStoragePoolObjUnlock(pool);
+    VIR_FREE(name);
+}
+
+
+static void
+storagePoolWatchEvent(int watch,
+                      int fd ATTRIBUTE_UNUSED,
+                      int events ATTRIBUTE_UNUSED,
+                      void *opaque)
+{
+    const char *name = opaque;
+    virStoragePoolObjPtr pool;
+    char *job = NULL;
+
+    storageDriverLock(driverState);
+    pool = virStoragePoolObjFindByName(&driverState->pools, name);
+    storageDriverUnlock(driverState);
+
+    if (!pool)
+        return;
+
+    if (pool->watch != watch || !virStoragePoolObjIsActive(pool))
+        goto cleanup;
+
+    if (!storagePoolWatchRead(pool))
+        goto cleanup;
+
+    if (VIR_STRDUP(job, name) < 0 ||
+        virThreadPoolSendJob(driverState->watchPool, 0, job) < 0) {
+        VIR_WARN("Unable to handle changes of pool '%s': %s",
+                 name, virGetLastErrorMessage());
+        virResetLastError();
+        VIR_FREE(job);
+    }
+
+ cleanup:
+    virStoragePoolObjUnlock(pool);
+}
+
+
+/*
+ * Start keeping the volume list of @pool current by watching its
+ * target directory, if the pool asks for it. Failing to set up the
+ * watch is not fatal, the pool then needs explicit refreshes as usual.
+ * Must be called with the pool locked.
+ */
+static void
+storagePoolWatchStart(virStoragePoolObjPtr pool)
+{
+    char *name = NULL;
+
+    if (!pool->def->refreshWatch || pool->watch >= 0)
+        return;
+
+    if (!(pool->watchDirty = virHashCreate(16, NULL)))
+        goto error;
+
+    if ((pool->watchfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+        virReportSystemError(errno, "%s", _("unable to initialize inotify"));
+        goto error;
+    }
+
+    if (inotify_add_watch(pool->watchfd, pool->def->target.path,
+                          IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                          IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR) < 0) {
+        virReportSystemError(errno, _("unable to watch '%s'"),
+                             pool->def->target.path);
+        goto error;
+    }
+
+    if (VIR_STRDUP(name, pool->def->name) < 0)
+        goto error;
+
+    if ((pool->watch = virEventAddHandle(pool->watchfd,
+                                         VIR_EVENT_HANDLE_READABLE,
+                                         storagePoolWatchEvent,
+                                         name,
+                                         storagePoolWatchFree)) < 0) {
+        VIR_FREE(name);
+        goto error;
+    }
+
+    VIR_DEBUG("Watching target '%s' of pool '%s'",
+              pool->def->target.path, pool->def->name);
+    return;
+
+ error:
+    VIR_WARN("Not watching storage pool '%s': %s",
+             pool->def->name, virGetLastErrorMessage());
+    virResetLastError();
+    storagePoolWatchStop(pool);
+}
+
+#else /* !(WITH_STORAGE_DIR && HAVE_SYS_INOTIFY_H) */
+
+static void
+storagePoolWatchStop(virStoragePoolObjPtr pool ATTRIBUTE_UNUSED)
+{
+}
+
+static bool
+storagePoolWatchSync(virStorageDriverStatePtr driver ATTRIBUTE_UNUSED,
+                     virStoragePoolObjPtr pool ATTRIBUTE_UNUSED)
+{
+    return false;
+}
+
+static void
+storagePoolWatchStart(virStoragePoolObjPtr pool)
+{
+    if (pool->def->refreshWatch)
+        VIR_WARN("Watching storage pool '%s' is not supported "
+                 "on this platform", pool->def->name);
+}
+
+#endif /* !(WITH_STORAGE_DIR && HAVE_SYS_INOTIFY_H) */
+
+
 static void
 storageDriverAutostart(virStorageDriverStatePtr driver)
 {
@@ -130,6 +543,7 @@ storageDriverAutostart(virStorageDriverStatePtr driver)
                 continue;
             }
             pool->active = 1;
+            storagePoolWatchStart(pool);
         }
         virStoragePoolObjUnlock(pool);
     }
@@ -148,6 +562,7 @@ storageStateInitialize(bool privileged,
                        void *opaque ATTRIBUTE_UNUSED)
 {
     char *base = NULL;
+    char *cachedir = NULL;
 
     if (VIR_ALLOC(driverState) < 0)
         return -1;
@@ -159,12 +574,23 @@ storageStateInitialize(bool privileged,
     storageDriverLock(driverState);
 
     if (privileged) {
-        if (VIR_STRDUP(base, SYSCONFDIR "/libvirt") < 0)
+        if (VIR_STRDUP(base, SYSCONFDIR "/libvirt") < 0 ||
+            VIR_STRDUP(cachedir, LOCALSTATEDIR "/cache/libvirt/storage") < 0)
             goto error;
     } else {
+        char *usercache = NULL;
+
         base = virGetUserConfigDirectory();
         if (!base)
             goto error;
+
+        if (!(usercache = virGetUserCacheDirectory()))
+            goto error;
+        if (virAsprintf(&cachedir, "%s/storage", usercache) < 0) {
+            VIR_FREE(usercache);
+            goto error;
+        }
+        VIR_FREE(usercache);
     }
     driverState->privileged = privileged;
 
@@ -181,6 +607,20 @@ storageStateInitialize(bool privileged,
 
     VIR_FREE(base);
 
+#if WITH_STORAGE_DIR
+    /* Lets directory pools skip probing images which didn't change */
+    if (virStorageBackendFileSystemSetCacheDir(cachedir) < 0)
+        goto error;
+#endif
+    VIR_FREE(cachedir);
+
+#if WITH_STORAGE_DIR && HAVE_SYS_INOTIFY_H
+    if (!(driverState->watchPool = virThreadPoolNew(0, 1, 0,
+                                                    storagePoolWatchHandler,
+                                                    driverState)))
+        goto error;
+#endif
+
     if (virStoragePoolLoadAllConfigs(&driverState->pools,
                                      driverState->configDir,
                                      driverState->autostartDir) < 0)
@@ -191,6 +631,7 @@ storageStateInitialize(bool privileged,
 
  error:
     VIR_FREE(base);
+    VIR_FREE(cachedir);
     storageDriverUnlock(driverState);
     storageStateCleanup();
     return -1;
@@ -243,16 +684,34 @@ storageStateReload(void)
 static int
 storageStateCleanup(void)
 {
+    size_t i;
+
     if (!driverState)
         return -1;
 
     storageDriverLock(driverState);
 
+    for (i = 0; i < driverState->pools.count; i++) {
+        virStoragePoolObjPtr pool = driverState->pools.objs[i];
+
+        virStoragePoolObjLock(pool);
+        storagePoolWatchStop(pool);
+        virStoragePoolObjUnlock(pool);
+    }
+
+    /* Let a running watch job finish, it needs the driver lock */
+    storageDriverUnlock(driverState);
+    virThreadPoolFree(driverState->watchPool);
+    storageDriverLock(driverState);
+
     /* free inactive pools */
     virStoragePoolObjListFree(&driverState->pools);
 
     VIR_FREE(driverState->configDir);
     VIR_FREE(driverState->autostartDir);
+#if WITH_STORAGE_DIR
+    ignore_value(virStorageBackendFileSystemSetCacheDir(NULL));
+#endif
     storageDriverUnlock(driverState);
     virMutexDestroy(&driverState->lock);
     VIR_FREE(driverState);
@@ -640,6 +1099,7 @@ storagePoolCreateXML(virConnectPtr conn,
     }
     VIR_INFO("Creating storage pool '%s'", pool->def->name);
     pool->active = 1;
+    storagePoolWatchStart(pool);
 
     ret = virGetStoragePool(conn, pool->def->name, pool->def->uuid,
                             NULL, NULL);
@@ -748,6 +1208,10 @@ storagePoolUndefine(virStoragePoolPtr obj)
     VIR_FREE(pool->configFile);
     VIR_FREE(pool->autostartLink);
 
+#if WITH_STORAGE_DIR
+    virStorageBackendFileSystemCacheRemove(pool);
+#endif
+
     VIR_INFO("Undefining storage pool '%s'", pool->def->name);
     virStoragePoolObjRemove(&driver->pools, pool);
     pool = NULL;
@@ -797,6 +1261,7 @@ storagePoolCreate(virStoragePoolPtr obj,
 
     VIR_INFO("Starting up storage pool '%s'", pool->def->name);
     pool->active = 1;
+    storagePoolWatchStart(pool);
     ret = 0;
 
  cleanup:
@@ -876,9 +1341,13 @@ storagePoolDestroy(virStoragePoolPtr obj)
         goto cleanup;
     }
 
+    storagePoolWatchStop(pool);
+
     if (backend->stopPool &&
-        backend->stopPool(obj->conn, pool) < 0)
+        backend->stopPool(obj->conn, pool) < 0) {
+        storagePoolWatchStart(pool);
         goto cleanup;
+    }
 
     virStoragePoolObjClearVols(pool);
 
@@ -886,6 +1355,9 @@ storagePoolDestroy(virStoragePoolPtr obj)
     VIR_INFO("Shutting down storage pool '%s'", pool->def->name);
 
     if (pool->configFile == NULL) {
+#if WITH_STORAGE_DIR
+        virStorageBackendFileSystemCacheRemove(pool);
+#endif
         virStoragePoolObjRemove(&driver->pools, pool);
         pool = NULL;
     } else if (pool->newDef) {
@@ -989,11 +1461,21 @@ storagePoolRefresh(virStoragePoolPtr obj,
         goto cleanup;
     }
 
+    /* A healthy watch knows which files changed since the last refresh,
+     * there is no need to rescan the others */
+    if (storagePoolWatchSync(driver, pool)) {
+        VIR_DEBUG("Pool '%s' is watched, refreshed changed volumes only",
+                  pool->def->name);
+        ret = 0;
+        goto cleanup;
+    }
+
     virStoragePoolObjClearVols(pool);
     if (backend->refreshPool(obj->conn, pool) < 0) {
         if (backend->stopPool)
             backend->stopPool(obj->conn, pool);
 
+        storagePoolWatchStop(pool);
         pool->active = 0;
 
         if (pool->configFile == NULL) {
@@ -1474,6 +1956,20 @@ storageVolLookupByPath(virConnectPtr conn,
 }
 
 
+/* Drop cached image headers of a volume we are about to change */
+static void
+storageVolInvalidateMetadata(virStorageVolDefPtr vol)
+{
+    virStorageSource src = {
+        .type = VIR_STORAGE_TYPE_FILE,
+        .path = vol->target.path,
+    };
+
+    if (vol->type == VIR_STORAGE_VOL_FILE)
+        virStorageFileMetadataCacheInvalidate(&src);
+}
+
+
 static int
 storageVolDeleteInternal(virStorageVolPtr obj,
                          virStorageBackendPtr backend,
@@ -1492,6 +1988,8 @@ storageVolDeleteInternal(virStorageVolPtr obj,
         goto cleanup;
     }
 
+    storageVolInvalidateMetadata(vol);
+
     if (backend->deleteVol(obj->conn, pool, vol, flags) < 0)
         goto cleanup;
 
@@ -2092,6 +2590,8 @@ storageVolResize(virStorageVolPtr obj,
         goto cleanup;
     }
 
+    storageVolInvalidateMetadata(vol);
+
     if (backend->resizeVol(obj->conn, pool, vol, abs_capacity, flags) < 0)
         goto cleanup;
 
@@ -2347,6 +2847,8 @@ storageVolWipePattern(virStorageVolPtr obj,
         goto cleanup;
     }
 
+    storageVolInvalidateMetadata(vol);
+
     if (storageVolWipeInternal(vol, algorithm) == -1) {
         goto cleanup;
     }
@@ -2460,8 +2962,10 @@ storageConnectListAllStoragePools(virConnectPtr conn,
         goto cleanup;
 
     storageDriverLock(driver);
-    ret = virStoragePoolObjListExport(conn, driver->pools, pools,
-                                      virConnectListAllStoragePoolsCheckACL, flags);
+    ret = virStoragePoolObjListExport(conn, &driver->pools, &driver->lock,
+                                      pools,
+                                      virConnectListAllStoragePoolsCheckACLBulk,
+                                      flags);
     storageDriverUnlock(driver);
 
  cleanup:
@@ -2823,6 +3327,370 @@ virStorageFileAccess(virStorageSourcePtr src,
 }
 
 
+/*
+ * Host wide cache of image headers read while walking backing chains,
+ * keyed by the unique identifier of the image. An entry is only used
+ * while the image still has the same identity, size and timestamps.
+ * Images modified less than VIR_STORAGE_METADATA_CACHE_SETTLE_MS ago
+ * are never cached, since a rewrite within the timestamp granularity
+ * of the filesystem would otherwise go unnoticed. Once the headers
+ * take up more than VIR_STORAGE_METADATA_CACHE_MAX_BYTES, the least
+ * recently used ones are dropped.
+ */
+#define VIR_STORAGE_METADATA_CACHE_MAX_BYTES (8 * 1024 * 1024)
+#define VIR_STORAGE_METADATA_CACHE_SETTLE_MS 2000
+
+typedef struct _virStorageMetadataCacheEntry virStorageMetadataCacheEntry;
+typedef virStorageMetadataCacheEntry *virStorageMetadataCacheEntryPtr;
+struct _virStorageMetadataCacheEntry {
+    char *name;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+
+    char *buf;
+    ssize_t len;
+
+    /* LRU list, most recently used first */
+    virStorageMetadataCacheEntryPtr prev;
+    virStorageMetadataCacheEntryPtr next;
+};
+
+static virMutex virStorageMetadataCacheLock;
+static virHashTablePtr virStorageMetadataCache;
+static virStorageMetadataCacheEntryPtr virStorageMetadataCacheHead;
+static virStorageMetadataCacheEntryPtr virStorageMetadataCacheTail;
+static size_t virStorageMetadataCacheBytes;
+static size_t virStorageMetadataCacheMaxBytes =
+    VIR_STORAGE_METADATA_CACHE_MAX_BYTES;
+static unsigned int virStorageMetadataCacheSettleMs =
+    VIR_STORAGE_METADATA_CACHE_SETTLE_MS;
+
+static size_t
+virStorageMetadataCacheEntrySize(virStorageMetadataCacheEntryPtr entry)
+{
+    return sizeof(*entry) + entry->len;
+}
+
+/* Must be called with virStorageMetadataCacheLock held */
+static void
+virStorageMetadataCacheUnlink(virStorageMetadataCacheEntryPtr entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else if (virStorageMetadataCacheHead == entry)
+        virStorageMetadataCacheHead = entry->next;
+    else
+        return; /* not linked */
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        virStorageMetadataCacheTail = entry->prev;
+
+    entry->prev = entry->next = NULL;
+    virStorageMetadataCacheBytes -= virStorageMetadataCacheEntrySize(entry);
+}
+
+/* Must be called with virStorageMetadataCacheLock held */
+static void
+virStorageMetadataCacheLinkHead(virStorageMetadataCacheEntryPtr entry)
+{
+    entry->next = virStorageMetadataCacheHead;
+    if (virStorageMetadataCacheHead)
+        virStorageMetadataCacheHead->prev = entry;
+    else
+        virStorageMetadataCacheTail = entry;
+    virStorageMetadataCacheHead = entry;
+    virStorageMetadataCacheBytes += virStorageMetadataCacheEntrySize(entry);
+}
+
+static void
+virStorageMetadataCacheEntryFree(void *payload,
+                                 const void *name ATTRIBUTE_UNUSED)
+{
+    virStorageMetadataCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    virStorageMetadataCacheUnlink(entry);
+    VIR_FREE(entry->name);
+    VIR_FREE(entry->buf);
+    VIR_FREE(entry);
+}
+
+static int
+virStorageMetadataCacheOnceInit(void)
+{
+    if (virMutexInit(&virStorageMetadataCacheLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize mutex"));
+        return -1;
+    }
+
+    if (!(virStorageMetadataCache =
+          virHashCreate(64, virStorageMetadataCacheEntryFree)))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virStorageMetadataCache)
+
+
+static bool
+virStorageMetadataCacheEntryMatch(virStorageMetadataCacheEntryPtr entry,
+                                  const struct stat *st)
+{
+    struct timespec mtime = get_stat_mtime(st);
+    struct timespec ctime = get_stat_ctime(st);
+
+    return entry->dev == st->st_dev &&
+        entry->ino == st->st_ino &&
+        entry->size == st->st_size &&
+        entry->mtime.tv_sec == mtime.tv_sec &&
+        entry->mtime.tv_nsec == mtime.tv_nsec &&
+        entry->ctime.tv_sec == ctime.tv_sec &&
+        entry->ctime.tv_nsec == ctime.tv_nsec;
+}
+
+
+/**
+ * virStorageMetadataCacheLookup:
+ * @uniqueName: unique identifier of the image
+ * @st: current stat data of the image
+ * @buf: filled with a copy of the cached header
+ * @len: filled with the length of @buf
+ *
+ * Looks up the header of @uniqueName. An entry which doesn't match @st
+ * anymore is dropped.
+ *
+ * Returns 1 on a hit, 0 on a miss and -1 on error.
+ */
+int
+virStorageMetadataCacheLookup(const char *uniqueName,
+                              const struct stat *st,
+                              char **buf,
+                              ssize_t *len)
+{
+    virStorageMetadataCacheEntryPtr entry;
+    int ret = 0;
+
+    if (virStorageMetadataCacheInitialize() < 0)
+        return -1;
+
+    virMutexLock(&virStorageMetadataCacheLock);
+    if ((entry = virHashLookup(virStorageMetadataCache, uniqueName))) {
+        if (virStorageMetadataCacheEntryMatch(entry, st)) {
+            if (VIR_ALLOC_N(*buf, entry->len) < 0) {
+                ret = -1;
+            } else {
+                memcpy(*buf, entry->buf, entry->len);
+                *len = entry->len;
+                virStorageMetadataCacheUnlink(entry);
+                virStorageMetadataCacheLinkHead(entry);
+                ret = 1;
+            }
+        } else {
+            virHashRemoveEntry(virStorageMetadataCache, uniqueName);
+        }
+    }
+    virMutexUnlock(&virStorageMetadataCacheLock);
+
+    return ret;
+}
+
+
+/**
+ * virStorageMetadataCacheStore:
+ * @uniqueName: unique identifier of the image
+ * @st: stat data of the image at the time @buf was read
+ * @buf: the header
+ * @len: length of @buf
+ *
+ * Remembers the header of @uniqueName, unless the image changed too
+ * recently to be trusted. Failures are not reported, the header is just
+ * not cached then.
+ */
+void
+virStorageMetadataCacheStore(const char *uniqueName,
+                             const struct stat *st,
+                             const char *buf,
+                             ssize_t len)
+{
+    virStorageMetadataCacheEntryPtr entry = NULL;
+    unsigned long long now;
+    struct timespec mtime = get_stat_mtime(st);
+    struct timespec ctime = get_stat_ctime(st);
+    unsigned long long changed;
+
+    if (virStorageMetadataCacheInitialize() < 0 ||
+        virTimeMillisNow(&now) < 0) {
+        virResetLastError();
+        return;
+    }
+
+    changed = MAX(mtime.tv_sec * 1000ULL + mtime.tv_nsec / 1000000,
+                  ctime.tv_sec * 1000ULL + ctime.tv_nsec / 1000000);
+    if (now < changed + virStorageMetadataCacheSettleMs)
+        return;
+
+    if (VIR_ALLOC(entry) < 0 ||
+        VIR_STRDUP(entry->name, uniqueName) < 0 ||
+        VIR_ALLOC_N(entry->buf, len) < 0)
+        goto error;
+
+    memcpy(entry->buf, buf, len);
+    entry->len = len;
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = mtime;
+    entry->ctime = ctime;
+
+    virMutexLock(&virStorageMetadataCacheLock);
+    if (virStorageMetadataCacheEntrySize(entry) >
+        virStorageMetadataCacheMaxBytes ||
+        virHashUpdateEntry(virStorageMetadataCache, uniqueName, entry) < 0) {
+        virMutexUnlock(&virStorageMetadataCacheLock);
+        goto error;
+    }
+    virStorageMetadataCacheLinkHead(entry);
+
+    while (virStorageMetadataCacheBytes > virStorageMetadataCacheMaxBytes) {
+        VIR_DEBUG("dropping cached header of %s",
+                  virStorageMetadataCacheTail->name);
+        virHashRemoveEntry(virStorageMetadataCache,
+                           virStorageMetadataCacheTail->name);
+    }
+    virMutexUnlock(&virStorageMetadataCacheLock);
+    return;
+
+ error:
+    virResetLastError();
+    virStorageMetadataCacheEntryFree(entry, NULL);
+}
+
+
+/**
+ * virStorageMetadataCacheSetLimits:
+ * @maxBytes: how much memory cached headers may take up
+ * @settleMs: how long an image must be unchanged before it is cached
+ *
+ * Overrides the built-in limits of the header cache and empties it.
+ * Only meant for tests.
+ */
+void
+virStorageMetadataCacheSetLimits(size_t maxBytes,
+                                 unsigned int settleMs)
+{
+    if (virStorageMetadataCacheInitialize() < 0) {
+        virResetLastError();
+        return;
+    }
+
+    virMutexLock(&virStorageMetadataCacheLock);
+    virHashRemoveAll(virStorageMetadataCache);
+    virStorageMetadataCacheMaxBytes = maxBytes;
+    virStorageMetadataCacheSettleMs = settleMs;
+    virMutexUnlock(&virStorageMetadataCacheLock);
+}
+
+
+/*
+ * Read the header of @src, which is known as @uniqueName, or serve it
+ * from the cache if the image did not change since it was last read.
+ * Same semantics as virStorageFileReadHeader.
+ */
+static ssize_t
+virStorageFileReadHeaderCached(virStorageSourcePtr src,
+                               const char *uniqueName,
+                               char **buf)
+{
+    struct stat st;
+    bool cacheable;
+    ssize_t ret = -1;
+
+    /* Writes to block devices don't touch their timestamps */
+    cacheable = virStorageFileStat(src, &st) == 0 && S_ISREG(st.st_mode);
+
+    if (cacheable) {
+        switch (virStorageMetadataCacheLookup(uniqueName, &st, buf, &ret)) {
+        case -1:
+            return -1;
+        case 1:
+            VIR_DEBUG("using cached header of %s (%s)", src->path, uniqueName);
+            return ret;
+        }
+    }
+
+    if ((ret = virStorageFileReadHeader(src, VIR_STORAGE_MAX_HEADER, buf)) < 0)
+        return ret;
+
+    if (cacheable)
+        virStorageMetadataCacheStore(uniqueName, &st, *buf, ret);
+
+    return ret;
+}
+
+
+/**
+ * virStorageFileMetadataCacheInvalidate:
+ *
+ * @src: top of a backing chain
+ *
+ * Forget the cached headers of @src and all of its backing images. Needs
+ * to be called whenever libvirt changes an image by other means than
+ * plain writes, whose effects are detected anyway.
+ */
+void
+virStorageFileMetadataCacheInvalidate(virStorageSourcePtr src)
+{
+    virStorageSourcePtr tmp;
+    const char *uniqueName;
+
+    if (virStorageMetadataCacheInitialize() < 0) {
+        virResetLastError();
+        return;
+    }
+
+    for (tmp = src; tmp; tmp = tmp->backingStore) {
+        bool initialized;
+
+        if (!virStorageFileSupportsBackingChainTraversal(tmp))
+            continue;
+
+        if (!(initialized = virStorageFileIsInitialized(tmp)) &&
+            virStorageFileInit(tmp) < 0)
+            goto flush;
+
+        if (!(uniqueName = virStorageFileGetUniqueIdentifier(tmp))) {
+            if (!initialized)
+                virStorageFileDeinit(tmp);
+            goto flush;
+        }
+
+        virMutexLock(&virStorageMetadataCacheLock);
+        virHashRemoveEntry(virStorageMetadataCache, uniqueName);
+        virMutexUnlock(&virStorageMetadataCacheLock);
+
+        if (!initialized)
+            virStorageFileDeinit(tmp);
+    }
+    return;
+
+ flush:
+    /* Can't tell which entry belongs to the image, drop them all */
+    virResetLastError();
+    virMutexLock(&virStorageMetadataCacheLock);
+    virHashRemoveAll(virStorageMetadataCache);
+    virMutexUnlock(&virStorageMetadataCacheLock);
+}
+
+
 /* Recursive workhorse for virStorageFileGetMetadata.  */
 static int
 virStorageFileGetMetadataRecurse(virStorageSourcePtr src,
@@ -2868,8 +3736,8 @@ virStorageFileGetMetadataRecurse(virStorageSourcePtr src,
     if (virHashAddEntry(cycle, uniqueName, (void *)1) < 0)
         goto cleanup;
 
-    if ((headerLen = virStorageFileReadHeader(src, VIR_STORAGE_MAX_HEADER,
-                                              &buf)) < 0)
+    if ((headerLen = virStorageFileReadHeaderCached(src, uniqueName,
+                                                    &buf)) < 0)
         goto cleanup;
 
     if (virStorageFileGetMetadataInternal(src, buf, headerLen,
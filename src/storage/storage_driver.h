@@ -48,6 +48,7 @@ int virStorageFileGetMetadata(virStorageSourcePtr src,
                               uid_t uid, gid_t gid,
                               bool allow_probe)
     ATTRIBUTE_NONNULL(1);
+void virStorageFileMetadataCacheInvalidate(virStorageSourcePtr src);
 
 int storageRegister(void);
 
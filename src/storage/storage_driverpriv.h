@@ -0,0 +1,44 @@
+/*
+ * storage_driverpriv.h: private declarations for the storage driver
+ *
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __VIR_STORAGE_DRIVERPRIV_H__
+# define __VIR_STORAGE_DRIVERPRIV_H__
+
+# include <sys/stat.h>
+
+# include "internal.h"
+
+/*
+ * This header file should never be used outside unit tests.
+ */
+
+int virStorageMetadataCacheLookup(const char *uniqueName,
+                                  const struct stat *st,
+                                  char **buf,
+                                  ssize_t *len);
+void virStorageMetadataCacheStore(const char *uniqueName,
+                                  const struct stat *st,
+                                  const char *buf,
+                                  ssize_t len);
+void virStorageMetadataCacheSetLimits(size_t maxBytes,
+                                      unsigned int settleMs);
+
+#endif /* __VIR_STORAGE_DRIVERPRIV_H__ */
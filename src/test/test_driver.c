@@ -3648,7 +3648,8 @@ testConnectListAllNetworks(virConnectPtr conn,
     virCheckFlags(VIR_CONNECT_LIST_NETWORKS_FILTERS_ALL, -1);
 
     testDriverLock(privconn);
-    ret = virNetworkObjListExport(conn, privconn->networks, nets, NULL, flags);
+    ret = virNetworkObjListExport(conn, &privconn->networks, NULL,
+                                  nets, NULL, flags);
     testDriverUnlock(privconn);
 
     return ret;
@@ -4663,8 +4664,8 @@ testConnectListAllStoragePools(virConnectPtr conn,
     virCheckFlags(VIR_CONNECT_LIST_STORAGE_POOLS_FILTERS_ALL, -1);
 
     testDriverLock(privconn);
-    ret = virStoragePoolObjListExport(conn, privconn->pools, pools,
-                                      NULL, flags);
+    ret = virStoragePoolObjListExport(conn, &privconn->pools, NULL,
+                                      pools, NULL, flags);
     testDriverUnlock(privconn);
 
     return ret;
@@ -6886,6 +6887,20 @@ testDomainSnapshotAlignDisks(virDomainObjPtr vm,
     return virDomainSnapshotAlignDisks(def, align_location, align_match);
 }
 
+/* Makes @snap a child of its parent in the snapshot tree of @vm */
+static void
+testDomainSnapshotLinkParent(virDomainObjPtr vm,
+                             virDomainSnapshotObjPtr snap)
+{
+    virDomainSnapshotObjPtr other;
+
+    other = virDomainSnapshotFindByName(vm->snapshots, snap->def->parent);
+    snap->parent = other;
+    other->nchildren++;
+    snap->sibling = other->first_child;
+    other->first_child = snap;
+}
+
 static virDomainSnapshotPtr
 testDomainSnapshotCreateXML(virDomainPtr domain,
                             const char *xmlDesc,
@@ -6984,15 +6999,9 @@ testDomainSnapshotCreateXML(virDomainPtr domain,
     VIR_FREE(xml);
     if (vm) {
         if (snapshot) {
-            virDomainSnapshotObjPtr other;
             if (update_current)
                 vm->current_snapshot = snap;
-            other = virDomainSnapshotFindByName(vm->snapshots,
-                                                snap->def->parent);
-            snap->parent = other;
-            other->nchildren++;
-            snap->sibling = other->first_child;
-            other->first_child = snap;
+            testDomainSnapshotLinkParent(vm, snap);
         }
         virObjectUnlock(vm);
     }
@@ -7006,6 +7015,132 @@ testDomainSnapshotCreateXML(virDomainPtr domain,
 }
 
 
+static int
+testDomainSnapshotCreateGroup(virConnectPtr conn,
+                              virDomainPtr *domains,
+                              const char **xmlDescs,
+                              unsigned int ndomains,
+                              virDomainSnapshotPtr **snapshots,
+                              unsigned int flags)
+{
+    testConnPtr privconn = conn->privateData;
+    virDomainObjPtr vm = NULL;
+    virDomainSnapshotDefPtr *defs = NULL;
+    virDomainSnapshotPtr *snaps = NULL;
+    virDomainSnapshotDefPtr def;
+    unsigned int parse_flags = VIR_DOMAIN_SNAPSHOT_PARSE_DISKS;
+    int ret = -1;
+    size_t i, j;
+
+    /*
+     * DISK_ONLY: Implemented
+     * QUIESCE: Nothing to do
+     * ATOMIC: Nothing to do
+     */
+    virCheckFlags(VIR_DOMAIN_SNAPSHOT_CREATE_DISK_ONLY |
+                  VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE |
+                  VIR_DOMAIN_SNAPSHOT_CREATE_ATOMIC, -1);
+
+    for (i = 0; i < ndomains; i++) {
+        for (j = 0; j < i; j++) {
+            if (memcmp(domains[i]->uuid, domains[j]->uuid,
+                       VIR_UUID_BUFLEN) == 0) {
+                virReportError(VIR_ERR_INVALID_ARG,
+                               _("domain '%s' is listed more than once"),
+                               domains[i]->name);
+                return -1;
+            }
+        }
+    }
+
+    if (VIR_ALLOC_N(defs, ndomains) < 0 ||
+        VIR_ALLOC_N(snaps, ndomains + 1) < 0)
+        goto cleanup;
+
+    /* Check every member before any snapshot is taken */
+    for (i = 0; i < ndomains; i++) {
+        if (!(vm = testDomObjFromDomain(domains[i])))
+            goto cleanup;
+
+        if (!virDomainObjIsActive(vm)) {
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("domain '%s' is not running"), vm->def->name);
+            goto cleanup;
+        }
+
+        if (!(def = virDomainSnapshotDefParseString(xmlDescs[i],
+                                                    privconn->caps,
+                                                    privconn->xmlopt,
+                                                    1 << VIR_DOMAIN_VIRT_TEST,
+                                                    parse_flags)))
+            goto cleanup;
+        defs[i] = def;
+
+        if (virDomainSnapshotFindByName(vm->snapshots, def->name)) {
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           _("domain '%s' already has a snapshot '%s'"),
+                           vm->def->name, def->name);
+            goto cleanup;
+        }
+
+        if (!(def->dom = virDomainDefCopy(vm->def,
+                                          privconn->caps,
+                                          privconn->xmlopt,
+                                          true)) ||
+            testDomainSnapshotAlignDisks(vm, def, flags) < 0)
+            goto cleanup;
+
+        virObjectUnlock(vm);
+        vm = NULL;
+    }
+
+    for (i = 0; i < ndomains; i++) {
+        virDomainSnapshotObjPtr snap;
+
+        if (!(vm = testDomObjFromDomain(domains[i])))
+            goto cleanup;
+
+        if (!(snap = virDomainSnapshotAssignDef(vm->snapshots, defs[i])))
+            goto cleanup;
+        defs[i] = NULL;
+
+        if ((vm->current_snapshot &&
+             VIR_STRDUP(snap->def->parent,
+                        vm->current_snapshot->def->name) < 0) ||
+            !(snaps[i] = virGetDomainSnapshot(domains[i], snap->def->name))) {
+            virDomainSnapshotObjListRemove(vm->snapshots, snap);
+            goto cleanup;
+        }
+
+        vm->current_snapshot = snap;
+        testDomainSnapshotLinkParent(vm, snap);
+
+        virObjectUnlock(vm);
+        vm = NULL;
+    }
+
+    *snapshots = snaps;
+    snaps = NULL;
+    ret = 0;
+
+ cleanup:
+    if (vm)
+        virObjectUnlock(vm);
+    if (snaps) {
+        for (i = 0; i < ndomains; i++) {
+            if (snaps[i])
+                virDomainSnapshotFree(snaps[i]);
+        }
+        VIR_FREE(snaps);
+    }
+    if (defs) {
+        for (i = 0; i < ndomains; i++)
+            virDomainSnapshotDefFree(defs[i]);
+        VIR_FREE(defs);
+    }
+    return ret;
+}
+
 typedef struct _testSnapRemoveData testSnapRemoveData;
 typedef testSnapRemoveData *testSnapRemoveDataPtr;
 struct _testSnapRemoveData {
@@ -7446,6 +7581,7 @@ static virDriver testDriver = {
     .domainSnapshotIsCurrent = testDomainSnapshotIsCurrent, /* 1.1.4 */
     .domainSnapshotHasMetadata = testDomainSnapshotHasMetadata, /* 1.1.4 */
     .domainSnapshotCreateXML = testDomainSnapshotCreateXML, /* 1.1.4 */
+    .domainSnapshotCreateGroup = testDomainSnapshotCreateGroup, /* 1.2.8 */
     .domainRevertToSnapshot = testDomainRevertToSnapshot, /* 1.1.4 */
     .domainSnapshotDelete = testDomainSnapshotDelete, /* 1.1.4 */
 
@@ -2753,7 +2753,7 @@ static int umlConnectListAllDomains(virConnectPtr conn,
 
     umlDriverLock(driver);
     ret = virDomainObjListExport(driver->domains, conn, domains,
-                                 virConnectListAllDomainsCheckACL, flags);
+                                 virConnectListAllDomainsCheckACLBulk, flags);
     umlDriverUnlock(driver);
 
     return ret;
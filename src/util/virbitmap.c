@@ -708,6 +708,28 @@ virBitmapCountBits(virBitmapPtr bitmap)
     return ret;
 }
 
+/**
+ * virBitmapSubtract:
+ * @a: bitmap to modify
+ * @b: bitmap with bits to clear
+ *
+ * Clear every bit in @a that is set in @b. Bits of @b beyond the size
+ * of @a are ignored.
+ */
+void
+virBitmapSubtract(virBitmapPtr a,
+                  virBitmapPtr b)
+{
+    size_t i;
+    size_t max = a->map_len;
+
+    if (max > b->map_len)
+        max = b->map_len;
+
+    for (i = 0; i < max; i++)
+        a->map[i] &= ~b->map[i];
+}
+
 /**
  * virBitmapDataToString:
  * @data: the data
@@ -127,6 +127,11 @@ virBufferGrow(virBufferPtr buf, unsigned int len)
 
     size = buf->use + len + 1000;
 
+    /* Grow geometrically, so that formatting a large document piece
+     * by piece does not reallocate (and copy) it every kilobyte.  */
+    if (buf->size <= INT_MAX / 2 && size < (int) buf->size * 2)
+        size = buf->size * 2;
+
     if (VIR_REALLOC_N_QUIET(buf->content, size) < 0) {
         virBufferSetError(buf, errno);
         return -1;
@@ -382,6 +387,61 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
     buf->use += count;
 }
 
+/**
+ * virBufferEscapeXMLCopy:
+ * @out: destination with room for at least 6 * strlen(@str) bytes
+ * @str: the string to escape
+ *
+ * Copy @str into @out, escaping the characters that are special in
+ * XML and dropping control characters XML cannot represent.  @out is
+ * not NUL terminated.
+ *
+ * Returns a pointer just past the last byte written.
+ */
+static char *
+virBufferEscapeXMLCopy(char *out, const char *str)
+{
+    const char *cur;
+
+    for (cur = str; *cur != 0; cur++) {
+        switch (*cur) {
+        case '<':
+            memcpy(out, "&lt;", 4);
+            out += 4;
+            break;
+        case '>':
+            memcpy(out, "&gt;", 4);
+            out += 4;
+            break;
+        case '&':
+            memcpy(out, "&amp;", 5);
+            out += 5;
+            break;
+        case '"':
+            memcpy(out, "&quot;", 6);
+            out += 6;
+            break;
+        case '\'':
+            memcpy(out, "&apos;", 6);
+            out += 6;
+            break;
+        default:
+            /*
+             * default case, just copy !
+             * Note that character over 0x80 are likely to give problem
+             * with UTF-8 XML, but since our string don't have an encoding
+             * it's hard to handle properly we have to assume it's UTF-8 too
+             */
+            if (((unsigned char)*cur >= 0x20) || (*cur == '\n') ||
+                (*cur == '\t') || (*cur == '\r'))
+                *out++ = *cur;
+            break;
+        }
+    }
+
+    return out;
+}
+
 /**
  * virBufferEscapeString:
  * @buf: the buffer to append to
@@ -396,9 +456,9 @@ virBufferVasprintf(virBufferPtr buf, const char *format, va_list argptr)
 void
 virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
 {
-    int len;
+    size_t len, suffix;
+    const char *conv;
     char *escaped, *out;
-    const char *cur;
 
     if ((format == NULL) || (buf == NULL) || (str == NULL))
         return;
@@ -407,6 +467,31 @@ virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
         return;
 
     len = strlen(str);
+
+    /* The usual format is plain text around a single %s: write the
+     * text and the escaped string straight into the buffer, without
+     * a temporary copy or a second pass through vsnprintf.  */
+    conv = strchr(format, '%');
+    if (conv && conv[1] == 's' && !strchr(conv + 2, '%')) {
+        suffix = strlen(conv + 2);
+        if (len > (INT_MAX - suffix - 1) / 6) {
+            virBufferSetError(buf, ENOMEM);
+            return;
+        }
+
+        /* auto-indent and the text before %s */
+        virBufferAdd(buf, format, conv - format);
+        if (virBufferGrow(buf, 6 * len + suffix + 1) < 0)
+            return;
+
+        out = virBufferEscapeXMLCopy(&buf->content[buf->use], str);
+        memcpy(out, conv + 2, suffix);
+        out += suffix;
+        *out = '\0';
+        buf->use = out - buf->content;
+        return;
+    }
+
     if (strcspn(str, "<>&'\"") == len) {
         virBufferAsprintf(buf, format, str);
         return;
@@ -418,51 +503,7 @@ virBufferEscapeString(virBufferPtr buf, const char *format, const char *str)
         return;
     }
 
-    cur = str;
-    out = escaped;
-    while (*cur != 0) {
-        if (*cur == '<') {
-            *out++ = '&';
-            *out++ = 'l';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '>') {
-            *out++ = '&';
-            *out++ = 'g';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '&') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'm';
-            *out++ = 'p';
-            *out++ = ';';
-        } else if (*cur == '"') {
-            *out++ = '&';
-            *out++ = 'q';
-            *out++ = 'u';
-            *out++ = 'o';
-            *out++ = 't';
-            *out++ = ';';
-        } else if (*cur == '\'') {
-            *out++ = '&';
-            *out++ = 'a';
-            *out++ = 'p';
-            *out++ = 'o';
-            *out++ = 's';
-            *out++ = ';';
-        } else if (((unsigned char)*cur >= 0x20) || (*cur == '\n') || (*cur == '\t') ||
-                   (*cur == '\r')) {
-            /*
-             * default case, just copy !
-             * Note that character over 0x80 are likely to give problem
-             * with UTF-8 XML, but since our string don't have an encoding
-             * it's hard to handle properly we have to assume it's UTF-8 too
-             */
-            *out++ = *cur;
-        }
-        cur++;
-    }
+    out = virBufferEscapeXMLCopy(escaped, str);
     *out = 0;
 
     virBufferAsprintf(buf, format, escaped);
@@ -865,8 +865,15 @@ virCgroupGetValueU64(virCgroupPtr group,
 }
 
 
+/*
+ * Copies cpuset.cpus and cpuset.mems of @parent to @group. Non-NULL
+ * entries of @values (in the same order) are used instead of reading
+ * the parent's file, @values itself may be NULL.
+ */
 static int
-virCgroupCpuSetInherit(virCgroupPtr parent, virCgroupPtr group)
+virCgroupCpuSetInherit(virCgroupPtr parent,
+                       virCgroupPtr group,
+                       const char *const *values)
 {
     size_t i;
     const char *inherit_values[] = {
@@ -878,11 +885,15 @@ virCgroupCpuSetInherit(virCgroupPtr parent, virCgroupPtr group)
     for (i = 0; i < ARRAY_CARDINALITY(inherit_values); i++) {
         char *value;
 
-        if (virCgroupGetValueStr(parent,
-                                 VIR_CGROUP_CONTROLLER_CPUSET,
-                                 inherit_values[i],
-                                 &value) < 0)
+        if (values && values[i]) {
+            if (VIR_STRDUP(value, values[i]) < 0)
+                return -1;
+        } else if (virCgroupGetValueStr(parent,
+                                        VIR_CGROUP_CONTROLLER_CPUSET,
+                                        inherit_values[i],
+                                        &value) < 0) {
             return -1;
+        }
 
         VIR_DEBUG("Inherit %s = %s", inherit_values[i], value);
 
@@ -926,10 +937,11 @@ virCgroupSetMemoryUseHierarchy(virCgroupPtr group)
 
 
 static int
-virCgroupMakeGroup(virCgroupPtr parent,
-                   virCgroupPtr group,
-                   bool create,
-                   unsigned int flags)
+virCgroupMakeGroupFull(virCgroupPtr parent,
+                       virCgroupPtr group,
+                       bool create,
+                       unsigned int flags,
+                       const char *const *cpuset)
 {
     size_t i;
     int ret = -1;
@@ -987,7 +999,7 @@ virCgroupMakeGroup(virCgroupPtr parent,
                 (i == VIR_CGROUP_CONTROLLER_CPUSET ||
                  STREQ(group->controllers[i].mountPoint,
                        group->controllers[VIR_CGROUP_CONTROLLER_CPUSET].mountPoint))) {
-                if (virCgroupCpuSetInherit(parent, group) < 0) {
+                if (virCgroupCpuSetInherit(parent, group, cpuset) < 0) {
                     VIR_FREE(path);
                     goto cleanup;
                 }
@@ -1019,6 +1031,16 @@ virCgroupMakeGroup(virCgroupPtr parent,
 }
 
 
+static int
+virCgroupMakeGroup(virCgroupPtr parent,
+                   virCgroupPtr group,
+                   bool create,
+                   unsigned int flags)
+{
+    return virCgroupMakeGroupFull(parent, group, create, flags, NULL);
+}
+
+
 /**
  * virCgroupNew:
  * @path: path for the new group
@@ -1073,6 +1095,31 @@ virCgroupNew(pid_t pid,
 }
 
 
+/*
+ * Returns true if controller @i shares its directory with a controller
+ * that comes before it, e.g. cpu and cpuacct mounted together.
+ */
+static bool
+virCgroupControllerIsCoMounted(virCgroupPtr group, size_t i)
+{
+    size_t j;
+
+    for (j = 0; j < i; j++) {
+        if (j == VIR_CGROUP_CONTROLLER_SYSTEMD ||
+            !group->controllers[j].mountPoint)
+            continue;
+
+        if (STREQ(group->controllers[i].mountPoint,
+                  group->controllers[j].mountPoint) &&
+            STREQ_NULLABLE(group->controllers[i].placement,
+                           group->controllers[j].placement))
+            return true;
+    }
+
+    return false;
+}
+
+
 /**
  * virCgroupAddTask:
  *
@@ -1096,6 +1143,10 @@ virCgroupAddTask(virCgroupPtr group, pid_t pid)
         if (i == VIR_CGROUP_CONTROLLER_SYSTEMD)
             continue;
 
+        /* One write per directory is enough */
+        if (virCgroupControllerIsCoMounted(group, i))
+            continue;
+
         if (virCgroupSetValueU64(group, i, "tasks", pid) < 0)
             goto cleanup;
     }
@@ -1456,6 +1507,106 @@ virCgroupNewVcpu(virCgroupPtr domain,
 }
 
 
+/**
+ * virCgroupNewVcpus:
+ *
+ * @domain: group for the domain
+ * @nvcpus: number of vcpus
+ * @cpus: optional array of @nvcpus cpuset.cpus values
+ * @groups: Pointer to returned array of @nvcpus virCgroupPtr
+ *
+ * Creates the groups of vcpus 0 to @nvcpus - 1 at once, as
+ * virCgroupNewVcpu with @create set would one by one. The cpuset of
+ * @domain is read only once for all of them. A vcpu with a non-NULL
+ * entry in @cpus gets that value as its cpuset.cpus right away instead
+ * of inheriting the domain's value first.
+ *
+ * Returns 0 on success, or -1 on error with all new groups removed
+ */
+int
+virCgroupNewVcpus(virCgroupPtr domain,
+                  size_t nvcpus,
+                  char **cpus,
+                  virCgroupPtr **groups)
+{
+    int ret = -1;
+    char *name = NULL;
+    char *path = NULL;
+    char *inherit[2] = { NULL, NULL };
+    const char *cpuset[2];
+    virCgroupPtr *list = NULL;
+    bool existed;
+    int controllers;
+    size_t i;
+
+    *groups = NULL;
+
+    controllers = ((1 << VIR_CGROUP_CONTROLLER_CPU) |
+                   (1 << VIR_CGROUP_CONTROLLER_CPUACCT) |
+                   (1 << VIR_CGROUP_CONTROLLER_CPUSET));
+
+    if (domain->controllers[VIR_CGROUP_CONTROLLER_CPUSET].mountPoint &&
+        (virCgroupGetValueStr(domain, VIR_CGROUP_CONTROLLER_CPUSET,
+                              "cpuset.cpus", &inherit[0]) < 0 ||
+         virCgroupGetValueStr(domain, VIR_CGROUP_CONTROLLER_CPUSET,
+                              "cpuset.mems", &inherit[1]) < 0))
+        goto cleanup;
+
+    if (VIR_ALLOC_N(list, nvcpus) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nvcpus; i++) {
+        if (virAsprintf(&name, "vcpu%zu", i) < 0)
+            goto error;
+
+        if (virCgroupNew(-1, name, domain, controllers, &list[i]) < 0)
+            goto error;
+        VIR_FREE(name);
+
+        cpuset[0] = cpus && cpus[i] ? cpus[i] : inherit[0];
+        cpuset[1] = inherit[1];
+
+        /* Only new groups inherit the cpuset, so an existing one needs
+         * its cpus set explicitly */
+        existed = false;
+        if (cpus && cpus[i] && inherit[0]) {
+            if (virCgroupPathOfController(list[i],
+                                          VIR_CGROUP_CONTROLLER_CPUSET,
+                                          "", &path) < 0)
+                goto error;
+            existed = virFileExists(path);
+            VIR_FREE(path);
+        }
+
+        if (virCgroupMakeGroupFull(domain, list[i], true,
+                                   VIR_CGROUP_NONE, cpuset) < 0)
+            goto error;
+
+        if (existed && virCgroupSetCpusetCpus(list[i], cpus[i]) < 0)
+            goto error;
+    }
+
+    *groups = list;
+    list = NULL;
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(name);
+    VIR_FREE(path);
+    VIR_FREE(inherit[0]);
+    VIR_FREE(inherit[1]);
+    return ret;
+
+ error:
+    for (i = 0; i < nvcpus && list[i]; i++) {
+        virCgroupRemove(list[i]);
+        virCgroupFree(&list[i]);
+    }
+    VIR_FREE(list);
+    goto cleanup;
+}
+
+
 /**
  * virCgroupNewEmulator:
  *
@@ -3885,6 +4036,18 @@ virCgroupNewVcpu(virCgroupPtr domain ATTRIBUTE_UNUSED,
 }
 
 
+int
+virCgroupNewVcpus(virCgroupPtr domain ATTRIBUTE_UNUSED,
+                  size_t nvcpus ATTRIBUTE_UNUSED,
+                  char **cpus ATTRIBUTE_UNUSED,
+                  virCgroupPtr **groups ATTRIBUTE_UNUSED)
+{
+    virReportSystemError(ENXIO, "%s",
+                         _("Control groups not supported on this platform"));
+    return -1;
+}
+
+
 int
 virCgroupNewEmulator(virCgroupPtr domain ATTRIBUTE_UNUSED,
                      bool create ATTRIBUTE_UNUSED,
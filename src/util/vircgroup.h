@@ -71,6 +71,12 @@ int virCgroupNewVcpu(virCgroupPtr domain,
                      virCgroupPtr *group)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(4);
 
+int virCgroupNewVcpus(virCgroupPtr domain,
+                      size_t nvcpus,
+                      char **cpus,
+                      virCgroupPtr **groups)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(4);
+
 int virCgroupNewEmulator(virCgroupPtr domain,
                          bool create,
                          virCgroupPtr *group)
@@ -302,6 +302,23 @@ static bool virDBusIsBasicType(char c)
     return !!memchr(virDBusBasicTypes, c, ARRAY_CARDINALITY(virDBusBasicTypes));
 }
 
+/*
+ * An array ref may hold either a single basic type, or
+ * a dict entry of two basic types, in which case the
+ * array holds the keys and values interleaved.
+ */
+static bool virDBusIsArrayRefSignature(const char *s)
+{
+    if (virDBusIsBasicType(s[0]) && !s[1])
+        return true;
+
+    return s[0] == DBUS_DICT_ENTRY_BEGIN_CHAR &&
+        virDBusIsBasicType(s[1]) &&
+        virDBusIsBasicType(s[2]) &&
+        s[3] == DBUS_DICT_ENTRY_END_CHAR &&
+        !s[4];
+}
+
 /*
  * All code related to virDBusMessageIterEncode and
  * virDBusMessageIterDecode is derived from systemd
@@ -435,6 +452,7 @@ struct _virDBusTypeStack {
     const char *types;
     size_t nstruct;
     size_t narray;
+    bool arrayref;
     DBusMessageIter *iter;
 };
 
@@ -443,7 +461,8 @@ static int virDBusTypeStackPush(virDBusTypeStack **stack,
                                 DBusMessageIter *iter,
                                 const char *types,
                                 size_t nstruct,
-                                size_t narray)
+                                size_t narray,
+                                bool arrayref)
 {
     if (*nstack >= VIR_DBUS_TYPE_STACK_MAX_DEPTH) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -458,6 +477,7 @@ static int virDBusTypeStackPush(virDBusTypeStack **stack,
     (*stack)[(*nstack) - 1].types = types;
     (*stack)[(*nstack) - 1].nstruct = nstruct;
     (*stack)[(*nstack) - 1].narray = narray;
+    (*stack)[(*nstack) - 1].arrayref = arrayref;
     VIR_DEBUG("Pushed types='%s' nstruct=%zu narray=%zu", types, nstruct, narray);
     return 0;
 }
@@ -468,7 +488,8 @@ static int virDBusTypeStackPop(virDBusTypeStack **stack,
                                DBusMessageIter **iter,
                                const char **types,
                                size_t *nstruct,
-                               size_t *narray)
+                               size_t *narray,
+                               bool *arrayref)
 {
     if (*nstack == 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -480,6 +501,7 @@ static int virDBusTypeStackPop(virDBusTypeStack **stack,
     *types = (*stack)[(*nstack) - 1].types;
     *nstruct = (*stack)[(*nstack) - 1].nstruct;
     *narray = (*stack)[(*nstack) - 1].narray;
+    *arrayref = (*stack)[(*nstack) - 1].arrayref;
     VIR_DEBUG("Popped types='%s' nstruct=%zu narray=%zu", *types, *nstruct, *narray);
     VIR_SHRINK_N(*stack, *nstack, 1);
 
@@ -557,14 +579,17 @@ virDBusMessageIterEncode(DBusMessageIter *rootiter,
             (narray == (size_t)-1 &&
              nstruct == 0)) {
             DBusMessageIter *thisiter = iter;
-            arrayref = false;
-            arrayptr = NULL;
             VIR_DEBUG("Popping iter=%p", iter);
             if (nstack == 0)
                 break;
+            /* Leaving a dict entry of an array ref keeps walking
+             * the same array of values */
             if (virDBusTypeStackPop(&stack, &nstack, &iter,
-                                    &types, &nstruct, &narray) < 0)
+                                    &types, &nstruct, &narray,
+                                    &arrayref) < 0)
                 goto cleanup;
+            if (!arrayref)
+                arrayptr = NULL;
             VIR_DEBUG("Popped iter=%p", iter);
 
             if (!dbus_message_iter_close_container(iter, thisiter)) {
@@ -649,10 +674,9 @@ virDBusMessageIterEncode(DBusMessageIter *rootiter,
             if (VIR_STRNDUP(contsig, t + 1, siglen) < 0)
                 goto cleanup;
 
-            if (arrayref && (strlen(contsig) > 1 ||
-                             !virDBusIsBasicType(*contsig))) {
+            if (arrayref && !virDBusIsArrayRefSignature(contsig)) {
                 virReportError(VIR_ERR_INTERNAL_ERROR,
-                               _("Got array ref but '%s' is not a single basic type"),
+                               _("Got array ref but '%s' is not a basic type or dict entry"),
                                contsig);
                 goto cleanup;
             }
@@ -670,7 +694,7 @@ virDBusMessageIterEncode(DBusMessageIter *rootiter,
                 goto cleanup;
             if (virDBusTypeStackPush(&stack, &nstack,
                                      iter, types,
-                                     nstruct, narray) < 0) {
+                                     nstruct, narray, false) < 0) {
                 VIR_FREE(newiter);
                 goto cleanup;
             }
@@ -698,7 +722,7 @@ virDBusMessageIterEncode(DBusMessageIter *rootiter,
                 goto cleanup;
             if (virDBusTypeStackPush(&stack, &nstack,
                                      iter, types,
-                                     nstruct, narray) < 0) {
+                                     nstruct, narray, arrayref) < 0) {
                 VIR_FREE(newiter);
                 goto cleanup;
             }
@@ -732,7 +756,7 @@ virDBusMessageIterEncode(DBusMessageIter *rootiter,
 
             if (virDBusTypeStackPush(&stack, &nstack,
                                      iter, types,
-                                     nstruct, narray) < 0) {
+                                     nstruct, narray, arrayref) < 0) {
                 VIR_FREE(newiter);
                 goto cleanup;
             }
@@ -760,7 +784,8 @@ virDBusMessageIterEncode(DBusMessageIter *rootiter,
         DBusMessageIter *thisiter = iter;
         VIR_DEBUG("Popping iter=%p", iter);
         ignore_value(virDBusTypeStackPop(&stack, &nstack, &iter,
-                                         &types, &nstruct, &narray));
+                                         &types, &nstruct, &narray,
+                                         &arrayref));
         VIR_DEBUG("Popped iter=%p", iter);
 
         if (thisiter != rootiter)
@@ -836,7 +861,8 @@ virDBusMessageIterDecode(DBusMessageIter *rootiter,
             if (nstack == 0)
                 break;
             if (virDBusTypeStackPop(&stack, &nstack, &iter,
-                                    &types, &nstruct, &narray) < 0)
+                                    &types, &nstruct, &narray,
+                                    &arrayref) < 0)
                 goto cleanup;
             VIR_DEBUG("Popped iter=%p types=%s", iter, types);
             if (thisiter != rootiter)
@@ -959,7 +985,7 @@ virDBusMessageIterDecode(DBusMessageIter *rootiter,
             dbus_message_iter_recurse(iter, newiter);
             if (virDBusTypeStackPush(&stack, &nstack,
                                      iter, types,
-                                     nstruct, narray) < 0)
+                                     nstruct, narray, false) < 0)
                 goto cleanup;
             VIR_FREE(contsig);
             iter = newiter;
@@ -989,7 +1015,7 @@ virDBusMessageIterDecode(DBusMessageIter *rootiter,
             dbus_message_iter_recurse(iter, newiter);
             if (virDBusTypeStackPush(&stack, &nstack,
                                      iter, types,
-                                     nstruct, narray) < 0) {
+                                     nstruct, narray, false) < 0) {
                 VIR_DEBUG("Push failed");
                 goto cleanup;
             }
@@ -1020,7 +1046,7 @@ virDBusMessageIterDecode(DBusMessageIter *rootiter,
 
             if (virDBusTypeStackPush(&stack, &nstack,
                                      iter, types,
-                                     nstruct, narray) < 0)
+                                     nstruct, narray, false) < 0)
                 goto cleanup;
             VIR_FREE(contsig);
             iter = newiter;
@@ -1260,6 +1286,12 @@ int virDBusMessageDecode(DBusMessage* msg,
  *
  *     (3, "email", "s", "joe@blogs.com", "age", "i", 35,
  *      "address", "as", 3, "Some house", "Some road", "some city")
+ *
+ * - "a&{ss}" - a hash table passed by reference, as the number
+ *   of entries followed by an array of interleaved keys and values
+ *
+ *     (3, (const char *[]){"title", "Mr", "forename", "Joe",
+ *                          "surname", "Bloggs"})
  */
 int virDBusCreateMethodV(DBusMessage **call,
                          const char *destination,
@@ -1512,6 +1544,86 @@ int virDBusCallMethod(DBusConnection *conn,
 }
 
 
+/**
+ * virDBusCallMultiple:
+ * @conn: a DBus connection
+ * @calls: array of messages to send
+ * @ncalls: number of elements in @calls
+ * @replies: array of @ncalls elements to receive the replies
+ *
+ * This invokes every method encoded in @calls on the DBus
+ * bus @conn. All the calls are queued before waiting for any
+ * reply, so the remote services can handle them in a single
+ * round trip instead of one round trip per call.
+ *
+ * A call which fails, or which gets a DBus error in return,
+ * has its error logged and a NULL reply stored in @replies.
+ * The caller must free every non-NULL reply.
+ *
+ * Returns 0 on success, or -1 if the calls could not be sent
+ */
+int virDBusCallMultiple(DBusConnection *conn,
+                        DBusMessage **calls,
+                        size_t ncalls,
+                        DBusMessage **replies)
+{
+    DBusPendingCall **pending = NULL;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < ncalls; i++)
+        replies[i] = NULL;
+
+    if (VIR_ALLOC_N(pending, ncalls) < 0)
+        return -1;
+
+    for (i = 0; i < ncalls; i++) {
+        if (!dbus_connection_send_with_reply(conn, calls[i], &pending[i],
+                                             VIR_DBUS_METHOD_CALL_TIMEOUT_MILLIS) ||
+            !pending[i]) {
+            virReportError(VIR_ERR_DBUS_SERVICE, _("%s: %s"),
+                           dbus_message_get_member(calls[i]),
+                           _("unable to send method call"));
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < ncalls; i++) {
+        DBusMessage *reply;
+        DBusError error;
+
+        dbus_pending_call_block(pending[i]);
+        reply = dbus_pending_call_steal_reply(pending[i]);
+        dbus_pending_call_unref(pending[i]);
+        pending[i] = NULL;
+
+        dbus_error_init(&error);
+        if (!reply || dbus_set_error_from_message(&error, reply)) {
+            VIR_WARN("%s: %s", dbus_message_get_member(calls[i]),
+                     error.message ? error.message : _("unknown error"));
+            dbus_error_free(&error);
+            if (reply)
+                dbus_message_unref(reply);
+            continue;
+        }
+
+        replies[i] = reply;
+    }
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < ncalls; i++) {
+        if (pending[i]) {
+            dbus_pending_call_cancel(pending[i]);
+            dbus_pending_call_unref(pending[i]);
+        }
+    }
+    VIR_FREE(pending);
+    return ret;
+}
+
+
 /**
  * virDBusMessageRead:
  * @msg: the reply to decode
@@ -1711,6 +1823,16 @@ int virDBusCallMethod(DBusConnection *conn ATTRIBUTE_UNUSED,
     return -1;
 }
 
+int virDBusCallMultiple(DBusConnection *conn ATTRIBUTE_UNUSED,
+                        DBusMessage **calls ATTRIBUTE_UNUSED,
+                        size_t ncalls ATTRIBUTE_UNUSED,
+                        DBusMessage **replies ATTRIBUTE_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR,
+                   "%s", _("DBus support not compiled into this binary"));
+    return -1;
+}
+
 int virDBusMessageRead(DBusMessage *msg ATTRIBUTE_UNUSED,
                        const char *types ATTRIBUTE_UNUSED, ...)
 {
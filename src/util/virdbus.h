@@ -68,6 +68,10 @@ int virDBusCallMethod(DBusConnection *conn,
                       const char *iface,
                       const char *member,
                       const char *types, ...);
+int virDBusCallMultiple(DBusConnection *conn,
+                        DBusMessage **calls,
+                        size_t ncalls,
+                        DBusMessage **replies);
 int virDBusMessageRead(DBusMessage *msg,
                        const char *types, ...);
 void virDBusMessageUnref(DBusMessage *msg);
@@ -32,6 +32,8 @@
 #include "virlog.h"
 #include "virstring.h"
 #include "virutil.h"
+#include "virthread.h"
+#include "virtime.h"
 
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -1833,6 +1835,246 @@ virNetDevRestoreNetConfig(const char *linkdev ATTRIBUTE_UNUSED,
 
 #endif /* defined(__linux__) && defined(HAVE_LIBNL) */
 
+#if defined(__linux__) && defined(HAVE_LIBNL)
+
+/* How long a dump of all links is reused before the kernel is asked
+ * again. Short enough not to matter for link state, long enough to
+ * serve a sweep over thousands of tap devices with a single dump. */
+# define VIR_NETDEV_LINK_STATS_CACHE_MS 1000
+
+static virMutex virNetDevLinkStatsLock;
+static virHashTablePtr virNetDevLinkStatsCache;
+static unsigned long long virNetDevLinkStatsTimestamp;
+
+static int
+virNetDevOnceInit(void)
+{
+    if (virMutexInit(&virNetDevLinkStatsLock) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("unable to initialize mutex"));
+        return -1;
+    }
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virNetDev)
+
+
+static int
+virNetDevParseLinkStats(struct nlmsghdr *msg,
+                        void *opaque)
+{
+    virHashTablePtr table = opaque;
+    struct nlattr *tb[IFLA_MAX + 1] = { NULL };
+    struct ifinfomsg *ifinfo;
+    virNetDevLinkStatsPtr stats = NULL;
+    const char *ifname;
+
+    if (msg->nlmsg_type != RTM_NEWLINK)
+        return 0;
+
+    if (nlmsg_parse(msg, sizeof(*ifinfo), tb, IFLA_MAX, NULL) < 0 ||
+        !tb[IFLA_IFNAME]) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed netlink response message"));
+        return -1;
+    }
+
+    ifinfo = nlmsg_data(msg);
+    ifname = nla_get_string(tb[IFLA_IFNAME]);
+
+    if (VIR_ALLOC(stats) < 0)
+        return -1;
+
+    stats->ifindex = ifinfo->ifi_index;
+    if (tb[IFLA_MASTER])
+        stats->master = nla_get_u32(tb[IFLA_MASTER]);
+    if (tb[IFLA_MTU])
+        stats->mtu = nla_get_u32(tb[IFLA_MTU]);
+    /* IF_OPER_* values are offset by one from virInterfaceState */
+    if (tb[IFLA_OPERSTATE] &&
+        nla_get_u8(tb[IFLA_OPERSTATE]) < VIR_INTERFACE_STATE_LAST - 1)
+        stats->state = nla_get_u8(tb[IFLA_OPERSTATE]) + 1;
+
+    if (tb[IFLA_STATS64] &&
+        nla_len(tb[IFLA_STATS64]) >= sizeof(struct rtnl_link_stats64)) {
+        struct rtnl_link_stats64 s64;
+
+        /* The attribute is not necessarily 64-bit aligned */
+        memcpy(&s64, nla_data(tb[IFLA_STATS64]), sizeof(s64));
+        stats->rx_bytes = s64.rx_bytes;
+        stats->rx_packets = s64.rx_packets;
+        stats->rx_errs = s64.rx_errors;
+        stats->rx_drop = s64.rx_dropped;
+        stats->tx_bytes = s64.tx_bytes;
+        stats->tx_packets = s64.tx_packets;
+        stats->tx_errs = s64.tx_errors;
+        stats->tx_drop = s64.tx_dropped;
+    } else if (tb[IFLA_STATS] &&
+               nla_len(tb[IFLA_STATS]) >= sizeof(struct rtnl_link_stats)) {
+        struct rtnl_link_stats *s32 = nla_data(tb[IFLA_STATS]);
+
+        stats->rx_bytes = s32->rx_bytes;
+        stats->rx_packets = s32->rx_packets;
+        stats->rx_errs = s32->rx_errors;
+        stats->rx_drop = s32->rx_dropped;
+        stats->tx_bytes = s32->tx_bytes;
+        stats->tx_packets = s32->tx_packets;
+        stats->tx_errs = s32->tx_errors;
+        stats->tx_drop = s32->tx_dropped;
+    }
+
+    if (virHashUpdateEntry(table, ifname, stats) < 0) {
+        VIR_FREE(stats);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static virHashTablePtr
+virNetDevDumpLinkStats(void)
+{
+    struct ifinfomsg ifinfo = { .ifi_family = AF_UNSPEC };
+    struct nl_msg *nl_msg;
+    virHashTablePtr table = NULL;
+
+    if (!(nl_msg = nlmsg_alloc_simple(RTM_GETLINK,
+                                      NLM_F_REQUEST | NLM_F_DUMP))) {
+        virReportOOMError();
+        return NULL;
+    }
+
+    if (nlmsg_append(nl_msg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("allocated netlink buffer is too small"));
+        goto error;
+    }
+
+    if (!(table = virHashCreate(64, virHashValueFree)))
+        goto error;
+
+    if (virNetlinkDumpCommand(nl_msg, virNetDevParseLinkStats,
+                              0, 0, NETLINK_ROUTE, 0, table) < 0)
+        goto error;
+
+    nlmsg_free(nl_msg);
+    return table;
+
+ error:
+    nlmsg_free(nl_msg);
+    virHashFree(table);
+    return NULL;
+}
+
+
+/* Must be called with virNetDevLinkStatsLock held */
+static int
+virNetDevRefreshLinkStats(void)
+{
+    unsigned long long now;
+    virHashTablePtr table;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+
+    if (virNetDevLinkStatsCache &&
+        now - virNetDevLinkStatsTimestamp < VIR_NETDEV_LINK_STATS_CACHE_MS)
+        return 0;
+
+    if (!(table = virNetDevDumpLinkStats()))
+        return -1;
+
+    virHashFree(virNetDevLinkStatsCache);
+    virNetDevLinkStatsCache = table;
+    virNetDevLinkStatsTimestamp = now;
+    return 0;
+}
+
+
+struct virNetDevCopyLinkStatsData {
+    virHashTablePtr table;
+    bool error;
+};
+
+static void
+virNetDevCopyLinkStats(void *payload,
+                       const void *name,
+                       void *opaque)
+{
+    struct virNetDevCopyLinkStatsData *data = opaque;
+    virNetDevLinkStatsPtr stats;
+
+    if (data->error)
+        return;
+
+    if (VIR_ALLOC(stats) < 0) {
+        data->error = true;
+        return;
+    }
+
+    memcpy(stats, payload, sizeof(*stats));
+
+    if (virHashAddEntry(data->table, name, stats) < 0) {
+        VIR_FREE(stats);
+        data->error = true;
+    }
+}
+
+
+/**
+ * virNetDevGetAllLinkStats:
+ *
+ * Fetch index, master, MTU, operational state and counters of all
+ * host links with a single netlink dump. The result of the dump is
+ * reused for a short while, so calling this repeatedly is cheap.
+ *
+ * Returns a hash table keyed by interface name with values of type
+ * virNetDevLinkStats, which the caller must free, or NULL on error.
+ */
+virHashTablePtr
+virNetDevGetAllLinkStats(void)
+{
+    struct virNetDevCopyLinkStatsData data = { NULL, false };
+    virHashTablePtr ret = NULL;
+
+    if (virNetDevInitialize() < 0)
+        return NULL;
+
+    virMutexLock(&virNetDevLinkStatsLock);
+
+    if (virNetDevRefreshLinkStats() < 0)
+        goto cleanup;
+
+    if (!(data.table = virHashCreate(virHashSize(virNetDevLinkStatsCache) + 1,
+                                     virHashValueFree)))
+        goto cleanup;
+
+    virHashForEach(virNetDevLinkStatsCache, virNetDevCopyLinkStats, &data);
+
+    if (data.error)
+        virHashFree(data.table);
+    else
+        ret = data.table;
+
+ cleanup:
+    virMutexUnlock(&virNetDevLinkStatsLock);
+    return ret;
+}
+
+#else /* defined(__linux__) && defined(HAVE_LIBNL) */
+
+virHashTablePtr
+virNetDevGetAllLinkStats(void)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("Unable to dump link stats on this platform"));
+    return NULL;
+}
+
+#endif /* defined(__linux__) && defined(HAVE_LIBNL) */
+
 #ifdef __linux__
 int
 virNetDevGetLinkInfo(const char *ifname,
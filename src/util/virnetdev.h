@@ -30,6 +30,7 @@
 # include "virmacaddr.h"
 # include "virpci.h"
 # include "device_conf.h"
+# include "virhash.h"
 
 # ifdef HAVE_STRUCT_IFREQ
 typedef struct ifreq virIfreq;
@@ -150,4 +151,24 @@ int virNetDevGetLinkInfo(const char *ifname,
                          virInterfaceLinkPtr lnk)
     ATTRIBUTE_NONNULL(1);
 
+typedef struct _virNetDevLinkStats virNetDevLinkStats;
+typedef virNetDevLinkStats *virNetDevLinkStatsPtr;
+struct _virNetDevLinkStats {
+    int ifindex;
+    int master;         /* ifindex of the master device, 0 if none */
+    unsigned int mtu;
+    int state;          /* enum virInterfaceState, 0 if not reported */
+    /* Counters as seen by the host */
+    unsigned long long rx_bytes;
+    unsigned long long rx_packets;
+    unsigned long long rx_errs;
+    unsigned long long rx_drop;
+    unsigned long long tx_bytes;
+    unsigned long long tx_packets;
+    unsigned long long tx_errs;
+    unsigned long long tx_drop;
+};
+
+virHashTablePtr virNetDevGetAllLinkStats(void);
+
 #endif /* __VIR_NETDEV_H__ */
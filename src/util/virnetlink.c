@@ -160,71 +160,47 @@ virNetlinkShutdown(void)
     }
 }
 
-/**
- * virNetlinkCommand:
- * @nlmsg: pointer to netlink message
- * @respbuf: pointer to pointer where response buffer will be allocated
- * @respbuflen: pointer to integer holding the size of the response buffer
- *      on return of the function.
- * @src_pid: the pid of the process to send a message
- * @dst_pid: the pid of the process to talk to, i.e., pid = 0 for kernel
- * @protocol: netlink protocol
- * @groups: the group identifier
- *
- * Send the given message to the netlink layer and receive response.
- * Returns 0 on success, -1 on error. In case of error, no response
- * buffer will be returned.
- */
-int virNetlinkCommand(struct nl_msg *nl_msg,
-                      struct nlmsghdr **resp, unsigned int *respbuflen,
-                      uint32_t src_pid, uint32_t dst_pid,
+static virNetlinkHandle *
+virNetlinkSendRequest(struct nl_msg *nl_msg, uint32_t src_pid,
+                      struct sockaddr_nl nladdr,
                       unsigned int protocol, unsigned int groups)
 {
-    int ret = -1;
-    struct sockaddr_nl nladdr = {
-            .nl_family = AF_NETLINK,
-            .nl_pid    = dst_pid,
-            .nl_groups = 0,
-    };
     ssize_t nbytes;
-    struct pollfd fds[1];
     int fd;
-    int n;
     struct nlmsghdr *nlmsg = nlmsg_hdr(nl_msg);
     virNetlinkHandle *nlhandle = NULL;
-    int len = 0;
 
     if (protocol >= MAX_LINKS) {
         virReportSystemError(EINVAL,
                              _("invalid protocol argument: %d"), protocol);
-        goto cleanup;
+        goto error;
     }
 
     nlhandle = virNetlinkAlloc();
     if (!nlhandle) {
         virReportSystemError(errno,
                              "%s", _("cannot allocate nlhandle for netlink"));
-        goto cleanup;
+        goto error;
     }
 
     if (nl_connect(nlhandle, protocol) < 0) {
         virReportSystemError(errno,
                         _("cannot connect to netlink socket with protocol %d"),
                              protocol);
-        goto cleanup;
+        goto error;
     }
 
     fd = nl_socket_get_fd(nlhandle);
     if (fd < 0) {
         virReportSystemError(errno,
                              "%s", _("cannot get netlink socket fd"));
-        goto cleanup;
+        goto error;
     }
 
     if (groups && nl_socket_add_membership(nlhandle, groups) < 0) {
         virReportSystemError(errno,
                              "%s", _("cannot add netlink membership"));
-        goto cleanup;
+        goto error;
     }
 
     nlmsg_set_dst(nl_msg, &nladdr);
@@ -235,11 +211,25 @@ int virNetlinkCommand(struct nl_msg *nl_msg,
     if (nbytes < 0) {
         virReportSystemError(errno,
                              "%s", _("cannot send to netlink socket"));
-        goto cleanup;
+        goto error;
     }
 
+    return nlhandle;
+
+ error:
+    if (nlhandle)
+        virNetlinkFree(nlhandle);
+    return NULL;
+}
+
+static int
+virNetlinkWaitResponse(virNetlinkHandle *nlhandle)
+{
+    struct pollfd fds[1];
+    int n;
+
     memset(fds, 0, sizeof(fds));
-    fds[0].fd = fd;
+    fds[0].fd = nl_socket_get_fd(nlhandle);
     fds[0].events = POLLIN;
 
     n = poll(fds, ARRAY_CARDINALITY(fds), NETLINK_ACK_TIMEOUT_S);
@@ -250,9 +240,48 @@ int virNetlinkCommand(struct nl_msg *nl_msg,
         if (n == 0)
             virReportSystemError(ETIMEDOUT, "%s",
                                  _("no valid netlink response was received"));
-        goto cleanup;
+        return -1;
     }
 
+    return 0;
+}
+
+/**
+ * virNetlinkCommand:
+ * @nlmsg: pointer to netlink message
+ * @respbuf: pointer to pointer where response buffer will be allocated
+ * @respbuflen: pointer to integer holding the size of the response buffer
+ *      on return of the function.
+ * @src_pid: the pid of the process to send a message
+ * @dst_pid: the pid of the process to talk to, i.e., pid = 0 for kernel
+ * @protocol: netlink protocol
+ * @groups: the group identifier
+ *
+ * Send the given message to the netlink layer and receive response.
+ * Returns 0 on success, -1 on error. In case of error, no response
+ * buffer will be returned.
+ */
+int virNetlinkCommand(struct nl_msg *nl_msg,
+                      struct nlmsghdr **resp, unsigned int *respbuflen,
+                      uint32_t src_pid, uint32_t dst_pid,
+                      unsigned int protocol, unsigned int groups)
+{
+    int ret = -1;
+    struct sockaddr_nl nladdr = {
+            .nl_family = AF_NETLINK,
+            .nl_pid    = dst_pid,
+            .nl_groups = 0,
+    };
+    virNetlinkHandle *nlhandle = NULL;
+    int len = 0;
+
+    if (!(nlhandle = virNetlinkSendRequest(nl_msg, src_pid, nladdr,
+                                           protocol, groups)))
+        goto cleanup;
+
+    if (virNetlinkWaitResponse(nlhandle) < 0)
+        goto cleanup;
+
     len = nl_recv(nlhandle, &nladdr, (unsigned char **)resp, NULL);
     if (len == 0) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
@@ -272,7 +301,96 @@ int virNetlinkCommand(struct nl_msg *nl_msg,
         *respbuflen = 0;
     }
 
-    virNetlinkFree(nlhandle);
+    if (nlhandle)
+        virNetlinkFree(nlhandle);
+    return ret;
+}
+
+/**
+ * virNetlinkDumpCommand:
+ * @nlmsg: pointer to netlink message, which must have NLM_F_DUMP set
+ * @callback: function called for every message of the reply
+ * @src_pid: the pid of the process to send a message
+ * @dst_pid: the pid of the process to talk to, i.e., pid = 0 for kernel
+ * @protocol: netlink protocol
+ * @groups: the group identifier
+ * @opaque: data passed to @callback
+ *
+ * Send the given dump request to the netlink layer and pass every
+ * message of the possibly multi-part response to @callback, until the
+ * kernel signals the end of the dump. This fetches e.g. all links in a
+ * single round trip instead of one request per device.
+ *
+ * Returns 0 on success, -1 on error or if @callback failed.
+ */
+int virNetlinkDumpCommand(struct nl_msg *nl_msg,
+                          virNetlinkDumpCallback callback,
+                          uint32_t src_pid, uint32_t dst_pid,
+                          unsigned int protocol, unsigned int groups,
+                          void *opaque)
+{
+    int ret = -1;
+    bool end = false;
+    int len = 0;
+    struct nlmsghdr *resp = NULL;
+    struct nlmsghdr *msg = NULL;
+    struct nlmsgerr *err;
+    struct sockaddr_nl nladdr = {
+            .nl_family = AF_NETLINK,
+            .nl_pid    = dst_pid,
+            .nl_groups = 0,
+    };
+    virNetlinkHandle *nlhandle = NULL;
+
+    if (!(nlhandle = virNetlinkSendRequest(nl_msg, src_pid, nladdr,
+                                           protocol, groups)))
+        goto cleanup;
+
+    while (!end) {
+        if (virNetlinkWaitResponse(nlhandle) < 0)
+            goto cleanup;
+
+        len = nl_recv(nlhandle, &nladdr, (unsigned char **)&resp, NULL);
+        if (len == 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("nl_recv failed - returned 0 bytes"));
+            goto cleanup;
+        }
+        if (len < 0) {
+            virReportSystemError(errno, "%s", _("nl_recv failed"));
+            goto cleanup;
+        }
+
+        for (msg = resp; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+            if (msg->nlmsg_type == NLMSG_DONE) {
+                end = true;
+                break;
+            }
+
+            if (msg->nlmsg_type == NLMSG_ERROR) {
+                err = (struct nlmsgerr *)NLMSG_DATA(msg);
+                if (msg->nlmsg_len < NLMSG_LENGTH(sizeof(*err))) {
+                    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                                   _("malformed netlink response message"));
+                } else {
+                    virReportSystemError(-err->error, "%s",
+                                         _("netlink dump request failed"));
+                }
+                goto cleanup;
+            }
+
+            if (callback(msg, opaque) < 0)
+                goto cleanup;
+        }
+
+        VIR_FREE(resp);
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(resp);
+    if (nlhandle)
+        virNetlinkFree(nlhandle);
     return ret;
 }
 
@@ -762,6 +880,18 @@ int virNetlinkCommand(struct nl_msg *nl_msg ATTRIBUTE_UNUSED,
     return -1;
 }
 
+int virNetlinkDumpCommand(struct nl_msg *nl_msg ATTRIBUTE_UNUSED,
+                          virNetlinkDumpCallback callback ATTRIBUTE_UNUSED,
+                          uint32_t src_pid ATTRIBUTE_UNUSED,
+                          uint32_t dst_pid ATTRIBUTE_UNUSED,
+                          unsigned int protocol ATTRIBUTE_UNUSED,
+                          unsigned int groups ATTRIBUTE_UNUSED,
+                          void *opaque ATTRIBUTE_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
 /**
  * stopNetlinkEventServer: stop the monitor to receive netlink
  * messages for libvirtd
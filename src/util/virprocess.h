@@ -52,6 +52,10 @@ int virProcessGetAffinity(pid_t pid,
 int virProcessGetStartTime(pid_t pid,
                            unsigned long long *timestamp);
 
+int virProcessGetSchedstat(pid_t pid,
+                           pid_t tid,
+                           unsigned long long *runtime);
+
 int virProcessGetNamespaces(pid_t pid,
                             size_t *nfdlist,
                             int **fdlist);
@@ -37,9 +37,13 @@
 # include "virstatslinux.h"
 # include "viralloc.h"
 # include "virfile.h"
+# include "virlog.h"
+# include "virnetdev.h"
 
 # define VIR_FROM_THIS VIR_FROM_STATS_LINUX
 
+VIR_LOG_INIT("util.statslinux");
+
 
 /*-------------------- interface stats --------------------*/
 /* Just reads the named interface, so not Xen or QEMU-specific.
@@ -47,13 +51,73 @@
  * the interface of a domain they own.  We do no such checking.
  */
 
+/*
+ * Parse one line of /proc/net/dev. On success @ifname points to the
+ * interface name inside @line and @stats is filled in. Returns -1 for
+ * header lines and lines which can't be parsed.
+ */
+static int
+linuxParseInterfaceStatsLine(char *line,
+                             char **ifname,
+                             struct _virDomainInterfaceStats *stats)
+{
+    char *colon;
+    long long dummy;
+    long long rx_bytes;
+    long long rx_packets;
+    long long rx_errs;
+    long long rx_drop;
+    long long tx_bytes;
+    long long tx_packets;
+    long long tx_errs;
+    long long tx_drop;
+
+    /* The line looks like:
+     *   "   eth0:..."
+     * Split it at the colon.
+     */
+    colon = strchr(line, ':');
+    if (!colon)
+        return -1;
+    *colon = '\0';
+
+    /* IMPORTANT NOTE!
+     * /proc/net/dev vif<domid>.nn sees the network from the point
+     * of view of dom0 / hypervisor.  So bytes TRANSMITTED by dom0
+     * are bytes RECEIVED by the domain.  That's why the TX/RX fields
+     * appear to be swapped here.
+     */
+    if (sscanf(colon+1,
+               "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
+               &tx_bytes, &tx_packets, &tx_errs, &tx_drop,
+               &dummy, &dummy, &dummy, &dummy,
+               &rx_bytes, &rx_packets, &rx_errs, &rx_drop,
+               &dummy, &dummy, &dummy, &dummy) != 16)
+        return -1;
+
+    while (*line == ' ')
+        line++;
+    *ifname = line;
+
+    stats->rx_bytes = rx_bytes;
+    stats->rx_packets = rx_packets;
+    stats->rx_errs = rx_errs;
+    stats->rx_drop = rx_drop;
+    stats->tx_bytes = tx_bytes;
+    stats->tx_packets = tx_packets;
+    stats->tx_errs = tx_errs;
+    stats->tx_drop = tx_drop;
+
+    return 0;
+}
+
 int
 linuxDomainInterfaceStats(const char *path,
                           struct _virDomainInterfaceStats *stats)
 {
-    int path_len;
     FILE *fp;
-    char line[256], *colon;
+    char line[256], *ifname;
+    struct _virDomainInterfaceStats tmp;
 
     fp = fopen("/proc/net/dev", "r");
     if (!fp) {
@@ -62,52 +126,13 @@ linuxDomainInterfaceStats(const char *path,
         return -1;
     }
 
-    path_len = strlen(path);
-
     while (fgets(line, sizeof(line), fp)) {
-        long long dummy;
-        long long rx_bytes;
-        long long rx_packets;
-        long long rx_errs;
-        long long rx_drop;
-        long long tx_bytes;
-        long long tx_packets;
-        long long tx_errs;
-        long long tx_drop;
-
-        /* The line looks like:
-         *   "   eth0:..."
-         * Split it at the colon.
-         */
-        colon = strchr(line, ':');
-        if (!colon) continue;
-        *colon = '\0';
-        if (colon-path_len >= line &&
-            STREQ(colon-path_len, path)) {
-            /* IMPORTANT NOTE!
-             * /proc/net/dev vif<domid>.nn sees the network from the point
-             * of view of dom0 / hypervisor.  So bytes TRANSMITTED by dom0
-             * are bytes RECEIVED by the domain.  That's why the TX/RX fields
-             * appear to be swapped here.
-             */
-            if (sscanf(colon+1,
-                       "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
-                       &tx_bytes, &tx_packets, &tx_errs, &tx_drop,
-                       &dummy, &dummy, &dummy, &dummy,
-                       &rx_bytes, &rx_packets, &rx_errs, &rx_drop,
-                       &dummy, &dummy, &dummy, &dummy) != 16)
-                continue;
-
-            stats->rx_bytes = rx_bytes;
-            stats->rx_packets = rx_packets;
-            stats->rx_errs = rx_errs;
-            stats->rx_drop = rx_drop;
-            stats->tx_bytes = tx_bytes;
-            stats->tx_packets = tx_packets;
-            stats->tx_errs = tx_errs;
-            stats->tx_drop = tx_drop;
-            VIR_FORCE_FCLOSE(fp);
+        if (linuxParseInterfaceStatsLine(line, &ifname, &tmp) < 0)
+            continue;
 
+        if (STREQ(ifname, path)) {
+            *stats = tmp;
+            VIR_FORCE_FCLOSE(fp);
             return 0;
         }
     }
@@ -118,4 +143,116 @@ linuxDomainInterfaceStats(const char *path,
     return -1;
 }
 
+# ifdef HAVE_LIBNL
+struct linuxConvertLinkStatsData {
+    virHashTablePtr table;
+    bool error;
+};
+
+/* Adds the domain view of one link of a netlink dump to data->table */
+static void
+linuxConvertLinkStats(void *payload,
+                      const void *name,
+                      void *opaque)
+{
+    virNetDevLinkStatsPtr lnk = payload;
+    struct linuxConvertLinkStatsData *data = opaque;
+    struct _virDomainInterfaceStats *stats;
+
+    if (data->error)
+        return;
+
+    if (VIR_ALLOC(stats) < 0) {
+        data->error = true;
+        return;
+    }
+
+    /* Swapped for the same reason as in linuxParseInterfaceStatsLine */
+    stats->rx_bytes = lnk->tx_bytes;
+    stats->rx_packets = lnk->tx_packets;
+    stats->rx_errs = lnk->tx_errs;
+    stats->rx_drop = lnk->tx_drop;
+    stats->tx_bytes = lnk->rx_bytes;
+    stats->tx_packets = lnk->rx_packets;
+    stats->tx_errs = lnk->rx_errs;
+    stats->tx_drop = lnk->rx_drop;
+
+    if (virHashAddEntry(data->table, name, stats) < 0) {
+        VIR_FREE(stats);
+        data->error = true;
+    }
+}
+# endif
+
+/*
+ * Fetch the stats of all host interfaces at once, from a netlink link
+ * dump if available or else by reading /proc/net/dev once, and return
+ * them in a hash table keyed by interface name, with values of type
+ * struct _virDomainInterfaceStats. Callers querying many interfaces
+ * at once should use this instead of linuxDomainInterfaceStats.
+ * Returns NULL on error.
+ */
+virHashTablePtr
+linuxDomainInterfaceStatsAll(void)
+{
+    FILE *fp;
+    char line[256], *ifname;
+    virHashTablePtr ret = NULL;
+    virHashTablePtr table = NULL;
+    struct _virDomainInterfaceStats *stats = NULL;
+
+# ifdef HAVE_LIBNL
+    struct linuxConvertLinkStatsData data = { NULL, false };
+    virHashTablePtr links;
+
+    /* Prefer a netlink dump, it carries 64-bit counters and is shared
+     * with other users of the link data */
+    if ((links = virNetDevGetAllLinkStats())) {
+        if ((data.table = virHashCreate(virHashSize(links) + 1,
+                                        virHashValueFree))) {
+            virHashForEach(links, linuxConvertLinkStats, &data);
+            if (data.error) {
+                virHashFree(data.table);
+                data.table = NULL;
+            }
+        }
+        virHashFree(links);
+        return data.table;
+    }
+    VIR_DEBUG("Unable to dump links, falling back to /proc/net/dev");
+    virResetLastError();
+# endif
+
+    fp = fopen("/proc/net/dev", "r");
+    if (!fp) {
+        virReportSystemError(errno, "%s",
+                             _("Could not open /proc/net/dev"));
+        return NULL;
+    }
+
+    if (!(table = virHashCreate(32, virHashValueFree)))
+        goto cleanup;
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (!stats && VIR_ALLOC(stats) < 0)
+            goto cleanup;
+
+        if (linuxParseInterfaceStatsLine(line, &ifname, stats) < 0)
+            continue;
+
+        if (virHashUpdateEntry(table, ifname, stats) < 0)
+            goto cleanup;
+        stats = NULL;
+    }
+
+    ret = table;
+    table = NULL;
+
+ cleanup:
+    VIR_FORCE_FCLOSE(fp);
+    VIR_FREE(stats);
+    virHashFree(table);
+    return ret;
+}
+
 #endif /* __linux__ */
@@ -94,6 +94,9 @@ virSysinfoDefPtr virSysinfoRead(void);
 
 void virSysinfoDefFree(virSysinfoDefPtr def);
 
+virSysinfoDefPtr virSysinfoDefCopy(const virSysinfoDef *src)
+    ATTRIBUTE_NONNULL(1);
+
 int virSysinfoFormat(virBufferPtr buf, virSysinfoDefPtr def)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
@@ -37,6 +37,8 @@
 #include "viralloc.h"
 #include "virfile.h"
 #include "virstring.h"
+#include "virhash.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_XML
 
@@ -56,6 +58,88 @@ struct virParserData {
  *									*
  ************************************************************************/
 
+/* Compiled XPath expressions are kept per thread, keyed by the XPath
+ * string. Almost all expressions we evaluate are string literals, so
+ * the cache stays small; should something keep generating new ones,
+ * it is simply emptied once it grows too large. */
+#define VIR_XPATH_CACHE_MAX 2048
+
+static virThreadLocal virXPathCache;
+
+static void
+virXPathCacheEntryFree(void *payload,
+                       const void *name ATTRIBUTE_UNUSED)
+{
+    xmlXPathFreeCompExpr(payload);
+}
+
+static void
+virXPathCacheFree(void *opaque)
+{
+    virHashFree(opaque);
+}
+
+static int
+virXPathOnceInit(void)
+{
+    if (virThreadLocalInit(&virXPathCache, virXPathCacheFree) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to initialize thread local variable"));
+        return -1;
+    }
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virXPath)
+
+
+/* Drop-in replacement for xmlXPathEval which avoids compiling the same
+ * expression over and over again */
+static xmlXPathObjectPtr
+virXPathEvalCached(const char *xpath,
+                   xmlXPathContextPtr ctxt)
+{
+    virHashTablePtr cache = NULL;
+    xmlXPathCompExprPtr comp;
+    xmlXPathObjectPtr obj;
+
+    if (virXPathInitialize() < 0)
+        goto uncached;
+
+    if (!(cache = virThreadLocalGet(&virXPathCache))) {
+        if (!(cache = virHashCreate(64, virXPathCacheEntryFree)))
+            goto uncached;
+
+        if (virThreadLocalSet(&virXPathCache, cache) < 0) {
+            virHashFree(cache);
+            goto uncached;
+        }
+    }
+
+    if ((comp = virHashLookup(cache, xpath)))
+        return xmlXPathCompiledEval(comp, ctxt);
+
+    if (!(comp = xmlXPathCompile(BAD_CAST xpath)))
+        return NULL;
+
+    if (virHashSize(cache) >= VIR_XPATH_CACHE_MAX)
+        virHashRemoveAll(cache);
+
+    if (virHashAddEntry(cache, xpath, comp) < 0) {
+        virResetLastError();
+        obj = xmlXPathCompiledEval(comp, ctxt);
+        xmlXPathFreeCompExpr(comp);
+        return obj;
+    }
+
+    return xmlXPathCompiledEval(comp, ctxt);
+
+ uncached:
+    virResetLastError();
+    return xmlXPathEval(BAD_CAST xpath, ctxt);
+}
+
+
 /**
  * virXPathString:
  * @xpath: the XPath string to evaluate
@@ -80,7 +164,7 @@ virXPathString(const char *xpath,
         return NULL;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_STRING) ||
         (obj->stringval == NULL) || (obj->stringval[0] == 0)) {
@@ -147,7 +231,7 @@ virXPathNumber(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_NUMBER) ||
         (isnan(obj->floatval))) {
@@ -176,7 +260,7 @@ virXPathLongBase(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -282,7 +366,7 @@ virXPathULongBase(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -399,7 +483,7 @@ virXPathULongLong(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -446,7 +530,7 @@ virXPathLongLong(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj != NULL) && (obj->type == XPATH_STRING) &&
         (obj->stringval != NULL) && (obj->stringval[0] != 0)) {
@@ -506,7 +590,7 @@ virXPathBoolean(const char *xpath,
         return -1;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_BOOLEAN) ||
         (obj->boolval < 0) || (obj->boolval > 1)) {
@@ -543,7 +627,7 @@ virXPathNode(const char *xpath,
         return NULL;
     }
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if ((obj == NULL) || (obj->type != XPATH_NODESET) ||
         (obj->nodesetval == NULL) || (obj->nodesetval->nodeNr <= 0) ||
@@ -587,7 +671,7 @@ virXPathNodeSet(const char *xpath,
         *list = NULL;
 
     relnode = ctxt->node;
-    obj = xmlXPathEval(BAD_CAST xpath, ctxt);
+    obj = virXPathEvalCached(xpath, ctxt);
     ctxt->node = relnode;
     if (obj == NULL)
         return 0;
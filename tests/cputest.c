@@ -42,6 +42,8 @@
 
 #define VIR_FROM_THIS VIR_FROM_CPU
 
+#define DECODE_BENCH_LOOPS 2000
+
 enum cpuTestBoolWithError {
     FAIL    = -1,
     NO      = 0,
@@ -454,6 +456,64 @@ cpuTestHasFeature(const void *arg)
 }
 
 
+struct cpuTestDecodeBenchData {
+    virCPUDataPtr data;
+    virArch arch;
+    virCPUDefPtr cpu;
+};
+
+static int
+cpuTestDecodeBenchOne(void *opaque)
+{
+    struct cpuTestDecodeBenchData *data = opaque;
+
+    virCPUDefFree(data->cpu);
+    if (VIR_ALLOC(data->cpu) < 0)
+        return -1;
+
+    data->cpu->arch = data->arch;
+    data->cpu->type = VIR_CPU_TYPE_HOST;
+    return cpuDecode(data->cpu, data->data, NULL, 0, NULL);
+}
+
+/* Decoding CPUID data encoded from the host CPU must give back the
+ * host's model. All decodes score the candidates with the model
+ * bitmaps built once when the CPU map was loaded. */
+static int
+cpuTestDecodeBench(const void *arg ATTRIBUTE_UNUSED)
+{
+    int ret = -1;
+    virCPUDefPtr host = NULL;
+    struct cpuTestDecodeBenchData data = { NULL, VIR_ARCH_NONE, NULL };
+
+    if (!(host = cpuTestLoadXML("x86", "host")))
+        goto cleanup;
+
+    if (cpuEncode(host->arch, host, NULL, &data.data,
+                  NULL, NULL, NULL, NULL) < 0)
+        goto cleanup;
+    data.arch = host->arch;
+
+    if (virtTestBench("decodes", DECODE_BENCH_LOOPS,
+                      cpuTestDecodeBenchOne, &data) < 0)
+        goto cleanup;
+
+    if (STRNEQ_NULLABLE(data.cpu->model, host->model)) {
+        fprintf(stderr, "Expected CPU model %s, got %s\n",
+                host->model, NULLSTR(data.cpu->model));
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    cpuDataFree(data.data);
+    virCPUDefFree(host);
+    virCPUDefFree(data.cpu);
+    return ret;
+}
+
+
 static int (*cpuTest[])(const void *) = {
     cpuTestCompare,
     cpuTestGuestData,
@@ -644,6 +704,9 @@ mymain(void)
     DO_TEST_GUESTDATA("ppc64", "host", "guest", ppc_models, NULL, 0);
     DO_TEST_GUESTDATA("ppc64", "host", "guest-nofallback", ppc_models, "POWER7_v2.1", -1);
 
+    if (virtTestRun("CPU decode benchmark", cpuTestDecodeBench, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
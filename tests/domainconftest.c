@@ -24,6 +24,8 @@
 #include "virerror.h"
 #include "viralloc.h"
 #include "virlog.h"
+#include "virbuffer.h"
+#include "virutil.h"
 
 #include "domain_conf.h"
 
@@ -85,6 +87,146 @@ static int testGetFilesystem(const void *opaque)
     return ret;
 }
 
+
+#define PARSE_BENCH_DISKS 60
+#define PARSE_BENCH_NETS 40
+#define PARSE_BENCH_LOOPS 100
+
+struct testParseBenchData {
+    const char *xml;
+    virDomainDefPtr def;
+};
+
+static int testParseBenchOne(void *opaque)
+{
+    struct testParseBenchData *data = opaque;
+
+    virDomainDefFree(data->def);
+    if (!(data->def = virDomainDefParseString(data->xml, caps, xmlopt,
+                                              1 << VIR_DOMAIN_VIRT_TEST, 0)))
+        return -1;
+
+    return 0;
+}
+
+/* Repeated parses of one domain evaluate XPath expressions taken from
+ * the per-thread cache, which must still find every disk and
+ * interface of it. */
+static int testParseBench(const void *opaque ATTRIBUTE_UNUSED)
+{
+    int ret = -1;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    struct testParseBenchData data = { NULL, NULL };
+    char *xmlData = NULL;
+    char *dst;
+    size_t i;
+
+    virBufferAddLit(&buf, "<domain type='test'>\n");
+    virBufferAdjustIndent(&buf, 2);
+    virBufferAddLit(&buf, "<name>bench</name>\n");
+    virBufferAddLit(&buf, "<memory unit='KiB'>500000</memory>\n");
+    virBufferAddLit(&buf, "<vcpu placement='static'>4</vcpu>\n");
+    virBufferAddLit(&buf, "<os>\n");
+    virBufferAddLit(&buf, "  <type arch='x86_64'>hvm</type>\n");
+    virBufferAddLit(&buf, "</os>\n");
+    virBufferAddLit(&buf, "<devices>\n");
+    virBufferAdjustIndent(&buf, 2);
+    for (i = 0; i < PARSE_BENCH_DISKS; i++) {
+        if (!(dst = virIndexToDiskName(i, "vd")))
+            goto cleanup;
+        virBufferAddLit(&buf, "<disk type='file' device='disk'>\n");
+        virBufferAddLit(&buf, "  <driver name='qemu' type='qcow2'/>\n");
+        virBufferAsprintf(&buf, "  <source file='/var/lib/images/%s.img'/>\n",
+                          dst);
+        virBufferAsprintf(&buf, "  <target dev='%s' bus='virtio'/>\n", dst);
+        virBufferAddLit(&buf, "</disk>\n");
+        VIR_FREE(dst);
+    }
+    for (i = 0; i < PARSE_BENCH_NETS; i++) {
+        virBufferAddLit(&buf, "<interface type='bridge'>\n");
+        virBufferAsprintf(&buf, "  <mac address='52:54:00:00:00:%02zx'/>\n",
+                          i);
+        virBufferAddLit(&buf, "  <source bridge='br0'/>\n");
+        virBufferAddLit(&buf, "  <model type='virtio'/>\n");
+        virBufferAddLit(&buf, "</interface>\n");
+    }
+    virBufferAdjustIndent(&buf, -2);
+    virBufferAddLit(&buf, "</devices>\n");
+    virBufferAdjustIndent(&buf, -2);
+    virBufferAddLit(&buf, "</domain>\n");
+
+    if (virBufferCheckError(&buf) < 0)
+        goto cleanup;
+    data.xml = xmlData = virBufferContentAndReset(&buf);
+
+    if (virtTestBench("parses", PARSE_BENCH_LOOPS,
+                      testParseBenchOne, &data) < 0)
+        goto cleanup;
+
+    if (data.def->ndisks != PARSE_BENCH_DISKS ||
+        data.def->nnets != PARSE_BENCH_NETS) {
+        fprintf(stderr, "Expected %d disks and %d nets, got %zu and %zu\n",
+                PARSE_BENCH_DISKS, PARSE_BENCH_NETS,
+                data.def->ndisks, data.def->nnets);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virBufferFreeAndReset(&buf);
+    virDomainDefFree(data.def);
+    VIR_FREE(xmlData);
+    return ret;
+}
+
+/* The XML cache must be emptied and the generation changed by every
+ * bump, and flag combinations outside the public ones are not cached */
+static int testXMLCache(const void *opaque ATTRIBUTE_UNUSED)
+{
+    int ret = -1;
+    virDomainObjPtr vm = NULL;
+    unsigned long long generation;
+    unsigned int flags = VIR_DOMAIN_XML_SECURE | VIR_DOMAIN_XML_INACTIVE;
+
+    if (!(vm = virDomainObjNew(xmlopt)))
+        goto cleanup;
+
+    if (virDomainObjGetCachedXML(vm, flags)) {
+        fprintf(stderr, "New domain object has cached XML\n");
+        goto cleanup;
+    }
+
+    if (virDomainObjSetCachedXML(vm, flags, "<domain/>") < 0 ||
+        virDomainObjSetCachedXML(vm, 1 << 16, "<domain/>") < 0)
+        goto cleanup;
+
+    if (STRNEQ_NULLABLE(virDomainObjGetCachedXML(vm, flags), "<domain/>") ||
+        virDomainObjGetCachedXML(vm, 0) ||
+        virDomainObjGetCachedXML(vm, 1 << 16)) {
+        fprintf(stderr, "Wrong XML cached\n");
+        goto cleanup;
+    }
+
+    generation = vm->generation;
+    virDomainObjBumpGeneration(vm);
+
+    if (vm->generation == generation ||
+        virDomainObjGetCachedXML(vm, flags)) {
+        fprintf(stderr, "Bumping the generation kept the cached XML\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (vm) {
+        virObjectUnlock(vm);
+        virObjectUnref(vm);
+    }
+    return ret;
+}
+
 static int
 mymain(void)
 {
@@ -112,6 +254,12 @@ mymain(void)
     DO_TEST_GET_FS("/dev/pts", false);
     DO_TEST_GET_FS("/doesnotexist", false);
 
+    if (virtTestRun("Parse benchmark", testParseBench, NULL) < 0)
+        ret = -1;
+
+    if (virtTestRun("XML cache", testXMLCache, NULL) < 0)
+        ret = -1;
+
     virObjectUnref(caps);
     virObjectUnref(xmlopt);
 
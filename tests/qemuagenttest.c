@@ -24,6 +24,7 @@
 #include "qemumonitortestutils.h"
 #include "qemu/qemu_conf.h"
 #include "qemu/qemu_agent.h"
+#include "qemu/qemu_driverpriv.h"
 #include "virthread.h"
 #include "virerror.h"
 #include "virstring.h"
@@ -49,9 +50,6 @@ testQemuAgentFSFreeze(const void *data)
                                "{ \"return\" : 5 }") < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItem(test, "guest-fsfreeze-freeze",
                                "{ \"return\" : 7 }") < 0)
         goto cleanup;
@@ -100,9 +98,6 @@ testQemuAgentFSThaw(const void *data)
                                "{ \"return\" : 5 }") < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItem(test, "guest-fsfreeze-thaw",
                                "{ \"return\" : 7 }") < 0)
         goto cleanup;
@@ -133,6 +128,256 @@ testQemuAgentFSThaw(const void *data)
 }
 
 
+struct testQemuAgentAsyncData {
+    virMutex lock;
+    virCond cond;
+    bool done;
+    int ret;
+};
+
+
+static void
+testQemuAgentAsyncCallback(qemuAgentPtr mon ATTRIBUTE_UNUSED,
+                           int ret,
+                           virErrorPtr err ATTRIBUTE_UNUSED,
+                           void *opaque)
+{
+    struct testQemuAgentAsyncData *data = opaque;
+
+    virMutexLock(&data->lock);
+    data->ret = ret;
+    data->done = true;
+    virCondSignal(&data->cond);
+    virMutexUnlock(&data->lock);
+}
+
+
+static int
+testQemuAgentFSFreezeAsync(const void *data)
+{
+    virDomainXMLOptionPtr xmlopt = (virDomainXMLOptionPtr)data;
+    qemuMonitorTestPtr test = qemuMonitorTestNewAgent(xmlopt);
+    qemuAgentPtr agent;
+    struct testQemuAgentAsyncData freeze = { .done = false };
+    struct testQemuAgentAsyncData thaw = { .done = false };
+    const char *mountpoints[] = {"/fs1", "/fs2"};
+    int rc;
+    int ret = -1;
+
+    if (!test)
+        return -1;
+
+    if (virMutexInit(&freeze.lock) < 0 ||
+        virCondInit(&freeze.cond) < 0 ||
+        virMutexInit(&thaw.lock) < 0 ||
+        virCondInit(&thaw.cond) < 0)
+        goto cleanup;
+
+    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
+        goto cleanup;
+
+    if (qemuMonitorTestAddItem(test, "guest-fsfreeze-freeze",
+                               "{ \"return\" : 2 }") < 0)
+        goto cleanup;
+
+    if (qemuMonitorTestAddItem(test, "guest-fsfreeze-thaw",
+                               "{ \"return\" : 2 }") < 0)
+        goto cleanup;
+
+    /* both commands are queued at once, the thaw has to
+     * be sent only after the freeze finished */
+    agent = qemuMonitorTestGetAgent(test);
+    virObjectLock(agent);
+    rc = qemuAgentFSFreezeAsync(agent, mountpoints, 2,
+                                VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT,
+                                testQemuAgentAsyncCallback, &freeze);
+    if (rc == 0)
+        rc = qemuAgentFSThawAsync(agent,
+                                  VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT,
+                                  testQemuAgentAsyncCallback, &thaw);
+    virObjectUnlock(agent);
+    if (rc < 0)
+        goto cleanup;
+
+    virMutexLock(&thaw.lock);
+    while (!thaw.done)
+        ignore_value(virCondWait(&thaw.cond, &thaw.lock));
+    virMutexUnlock(&thaw.lock);
+
+    virMutexLock(&freeze.lock);
+    while (!freeze.done)
+        ignore_value(virCondWait(&freeze.cond, &freeze.lock));
+    virMutexUnlock(&freeze.lock);
+
+    if (freeze.ret != 2 || thaw.ret != 2) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "expected 2 frozen and thawed filesystems, "
+                       "got %d and %d", freeze.ret, thaw.ret);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    qemuMonitorTestFree(test);
+    virMutexDestroy(&freeze.lock);
+    ignore_value(virCondDestroy(&freeze.cond));
+    virMutexDestroy(&thaw.lock);
+    ignore_value(virCondDestroy(&thaw.cond));
+    return ret;
+}
+
+
+/* Queues the freezes of a group snapshot of @nmembers guests, whose
+ * agents give the @replies. A NULL reply stands for a member that
+ * fails before its guest is asked to freeze, after which no more
+ * freezes are queued. Checks whether the group may go on and how each
+ * guest is thawed, as of qemuDomainSnapshotGroupThawMode. */
+static int
+testQemuAgentGroup(virDomainXMLOptionPtr xmlopt,
+                   const char *const *replies,
+                   size_t nmembers,
+                   bool frozen,
+                   const int *thaw)
+{
+    qemuDomainSnapshotGroup group;
+    qemuMonitorTestPtr *tests = NULL;
+    qemuAgentPtr agent;
+    int timeout = VIR_DOMAIN_QEMU_AGENT_COMMAND_DEFAULT;
+    size_t i;
+    int rc;
+    bool failed;
+    int ret = -1;
+
+    memset(&group, 0, sizeof(group));
+
+    if (qemuDomainSnapshotGroupInit(&group, NULL, nmembers) < 0 ||
+        VIR_ALLOC_N(tests, nmembers) < 0)
+        goto cleanup;
+
+    for (i = 0; i < nmembers; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+
+        if (!replies[i]) {
+            virReportError(VIR_ERR_OPERATION_INVALID,
+                           "member %zu can't be frozen", i);
+            qemuDomainSnapshotGroupFail(member);
+            break;
+        }
+
+        if (!(tests[i] = qemuMonitorTestNewAgent(xmlopt)))
+            goto cleanup;
+
+        if (qemuMonitorTestAddAgentSyncResponse(tests[i]) < 0)
+            goto cleanup;
+
+        if (qemuMonitorTestAddItem(tests[i], "guest-fsfreeze-freeze",
+                                   replies[i]) < 0)
+            goto cleanup;
+
+        agent = qemuMonitorTestGetAgent(tests[i]);
+        virObjectLock(agent);
+        rc = qemuDomainSnapshotGroupQueueFreeze(agent, member, timeout);
+        virObjectUnlock(agent);
+        if (rc < 0)
+            goto cleanup;
+    }
+    virResetLastError();
+
+    if (qemuDomainSnapshotGroupWaitFrozen(&group) != frozen) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "expected the group %s be frozen",
+                       frozen ? "to" : "not to");
+        goto cleanup;
+    }
+
+    for (i = 0; i < nmembers; i++) {
+        qemuDomainSnapshotGroupMemberPtr member = &group.members[i];
+        int mode = qemuDomainSnapshotGroupThawMode(member);
+
+        if (mode != thaw[i]) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "expected thaw mode %d of member %zu, got %d",
+                           thaw[i], i, mode);
+            goto cleanup;
+        }
+
+        /* whatever kept a member from freezing is what gets reported */
+        failed = !replies[i] || thaw[i] < 0;
+        if (!!member->err != failed) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "unexpected error state of member %zu", i);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (tests) {
+        for (i = 0; i < nmembers; i++)
+            qemuMonitorTestFree(tests[i]);
+        VIR_FREE(tests);
+    }
+    qemuDomainSnapshotGroupClear(&group);
+    return ret;
+}
+
+
+#define TEST_GROUP_FROZEN "{ \"return\" : 1 }"
+#define TEST_GROUP_FAILED                                               \
+    "{ \"error\" :"                                                     \
+    "    { \"class\" : \"GenericError\","                               \
+    "      \"desc\" : \"failed to freeze /: Device busy\""              \
+    "    }"                                                             \
+    "}"
+
+static int
+testQemuAgentGroupFreeze(const void *data)
+{
+    const char *replies[] = {
+        TEST_GROUP_FROZEN, TEST_GROUP_FROZEN, TEST_GROUP_FROZEN
+    };
+    const int thaw[] = { 1, 1, 1 };
+
+    return testQemuAgentGroup((virDomainXMLOptionPtr)data,
+                              replies, ARRAY_CARDINALITY(replies),
+                              true, thaw);
+}
+
+
+/* The guests that froze are still thawed, the one that failed
+ * may have frozen some filesystems already */
+static int
+testQemuAgentGroupFreezeFailed(const void *data)
+{
+    const char *replies[] = {
+        TEST_GROUP_FROZEN, TEST_GROUP_FAILED, TEST_GROUP_FROZEN
+    };
+    const int thaw[] = { 1, -1, 1 };
+
+    return testQemuAgentGroup((virDomainXMLOptionPtr)data,
+                              replies, ARRAY_CARDINALITY(replies),
+                              false, thaw);
+}
+
+
+/* A member that fails before its freeze leaves the guests frozen
+ * so far to be thawed, and the others alone */
+static int
+testQemuAgentGroupFreezePartial(const void *data)
+{
+    const char *replies[] = {
+        TEST_GROUP_FROZEN, NULL, TEST_GROUP_FROZEN
+    };
+    const int thaw[] = { 1, 0, 0 };
+
+    return testQemuAgentGroup((virDomainXMLOptionPtr)data,
+                              replies, ARRAY_CARDINALITY(replies),
+                              false, thaw);
+}
+
+
 static int
 testQemuAgentFSTrim(const void *data)
 {
@@ -181,16 +426,10 @@ testQemuAgentSuspend(const void *data)
                                "{ \"return\" : {} }") < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItem(test, "guest-suspend-disk",
                                "{ \"return\" : {} }") < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItem(test, "guest-suspend-hybrid",
                                "{ \"return\" : {} }") < 0)
         goto cleanup;
@@ -425,9 +664,6 @@ testQemuAgentCPU(const void *data)
     if (qemuAgentUpdateCPUInfo(2, cpuinfo, nvcpus) < 0)
         goto cleanup;
 
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItemParams(test, "guest-set-vcpus",
                                      "{ \"return\" : 4 }",
                                      "vcpus", testQemuAgentCPUArguments1,
@@ -445,9 +681,6 @@ testQemuAgentCPU(const void *data)
     }
 
     /* try to hotplug two */
-    if (qemuMonitorTestAddAgentSyncResponse(test) < 0)
-        goto cleanup;
-
     if (qemuMonitorTestAddItemParams(test, "guest-set-vcpus",
                                      "{ \"return\" : 4 }",
                                      "vcpus", testQemuAgentCPUArguments2,
@@ -604,6 +837,10 @@ mymain(void)
 
     DO_TEST(FSFreeze);
     DO_TEST(FSThaw);
+    DO_TEST(FSFreezeAsync);
+    DO_TEST(GroupFreeze);
+    DO_TEST(GroupFreezeFailed);
+    DO_TEST(GroupFreezePartial);
     DO_TEST(FSTrim);
     DO_TEST(Suspend);
     DO_TEST(Shutdown);
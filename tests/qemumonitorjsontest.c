@@ -1023,6 +1023,78 @@ testQemuMonitorJSONGetDeviceAliases(const void *data)
     return ret;
 }
 
+static int
+testQemuMonitorJSONGetStartupInfo(const void *data)
+{
+    virDomainXMLOptionPtr xmlopt = (virDomainXMLOptionPtr)data;
+    qemuMonitorTestPtr test = qemuMonitorTestNewSimple(true, xmlopt);
+    int ret = -1;
+    virHashTablePtr paths = NULL;
+    int *pids = NULL;
+    int npids;
+    char **aliases = NULL;
+    const char *path;
+
+    if (!test)
+        return -1;
+
+    if (!(paths = virHashCreate(32, (virHashDataFree) free)))
+        goto cleanup;
+
+    if (qemuMonitorTestAddItem(test, "query-chardev",
+                               "{\"return\": ["
+                               " {\"filename\": \"pty:/dev/pts/20\","
+                               "  \"label\": \"charserial0\"}"
+                               "]}") < 0 ||
+        qemuMonitorTestAddItem(test, "query-cpus",
+                               "{\"return\": ["
+                               " {\"current\": true, \"CPU\": 0,"
+                               "  \"halted\": false, \"thread_id\": 17622},"
+                               " {\"current\": false, \"CPU\": 1,"
+                               "  \"halted\": true, \"thread_id\": 17624}"
+                               "]}") < 0 ||
+        qemuMonitorTestAddItem(test, "qom-list",
+                               "{\"return\": ["
+                               " {\"name\": \"serial0\","
+                               "  \"type\": \"child<isa-serial>\"},"
+                               " {\"name\": \"type\", \"type\": \"string\"}"
+                               "]}") < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONGetStartupInfo(qemuMonitorTestGetMonitor(test),
+                                      paths, &pids, &npids, &aliases) < 0)
+        goto cleanup;
+
+    if (!(path = virHashLookup(paths, "charserial0")) ||
+        STRNEQ(path, "/dev/pts/20")) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "missing or wrong path for charserial0");
+        goto cleanup;
+    }
+
+    if (npids != 2 || pids[0] != 17622 || pids[1] != 17624) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "unexpected vCPU threads, got %d", npids);
+        goto cleanup;
+    }
+
+    if (!aliases || !aliases[0] || STRNEQ(aliases[0], "serial0") ||
+        aliases[1]) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "unexpected device aliases");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virHashFree(paths);
+    VIR_FREE(pids);
+    virStringFreeList(aliases);
+    qemuMonitorTestFree(test);
+    return ret;
+}
+
 static int
 testQemuMonitorJSONCPU(const void *data)
 {
@@ -1620,6 +1692,84 @@ testQemuMonitorJSONqemuMonitorJSONGetBlockStatsInfo(const void *data)
     return ret;
 }
 
+static int
+testQemuMonitorJSONqemuMonitorJSONGetDomainStats(const void *data)
+{
+    virDomainXMLOptionPtr xmlopt = (virDomainXMLOptionPtr)data;
+    qemuMonitorTestPtr test = qemuMonitorTestNewSimple(true, xmlopt);
+    int ret = -1;
+    const char *devs[] = { "virtio-disk0", NULL, "virtio-disk9" };
+    qemuBlockStats blockstats[ARRAY_CARDINALITY(devs)];
+    int blockrc[ARRAY_CARDINALITY(devs)];
+    virDomainMemoryStatStruct memstats[VIR_DOMAIN_MEMORY_STAT_NR];
+    int nblockparams;
+    int nmemstats;
+
+    if (!test)
+        return -1;
+
+    if (qemuMonitorTestAddItem(test, "query-blockstats",
+                               "{\"return\": ["
+                               " {\"device\": \"drive-virtio-disk0\","
+                               "  \"stats\": {"
+                               "   \"flush_total_time_ns\": 0,"
+                               "   \"wr_highest_offset\": 10406001664,"
+                               "   \"wr_total_time_ns\": 530699221,"
+                               "   \"wr_bytes\": 2845696,"
+                               "   \"rd_total_time_ns\": 640616474,"
+                               "   \"flush_operations\": 0,"
+                               "   \"wr_operations\": 174,"
+                               "   \"rd_bytes\": 28505088,"
+                               "   \"rd_operations\": 1279}}"
+                               "]}") < 0 ||
+        qemuMonitorTestAddItem(test, "query-balloon",
+                               "{\"return\": {\"actual\": 4294967296}}") < 0)
+        goto cleanup;
+
+    if (qemuMonitorJSONGetDomainStats(qemuMonitorTestGetMonitor(test), NULL,
+                                      ARRAY_CARDINALITY(devs), devs,
+                                      blockstats, blockrc, &nblockparams,
+                                      memstats, VIR_DOMAIN_MEMORY_STAT_NR,
+                                      &nmemstats) < 0)
+        goto cleanup;
+
+    if (blockrc[0] != 0 || blockrc[1] != -1 || blockrc[2] != -1) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Unexpected block stats results: %d %d %d",
+                       blockrc[0], blockrc[1], blockrc[2]);
+        goto cleanup;
+    }
+
+    if (blockstats[0].rd_req != 1279 ||
+        blockstats[0].wr_bytes != 2845696 ||
+        blockstats[0].errs != -1) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Invalid block stats of virtio-disk0");
+        goto cleanup;
+    }
+
+    if (nblockparams != 8) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "Invalid number of stats: %d, expected 8",
+                       nblockparams);
+        goto cleanup;
+    }
+
+    if (nmemstats != 1 ||
+        memstats[0].tag != VIR_DOMAIN_MEMORY_STAT_ACTUAL_BALLOON ||
+        memstats[0].val != 4194304) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       "Invalid memory stats");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    qemuMonitorTestFree(test);
+    return ret;
+}
+
 static int
 testQemuMonitorJSONqemuMonitorJSONGetMigrationCacheSize(const void *data)
 {
@@ -2256,6 +2406,7 @@ mymain(void)
     DO_TEST(GetObjectProperty);
     DO_TEST(SetObjectProperty);
     DO_TEST(GetDeviceAliases);
+    DO_TEST(GetStartupInfo);
     DO_TEST(CPU);
     DO_TEST(GetNonExistingCPUData);
     DO_TEST_SIMPLE("qmp_capabilities", qemuMonitorJSONSetCapabilities);
@@ -2297,6 +2448,7 @@ mymain(void)
     DO_TEST(qemuMonitorJSONGetBalloonInfo);
     DO_TEST(qemuMonitorJSONGetBlockInfo);
     DO_TEST(qemuMonitorJSONGetBlockStatsInfo);
+    DO_TEST(qemuMonitorJSONGetDomainStats);
     DO_TEST(qemuMonitorJSONGetMigrationCacheSize);
     DO_TEST(qemuMonitorJSONGetMigrationStatus);
     DO_TEST(qemuMonitorJSONGetSpiceMigrationStatus);
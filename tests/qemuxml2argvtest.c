@@ -396,6 +396,26 @@ static int testCompareXMLToArgvFiles(const char *xml,
         goto out;
     }
 
+    /* The guest CPU argument is cached now, building the command line
+     * again must give exactly the same result */
+    if (vmdef->cpu) {
+        virCommandFree(cmd);
+        VIR_FREE(actualargv);
+
+        if (!(cmd = qemuBuildCommandLine(conn, &driver, vmdef, &monitor_chr,
+                                         (flags & FLAG_JSON), extraFlags,
+                                         migrateFrom, migrateFd, NULL,
+                                         VIR_NETDEV_VPORT_PROFILE_OP_NO_OP,
+                                         &testCallbacks, false)) ||
+            !(actualargv = virCommandToString(cmd)))
+            goto out;
+
+        if (STRNEQ(expectargv, actualargv)) {
+            virtTestDifference(stderr, expectargv, actualargv);
+            goto out;
+        }
+    }
+
  ok:
     if (!virtTestOOMActive() &&
         (flags & FLAG_EXPECT_ERROR)) {
@@ -519,6 +539,10 @@ mymain(void)
 
     if ((driver.caps = testQemuCapsInit()) == NULL)
         return EXIT_FAILURE;
+    if (virMutexInit(&driver.lock) < 0)
+        return EXIT_FAILURE;
+    if (!(driver.cpuModelArgs = virQEMUDriverCpuModelArgCacheNew()))
+        return EXIT_FAILURE;
     if (!(driver.xmlopt = virQEMUDriverCreateXMLConf(&driver)))
         return EXIT_FAILURE;
     VIR_FREE(driver.config->stateDir);
@@ -1389,6 +1413,8 @@ mymain(void)
     virObjectUnref(driver.config);
     virObjectUnref(driver.caps);
     virObjectUnref(driver.xmlopt);
+    virHashFree(driver.cpuModelArgs);
+    virMutexDestroy(&driver.lock);
 
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
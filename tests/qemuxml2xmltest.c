@@ -22,6 +22,55 @@
 
 static virQEMUDriver driver;
 
+/* The native copy of a definition must match what a round trip
+ * through XML gives, migratable or not.  */
+static int
+testCompareDefCopy(virDomainDefPtr def, const char *inxml, bool migratable)
+{
+    char *xml = NULL;
+    char *expected = NULL;
+    char *actual = NULL;
+    virDomainDefPtr roundtrip = NULL;
+    virDomainDefPtr copy = NULL;
+    unsigned int flags = VIR_DOMAIN_XML_SECURE;
+    int ret = -1;
+
+    if (migratable)
+        flags |= VIR_DOMAIN_XML_INACTIVE | VIR_DOMAIN_XML_MIGRATABLE;
+
+    if (!(xml = virDomainDefFormat(def, flags)))
+        goto cleanup;
+
+    if (!(roundtrip = virDomainDefParseString(xml, driver.caps, driver.xmlopt,
+                                              QEMU_EXPECTED_VIRT_TYPES,
+                                              VIR_DOMAIN_XML_INACTIVE)))
+        goto cleanup;
+
+    if (!(copy = virDomainDefCopy(def, driver.caps, driver.xmlopt,
+                                  migratable)))
+        goto cleanup;
+
+    if (!(expected = virDomainDefFormat(roundtrip, VIR_DOMAIN_XML_SECURE)) ||
+        !(actual = virDomainDefFormat(copy, VIR_DOMAIN_XML_SECURE)))
+        goto cleanup;
+
+    if (STRNEQ(expected, actual)) {
+        fprintf(stderr, "%scopy of %s differs from XML round trip\n",
+                migratable ? "migratable " : "", inxml);
+        virtTestDifference(stderr, expected, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(xml);
+    VIR_FREE(expected);
+    VIR_FREE(actual);
+    virDomainDefFree(roundtrip);
+    virDomainDefFree(copy);
+    return ret;
+}
+
 static int
 testCompareXMLToXMLFiles(const char *inxml, const char *outxml, bool live)
 {
@@ -54,6 +103,10 @@ testCompareXMLToXMLFiles(const char *inxml, const char *outxml, bool live)
         goto fail;
     }
 
+    if (testCompareDefCopy(def, inxml, false) < 0 ||
+        testCompareDefCopy(def, inxml, true) < 0)
+        goto fail;
+
     ret = 0;
  fail:
     VIR_FREE(inXmlData);
@@ -63,6 +116,112 @@ testCompareXMLToXMLFiles(const char *inxml, const char *outxml, bool live)
     return ret;
 }
 
+/* The hostdev a network interface gets as its actual device is not
+ * part of the config, a copy must drop it along with <actual>.  */
+static int
+testCompareDefCopyActualHostdev(const void *data ATTRIBUTE_UNUSED)
+{
+    char *inxml = NULL;
+    char *inXmlData = NULL;
+    virDomainDefPtr def = NULL;
+    virDomainNetDefPtr net;
+    virDomainActualNetDefPtr actual;
+    virDomainHostdevDefPtr hostdev;
+    int ret = -1;
+
+    if (virAsprintf(&inxml, "%s/qemuxml2argvdata/qemuxml2argv-%s.xml",
+                    abs_srcdir, "net-virtio-network-portgroup") < 0 ||
+        virtTestLoadFile(inxml, &inXmlData) < 0)
+        goto cleanup;
+
+    if (!(def = virDomainDefParseString(inXmlData, driver.caps, driver.xmlopt,
+                                        QEMU_EXPECTED_VIRT_TYPES, 0)))
+        goto cleanup;
+
+    net = def->nets[0];
+    if (net->type != VIR_DOMAIN_NET_TYPE_NETWORK) {
+        fprintf(stderr, "expected a network interface in %s\n", inxml);
+        goto cleanup;
+    }
+
+    /* what the network driver does when it hands out a VF */
+    if (VIR_ALLOC(actual) < 0)
+        goto cleanup;
+    net->data.network.actual = actual;
+    actual->type = VIR_DOMAIN_NET_TYPE_HOSTDEV;
+    hostdev = &actual->data.hostdev.def;
+    hostdev->parent.type = VIR_DOMAIN_DEVICE_NET;
+    hostdev->parent.data.net = net;
+    hostdev->info = &net->info;
+    hostdev->mode = VIR_DOMAIN_HOSTDEV_MODE_SUBSYS;
+    hostdev->managed = true;
+    hostdev->source.subsys.type = VIR_DOMAIN_HOSTDEV_SUBSYS_TYPE_PCI;
+    hostdev->source.subsys.u.pci.addr.bus = 3;
+    hostdev->source.subsys.u.pci.addr.slot = 7;
+    hostdev->source.subsys.u.pci.addr.function = 1;
+
+    if (virDomainHostdevInsert(def, hostdev) < 0)
+        goto cleanup;
+
+    if (testCompareDefCopy(def, inxml, false) < 0 ||
+        testCompareDefCopy(def, inxml, true) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(inxml);
+    VIR_FREE(inXmlData);
+    virDomainDefFree(def);
+    return ret;
+}
+
+/* Migratable copies drop the listen addresses that were taken from the
+ * config file of the driver rather than from the domain XML.  */
+static int
+testCompareDefCopyConfigListen(const void *data ATTRIBUTE_UNUSED)
+{
+    char *inxml = NULL;
+    char *inXmlData = NULL;
+    virDomainDefPtr def = NULL;
+    virDomainDefPtr copy = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&inxml, "%s/qemuxml2argvdata/qemuxml2argv-%s.xml",
+                    abs_srcdir, "graphics-vnc") < 0 ||
+        virtTestLoadFile(inxml, &inXmlData) < 0)
+        goto cleanup;
+
+    if (!(def = virDomainDefParseString(inXmlData, driver.caps, driver.xmlopt,
+                                        QEMU_EXPECTED_VIRT_TYPES,
+                                        VIR_DOMAIN_XML_INACTIVE)))
+        goto cleanup;
+
+    /* what qemuProcessStart does for vnc_listen from qemu.conf */
+    def->graphics[0]->listens[0].fromConfig = true;
+
+    if (testCompareDefCopy(def, inxml, false) < 0 ||
+        testCompareDefCopy(def, inxml, true) < 0)
+        goto cleanup;
+
+    if (!(copy = virDomainDefCopy(def, driver.caps, driver.xmlopt, true)))
+        goto cleanup;
+
+    if (copy->graphics[0]->nListens != 0) {
+        fprintf(stderr, "migratable copy kept the config file listen\n");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(inxml);
+    VIR_FREE(inXmlData);
+    virDomainDefFree(def);
+    virDomainDefFree(copy);
+    return ret;
+}
+
 enum {
     WHEN_INACTIVE = 1,
     WHEN_ACTIVE = 2,
@@ -231,6 +390,9 @@ mymain(void)
     DO_TEST_FULL("disk-mirror", true, WHEN_INACTIVE);
     DO_TEST("graphics-listen-network");
     DO_TEST("graphics-vnc");
+    if (virtTestRun("QEMU XML-2-XML migratable copy of config listen",
+                    testCompareDefCopyConfigListen, NULL) < 0)
+        ret = -1;
     DO_TEST("graphics-vnc-websocket");
     DO_TEST("graphics-vnc-sasl");
     DO_TEST("graphics-vnc-tls");
@@ -255,6 +417,9 @@ mymain(void)
     DO_TEST("net-virtio-network-portgroup");
     DO_TEST("net-hostdev");
     DO_TEST("net-hostdev-vfio");
+    if (virtTestRun("QEMU XML-2-XML copy of actual hostdev",
+                    testCompareDefCopyActualHostdev, NULL) < 0)
+        ret = -1;
     DO_TEST("net-openvswitch");
     DO_TEST("sound");
     DO_TEST("sound-device");
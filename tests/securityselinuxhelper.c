@@ -178,6 +178,10 @@ int setfilecon_raw(const char *path, VIR_SELINUX_CTX_CONST char *con)
         errno = EOPNOTSUPP;
         return -1;
     }
+    /* Files under labelled/ carry the right label from the start, so
+     * any relabelling of them is turned into a visible mistake */
+    if (STRPREFIX(path, abs_builddir "/securityselinuxlabeldata/labelled/"))
+        constr = "system_u:object_r:relabelled_t:s0";
     return setxattr(path, "user.libvirt.selinux",
                     constr, strlen(constr), 0);
 }
@@ -86,6 +86,7 @@ mymain(void)
 
     DO_TEST("pool-dir");
     DO_TEST("pool-dir-naming");
+    DO_TEST("pool-dir-watch");
     DO_TEST("pool-fs");
     DO_TEST("pool-logical");
     DO_TEST("pool-logical-nopath");
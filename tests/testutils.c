@@ -46,6 +46,7 @@
 #include "dirname.h"
 #include "virprocess.h"
 #include "virstring.h"
+#include "virtime.h"
 
 #ifdef TEST_OOM
 # ifdef TEST_OOM_TRACE
@@ -300,6 +301,38 @@ virtTestRun(const char *title,
     return ret;
 }
 
+/*
+ * Runs @body @loops times, stopping at the first failure. The time it
+ * took is printed if VIR_TEST_DEBUG is set, described by @what.
+ *
+ * returns: -1 = error, 0 = success
+ */
+int
+virtTestBench(const char *what,
+              size_t loops,
+              int (*body)(void *opaque),
+              void *opaque)
+{
+    unsigned long long start, end;
+    size_t i;
+
+    if (virTimeMillisNow(&start) < 0)
+        return -1;
+
+    for (i = 0; i < loops; i++) {
+        if (body(opaque) < 0)
+            return -1;
+    }
+
+    if (virTimeMillisNow(&end) < 0)
+        return -1;
+
+    if (virTestGetDebug())
+        fprintf(stderr, "\n%zu %s took %llu ms\n", loops, what, end - start);
+
+    return 0;
+}
+
 /* Allocate BUF to the size of FILE. Read FILE into buffer BUF.
    Upon any failure, diagnose it and return -1, but don't bother trying
    to preserve errno. Otherwise, return the number of bytes copied into BUF. */
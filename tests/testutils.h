@@ -53,6 +53,10 @@ void virtTestResult(const char *name, int ret, const char *msg, ...)
 int virtTestRun(const char *title,
                 int (*body)(const void *data),
                 const void *data);
+int virtTestBench(const char *what,
+                  size_t loops,
+                  int (*body)(void *opaque),
+                  void *opaque);
 int virtTestLoadFile(const char *file, char **buf);
 int virtTestCaptureProgramOutput(const char *const argv[], char **buf, int maxlen);
 
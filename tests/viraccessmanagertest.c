@@ -0,0 +1,471 @@
+/*
+ * Copyright (C) 2014 Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+
+#include "testutils.h"
+
+#include "datatypes.h"
+#include "access/viraccessmanager.h"
+#include "access/viraccessapicheck.h"
+#include "viridentity.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virstring.h"
+
+#if defined(WITH_DBUS) && defined(__linux__) && WITH_POLKIT1
+# define WITH_MOCK_POLKIT 1
+# include <dbus/dbus.h>
+# include "virmock.h"
+#endif
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.accessmanagertest");
+
+/* Objects whose name starts with "deny" are denied by the mock polkit */
+static const char *testNames[] = {
+    "alpha", "deny-beta", "gamma", "deny-delta", "epsilon",
+};
+#define TEST_NOBJECTS ARRAY_CARDINALITY(testNames)
+
+/* CheckAuthorization requests the mock polkit got */
+static size_t testPolkitCalls;
+
+#ifdef WITH_MOCK_POLKIT
+/* Decides on one CheckAuthorization request, from its details */
+static DBusMessage *
+testPolkitCheckAuthorization(DBusMessage *message)
+{
+    DBusMessage *reply = NULL;
+    DBusMessageIter iter;
+    DBusMessageIter details;
+    DBusMessageIter result;
+    DBusMessageIter sub;
+    dbus_bool_t isAuthorized = TRUE;
+    dbus_bool_t isChallenge = FALSE;
+
+    /* skip the subject and the action ID */
+    if (!dbus_message_iter_init(message, &iter) ||
+        !dbus_message_iter_next(&iter) ||
+        !dbus_message_iter_next(&iter) ||
+        dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY)
+        return NULL;
+
+    dbus_message_iter_recurse(&iter, &details);
+    while (dbus_message_iter_get_arg_type(&details) == DBUS_TYPE_DICT_ENTRY) {
+        DBusMessageIter entry;
+        const char *value;
+
+        dbus_message_iter_recurse(&details, &entry);
+        dbus_message_iter_next(&entry);
+        dbus_message_iter_get_basic(&entry, &value);
+        if (STRPREFIX(value, "deny"))
+            isAuthorized = FALSE;
+        dbus_message_iter_next(&details);
+    }
+
+    if (!(reply = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN)))
+        return NULL;
+
+    dbus_message_iter_init_append(reply, &iter);
+    if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_STRUCT,
+                                          NULL, &result) ||
+        !dbus_message_iter_append_basic(&result, DBUS_TYPE_BOOLEAN,
+                                        &isAuthorized) ||
+        !dbus_message_iter_append_basic(&result, DBUS_TYPE_BOOLEAN,
+                                        &isChallenge) ||
+        !dbus_message_iter_open_container(&result, DBUS_TYPE_ARRAY,
+                                          "{ss}", &sub) ||
+        !dbus_message_iter_close_container(&result, &sub) ||
+        !dbus_message_iter_close_container(&iter, &result)) {
+        dbus_message_unref(reply);
+        return NULL;
+    }
+
+    return reply;
+}
+
+
+/* The reply itself stands for the pending call, it is ready at once */
+VIR_MOCK_IMPL_RET_ARGS(dbus_connection_send_with_reply,
+                       dbus_bool_t,
+                       DBusConnection *, connection,
+                       DBusMessage *, message,
+                       DBusPendingCall **, pending_return,
+                       int, timeout_milliseconds)
+{
+    DBusMessage *reply;
+
+    VIR_MOCK_IMPL_INIT_REAL(dbus_connection_send_with_reply);
+
+    if (STRNEQ(dbus_message_get_member(message), "CheckAuthorization") ||
+        !(reply = testPolkitCheckAuthorization(message)))
+        return FALSE;
+
+    testPolkitCalls++;
+    *pending_return = (DBusPendingCall *) reply;
+    return TRUE;
+}
+
+
+VIR_MOCK_IMPL_RET_ARGS(dbus_pending_call_steal_reply,
+                       DBusMessage *,
+                       DBusPendingCall *, pending)
+{
+    VIR_MOCK_IMPL_INIT_REAL(dbus_pending_call_steal_reply);
+
+    return (DBusMessage *) pending;
+}
+
+
+VIR_MOCK_IMPL_VOID_ARGS(dbus_pending_call_cancel,
+                        DBusPendingCall *, pending)
+{
+    VIR_MOCK_IMPL_INIT_REAL(dbus_pending_call_cancel);
+
+    dbus_message_unref((DBusMessage *) pending);
+}
+#endif /* WITH_MOCK_POLKIT */
+
+
+struct testAccessData {
+    const char **drivers;       /* stacked if there is more than one */
+    bool denies;                /* the "deny" objects are denied */
+    bool polkit;                /* decisions come from the mock polkit */
+};
+
+
+static virAccessManagerPtr
+testAccessManagerNew(const struct testAccessData *data)
+{
+    virAccessManagerPtr mgr;
+
+    if (data->drivers[1])
+        mgr = virAccessManagerNewStack(data->drivers);
+    else
+        mgr = virAccessManagerNew(data->drivers[0]);
+
+    virAccessManagerSetDefault(mgr);
+    return mgr;
+}
+
+
+/*
+ * Checks that the bulk decisions in @bulk match the per-object ones
+ * in @single, and the names of the objects. A bulk filter has to ask
+ * polkit about every object once, as @nbulk tells, and then nothing
+ * once the decisions are cached, as @ncached tells.
+ */
+static int
+testAccessCompare(const struct testAccessData *data,
+                  const char *typename,
+                  const bool *bulk,
+                  const bool *single,
+                  size_t nbulk,
+                  size_t ncached)
+{
+    size_t i;
+
+    for (i = 0; i < TEST_NOBJECTS; i++) {
+        bool allowed = !data->denies || !STRPREFIX(testNames[i], "deny");
+
+        if (bulk[i] != single[i] || bulk[i] != allowed) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           "%s '%s': expected %s, bulk %s, single %s",
+                           typename, testNames[i],
+                           allowed ? "allowed" : "denied",
+                           bulk[i] ? "allowed" : "denied",
+                           single[i] ? "allowed" : "denied");
+            return -1;
+        }
+    }
+
+    if (nbulk != (data->polkit ? TEST_NOBJECTS : 0) || ncached != 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       "%s: expected %zu polkit calls and none cached, "
+                       "got %zu and %zu", typename,
+                       data->polkit ? TEST_NOBJECTS : 0, nbulk, ncached);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testAccessDomains(const struct testAccessData *data,
+                  virConnectPtr conn)
+{
+    virAccessManagerPtr mgr = NULL;
+    virDomainDefPtr defs[TEST_NOBJECTS] = { NULL };
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    bool bulk[TEST_NOBJECTS];
+    bool single[TEST_NOBJECTS];
+    bool cached[TEST_NOBJECTS];
+    size_t nbulk;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_NOBJECTS; i++) {
+        memset(uuid, i + 1, sizeof(uuid));
+        if (!(defs[i] = virDomainDefNew(testNames[i], uuid, i + 1)))
+            goto cleanup;
+    }
+
+    /* Separate managers, so that no decision comes from the cache */
+    if (!(mgr = testAccessManagerNew(data)))
+        goto cleanup;
+    testPolkitCalls = 0;
+    if (virConnectListAllDomainsCheckACLBulk(conn, defs, TEST_NOBJECTS,
+                                             bulk) < 0)
+        goto cleanup;
+    nbulk = testPolkitCalls;
+    virObjectUnref(mgr);
+    mgr = NULL;
+
+    if (!(mgr = testAccessManagerNew(data)))
+        goto cleanup;
+    for (i = 0; i < TEST_NOBJECTS; i++)
+        single[i] = virConnectListAllDomainsCheckACL(conn, defs[i]);
+
+    testPolkitCalls = 0;
+    if (virConnectListAllDomainsCheckACLBulk(conn, defs, TEST_NOBJECTS,
+                                             cached) < 0 ||
+        testAccessCompare(data, "domain", cached, single, nbulk,
+                          testPolkitCalls) < 0 ||
+        testAccessCompare(data, "domain", bulk, single, nbulk, 0) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < TEST_NOBJECTS; i++)
+        virDomainDefFree(defs[i]);
+    virAccessManagerSetDefault(NULL);
+    virObjectUnref(mgr);
+    return ret;
+}
+
+
+static int
+testAccessNetworks(const struct testAccessData *data,
+                   virConnectPtr conn)
+{
+    virAccessManagerPtr mgr = NULL;
+    virNetworkDefPtr defs[TEST_NOBJECTS] = { NULL };
+    bool bulk[TEST_NOBJECTS];
+    bool single[TEST_NOBJECTS];
+    bool cached[TEST_NOBJECTS];
+    size_t nbulk;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_NOBJECTS; i++) {
+        if (VIR_ALLOC(defs[i]) < 0 ||
+            VIR_STRDUP(defs[i]->name, testNames[i]) < 0)
+            goto cleanup;
+        memset(defs[i]->uuid, i + 1, sizeof(defs[i]->uuid));
+    }
+
+    if (!(mgr = testAccessManagerNew(data)))
+        goto cleanup;
+    testPolkitCalls = 0;
+    if (virConnectListAllNetworksCheckACLBulk(conn, defs, TEST_NOBJECTS,
+                                              bulk) < 0)
+        goto cleanup;
+    nbulk = testPolkitCalls;
+    virObjectUnref(mgr);
+    mgr = NULL;
+
+    if (!(mgr = testAccessManagerNew(data)))
+        goto cleanup;
+    for (i = 0; i < TEST_NOBJECTS; i++)
+        single[i] = virConnectListAllNetworksCheckACL(conn, defs[i]);
+
+    testPolkitCalls = 0;
+    if (virConnectListAllNetworksCheckACLBulk(conn, defs, TEST_NOBJECTS,
+                                              cached) < 0 ||
+        testAccessCompare(data, "network", cached, single, nbulk,
+                          testPolkitCalls) < 0 ||
+        testAccessCompare(data, "network", bulk, single, nbulk, 0) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < TEST_NOBJECTS; i++)
+        virNetworkDefFree(defs[i]);
+    virAccessManagerSetDefault(NULL);
+    virObjectUnref(mgr);
+    return ret;
+}
+
+
+static int
+testAccessStoragePools(const struct testAccessData *data,
+                       virConnectPtr conn)
+{
+    virAccessManagerPtr mgr = NULL;
+    virStoragePoolDefPtr defs[TEST_NOBJECTS] = { NULL };
+    bool bulk[TEST_NOBJECTS];
+    bool single[TEST_NOBJECTS];
+    bool cached[TEST_NOBJECTS];
+    size_t nbulk;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < TEST_NOBJECTS; i++) {
+        if (VIR_ALLOC(defs[i]) < 0 ||
+            VIR_STRDUP(defs[i]->name, testNames[i]) < 0)
+            goto cleanup;
+        memset(defs[i]->uuid, i + 1, sizeof(defs[i]->uuid));
+    }
+
+    if (!(mgr = testAccessManagerNew(data)))
+        goto cleanup;
+    testPolkitCalls = 0;
+    if (virConnectListAllStoragePoolsCheckACLBulk(conn, defs, TEST_NOBJECTS,
+                                                  bulk) < 0)
+        goto cleanup;
+    nbulk = testPolkitCalls;
+    virObjectUnref(mgr);
+    mgr = NULL;
+
+    if (!(mgr = testAccessManagerNew(data)))
+        goto cleanup;
+    for (i = 0; i < TEST_NOBJECTS; i++)
+        single[i] = virConnectListAllStoragePoolsCheckACL(conn, defs[i]);
+
+    testPolkitCalls = 0;
+    if (virConnectListAllStoragePoolsCheckACLBulk(conn, defs, TEST_NOBJECTS,
+                                                  cached) < 0 ||
+        testAccessCompare(data, "storage pool", cached, single, nbulk,
+                          testPolkitCalls) < 0 ||
+        testAccessCompare(data, "storage pool", bulk, single, nbulk, 0) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < TEST_NOBJECTS; i++)
+        virStoragePoolDefFree(defs[i]);
+    virAccessManagerSetDefault(NULL);
+    virObjectUnref(mgr);
+    return ret;
+}
+
+
+static int
+testConnectClose(virConnectPtr conn ATTRIBUTE_UNUSED)
+{
+    return 0;
+}
+
+static virDriver testDriver = {
+    .no = VIR_DRV_TEST,
+    .name = "QEMU",
+    .connectClose = testConnectClose,
+};
+
+static int
+testAccessBulk(const void *opaque)
+{
+    const struct testAccessData *data = opaque;
+    virConnectPtr conn;
+    int ret = -1;
+
+    if (!(conn = virGetConnect()))
+        return -1;
+    conn->driver = &testDriver;
+
+    if (testAccessDomains(data, conn) < 0 ||
+        testAccessNetworks(data, conn) < 0 ||
+        testAccessStoragePools(data, conn) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(conn);
+    return ret;
+}
+
+
+/* The polkit driver decides on behalf of the current identity */
+static int
+testAccessSetIdentity(void)
+{
+    virIdentityPtr ident;
+    int ret = -1;
+
+    if (!(ident = virIdentityNew()))
+        return -1;
+
+    if (virIdentitySetAttr(ident, VIR_IDENTITY_ATTR_UNIX_PROCESS_ID,
+                           "1234") < 0 ||
+        virIdentitySetAttr(ident, VIR_IDENTITY_ATTR_UNIX_PROCESS_TIME,
+                           "5678") < 0 ||
+        virIdentitySetAttr(ident, VIR_IDENTITY_ATTR_UNIX_USER_ID,
+                           "1000") < 0 ||
+        virIdentitySetCurrent(ident) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnref(ident);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (testAccessSetIdentity() < 0)
+        return EXIT_FAILURE;
+
+#define DO_TEST(name, denies, polkit, ...)                              \
+    do {                                                                \
+        const char *drivers[] = { __VA_ARGS__, NULL };                  \
+        struct testAccessData data = { drivers, denies, polkit };       \
+        if (virtTestRun("Bulk ACL filter " name, testAccessBulk,        \
+                        &data) < 0)                                     \
+            ret = -1;                                                   \
+    } while (0)
+
+    DO_TEST("nop", false, false, "nop");
+    DO_TEST("stack nop", false, false, "nop", "nop");
+#ifdef WITH_MOCK_POLKIT
+    DO_TEST("polkit", true, true, "polkit");
+    DO_TEST("stack nop polkit", true, true, "nop", "polkit");
+#endif
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifdef WITH_MOCK_POLKIT
+VIRT_TEST_MAIN_PRELOAD(mymain, abs_builddir "/.libs/virmockdbus.so")
+#else
+VIRT_TEST_MAIN(mymain)
+#endif
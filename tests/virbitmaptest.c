@@ -509,6 +509,35 @@ test9(const void *opaque ATTRIBUTE_UNUSED)
 
 }
 
+/* test virBitmapSubtract */
+static int
+test10(const void *opaque ATTRIBUTE_UNUSED)
+{
+    int ret = -1;
+    virBitmapPtr a = NULL;
+    virBitmapPtr b = NULL;
+    char *str = NULL;
+
+    if (virBitmapParse("0-3,64-67,99", 0, &a, 100) < 0 ||
+        virBitmapParse("1,3,65,70", 0, &b, 100) < 0)
+        goto cleanup;
+
+    virBitmapSubtract(a, b);
+
+    if (!(str = virBitmapFormat(a)))
+        goto cleanup;
+
+    if (STRNEQ(str, "0,2,64,66-67,99"))
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virBitmapFree(a);
+    virBitmapFree(b);
+    VIR_FREE(str);
+    return ret;
+}
+
 static int
 mymain(void)
 {
@@ -532,6 +561,8 @@ mymain(void)
         ret = -1;
     if (virtTestRun("test9", test9, NULL) < 0)
         ret = -1;
+    if (virtTestRun("test10", test10, NULL) < 0)
+        ret = -1;
 
     return ret;
 }
@@ -200,6 +200,118 @@ static int testBufTrim(const void *data ATTRIBUTE_UNUSED)
     return ret;
 }
 
+static int testBufEscapeString(const void *data ATTRIBUTE_UNUSED)
+{
+    virBuffer bufinit = VIR_BUFFER_INITIALIZER;
+    virBufferPtr buf = &bufinit;
+    const char expected[] =
+        "  <name>a&lt;b&gt;&amp;c</name>\n"
+        "  <desc q='&apos;&quot;tab\there'/>\n"
+        "  %plain\n"
+        "  x=dropped\n";
+    char *result = NULL;
+    int ret = -1;
+
+    virBufferAdjustIndent(buf, 2);
+    virBufferEscapeString(buf, "<name>%s</name>\n", "a<b>&c");
+    virBufferEscapeString(buf, "<desc q='%s'/>\n", "'\"tab\there");
+    virBufferEscapeString(buf, "<skipped>%s</skipped>\n", NULL);
+    virBufferEscapeString(buf, "%%%s\n", "plain");
+    virBufferEscapeString(buf, "x=%s\n", "drop\001ped");
+
+    if (virBufferError(buf)) {
+        TEST_ERROR("Buffer had error");
+        goto cleanup;
+    }
+
+    result = virBufferContentAndReset(buf);
+    if (!result || STRNEQ(result, expected)) {
+        virtTestDifference(stderr, expected, result);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(result);
+    return ret;
+}
+
+#define FORMAT_BENCH_DEVICES 2000
+#define FORMAT_BENCH_LOOPS 50
+
+struct testBufFormatBenchData {
+    char *first;
+    char *result;
+};
+
+static int testBufFormatBenchOne(void *opaque)
+{
+    struct testBufFormatBenchData *data = opaque;
+    virBuffer bufinit = VIR_BUFFER_INITIALIZER;
+    virBufferPtr buf = &bufinit;
+    size_t i;
+
+    VIR_FREE(data->result);
+
+    virBufferAddLit(buf, "<domain type='kvm'>\n");
+    virBufferAdjustIndent(buf, 2);
+    virBufferEscapeString(buf, "<name>%s</name>\n", "bench");
+    virBufferEscapeString(buf, "<description>%s</description>\n",
+                          "Guest <bench> & friends");
+    virBufferAddLit(buf, "<devices>\n");
+    virBufferAdjustIndent(buf, 2);
+    for (i = 0; i < FORMAT_BENCH_DEVICES; i++) {
+        virBufferAddLit(buf, "<disk type='file' device='disk'>\n");
+        virBufferAdjustIndent(buf, 2);
+        virBufferAddLit(buf, "<driver name='qemu' type='qcow2'/>\n");
+        virBufferEscapeString(buf, "<source file='%s'/>\n",
+                              "/var/lib/libvirt/images/bench-disk.qcow2");
+        virBufferAsprintf(buf, "<target dev='vd%zu' bus='virtio'/>\n", i);
+        virBufferEscapeString(buf, "<serial>%s</serial>\n",
+                              "serial'with\"quotes&amp");
+        virBufferAdjustIndent(buf, -2);
+        virBufferAddLit(buf, "</disk>\n");
+    }
+    virBufferAdjustIndent(buf, -2);
+    virBufferAddLit(buf, "</devices>\n");
+    virBufferAdjustIndent(buf, -2);
+    virBufferAddLit(buf, "</domain>\n");
+
+    if (virBufferError(buf)) {
+        TEST_ERROR("Buffer had error");
+        virBufferFreeAndReset(buf);
+        return -1;
+    }
+
+    data->result = virBufferContentAndReset(buf);
+    if (!data->first)
+        return VIR_STRDUP(data->first, data->result) < 0 ? -1 : 0;
+
+    if (STRNEQ(data->first, data->result)) {
+        virtTestDifference(stderr, data->first, data->result);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Builds a large document the way virDomainDefFormat does, one element
+ * at a time with a mix of literal, printf and escaped appends, so that
+ * the buffer grows many times along the escaping fast path. Every
+ * round has to produce exactly the document of the first one. */
+static int testBufFormatBench(const void *opaque ATTRIBUTE_UNUSED)
+{
+    struct testBufFormatBenchData data = { NULL, NULL };
+    int ret;
+
+    ret = virtTestBench("documents", FORMAT_BENCH_LOOPS,
+                        testBufFormatBenchOne, &data);
+
+    VIR_FREE(data.first);
+    VIR_FREE(data.result);
+    return ret;
+}
+
 
 static int
 mymain(void)
@@ -218,6 +330,8 @@ mymain(void)
     DO_TEST("VSprintf infinite loop", testBufInfiniteLoop, 0);
     DO_TEST("Auto-indentation", testBufAutoIndent, 0);
     DO_TEST("Trim", testBufTrim, 0);
+    DO_TEST("EscapeString", testBufEscapeString, 0);
+    DO_TEST("Format benchmark", testBufFormatBench, 0);
 
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -464,6 +464,56 @@ static int testCgroupNewForPartitionDomainEscaped(const void *args ATTRIBUTE_UNU
     return ret;
 }
 
+static int testCgroupNewVcpus(const void *args ATTRIBUTE_UNUSED)
+{
+    virCgroupPtr partitioncgroup = NULL;
+    virCgroupPtr domaincgroup = NULL;
+    virCgroupPtr *vcpucgroups = NULL;
+    char *cpus[] = { NULL, (char *)"1", NULL };
+    const char *expected[] = { "0-1", "1", "0-1" };
+    char *value = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (virCgroupNewPartition("/production", true, -1, &partitioncgroup) < 0 ||
+        virCgroupNewDomainPartition(partitioncgroup, "qemu", "bar", true,
+                                    &domaincgroup) < 0) {
+        fprintf(stderr, "Cannot create domain cgroup\n");
+        goto cleanup;
+    }
+
+    if (virCgroupNewVcpus(domaincgroup, ARRAY_CARDINALITY(cpus),
+                          cpus, &vcpucgroups) < 0) {
+        fprintf(stderr, "Cannot create vcpu cgroups\n");
+        goto cleanup;
+    }
+
+    for (i = 0; i < ARRAY_CARDINALITY(cpus); i++) {
+        if (virCgroupGetCpusetCpus(vcpucgroups[i], &value) < 0)
+            goto cleanup;
+
+        if (STRNEQ(value, expected[i])) {
+            fprintf(stderr, "Wrong cpuset.cpus for vcpu%zu: '%s' != '%s'\n",
+                    i, value, expected[i]);
+            goto cleanup;
+        }
+        VIR_FREE(value);
+    }
+
+    ret = 0;
+
+ cleanup:
+    if (vcpucgroups) {
+        for (i = 0; i < ARRAY_CARDINALITY(cpus); i++)
+            virCgroupFree(&vcpucgroups[i]);
+        VIR_FREE(vcpucgroups);
+    }
+    VIR_FREE(value);
+    virCgroupFree(&partitioncgroup);
+    virCgroupFree(&domaincgroup);
+    return ret;
+}
+
 static int testCgroupNewForSelfAllInOne(const void *args ATTRIBUTE_UNUSED)
 {
     virCgroupPtr cgroup = NULL;
@@ -788,6 +838,9 @@ mymain(void)
     if (virtTestRun("New cgroup for domain partition escaped", testCgroupNewForPartitionDomainEscaped, NULL) < 0)
         ret = -1;
 
+    if (virtTestRun("New cgroups for vcpus", testCgroupNewVcpus, NULL) < 0)
+        ret = -1;
+
     if (virtTestRun("Cgroup available", testCgroupAvailable, (void*)0x1) < 0)
         ret = -1;
 
@@ -472,6 +472,76 @@ static int testMessageDict(const void *args ATTRIBUTE_UNUSED)
 }
 
 
+static int testMessageDictRef(const void *args ATTRIBUTE_UNUSED)
+{
+    DBusMessage *msg = NULL;
+    int ret = -1;
+    const char *in_str1 = "Hello";
+    const char *in_strv1[] = {
+        "Fruit1", "Apple",
+        "Fruit2", "Orange",
+        "Fruit3", "Kiwi",
+    };
+    const char *in_str2 = "World";
+    char *out_str1 = NULL, *out_str2 = NULL;
+    char *out_key1 = NULL, *out_key2 = NULL, *out_key3 = NULL;
+    char *out_val1 = NULL, *out_val2 = NULL, *out_val3 = NULL;
+
+    if (!(msg = dbus_message_new_method_call("org.libvirt.test",
+                                             "/org/libvirt/test",
+                                             "org.libvirt.test.astrochicken",
+                                             "cluck"))) {
+        VIR_DEBUG("Failed to allocate method call");
+        goto cleanup;
+    }
+
+    if (virDBusMessageEncode(msg,
+                             "sa&{ss}s",
+                             in_str1,
+                             3, in_strv1,
+                             in_str2) < 0) {
+        VIR_DEBUG("Failed to encode arguments");
+        goto cleanup;
+    }
+
+    if (virDBusMessageDecode(msg,
+                             "sa{ss}s",
+                             &out_str1,
+                             3,
+                             &out_key1, &out_val1,
+                             &out_key2, &out_val2,
+                             &out_key3, &out_val3,
+                             &out_str2) < 0) {
+        VIR_DEBUG("Failed to decode arguments");
+        goto cleanup;
+    }
+
+
+    VERIFY_STR("str1", in_str1, out_str1, "%s");
+    VERIFY_STR("key1", in_strv1[0], out_key1, "%s");
+    VERIFY_STR("val1", in_strv1[1], out_val1, "%s");
+    VERIFY_STR("key2", in_strv1[2], out_key2, "%s");
+    VERIFY_STR("val2", in_strv1[3], out_val2, "%s");
+    VERIFY_STR("key3", in_strv1[4], out_key3, "%s");
+    VERIFY_STR("val3", in_strv1[5], out_val3, "%s");
+    VERIFY_STR("str2", in_str2, out_str2, "%s");
+
+    ret = 0;
+
+ cleanup:
+    VIR_FREE(out_str1);
+    VIR_FREE(out_str2);
+    VIR_FREE(out_key1);
+    VIR_FREE(out_key2);
+    VIR_FREE(out_key3);
+    VIR_FREE(out_val1);
+    VIR_FREE(out_val2);
+    VIR_FREE(out_val3);
+    dbus_message_unref(msg);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -489,6 +559,8 @@ mymain(void)
         ret = -1;
     if (virtTestRun("Test message dict ", testMessageDict, NULL) < 0)
         ret = -1;
+    if (virtTestRun("Test message dict ref ", testMessageDictRef, NULL) < 0)
+        ret = -1;
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
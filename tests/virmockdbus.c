@@ -61,4 +61,46 @@ VIR_MOCK_LINK_RET_ARGS(dbus_connection_send_with_reply_and_block,
                        int, timeout_milliseconds,
                        DBusError *, error)
 
+VIR_MOCK_STUB_VOID_ARGS(dbus_bus_add_match,
+                        DBusConnection *, connection,
+                        const char *, rule,
+                        DBusError *, error)
+
+VIR_MOCK_STUB_VOID_ARGS(dbus_bus_remove_match,
+                        DBusConnection *, connection,
+                        const char *, rule,
+                        DBusError *, error)
+
+VIR_MOCK_STUB_RET_ARGS(dbus_connection_add_filter,
+                       dbus_bool_t, 1,
+                       DBusConnection *, connection,
+                       DBusHandleMessageFunction, function,
+                       void *, user_data,
+                       DBusFreeFunction, free_data_function)
+
+VIR_MOCK_STUB_VOID_ARGS(dbus_connection_remove_filter,
+                        DBusConnection *, connection,
+                        DBusHandleMessageFunction, function,
+                        void *, user_data)
+
+VIR_MOCK_LINK_RET_ARGS(dbus_connection_send_with_reply,
+                       dbus_bool_t,
+                       DBusConnection *, connection,
+                       DBusMessage *, message,
+                       DBusPendingCall **, pending_return,
+                       int, timeout_milliseconds)
+
+VIR_MOCK_STUB_VOID_ARGS(dbus_pending_call_block,
+                        DBusPendingCall *, pending)
+
+VIR_MOCK_LINK_RET_ARGS(dbus_pending_call_steal_reply,
+                       DBusMessage *,
+                       DBusPendingCall *, pending)
+
+VIR_MOCK_STUB_VOID_ARGS(dbus_pending_call_unref,
+                        DBusPendingCall *, pending)
+
+VIR_MOCK_LINK_VOID_ARGS(dbus_pending_call_cancel,
+                        DBusPendingCall *, pending)
+
 #endif /* WITH_DBUS && !WIN32 */
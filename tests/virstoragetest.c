@@ -21,6 +21,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include <sys/time.h>
 
 #include "testutils.h"
 #include "vircommand.h"
@@ -32,6 +33,7 @@
 #include "dirname.h"
 
 #include "storage/storage_driver.h"
+#include "storage/storage_driverpriv.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -655,6 +657,228 @@ testPathRelative(const void *args)
 }
 
 
+/* Header cache sizes used below, large enough for three entries of
+ * CACHE_TEST_LEN bytes but not for four */
+#define CACHE_TEST_LEN 4096
+#define CACHE_TEST_MAX_BYTES (3 * CACHE_TEST_LEN + 1024)
+
+static int
+testCacheWriteFile(const char *path, size_t len, struct stat *st)
+{
+    char *buf = NULL;
+    int ret = -1;
+
+    if (virAsprintf(&buf, "%*d", (int) len, 0) < 0)
+        return -1;
+
+    if (virFileWriteStr(path, buf, 0600) < 0 ||
+        stat(path, st) < 0) {
+        fprintf(stderr, "unable to create %s\n", path);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(buf);
+    return ret;
+}
+
+/* Looks up @name and checks that it is a hit or miss as expected */
+static int
+testCacheCheck(const char *name, const struct stat *st, bool hit)
+{
+    char *buf = NULL;
+    ssize_t len = -1;
+    int rc;
+
+    if ((rc = virStorageMetadataCacheLookup(name, st, &buf, &len)) < 0)
+        return -1;
+    VIR_FREE(buf);
+
+    if (rc != hit) {
+        fprintf(stderr, "expected cache %s for %s\n",
+                hit ? "hit" : "miss", name);
+        return -1;
+    }
+    return 0;
+}
+
+
+static int
+testMetadataCacheHit(const void *args ATTRIBUTE_UNUSED)
+{
+    struct stat st;
+    char *buf = NULL;
+    ssize_t len = -1;
+    int ret = -1;
+
+    virStorageMetadataCacheSetLimits(CACHE_TEST_MAX_BYTES, 0);
+
+    if (testCacheWriteFile("cache1", CACHE_TEST_LEN, &st) < 0)
+        goto cleanup;
+
+    if (testCacheCheck("cache1", &st, false) < 0)
+        goto cleanup;
+
+    virStorageMetadataCacheStore("cache1", &st, "header", 6);
+    if (virStorageMetadataCacheLookup("cache1", &st, &buf, &len) != 1 ||
+        len != 6 || memcmp(buf, "header", 6) != 0) {
+        fprintf(stderr, "cached header not served\n");
+        goto cleanup;
+    }
+
+    /* Images which changed too recently are not cached */
+    virStorageMetadataCacheSetLimits(CACHE_TEST_MAX_BYTES, 60 * 1000);
+    virStorageMetadataCacheStore("cache1", &st, "header", 6);
+    if (testCacheCheck("cache1", &st, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(buf);
+    return ret;
+}
+
+
+static int
+testMetadataCacheChanged(const void *args ATTRIBUTE_UNUSED)
+{
+    struct stat st;
+    struct timeval tv[2];
+
+    virStorageMetadataCacheSetLimits(CACHE_TEST_MAX_BYTES, 0);
+
+    /* Size change */
+    if (testCacheWriteFile("cache1", CACHE_TEST_LEN, &st) < 0)
+        return -1;
+    virStorageMetadataCacheStore("cache1", &st, "header", 6);
+    if (testCacheWriteFile("cache1", CACHE_TEST_LEN * 2, &st) < 0 ||
+        testCacheCheck("cache1", &st, false) < 0)
+        return -1;
+
+    /* Timestamp change with the size kept */
+    virStorageMetadataCacheStore("cache1", &st, "header", 6);
+    if (testCacheCheck("cache1", &st, true) < 0)
+        return -1;
+
+    tv[0].tv_sec = tv[1].tv_sec = st.st_mtime - 3600;
+    tv[0].tv_usec = tv[1].tv_usec = 0;
+    if (utimes("cache1", tv) < 0 || stat("cache1", &st) < 0) {
+        fprintf(stderr, "unable to change timestamps of cache1\n");
+        return -1;
+    }
+    if (testCacheCheck("cache1", &st, false) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+testMetadataCacheEvict(const void *args ATTRIBUTE_UNUSED)
+{
+    const char *names[] = { "cache1", "cache2", "cache3", "cache4" };
+    struct stat st[ARRAY_CARDINALITY(names)];
+    char *buf = NULL;
+    size_t i;
+    int ret = -1;
+
+    virStorageMetadataCacheSetLimits(CACHE_TEST_MAX_BYTES, 0);
+
+    if (virAsprintf(&buf, "%*d", CACHE_TEST_LEN, 0) < 0)
+        return -1;
+
+    for (i = 0; i < ARRAY_CARDINALITY(names); i++) {
+        if (testCacheWriteFile(names[i], CACHE_TEST_LEN, &st[i]) < 0)
+            goto cleanup;
+    }
+
+    for (i = 0; i < 3; i++)
+        virStorageMetadataCacheStore(names[i], &st[i], buf, CACHE_TEST_LEN);
+
+    /* Using cache1 makes cache2 the least recently used one, which
+     * then has to make room for cache4, alone */
+    if (testCacheCheck("cache1", &st[0], true) < 0)
+        goto cleanup;
+    virStorageMetadataCacheStore(names[3], &st[3], buf, CACHE_TEST_LEN);
+
+    if (testCacheCheck("cache2", &st[1], false) < 0 ||
+        testCacheCheck("cache1", &st[0], true) < 0 ||
+        testCacheCheck("cache3", &st[2], true) < 0 ||
+        testCacheCheck("cache4", &st[3], true) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_FREE(buf);
+    return ret;
+}
+
+
+/* Image changes made by libvirt itself must drop the cached headers:
+ * deleting, resizing and wiping a volume drop the volume alone, while
+ * re-detecting a disk's chain after a block job drops the whole chain */
+static int
+testMetadataCacheInvalidate(const void *args ATTRIBUTE_UNUSED)
+{
+    virCommandPtr cmd = NULL;
+    virStorageSourcePtr chain = NULL;
+    virStorageSource vol = {
+        .type = VIR_STORAGE_TYPE_FILE,
+        .path = (char *) datadir "/cachetop",
+    };
+    char *canontop = NULL;
+    struct stat sttop;
+    struct stat straw;
+    int ret = -1;
+
+    virStorageMetadataCacheSetLimits(CACHE_TEST_MAX_BYTES, 0);
+
+    cmd = virCommandNewArgList(qemuimg, "create", "-f", "qcow2",
+                               "-obacking_file=raw,backing_fmt=raw",
+                               "cachetop", NULL);
+    if (virCommandRun(cmd, NULL) < 0)
+        goto cleanup;
+
+    if (!(canontop = canonicalize_file_name(vol.path))) {
+        virReportOOMError();
+        goto cleanup;
+    }
+    if (stat(canontop, &sttop) < 0 || stat(canonraw, &straw) < 0)
+        goto cleanup;
+
+    /* volume delete, resize and wipe */
+    if (!(chain = testStorageFileGetMetadata(vol.path, VIR_STORAGE_FILE_QCOW2,
+                                             -1, -1, false)))
+        goto cleanup;
+    if (testCacheCheck(canontop, &sttop, true) < 0 ||
+        testCacheCheck(canonraw, &straw, true) < 0)
+        goto cleanup;
+
+    virStorageFileMetadataCacheInvalidate(&vol);
+    if (testCacheCheck(canontop, &sttop, false) < 0 ||
+        testCacheCheck(canonraw, &straw, true) < 0)
+        goto cleanup;
+
+    /* block job re-detection */
+    virStorageSourceFree(chain);
+    if (!(chain = testStorageFileGetMetadata(vol.path, VIR_STORAGE_FILE_QCOW2,
+                                             -1, -1, false)))
+        goto cleanup;
+    virStorageFileMetadataCacheInvalidate(chain);
+    if (testCacheCheck(canontop, &sttop, false) < 0 ||
+        testCacheCheck(canonraw, &straw, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    virStorageSourceFree(chain);
+    virCommandFree(cmd);
+    VIR_FREE(canontop);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -1185,6 +1409,18 @@ mymain(void)
     TEST_RELATIVE_BACKING(21, backingchain[10], backingchain[11], "../../../../blah/image4");
     TEST_RELATIVE_BACKING(22, backingchain[11], backingchain[11], "../blah/image4");
 
+    if (virtTestRun("Metadata cache hit", testMetadataCacheHit, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Metadata cache changed image",
+                    testMetadataCacheChanged, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Metadata cache eviction",
+                    testMetadataCacheEvict, NULL) < 0)
+        ret = -1;
+    if (virtTestRun("Metadata cache invalidation",
+                    testMetadataCacheInvalidate, NULL) < 0)
+        ret = -1;
+
  cleanup:
     /* Final cleanup */
     virStorageSourceFree(chain);
@@ -472,6 +472,150 @@ cmdSnapshotCreateAs(vshControl *ctl, const vshCmd *cmd)
     return ret;
 }
 
+/*
+ * "snapshot-create-group" command
+ */
+static const vshCmdInfo info_snapshot_create_group[] = {
+    {.name = "help",
+     .data = N_("Create a disk snapshot of several domains at once")
+    },
+    {.name = "desc",
+     .data = N_("Create a disk snapshot of each domain, all taken at the "
+                "same point in time")
+    },
+    {.name = NULL}
+};
+
+static const vshCmdOptDef opts_snapshot_create_group[] = {
+    {.name = "name",
+     .type = VSH_OT_STRING,
+     .help = N_("name of the snapshot of each domain")
+    },
+    {.name = "description",
+     .type = VSH_OT_STRING,
+     .help = N_("description of the snapshot of each domain")
+    },
+    {.name = "no-metadata",
+     .type = VSH_OT_BOOL,
+     .help = N_("take snapshots but create no metadata")
+    },
+    {.name = "reuse-external",
+     .type = VSH_OT_BOOL,
+     .help = N_("reuse any existing external files")
+    },
+    {.name = "quiesce",
+     .type = VSH_OT_BOOL,
+     .help = N_("quiesce the file systems of every guest")
+    },
+    {.name = "atomic",
+     .type = VSH_OT_BOOL,
+     .help = N_("require atomic operation")
+    },
+    {.name = "domain",
+     .type = VSH_OT_ARGV,
+     .flags = VSH_OFLAG_REQ,
+     .help = N_("domain name, id or uuid")
+    },
+    {.name = NULL}
+};
+
+static bool
+cmdSnapshotCreateGroup(vshControl *ctl, const vshCmd *cmd)
+{
+    virDomainPtr *doms = NULL;
+    const char **xmlDescs = NULL;
+    virDomainSnapshotPtr *snapshots = NULL;
+    size_t ndoms = 0;
+    bool ret = false;
+    char *buffer = NULL;
+    const char *name = NULL;
+    const char *desc = NULL;
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    unsigned int flags = VIR_DOMAIN_SNAPSHOT_CREATE_DISK_ONLY;
+    const vshCmdOpt *opt = NULL;
+    size_t i;
+
+    if (vshCommandOptBool(cmd, "no-metadata"))
+        flags |= VIR_DOMAIN_SNAPSHOT_CREATE_NO_METADATA;
+    if (vshCommandOptBool(cmd, "reuse-external"))
+        flags |= VIR_DOMAIN_SNAPSHOT_CREATE_REUSE_EXT;
+    if (vshCommandOptBool(cmd, "quiesce"))
+        flags |= VIR_DOMAIN_SNAPSHOT_CREATE_QUIESCE;
+    if (vshCommandOptBool(cmd, "atomic"))
+        flags |= VIR_DOMAIN_SNAPSHOT_CREATE_ATOMIC;
+
+    if (vshCommandOptStringReq(ctl, cmd, "name", &name) < 0 ||
+        vshCommandOptStringReq(ctl, cmd, "description", &desc) < 0)
+        return false;
+
+    while ((opt = vshCommandOptArgv(cmd, opt)))
+        ndoms++;
+
+    doms = vshCalloc(ctl, ndoms, sizeof(*doms));
+    for (i = 0; (opt = vshCommandOptArgv(cmd, opt)); i++) {
+        if (!(doms[i] = vshLookupDomainBy(ctl, opt->data,
+                                          VSH_BYID | VSH_BYUUID |
+                                          VSH_BYNAME)))
+            goto cleanup;
+    }
+
+    /* Every domain gets the same snapshot description */
+    virBufferAddLit(&buf, "<domainsnapshot>\n");
+    virBufferAdjustIndent(&buf, 2);
+    virBufferEscapeString(&buf, "<name>%s</name>\n", name);
+    virBufferEscapeString(&buf, "<description>%s</description>\n", desc);
+    virBufferAdjustIndent(&buf, -2);
+    virBufferAddLit(&buf, "</domainsnapshot>\n");
+
+    if (virBufferError(&buf)) {
+        vshError(ctl, "%s", _("Out of memory"));
+        goto cleanup;
+    }
+
+    buffer = virBufferContentAndReset(&buf);
+
+    xmlDescs = vshCalloc(ctl, ndoms, sizeof(*xmlDescs));
+    for (i = 0; i < ndoms; i++)
+        xmlDescs[i] = buffer;
+
+    if (virDomainSnapshotCreateGroup(doms, xmlDescs, ndoms,
+                                     &snapshots, flags) < 0)
+        goto cleanup;
+
+    for (i = 0; i < ndoms; i++) {
+        const char *snapname = virDomainSnapshotGetName(snapshots[i]);
+
+        if (!snapname) {
+            vshError(ctl, "%s", _("Could not get snapshot name"));
+            goto cleanup;
+        }
+
+        if (i > 0)
+            vshPrint(ctl, "\n");
+        vshPrint(ctl, _("Domain snapshot %s created for %s"),
+                 snapname, virDomainGetName(doms[i]));
+    }
+
+    ret = true;
+
+ cleanup:
+    if (snapshots) {
+        for (i = 0; i < ndoms; i++)
+            virDomainSnapshotFree(snapshots[i]);
+        VIR_FREE(snapshots);
+    }
+    for (i = 0; i < ndoms && doms; i++) {
+        if (doms[i])
+            virDomainFree(doms[i]);
+    }
+    VIR_FREE(doms);
+    VIR_FREE(xmlDescs);
+    virBufferFreeAndReset(&buf);
+    VIR_FREE(buffer);
+
+    return ret;
+}
+
 /* Helper for resolving {--current | --ARG name} into a snapshot
  * belonging to DOM.  If EXCLUSIVE, fail if both --current and arg are
  * present.  On success, populate *SNAP and *NAME, before returning 0.
@@ -2020,6 +2164,12 @@ const vshCmdDef snapshotCmds[] = {
      .info = info_snapshot_create_as,
      .flags = 0
     },
+    {.name = "snapshot-create-group",
+     .handler = cmdSnapshotCreateGroup,
+     .opts = opts_snapshot_create_group,
+     .info = info_snapshot_create_group,
+     .flags = 0
+    },
     {.name = "snapshot-current",
      .handler = cmdSnapshotCurrent,
      .opts = opts_snapshot_current,